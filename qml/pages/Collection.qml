@@ -574,6 +574,8 @@ Page {
                 ListElement { itemtext: QT_TR_NOOP("Split");                 itemicon: "image://theme/icon-m-flip"; action: "split";}
                 //: track edit menu
                 ListElement { itemtext: QT_TR_NOOP("Drop inaccurate nodes"); itemicon: "image://theme/icon-m-reset"; action: "filter";}
+                //: track edit menu
+                ListElement { itemtext: QT_TR_NOOP("Archive");               itemicon: "image://theme/icon-m-folder"; action: "archive";}
             }
 
             delegate: ListItem{
@@ -600,6 +602,12 @@ Page {
                                             trackId: editTrackDialog.itemId,
                                             acceptPage: collectionPage
                                        });
+                    } else if (action == "archive"){
+                        pageStack.push(Qt.resolvedUrl("TrackArchive.qml"),
+                                       {
+                                            trackId: editTrackDialog.itemId,
+                                            acceptPage: collectionPage
+                                       });
                     } else {
                         pageStack.push(Qt.resolvedUrl("TrackEdit.qml"),
                                        {
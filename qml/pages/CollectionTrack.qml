@@ -53,15 +53,15 @@ Dialog{
 
         onLoadingChanged: {
             console.log("loading chagned: " + loading+ " segments: "+trackModel.segmentCount);
-            if (!loading){
-                var cnt=trackModel.segmentCount;
-                for (var segment=0; segment<cnt; segment++){
-                    var obj=trackModel.createOverlayForSegment(segment);
-                    obj.type="_track";
-                    console.log("add overlay for segment "+segment+": "+obj);
-                    //console.log("object "+row+": "+obj);
-                    wayPreviewMap.addOverlayObject(segment, obj);
-                }
+        }
+
+        onDataUpdated: {
+            // track is rendered progressively, overlays of updated segments are replaced
+            var cnt=trackModel.segmentCount;
+            for (var segment=firstSegment; segment<cnt; segment++){
+                var obj=trackModel.createOverlayForSegment(segment);
+                obj.type="_track";
+                wayPreviewMap.addOverlayObject(segment, obj);
             }
         }
     }
@@ -26,6 +26,7 @@ import QtQml.Models 2.1
 import harbour.osmscout.map 1.0
 
 import "../custom"
+import "../custom/Utils.js" as Utils
 
 Page {
     id: collectionListPage
@@ -113,6 +114,18 @@ Page {
                     width: parent.width
                     truncationMode: TruncationMode.Fade
                 }
+                Label {
+                    id: summaryLabel
+
+                    visible: model.trackCount > 0 || model.waypointCount > 0
+                    text: (model.trackCount > 0 ?
+                              qsTr("%n tracks", "", model.trackCount) + " (" + Utils.humanDistance(model.distance) + "), " : "") +
+                          qsTr("%n waypoints", "", model.waypointCount)
+                    font.pixelSize: Theme.fontSizeExtraSmall
+                    color: Theme.secondaryColor
+                    width: parent.width
+                    truncationMode: TruncationMode.Fade
+                }
             }
             onClicked: {
                 console.log("selected collection: " + model.name + " (" + model.id + ")");
@@ -169,14 +182,38 @@ Page {
             }
         }
 
-        header: PageHeader {
-            id: header
-            title: qsTr("Collections")
+        header: Column {
+            width: collectionListView.width
+
+            PageHeader {
+                id: header
+                title: qsTr("Collections")
+            }
+            ProgressBar {
+                id: migrationProgressBar
+                visible: collectionListModel.migrating
+                width: parent.width
+                minimumValue: 0
+                maximumValue: Math.max(1, collectionListModel.migrationTotal)
+                value: collectionListModel.migrationDone
+                //: progress of background upgrade of stored data, for example "120 / 3000"
+                valueText: qsTr("%1 / %2").arg(collectionListModel.migrationDone).arg(collectionListModel.migrationTotal)
+                label: collectionListModel.migrationStep
+            }
         }
 
         VerticalScrollDecorator {}
 
         PullDownMenu {
+            MenuItem {
+                //: collection pull down menu, rebuild of the database file releasing unused space
+                text: qsTr("Compact storage")
+                onClicked: {
+                    remorse.execute(qsTr("Compacting storage"), function() {
+                        collectionListModel.compactDatabase();
+                    });
+                }
+            }
             MenuItem {
                 text: qsTr("Import")
                 onClicked: {
@@ -0,0 +1,103 @@
+/*
+ OSM Scout for Sailfish OS
+ Copyright (C) 2022  Lukas Karas
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+import QtQuick 2.0
+import Sailfish.Silica 1.0
+
+import harbour.osmscout.map 1.0
+
+import "../custom"
+
+Dialog {
+    id: trackArchiveDialog
+
+    property var acceptPage;
+    property var trackId;
+
+    acceptDestination: trackArchiveDialog.acceptPage
+    acceptDestinationAction: PageStackAction.Pop
+
+    canAccept: !trackModel.loading
+    onAccepted: {
+        trackModel.archive();
+    }
+
+    CollectionTrackModel{
+        id: trackModel
+        trackId: trackArchiveDialog.trackId
+
+        onBoundingBoxChanged: {
+            wayPreviewMap.showLocation(trackModel.boundingBox);
+        }
+
+        onLoadingChanged: {
+            if (!loading){
+                var cnt=trackModel.segmentCount;
+                for (var segment=0; segment<cnt; segment++){
+                    var obj=trackModel.createOverlayForSegment(segment);
+                    obj.type="_track";
+                    wayPreviewMap.addOverlayObject(segment, obj);
+                }
+            }
+        }
+    }
+
+    DialogHeader {
+        id: trackArchiveDialogHeader
+        title: trackModel.name
+        //: track edit, accept button of archive dialog
+        acceptText: qsTr("Archive")
+        spacing: trackArchiveDialog.isPortrait ? Theme.paddingLarge : 0
+    }
+
+    Label {
+        id: description
+        anchors{
+            right: parent.right
+            left: parent.left
+            bottom: parent.bottom
+            margins: Theme.horizontalPageMargin
+        }
+        wrapMode: Text.WordWrap
+        color: Theme.secondaryColor
+        font.pixelSize: Theme.fontSizeSmall
+        //: description of track archiving (track edit)
+        text: qsTr("Track nodes will be moved to read-only archive file, so the track is loaded faster. Editing of nodes moves them back to the database.")
+    }
+
+    MapComponent{
+        id: wayPreviewMap
+        showCurrentPosition: true
+        anchors{
+            top: trackArchiveDialogHeader.bottom
+            right: parent.right
+            left: parent.left
+            bottom: description.top
+            bottomMargin: Theme.paddingLarge
+        }
+    }
+
+    BusyIndicator {
+        id: busyIndicator
+        running: trackModel.loading
+        size: BusyIndicatorSize.Large
+        anchors.horizontalCenter: parent.horizontalCenter
+        anchors.verticalCenter: parent.verticalCenter
+    }
+}
@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+
+# Replays read queries of Storage (the same SQL as StorageBenchmark read tests)
+# on synthetic database with Storage schema, for a grid of connection cache and mmap sizes.
+# It uses SQLite only (python sqlite3 module), so it may be run where the application
+# cannot be built. Results are printed as JSON lines, timings are in milliseconds.
+#
+# Cold pass is measured with new connections, after dropping OS page cache when it is
+# permitted (root), warm passes reuse the connections.
+#
+#   storage-replay.py database.sqlite [--collections 4 --tracks 100 --points 10000 --waypoints 5000]
+
+import argparse
+import json
+import os
+import random
+import sqlite3
+import statistics
+import time
+
+CACHE_KIB = [2048, 4096, 8192, 16384]
+MMAP_MIB = [0, 16, 64, 256]
+CHUNK_POINTS = 4096
+BYTES_PER_POINT = 7  # average size of point packed by TrackPointCodec (time and elevation present)
+LOD_RATIOS = [0.4, 0.15, 0.05, 0.02]  # retained points of every level of detail
+
+SCHEMA = [
+    "CREATE TABLE `collection` (`id` INTEGER PRIMARY KEY, `name` varchar(255) NOT NULL, "
+    "`description` varchar(255) NULL, `visible` tinyint(1) NOT NULL)",
+    "CREATE TABLE `collection_stats` (`collection_id` INTEGER PRIMARY KEY, `waypoint_count` INTEGER NOT NULL DEFAULT 0, "
+    "`waypoint_hidden` INTEGER NOT NULL DEFAULT 0, `track_count` INTEGER NOT NULL DEFAULT 0, "
+    "`track_hidden` INTEGER NOT NULL DEFAULT 0, `distance` double NOT NULL DEFAULT 0, "
+    "`from_time` INTEGER NULL, `to_time` INTEGER NULL)",
+    "CREATE TABLE `track` (`id` INTEGER PRIMARY KEY, `collection_id` INTEGER NOT NULL, `name` varchar(255) NOT NULL, "
+    "`description` varchar(255) NULL, `open` tinyint(1) NOT NULL, `creation_time` INTEGER NOT NULL, "
+    "`modification_time` INTEGER NOT NULL, `color` varchar(12) NULL, `type` varchar(80) NULL, "
+    "`visible` tinyint(1) NOT NULL, `from_time` INTEGER NULL, `to_time` INTEGER NULL, "
+    "`distance` DOUBLE NOT NULL, `raw_distance` DOUBLE NOT NULL, `duration` INTEGER NOT NULL, "
+    "`moving_duration` INTEGER NOT NULL, `max_speed` DOUBLE NOT NULL, `average_speed` DOUBLE NOT NULL, "
+    "`moving_average_speed` DOUBLE NOT NULL, `ascent` DOUBLE NOT NULL, `descent` DOUBLE NOT NULL, "
+    "`min_elevation` DOUBLE NULL, `max_elevation` DOUBLE NULL, `bbox_min_lat` DOUBLE NOT NULL, "
+    "`bbox_min_lon` DOUBLE NOT NULL, `bbox_max_lat` DOUBLE NOT NULL, `bbox_max_lon` DOUBLE NOT NULL)",
+    "CREATE TABLE `track_segment` (`id` INTEGER PRIMARY KEY, `track_id` INTEGER NOT NULL, "
+    "`open` tinyint(1) NOT NULL, `creation_time` INTEGER NOT NULL, `distance` double NOT NULL)",
+    "CREATE TABLE `track_segment_data` (`segment_id` INTEGER NOT NULL, `chunk` INTEGER NOT NULL, "
+    "`first_point` INTEGER NOT NULL, `point_count` INTEGER NOT NULL, `data` BLOB NOT NULL, "
+    "PRIMARY KEY (`segment_id`, `chunk`))",
+    "CREATE INDEX idx_track_segment_data_first_point ON track_segment_data (segment_id, first_point)",
+    "CREATE TABLE `track_segment_lod` (`segment_id` INTEGER NOT NULL, `level` INTEGER NOT NULL, "
+    "`point_count` INTEGER NOT NULL, `data` BLOB NOT NULL, PRIMARY KEY (`segment_id`, `level`))",
+    "CREATE TABLE `track_archive` (`track_id` INTEGER PRIMARY KEY, `file` varchar(255) NOT NULL, "
+    "`point_count` INTEGER NOT NULL)",
+    "CREATE TABLE `waypoint` (`id` INTEGER PRIMARY KEY, `collection_id` INTEGER NOT NULL, "
+    "`modification_time` INTEGER NOT NULL, `timestamp` INTEGER NULL, `latitude` double NOT NULL, "
+    "`longitude` double NOT NULL, `elevation` double NULL, `name` varchar(255) NOT NULL, "
+    "`description` varchar(255) NULL, `symbol` varchar(255) NULL, `visible` tinyint(1) NOT NULL)",
+    "CREATE INDEX `idx_track_collection_id` ON `track` (`collection_id`)",
+    "CREATE INDEX `idx_waypoint_collection_id` ON `waypoint` (`collection_id`)",
+    "CREATE VIRTUAL TABLE `waypoint_rtree` USING rtree(`id`, `min_lat`, `max_lat`, `min_lon`, `max_lon`)",
+    "CREATE VIRTUAL TABLE `waypoint_fts` USING fts5(`name`, `description`, `symbol`, "
+    "content='waypoint', content_rowid='id', prefix='2 3')",
+]
+
+LOAD_COLLECTIONS = ("SELECT `id`, `visible`, `name`, `description`, `waypoint_count`, `waypoint_hidden`, "
+                    "`track_count`, `track_hidden`, `distance`, `from_time`, `to_time` FROM `collection` "
+                    "LEFT JOIN `collection_stats` ON `collection_stats`.`collection_id` = `collection`.`id`;")
+LOAD_TRACKS = "SELECT * FROM `track` WHERE collection_id = ?;"
+LOAD_WAYPOINTS = "SELECT * FROM `waypoint` WHERE collection_id = ?;"
+LOAD_SEGMENTS = "SELECT `id` FROM `track_segment` WHERE track_id = ? ORDER BY `id`;"
+LOAD_SEGMENT_DATA = ("SELECT 0 AS `part`, `first_point`, `point_count`, `data`, NULL AS `file` "
+                     "FROM `track_segment_data` WHERE `segment_id` = ? "
+                     "UNION ALL "
+                     "SELECT 1, 0, `track_archive`.`point_count`, NULL, `track_archive`.`file` FROM `track_segment` "
+                     "JOIN `track_archive` ON `track_archive`.`track_id` = `track_segment`.`track_id` "
+                     "WHERE `track_segment`.`id` = ? "
+                     "UNION ALL "
+                     "SELECT 2, 0, (SELECT MAX(`point_count`) FROM `track_segment_lod` WHERE `segment_id` = ?), NULL, NULL "
+                     "ORDER BY 1, 2;")
+LOAD_LOD = "SELECT `data` FROM `track_segment_lod` WHERE `segment_id` = ? AND `level` = ?;"
+NEARBY_WAYPOINTS = ("SELECT `waypoint`.* FROM `waypoint_rtree` "
+                    "JOIN `waypoint` ON `waypoint`.`id` = `waypoint_rtree`.`id` WHERE "
+                    "`waypoint_rtree`.`max_lat` >= ? AND `waypoint_rtree`.`min_lat` <= ? AND "
+                    "`waypoint_rtree`.`max_lon` >= ? AND `waypoint_rtree`.`min_lon` <= ?;")
+SEARCH_WAYPOINTS = ("SELECT `waypoint`.*, bm25(`waypoint_fts`, 10.0, 2.0, 1.0) AS `rank` FROM `waypoint_fts` "
+                    "JOIN `waypoint` ON `waypoint`.`id` = `waypoint_fts`.`rowid` "
+                    "WHERE `waypoint_fts` MATCH ? ORDER BY `rank` LIMIT 50;")
+
+
+def generate(path, args):
+    rnd = random.Random(args.seed)
+    for suffix in ["", "-wal", "-shm"]:
+        if os.path.exists(path + suffix):
+            os.remove(path + suffix)
+    db = sqlite3.connect(path)
+    db.execute("PRAGMA journal_mode = WAL;")
+    db.execute("PRAGMA auto_vacuum = INCREMENTAL;")
+    for sql in SCHEMA:
+        db.execute(sql)
+    segment_id = 0
+    track_id = 0
+    waypoint_id = 0
+    for c in range(1, args.collections + 1):
+        db.execute("INSERT INTO `collection` VALUES (?, ?, NULL, 1)", (c, "collection %d" % c))
+        db.execute("INSERT INTO `collection_stats` (`collection_id`, `waypoint_count`, `track_count`) VALUES (?, ?, ?)",
+                   (c, args.waypoints, args.tracks))
+        for t in range(args.tracks):
+            track_id += 1
+            lat = rnd.uniform(45, 55)
+            lon = rnd.uniform(5, 20)
+            db.execute("INSERT INTO `track` VALUES (?, ?, ?, NULL, 0, 0, 0, NULL, NULL, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, "
+                       "0, 0, NULL, NULL, ?, ?, ?, ?)",
+                       (track_id, c, "synth track %d" % track_id, lat, lon, lat + 0.1, lon + 0.1))
+            segment_id += 1
+            db.execute("INSERT INTO `track_segment` VALUES (?, ?, 0, 0, 0)", (segment_id, track_id))
+            for chunk, first in enumerate(range(0, args.points, CHUNK_POINTS)):
+                count = min(CHUNK_POINTS, args.points - first)
+                db.execute("INSERT INTO `track_segment_data` VALUES (?, ?, ?, ?, ?)",
+                           (segment_id, chunk, first, count, rnd.randbytes(count * BYTES_PER_POINT)))
+            for level, ratio in enumerate(LOD_RATIOS):
+                count = max(2, int(args.points * ratio))
+                db.execute("INSERT INTO `track_segment_lod` VALUES (?, ?, ?, ?)",
+                           (segment_id, level, count, rnd.randbytes(count * BYTES_PER_POINT)))
+        for w in range(args.waypoints):
+            waypoint_id += 1
+            lat = rnd.uniform(45, 55)
+            lon = rnd.uniform(5, 20)
+            db.execute("INSERT INTO `waypoint` VALUES (?, ?, 0, 0, ?, ?, 300, ?, ?, NULL, 1)",
+                       (waypoint_id, c, lat, lon, "Way %d" % waypoint_id, "synthetic waypoint %d" % waypoint_id))
+            db.execute("INSERT INTO `waypoint_rtree` VALUES (?, ?, ?, ?, ?)", (waypoint_id, lat, lat, lon, lon))
+        db.commit()
+    db.execute("INSERT INTO `waypoint_fts` (`waypoint_fts`) VALUES ('rebuild');")
+    db.commit()
+    db.execute("ANALYZE;")
+    db.execute("PRAGMA wal_checkpoint(TRUNCATE);")
+    db.close()
+
+
+def drop_os_cache():
+    try:
+        os.sync()
+        with open("/proc/sys/vm/drop_caches", "w") as f:
+            f.write("1")
+        return True
+    except OSError:
+        return False
+
+
+def connect(path, cache_kib, mmap_mib):
+    db = sqlite3.connect(path, check_same_thread=False)
+    db.execute("PRAGMA journal_mode = WAL;")
+    db.execute("PRAGMA cache_size = -%d;" % cache_kib)
+    db.execute("PRAGMA mmap_size = %d;" % (mmap_mib * 1024 * 1024))
+    db.execute("PRAGMA temp_store = MEMORY;")
+    return db
+
+
+def workload(db, args, rnd, result):
+    def measure(name, fn):
+        start = time.perf_counter()
+        fn()
+        result.setdefault(name, []).append((time.perf_counter() - start) * 1000)
+
+    def rows(sql, params=()):
+        return db.execute(sql, params).fetchall()
+
+    measure("loadCollections", lambda: rows(LOAD_COLLECTIONS))
+    for c in range(1, args.collections + 1):
+        measure("loadCollectionDetails", lambda: (rows(LOAD_TRACKS, (c,)), rows(LOAD_WAYPOINTS, (c,))))
+    track_count = args.collections * args.tracks
+    # map overlay: tracks in random order, visible level of detail
+    for track_id in rnd.sample(range(1, track_count + 1), min(track_count, 50)):
+        def lod():
+            for (segment_id,) in rows(LOAD_SEGMENTS, (track_id,)):
+                rows(LOAD_LOD, (segment_id, rnd.randrange(len(LOD_RATIOS))))
+        measure("loadTrackLod", lod)
+    # track page: all points of the track
+    for track_id in rnd.sample(range(1, track_count + 1), min(track_count, 20)):
+        def data():
+            for (segment_id,) in rows(LOAD_SEGMENTS, (track_id,)):
+                rows(LOAD_SEGMENT_DATA, (segment_id, segment_id, segment_id))
+        measure("loadTrackData", data)
+    for _ in range(20):
+        lat = rnd.uniform(45, 55)
+        lon = rnd.uniform(5, 20)
+        measure("loadNearbyWaypoints", lambda: rows(NEARBY_WAYPOINTS, (lat - 0.05, lat + 0.05, lon - 0.07, lon + 0.07)))
+    for i in range(20):
+        pattern = '"Way %d"*' % rnd.randrange(args.collections * args.waypoints) if i % 2 == 0 else '"synth"* "waypo"*'
+        measure("searchItems", lambda: rows(SEARCH_WAYPOINTS, (pattern,)))
+
+
+def summarize(result):
+    return {name: {"count": len(values),
+                   "median": round(statistics.median(values), 3),
+                   "total": round(sum(values), 3)}
+            for name, values in result.items()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay of Storage read queries for a grid of connection tuning")
+    parser.add_argument("database")
+    parser.add_argument("--collections", type=int, default=4)
+    parser.add_argument("--tracks", type=int, default=100)
+    parser.add_argument("--points", type=int, default=10000)
+    parser.add_argument("--waypoints", type=int, default=5000)
+    parser.add_argument("--warm", type=int, default=5, help="warm passes")
+    parser.add_argument("--seed", type=int, default=42)
+    parser.add_argument("--keep", action="store_true", help="reuse existing database")
+    args = parser.parse_args()
+
+    if not args.keep or not os.path.exists(args.database):
+        generate(args.database, args)
+    print(json.dumps({"sqlite": sqlite3.sqlite_version,
+                      "databaseMiB": round(os.path.getsize(args.database) / 1024 / 1024, 1)}))
+
+    for cache_kib in CACHE_KIB:
+        for mmap_mib in MMAP_MIB:
+            dropped = drop_os_cache()
+            db = connect(args.database, cache_kib, mmap_mib)
+            cold = {}
+            workload(db, args, random.Random(args.seed), cold)
+            warm = {}
+            for i in range(args.warm):
+                workload(db, args, random.Random(args.seed + 1 + i), warm)
+            db.close()
+            print(json.dumps({"cacheKiB": cache_kib, "mmapMiB": mmap_mib, "osCacheDropped": dropped,
+                              "cold": summarize(cold), "warm": summarize(warm)}), flush=True)
+
+
+if __name__ == "__main__":
+    main()
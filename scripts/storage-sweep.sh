@@ -0,0 +1,27 @@
+#!/bin/bash
+
+# Runs StorageBenchmark for a grid of connection cache and mmap sizes,
+# every result is stored as JSON file in output directory.
+
+if [ $# -lt 2 ] ; then
+	echo "Usage:"
+	echo "$0 path/to/StorageBenchmark output-directory [benchmark arguments...]"
+	exit 1
+fi
+
+BENCHMARK=$1
+OUTPUT=$2
+shift 2
+
+CACHE_KIB="2048 4096 8192 16384"
+MMAP_MIB="0 16 64 256"
+
+mkdir -p "$OUTPUT" || exit 1
+
+for CACHE in $CACHE_KIB ; do
+	for MMAP in $MMAP_MIB ; do
+		echo "cache ${CACHE} KiB, mmap ${MMAP} MiB"
+		OSMSCOUT_STORAGE_CACHE_KIB=$CACHE OSMSCOUT_STORAGE_MMAP_MIB=$MMAP \
+			"$BENCHMARK" --output "$OUTPUT/cache-${CACHE}-mmap-${MMAP}.json" "$@" || exit 1
+	done
+done
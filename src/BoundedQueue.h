@@ -0,0 +1,222 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Lock-free queue with limited capacity, for passing data between one producer
+ * and one consumer thread (ring buffer, single producer and single consumer only!).
+ *
+ * Producer waits while the queue is full, so memory usage stays bounded
+ * when the consumer is slower. Waiting thread yields for a while, then it is parked
+ * on condition variable until the other side makes progress (ring buffer itself
+ * stays lock-free, mutex is locked just when some thread is parked).
+ * Time spent by waiting is accumulated for throughput statistics.
+ *
+ * When queue is closed, push is refused and pop returns remaining items
+ * before it signals the end.
+ */
+template<typename T>
+class BoundedQueue
+{
+private:
+  class Backoff
+  {
+  public:
+    Backoff(BoundedQueue &queue, std::atomic<int64_t> &waitNs):
+      queue(queue), waitNs(waitNs)
+    {}
+
+    ~Backoff()
+    {
+      if (iteration > 0) {
+        waitNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+      }
+    }
+
+    /**
+     * Wait until ready returns true (it may return earlier, caller checks the condition again).
+     */
+    template<typename Ready>
+    void wait(const Ready &ready)
+    {
+      if (iteration++ == 0) {
+        start = Clock::now();
+      }
+      if (iteration < SpinIterations) {
+        std::this_thread::yield();
+      } else {
+        queue.park(ready);
+      }
+    }
+
+  private:
+    static constexpr int SpinIterations = 64;
+
+    using Clock = std::chrono::steady_clock;
+    BoundedQueue &queue;
+    std::atomic<int64_t> &waitNs;
+    Clock::time_point start;
+    int iteration{0};
+  };
+
+public:
+  explicit BoundedQueue(size_t capacity):
+    slots(capacity + 1)
+  {
+    assert(capacity > 0);
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue(BoundedQueue&&) = delete;
+  ~BoundedQueue() = default;
+
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(BoundedQueue&&) = delete;
+
+  /**
+   * Waits while the queue is full. Called from producer thread only.
+   * @return false when queue is closed
+   */
+  bool push(T &&item)
+  {
+    size_t current = tail.load(std::memory_order_relaxed);
+    size_t next = increment(current);
+    Backoff backoff(*this, pushWaitNs);
+    while (next == head.load(std::memory_order_acquire)) {
+      if (closed.load(std::memory_order_acquire)) {
+        return false;
+      }
+      backoff.wait([&]() {
+        return next != head.load(std::memory_order_acquire) || closed.load(std::memory_order_acquire);
+      });
+    }
+    if (closed.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots[current] = std::move(item);
+    tail.store(next, std::memory_order_release);
+    wakeUp();
+    return true;
+  }
+
+  /**
+   * Waits while the queue is empty. Called from consumer thread only.
+   * @return false when queue is closed and there are no more items
+   */
+  bool pop(T &item)
+  {
+    size_t current = head.load(std::memory_order_relaxed);
+    Backoff backoff(*this, popWaitNs);
+    while (current == tail.load(std::memory_order_acquire)) {
+      if (closed.load(std::memory_order_acquire) &&
+          current == tail.load(std::memory_order_acquire)) {
+        return false;
+      }
+      backoff.wait([&]() {
+        return current != tail.load(std::memory_order_acquire) || closed.load(std::memory_order_acquire);
+      });
+    }
+    item = std::move(slots[current]);
+    slots[current] = T();
+    head.store(increment(current), std::memory_order_release);
+    wakeUp();
+    return true;
+  }
+
+  /**
+   * Can be called from any thread.
+   */
+  void close()
+  {
+    closed.store(true, std::memory_order_release);
+    wakeUp();
+  }
+
+  /**
+   * Time spent by producer waiting for free slot
+   */
+  int64_t pushWait() const
+  {
+    return pushWaitNs.load();
+  }
+
+  /**
+   * Time spent by consumer waiting for an item
+   */
+  int64_t popWait() const
+  {
+    return popWaitNs.load();
+  }
+
+private:
+  size_t increment(size_t index) const
+  {
+    return (index + 1) % slots.size();
+  }
+
+  /**
+   * Park the thread until the other side calls wakeUp. Parked counter is increased
+   * before the condition is checked again, so the wake-up cannot be lost. Timeout is
+   * just a safety net.
+   */
+  template<typename Ready>
+  void park(const Ready &ready)
+  {
+    std::unique_lock<std::mutex> lock(parkMutex);
+    parked.fetch_add(1, std::memory_order_seq_cst);
+    if (!ready()) {
+      parkCondition.wait_for(lock, MaxParkTime);
+    }
+    parked.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Wake up parked thread, if any. Mutex is not touched when nobody is parked.
+   */
+  void wakeUp()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(parkMutex);
+      parkCondition.notify_all();
+    }
+  }
+
+private:
+  std::vector<T> slots;
+  alignas(64) std::atomic<size_t> head{0}; // next slot to pop
+  alignas(64) std::atomic<size_t> tail{0}; // next slot to push
+  std::atomic<bool> closed{false};
+  std::atomic<int64_t> pushWaitNs{0};
+  std::atomic<int64_t> popWaitNs{0};
+
+  static constexpr std::chrono::milliseconds MaxParkTime{100};
+  std::atomic<int> parked{0};
+  std::mutex parkMutex;
+  std::condition_variable parkCondition;
+};
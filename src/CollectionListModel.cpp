@@ -63,6 +63,22 @@ CollectionListModel::CollectionListModel()
           storage, &Storage::visibleAll,
           Qt::QueuedConnection);
 
+  connect(this, &CollectionListModel::compactDatabaseRequest,
+          storage, &Storage::compactDatabase,
+          Qt::QueuedConnection);
+
+  connect(storage, &Storage::databaseCompacted,
+          this, &CollectionListModel::onDatabaseCompacted,
+          Qt::QueuedConnection);
+
+  connect(storage, &Storage::migrationProgress,
+          this, &CollectionListModel::onMigrationProgress,
+          Qt::QueuedConnection);
+
+  connect(storage, &Storage::migrationFinished,
+          this, &CollectionListModel::onMigrationFinished,
+          Qt::QueuedConnection);
+
   emit collectionLoadRequest();
 }
 
@@ -84,9 +100,10 @@ void CollectionListModel::storageInitialisationError(QString)
   storageInitialised();
 }
 
-void CollectionListModel::onCollectionsLoaded(std::vector<Collection> collections, bool ok)
+void CollectionListModel::onCollectionsLoaded(CollectionListSnapshot snapshot, bool ok)
 {
   collectionsLoaded = true;
+  std::vector<Collection> collections = *snapshot;
 
   // following process is little bit complicated, but we don't want to call
   // model reset - it breaks UI animations for changes
@@ -157,6 +174,11 @@ QVariant CollectionListModel::data(const QModelIndex &index, int role) const
     case IdRole: return QString::number(collection.id);
     case VisibleRole: return collection.visible;
     case VisibleAllRole: return collection.visibleAll;
+    case WaypointCountRole: return collection.waypointCount;
+    case TrackCountRole: return collection.trackCount;
+    case DistanceRole: return collection.distance.AsMeter();
+    case FromRole: return collection.from;
+    case ToRole: return collection.to;
   }
   return QVariant();
 }
@@ -170,6 +192,11 @@ QHash<int, QByteArray> CollectionListModel::roleNames() const
   roles[IdRole]="id";
   roles[VisibleRole]="visible";
   roles[VisibleAllRole]="visibleAll";
+  roles[WaypointCountRole]="waypointCount";
+  roles[TrackCountRole]="trackCount";
+  roles[DistanceRole]="distance";
+  roles[FromRole]="from";
+  roles[ToRole]="to";
 
   return roles;
 }
@@ -185,7 +212,7 @@ Qt::ItemFlags CollectionListModel::flags(const QModelIndex &index) const
 
 bool CollectionListModel::isLoading() const
 {
-  return !collectionsLoaded;
+  return !collectionsLoaded || compacting;
 }
 
 void CollectionListModel::createCollection(QString name, QString description)
@@ -254,6 +281,42 @@ void CollectionListModel::importCollection(QString filePath)
   emit importCollectionRequest(filePath);
 }
 
+void CollectionListModel::compactDatabase()
+{
+  compacting=true;
+  emit loadingChanged();
+  emit compactDatabaseRequest();
+}
+
+void CollectionListModel::onDatabaseCompacted(bool)
+{
+  compacting=false;
+  emit loadingChanged();
+}
+
+void CollectionListModel::onMigrationProgress(QString step, qint64 done, qint64 total)
+{
+  migrating=true;
+  migrationStep=step;
+  migrationDone=done;
+  migrationTotal=total;
+  emit migrationChanged();
+}
+
+void CollectionListModel::onMigrationFinished(bool ok)
+{
+  if (!ok){
+    qWarning() << "Migration of legacy data fails";
+  }
+  migrating=false;
+  migrationStep.clear();
+  migrationDone=0;
+  migrationTotal=0;
+  emit migrationChanged();
+  // migrated collections may be changed (statistics)
+  emit collectionLoadRequest();
+}
+
 void CollectionListModel::sort(std::vector<Collection> &items) const
 {
   using namespace std::string_literals;
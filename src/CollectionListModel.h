@@ -31,6 +31,12 @@ class CollectionListModel : public QAbstractListModel {
   Q_PROPERTY(bool loading READ isLoading NOTIFY loadingChanged)
   Q_PROPERTY(Ordering ordering  READ getOrdering WRITE setOrdering NOTIFY orderingChanged)
 
+  // progress of background migration of legacy data, see Storage::migrationProgress
+  Q_PROPERTY(bool migrating READ isMigrating NOTIFY migrationChanged)
+  Q_PROPERTY(QString migrationStep READ getMigrationStep NOTIFY migrationChanged)
+  Q_PROPERTY(qint64 migrationDone READ getMigrationDone NOTIFY migrationChanged)
+  Q_PROPERTY(qint64 migrationTotal READ getMigrationTotal NOTIFY migrationChanged)
+
 signals:
   void loadingChanged() const;
   void collectionLoadRequest();
@@ -38,19 +44,26 @@ signals:
   void visibleAllRequest(qint64, bool);
   void deleteCollectionRequest(qint64);
   void importCollectionRequest(QString);
+  void compactDatabaseRequest();
   void error(QString message);
   void orderingChanged();
+  void migrationChanged();
 
 public slots:
   void storageInitialised();
   void storageInitialisationError(QString);
-  void onCollectionsLoaded(std::vector<Collection> collections, bool ok);
+  void onCollectionsLoaded(CollectionListSnapshot snapshot, bool ok);
   void createCollection(QString name, QString description);
   void deleteCollection(QString id);
   void editCollection(QString id, bool visible, QString name, QString description);
   void visibleAll(QString id);
   void visibleNone(QString id);
   void importCollection(QString filePath);
+  /** rebuild the database file, see Storage::compactDatabase */
+  void compactDatabase();
+  void onDatabaseCompacted(bool ok);
+  void onMigrationProgress(QString step, qint64 done, qint64 total);
+  void onMigrationFinished(bool ok);
 
 public:
   CollectionListModel();
@@ -70,7 +83,12 @@ public:
     DescriptionRole = Qt::UserRole+1,
     IdRole = Qt::UserRole+2,
     VisibleRole = Qt::UserRole+3,
-    VisibleAllRole = Qt::UserRole+4
+    VisibleAllRole = Qt::UserRole+4,
+    WaypointCountRole = Qt::UserRole+5,
+    TrackCountRole = Qt::UserRole+6,
+    DistanceRole = Qt::UserRole+7, // meters
+    FromRole = Qt::UserRole+8,
+    ToRole = Qt::UserRole+9
   };
   Q_ENUM(Roles)
 
@@ -88,11 +106,36 @@ public:
 
   void setOrdering(Ordering ordering);
 
+  bool isMigrating() const
+  {
+    return migrating;
+  }
+
+  QString getMigrationStep() const
+  {
+    return migrationStep;
+  }
+
+  qint64 getMigrationDone() const
+  {
+    return migrationDone;
+  }
+
+  qint64 getMigrationTotal() const
+  {
+    return migrationTotal;
+  }
+
 private:
   void sort(std::vector<Collection> &items) const;
 
 public:
   std::vector<Collection> collections;
   bool collectionsLoaded{false};
+  bool compacting{false};
+  bool migrating{false};
+  QString migrationStep;
+  qint64 migrationDone{0};
+  qint64 migrationTotal{0};
   Ordering ordering{DateAscent};
 };
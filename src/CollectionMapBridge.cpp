@@ -19,6 +19,14 @@
 
 #include "CollectionMapBridge.h"
 #include "CollectionModel.h"
+#include "TrackSimplifier.h"
+
+#include <cmath>
+
+namespace {
+  // tracks are requested for larger area than the view, to avoid requests on every small move
+  constexpr double TrackBoxMargin = 3.0;
+}
 
 CollectionMapBridge::CollectionMapBridge(QObject *parent):
   QObject(parent)
@@ -54,12 +62,28 @@ CollectionMapBridge::CollectionMapBridge(QObject *parent):
           this, &CollectionMapBridge::onCollectionDetailsLoaded,
           Qt::QueuedConnection);
 
-  connect(this, &CollectionMapBridge::trackDataRequest,
-          storage, &Storage::loadTrackData,
+  connect(storage, &Storage::collectionChanged,
+          this, &CollectionMapBridge::onCollectionChanged,
+          Qt::QueuedConnection);
+
+  connect(this, &CollectionMapBridge::trackLodRequest,
+          storage, &Storage::loadTrackLod,
+          Qt::DirectConnection);
+
+  connect(storage, &Storage::trackLodLoaded,
+          this, &CollectionMapBridge::onTrackLodLoaded,
+          Qt::QueuedConnection);
+
+  connect(storage, &Storage::trackPointsLoaded,
+          this, &CollectionMapBridge::onTrackPointsLoaded,
           Qt::QueuedConnection);
 
-  connect(storage, &Storage::trackDataLoaded,
-          this, &CollectionMapBridge::onTrackDataLoaded,
+  connect(this, &CollectionMapBridge::tracksInBoxRequest,
+          storage, &Storage::loadTracksInBox,
+          Qt::DirectConnection);
+
+  connect(storage, &Storage::tracksInBoxLoaded,
+          this, &CollectionMapBridge::onTracksInBoxLoaded,
           Qt::QueuedConnection);
 
   init();
@@ -79,38 +103,33 @@ void CollectionMapBridge::storageInitialisationError(QString e)
   emit error(e);
 }
 
-void CollectionMapBridge::onCollectionDetailsLoaded(Collection collection, bool /*ok*/)
+void CollectionMapBridge::onCollectionDetailsLoaded(CollectionSnapshot collection, bool /*ok*/)
 {
   using namespace std::string_literals;
-  if (!collection.visible || delegatedMap == nullptr){
+  if (!collection->visible || delegatedMap == nullptr){
     return;
   }
 
-  qDebug() << "Display collection" << collection.name << "(" << collection.id << ") on map" << delegatedMap;
+  qDebug() << "Display collection" << collection->name << "(" << collection->id << ") on map" << delegatedMap;
 
-  DisplayedCollection &dispColl = displayedCollection[collection.id];
+  DisplayedCollection &dispColl = displayedCollection[collection->id];
 
   QMap<qint64, DisplayedWaypoint> wptToHide = dispColl.waypoints;
   QMap<qint64, DisplayedWaypoint> &wptVisible = dispColl.waypoints;
 
   QMap<qint64, DisplayedTrack> trkToHide = dispColl.tracks;
-  QMap<qint64, DisplayedTrack> &trkVisible = dispColl.tracks;
 
-  if (collection.tracks){
-    for (const auto &trk: *(collection.tracks)){
+  // track data are requested just for tracks in the view, see onTracksInBoxLoaded
+  if (collection->tracks){
+    for (const auto &trk: *(collection->tracks)){
       if (trk.visible) {
         trkToHide.remove(trk.id);
-        if (!trkVisible.contains(trk.id) || trkVisible[trk.id].lastModification != trk.lastModification) {
-          qDebug() << "Request track data (" << trk.id << ")"
-                   << trkVisible[trk.id].lastModification << "/" << trk.lastModification;
-          emit trackDataRequest(trk, std::nullopt);
-        }
       }
     }
   }
 
-  if (collection.waypoints){
-    for (const auto &wpt: *(collection.waypoints)){
+  if (collection->waypoints){
+    for (const auto &wpt: *(collection->waypoints)){
       if (wpt.visible) {
         wptToHide.remove(wpt.id);
         if (!wptVisible.contains(wpt.id) || wptVisible[wpt.id].lastModification != wpt.lastModification) {
@@ -142,25 +161,218 @@ void CollectionMapBridge::onCollectionDetailsLoaded(Collection collection, bool
     wptVisible.remove(id);
   }
   for (const auto &id :trkToHide.keys()){
-    qDebug() << "Removing overlay track" << id << trkToHide[id].lastModification;
-    for (const auto &did: trkToHide[id].ids) {
-      delegatedMap->removeOverlayObject(did);
+    hideTrack(collection->id, id);
+  }
+
+  requestTracksInBox();
+}
+
+void CollectionMapBridge::hideTrack(qint64 collectionId, qint64 trackId)
+{
+  DisplayedCollection &dispColl = displayedCollection[collectionId];
+  qDebug() << "Removing overlay track" << trackId << dispColl.tracks[trackId].lastModification;
+  removeOverlays(dispColl.tracks[trackId].ids);
+  dispColl.tracks.remove(trackId);
+  if (loadingTracks.contains(trackId)) {
+    removeOverlays(loadingTracks.take(trackId).ids);
+  }
+}
+
+void CollectionMapBridge::removeOverlays(const std::vector<qint64> &ids)
+{
+  for (const auto &id: ids) {
+    delegatedMap->removeOverlayObject(id);
+  }
+}
+
+bool CollectionMapBridge::viewBox(double marginFactor, osmscout::GeoBox &box, int &zoom) const
+{
+  if (delegatedMap == nullptr || delegatedMap->width() <= 0 || delegatedMap->height() <= 0) {
+    return false;
+  }
+  osmscout::MapView *view = qobject_cast<osmscout::MapView*>(delegatedMap->property("view").value<QObject*>());
+  if (view == nullptr) {
+    return false;
+  }
+
+  // approximation of Mercator projection used by the map,
+  // world width in screen pixels is 256 * magnification * (dpi / 96)
+  constexpr double EarthCircumference = 40075016.686; // meters
+  double mag = std::max(1.0, view->GetMag());
+  double dpi = view->GetMapDpi() > 0 ? view->GetMapDpi() : 96.0;
+  double metersPerPixel = EarthCircumference * std::cos(view->GetLat() * M_PI / 180.0) / (256.0 * mag * dpi / 96.0);
+  double radius = std::hypot(delegatedMap->width(), delegatedMap->height()) / 2.0 * metersPerPixel * marginFactor;
+
+  box = osmscout::GeoBox::BoxByCenterAndRadius(osmscout::GeoCoord(view->GetLat(), view->GetLon()),
+                                               osmscout::Meters(radius));
+  zoom = int(std::log2(mag));
+  return true;
+}
+
+void CollectionMapBridge::requestTracksInBox()
+{
+  if (delegatedMap == nullptr || !enabled) {
+    return;
+  }
+  osmscout::GeoBox box;
+  int zoom;
+  if (!viewBox(TrackBoxMargin, box, zoom)) {
+    // view is not known, load all tracks, without size limit
+    box = osmscout::GeoBox(osmscout::GeoCoord(-90, -180), osmscout::GeoCoord(90, 180));
+    zoom = 20;
+  }
+  requestedBox = box;
+  requestedZoom = zoom;
+  emit tracksInBoxRequest(box, zoom);
+}
+
+void CollectionMapBridge::onViewChanged()
+{
+  osmscout::GeoBox box;
+  int zoom;
+  if (!enabled || !viewBox(1.0, box, zoom)) {
+    return;
+  }
+  if (requestedBox.IsValid() &&
+      requestedZoom == zoom &&
+      requestedBox.Includes(box.GetMinCoord(), false) &&
+      requestedBox.Includes(box.GetMaxCoord(), false)) {
+    return;
+  }
+  requestTracksInBox();
+}
+
+void CollectionMapBridge::onTracksInBoxLoaded(const osmscout::GeoBox &box, int zoom, TrackListSnapshot tracks, bool ok)
+{
+  if (delegatedMap == nullptr ||
+      !ok ||
+      !enabled ||
+      zoom != requestedZoom ||
+      box.GetMinCoord() != requestedBox.GetMinCoord() ||
+      box.GetMaxCoord() != requestedBox.GetMaxCoord()) {
+    // response for different request
+    return;
+  }
+
+  int level = TrackSimplifier::levelForZoom(zoom);
+  QSet<qint64> loaded;
+  for (const auto &trk: *tracks) {
+    loaded.insert(trk.id);
+    const DisplayedCollection &dispColl = displayedCollection[trk.collectionId];
+    if (dispColl.tracks.contains(trk.id) &&
+        dispColl.tracks[trk.id].lastModification == trk.lastModification &&
+        dispColl.tracks[trk.id].level == level) {
+      continue;
     }
-    trkVisible.remove(id);
+    if (loadingTracks.contains(trk.id) &&
+        loadingTracks[trk.id].lastModification == trk.lastModification &&
+        loadingTracks[trk.id].level == level) {
+      continue; // requested already
+    }
+    requestTrackData(trk, zoom);
+  }
+
+  // hide tracks out of the box
+  for (const auto &colId: displayedCollection.keys()) {
+    for (const auto &trkId: displayedCollection[colId].tracks.keys()) {
+      if (!loaded.contains(trkId)) {
+        hideTrack(colId, trkId);
+      }
+    }
+  }
+  tracksInBox = loaded;
+}
+
+void CollectionMapBridge::requestTrackData(const Track &track, int zoom)
+{
+  int level = TrackSimplifier::levelForZoom(zoom);
+  qDebug() << "Request track data (" << track.id << ")" << track.lastModification << "level" << level;
+  if (loadingTracks.contains(track.id)) {
+    // previous request is still in progress, its partial overlays are replaced
+    removeOverlays(loadingTracks.take(track.id).ids);
   }
+  loadingTracks[track.id] = LoadingTrack{track.collectionId, track.lastModification, level,
+                                         track.name, track.color, {}, -1, 0, std::nullopt};
+  emit trackLodRequest(track, zoom);
 }
 
-void CollectionMapBridge::onTrackDataLoaded(Track track, std::optional<double> accuracyFilter, bool complete, bool ok)
+void CollectionMapBridge::onTrackPointsLoaded(qint64 trackId, std::optional<double> accuracyFilter, int segment, qint64 offset,
+                                              std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> points)
 {
+  // partial points are emitted for raw level only
   if (delegatedMap == nullptr ||
       accuracyFilter != std::nullopt ||
-      !complete ||
+      !enabled ||
+      !points ||
+      points->empty() ||
+      !tracksInBox.contains(trackId) ||
+      !loadingTracks.contains(trackId)) {
+    return;
+  }
+
+  LoadingTrack &loading = loadingTracks[trackId];
+  if (loading.level >= 0 ||
+      segment < loading.segment ||
+      offset != (segment == loading.segment ? loading.segmentPoints : 0)) {
+    return; // chunk of concurrent load
+  }
+  if (loading.segment != segment) {
+    loading.segment = segment;
+    loading.segmentPoints = 0;
+    loading.lastCoord = std::nullopt;
+  }
+  loading.segmentPoints += qint64(points->size());
+
+  // chunk is displayed as standalone way, connected with the previous chunk of the segment
+  std::vector<osmscout::Point> wayPoints;
+  wayPoints.reserve(points->size() + 1);
+  if (loading.lastCoord) {
+    wayPoints.emplace_back(0, *loading.lastCoord);
+  }
+  for (auto const &p: *points) {
+    wayPoints.emplace_back(0, p.coord);
+  }
+  loading.lastCoord = points->back().coord;
+  if (wayPoints.size() < 2) {
+    return;
+  }
+
+  osmscout::OverlayWay trkOverlay(wayPoints);
+  trkOverlay.setTypeName(trackTypeName);
+  trkOverlay.setName(loading.name);
+  if (loading.color.has_value()) {
+    trkOverlay.setColorValue(loading.color.value());
+  }
+  loading.ids.push_back(nextObjectId++);
+  delegatedMap->addOverlayObject(loading.ids.back(), &trkOverlay);
+}
+
+void CollectionMapBridge::onTrackLodLoaded(Track track, int zoom, bool ok)
+{
+  int level = TrackSimplifier::levelForZoom(zoom);
+
+  // partial overlays are removed when complete track is displayed
+  std::vector<qint64> partialIds;
+  if (loadingTracks.contains(track.id)) {
+    if (loadingTracks[track.id].level != level) {
+      return; // response for previous request
+    }
+    partialIds = loadingTracks.take(track.id).ids;
+  }
+
+  if (delegatedMap == nullptr ||
       !ok ||
       !enabled ||
       !displayedCollection.contains(track.collectionId) ||
+      !tracksInBox.contains(track.id) ||
       !track.visible ||
-      displayedCollection[track.collectionId].tracks[track.id].lastModification == track.lastModification
+      (displayedCollection[track.collectionId].tracks.contains(track.id) &&
+       displayedCollection[track.collectionId].tracks[track.id].lastModification == track.lastModification &&
+       displayedCollection[track.collectionId].tracks[track.id].level == level)
       ){
+    if (delegatedMap != nullptr) {
+      removeOverlays(partialIds);
+    }
     return;
   }
 
@@ -170,34 +382,45 @@ void CollectionMapBridge::onTrackDataLoaded(Track track, std::optional<double> a
            << displayedCollection[track.collectionId].tracks[track.id].lastModification << "/" << track.lastModification
            << "to map" << delegatedMap;
 
+  // raw points of archived track are read from the mapped archive
+  size_t segmentCount = track.archive ? track.archive->segments.size() : track.data->segments.size();
+
   std::vector<qint64> ids;
   // if track is displayed already...
   if (displayedCollection.contains(track.collectionId) &&
       displayedCollection[track.collectionId].tracks.contains(track.id)){
     ids = displayedCollection[track.collectionId].tracks[track.id].ids;
   }
-  if (ids.size() < track.data->segments.size()) {
+  if (ids.size() < segmentCount) {
     // generate ids for new segments
-    ids.reserve(track.data->segments.size());
-    while (ids.size() < track.data->segments.size()) {
+    ids.reserve(segmentCount);
+    while (ids.size() < segmentCount) {
       ids.push_back(nextObjectId++);
     }
   }
-  if (ids.size() > track.data->segments.size()) {
+  if (ids.size() > segmentCount) {
     // hide segments from tail
-    for (size_t i=track.data->segments.size(); i < ids.size(); i++){
+    for (size_t i=segmentCount; i < ids.size(); i++){
       delegatedMap->removeOverlayObject(ids[i]);
     }
-    ids.resize(track.data->segments.size());
+    ids.resize(segmentCount);
   }
 
-  assert(ids.size() == track.data->segments.size());
-  for (size_t i=0; i < track.data->segments.size(); i++) {
-    const osmscout::gpx::TrackSegment &seg = track.data->segments[i];
+  assert(ids.size() == segmentCount);
+  for (size_t i=0; i < segmentCount; i++) {
     std::vector<osmscout::Point> points;
-    points.reserve(seg.points.size());
-    for (auto const &p:seg.points) {
-      points.emplace_back(0, p.coord);
+    if (track.archive) {
+      const TrackArchive::SegmentView &view = track.archive->segments[i];
+      points.reserve(view.size());
+      for (size_t p=0; p < view.size(); p++) {
+        points.emplace_back(0, view.coord(p));
+      }
+    } else {
+      const osmscout::gpx::TrackSegment &seg = track.data->segments[i];
+      points.reserve(seg.points.size());
+      for (auto const &p:seg.points) {
+        points.emplace_back(0, p.coord);
+      }
     }
     osmscout::OverlayWay trkOverlay(points);
     trkOverlay.setTypeName(trackTypeName);
@@ -209,13 +432,23 @@ void CollectionMapBridge::onTrackDataLoaded(Track track, std::optional<double> a
   }
   displayedCollection[track.collectionId].tracks[track.id]=DisplayedTrack{
     track.lastModification,
+    level,
     ids
   };
+  removeOverlays(partialIds);
 }
 
-void CollectionMapBridge::onCollectionsLoaded(std::vector<Collection> collections, bool /*ok*/)
+void CollectionMapBridge::onCollectionChanged(qint64 collectionId)
 {
-  qDebug() << "Loaded" << collections.size() << "collections for map" << delegatedMap;
+  // all items of displayed collection are needed for the map
+  if (delegatedMap != nullptr && enabled && displayedCollection.contains(collectionId)) {
+    collectionDetailRequest(Collection(collectionId));
+  }
+}
+
+void CollectionMapBridge::onCollectionsLoaded(CollectionListSnapshot collections, bool /*ok*/)
+{
+  qDebug() << "Loaded" << collections->size() << "collections for map" << delegatedMap;
 
   // clear deleted collections on map
   if (delegatedMap == nullptr) {
@@ -223,7 +456,7 @@ void CollectionMapBridge::onCollectionsLoaded(std::vector<Collection> collection
   }else{
     QMap<qint64, DisplayedCollection> collectionToHide = displayedCollection;
 
-    for (const auto &c: collections){
+    for (const auto &c: *collections){
       if (c.visible && enabled){
         collectionToHide.remove(c.id);
         collectionDetailRequest(c);
@@ -236,8 +469,11 @@ void CollectionMapBridge::onCollectionsLoaded(std::vector<Collection> collection
         delegatedMap->removeOverlayObject(wpt.id);
       }
       for (const auto &trk:col.tracks){
-        for (const auto &id:trk.ids){
-          delegatedMap->removeOverlayObject(id);
+        removeOverlays(trk.ids);
+      }
+      for (const auto &trkId: loadingTracks.keys()) {
+        if (loadingTracks[trkId].collectionId == colId) {
+          removeOverlays(loadingTracks.take(trkId).ids);
         }
       }
     }
@@ -246,11 +482,20 @@ void CollectionMapBridge::onCollectionsLoaded(std::vector<Collection> collection
 
 void CollectionMapBridge::setMap(QObject *map)
 {
+  if (delegatedMap != nullptr){
+    disconnect(delegatedMap, nullptr, this, nullptr);
+  }
   delegatedMap = qobject_cast<osmscout::MapWidget*>(map);
   if (delegatedMap == nullptr){
     return;
   }
   qDebug() << "CollectionMapBridge map:" << delegatedMap;
+  connect(delegatedMap, &osmscout::MapWidget::viewChanged,
+          this, &CollectionMapBridge::onViewChanged);
+  connect(delegatedMap, &QQuickItem::widthChanged,
+          this, &CollectionMapBridge::onViewChanged);
+  connect(delegatedMap, &QQuickItem::heightChanged,
+          this, &CollectionMapBridge::onViewChanged);
   init();
 }
 
@@ -264,6 +509,9 @@ void CollectionMapBridge::Invalidate()
       trk.lastModification = QDateTime();
     }
   }
+  for (auto &trk : loadingTracks){
+    trk.lastModification = QDateTime();
+  }
 }
 
 void CollectionMapBridge::setWaypointType(QString name)
@@ -39,16 +39,22 @@ class CollectionMapBridge : public QObject {
 signals:
   void collectionLoadRequest();
   void collectionDetailRequest(Collection);
-  void trackDataRequest(Track track, std::optional<double> accuracyFilter);
+  void trackLodRequest(Track track, int zoom);
+  void tracksInBoxRequest(const osmscout::GeoBox &box, int zoom);
   void error(QString message);
   void enabledChanged(bool enabled);
 
 public slots:
   void init();
   void storageInitialisationError(QString);
-  void onCollectionsLoaded(std::vector<Collection> collections, bool ok);
-  void onCollectionDetailsLoaded(Collection collection, bool ok);
-  void onTrackDataLoaded(Track track, std::optional<double> accuracyFilter, bool complete, bool ok);
+  void onCollectionsLoaded(CollectionListSnapshot collections, bool ok);
+  void onCollectionDetailsLoaded(CollectionSnapshot collection, bool ok);
+  void onCollectionChanged(qint64 collectionId);
+  void onTrackLodLoaded(Track track, int zoom, bool ok);
+  void onTrackPointsLoaded(qint64 trackId, std::optional<double> accuracyFilter, int segment, qint64 offset,
+                           std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> points);
+  void onTracksInBoxLoaded(const osmscout::GeoBox &box, int zoom, TrackListSnapshot tracks, bool ok);
+  void onViewChanged();
 
 public:
   CollectionMapBridge(QObject *parent = nullptr);
@@ -86,6 +92,17 @@ public:
 private:
   void Invalidate();
 
+  /**
+   * Compute box of current map view, enlarged by margin factor.
+   * @return false when map or its view is not available
+   */
+  bool viewBox(double marginFactor, osmscout::GeoBox &box, int &zoom) const;
+
+  void requestTracksInBox();
+  void requestTrackData(const Track &track, int zoom);
+  void hideTrack(qint64 collectionId, qint64 trackId);
+  void removeOverlays(const std::vector<qint64> &ids);
+
 private:
   osmscout::MapWidget *delegatedMap{nullptr};
   QString waypointTypeName{"_waypoint"};
@@ -96,6 +113,7 @@ private:
 
   struct DisplayedTrack {
     QDateTime lastModification;
+    int level{-1}; // level of detail, see TrackSimplifier
     std::vector<qint64> ids; // overlay object ids (object for every segment)
   };
   struct DisplayedWaypoint {
@@ -108,4 +126,27 @@ private:
   };
 
   QMap<qint64, DisplayedCollection> displayedCollection;
+
+  /**
+   * Track with requested data. Chunks of its points are displayed
+   * as separate overlay objects, until the track is loaded completely.
+   */
+  struct LoadingTrack {
+    qint64 collectionId;
+    QDateTime lastModification;
+    int level{-1}; // requested level of detail
+    QString name;
+    std::optional<osmscout::Color> color;
+    std::vector<qint64> ids; // overlay object ids (object for every chunk)
+    int segment{-1};
+    qint64 segmentPoints{0}; // points received for the segment
+    std::optional<osmscout::GeoCoord> lastCoord; // last point of previous chunk in the segment
+  };
+
+  QMap<qint64, LoadingTrack> loadingTracks;
+
+  // tracks are loaded for box around the view, they are requested again when view leaves it
+  osmscout::GeoBox requestedBox;
+  int requestedZoom{-1};
+  QSet<qint64> tracksInBox;
 };
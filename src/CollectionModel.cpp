@@ -23,7 +23,8 @@
 #include <QDebug>
 #include <QtCore/QStandardPaths>
 #include <QStorageInfo>
-#include <QtCore/QCollator>
+
+#include <algorithm>
 
 namespace {
 QString safeFileName(QString name)
@@ -45,12 +46,16 @@ CollectionModel::CollectionModel()
           this, &CollectionModel::storageInitialisationError,
           Qt::QueuedConnection);
 
-  connect(this, &CollectionModel::collectionDetailRequest,
-          storage, &Storage::loadCollectionDetails,
+  connect(this, &CollectionModel::collectionItemsRequest,
+          storage, &Storage::loadCollectionItems,
+          Qt::QueuedConnection);
+
+  connect(storage, &Storage::collectionItemsLoaded,
+          this, &CollectionModel::onCollectionItemsLoaded,
           Qt::QueuedConnection);
 
-  connect(storage, &Storage::collectionDetailsLoaded,
-          this, &CollectionModel::onCollectionDetailsLoaded,
+  connect(storage, &Storage::collectionChanged,
+          this, &CollectionModel::onCollectionChanged,
           Qt::QueuedConnection);
 
   connect(this, &CollectionModel::deleteWaypointRequest,
@@ -75,7 +80,7 @@ CollectionModel::CollectionModel()
 
   connect(this, &CollectionModel::exportCollectionRequest,
           storage, &Storage::exportCollection,
-          Qt::QueuedConnection);
+          Qt::DirectConnection);
 
   connect(storage, &Storage::collectionExported,
           this, &CollectionModel::onCollectionExported,
@@ -83,12 +88,16 @@ CollectionModel::CollectionModel()
 
   connect(this, &CollectionModel::exportTrackRequest,
           storage, &Storage::exportTrack,
-          Qt::QueuedConnection);
+          Qt::DirectConnection);
 
   connect(storage, &Storage::trackExported,
           this, &CollectionModel::onTrackExported,
           Qt::QueuedConnection);
 
+  connect(storage, &Storage::exportProgress,
+          this, &CollectionModel::onExportProgress,
+          Qt::QueuedConnection);
+
   connect(storage, &Storage::error,
           this, &CollectionModel::error,
           Qt::QueuedConnection);
@@ -172,9 +181,14 @@ void CollectionModel::storageInitialised()
 {
   beginResetModel();
   collectionLoaded = false;
+  items.clear();
+  totalCount = 0;
   endResetModel();
+  pendingOffset = -1;
+  refreshPending = false;
+  resetPending = false;
   if (collection.id > 0) {
-    emit collectionDetailRequest(collection);
+    refresh();
   }
 }
 
@@ -183,79 +197,83 @@ void CollectionModel::storageInitialisationError(QString)
   storageInitialised();
 }
 
-void CollectionModel::sort(std::vector<Item> &items) const
+void CollectionModel::onCollectionChanged(qint64 collectionId)
 {
-  using namespace converters;
-  using namespace std::string_literals;
+  if (this->collection.id != collectionId){
+    return;
+  }
+  // collection was modified, items are ordered by database, reload loaded window
+  refresh();
+}
 
-  auto date = [](const Item &item) -> QDateTime {
-    if (std::holds_alternative<Track>(item)){
-      return std::get<Track>(item).creationTime;
-    } else {
-      assert(std::holds_alternative<Waypoint>(item));
-      return timestampToDateTime(std::get<Waypoint>(item).data.time);
-    }
-  };
+void CollectionModel::requestItems(qint64 offset, qint64 limit)
+{
+  if (pendingOffset >= 0){
+    refreshPending = refreshPending || offset == 0;
+    return;
+  }
+  pendingOffset = offset;
+  emit collectionItemsRequest(collection, ordering, waypointFirst, offset, limit);
+}
 
-  auto name = [](const Item &item) -> QString {
-    if (std::holds_alternative<Track>(item)){
-      return std::get<Track>(item).name;
-    } else {
-      assert(std::holds_alternative<Waypoint>(item));
-      return QString::fromStdString(std::get<Waypoint>(item).data.name.value_or(""s));
-    }
-  };
+void CollectionModel::refresh()
+{
+  if (collection.id < 0){
+    return;
+  }
+  requestItems(0, std::max(qint64(items.size()), PageSize));
+}
 
-  static const QCollator coll;
-
-  std::sort(items.begin(), items.end(),
-            [&](const Item& lhs, const Item& rhs) {
-              if (waypointFirst && lhs.index() != rhs.index()){
-                return lhs.index() > rhs.index();
-              }
-              switch (ordering){
-                case DateAscent:
-                  return date(lhs) < date(rhs);
-                case DateDescent:
-                  return date(lhs) > date(rhs);
-                case NameAscent:
-                  return coll.compare(name(lhs), name(rhs)) < 0;
-                case NameDescent:
-                  return coll.compare(name(lhs), name(rhs)) > 0;
-              }
-              assert(false);
-              return false;
-            });
-}
-
-void CollectionModel::onCollectionDetailsLoaded(Collection collection, bool ok)
-{
-  if (this->collection.id != collection.id){
+void CollectionModel::onCollectionItemsLoaded(CollectionSnapshot collection, int ordering, bool waypointFirst, qint64 offset,
+                                              CollectionItemsSnapshot newItems, bool ok)
+{
+  if (this->collection.id != collection->id || offset != pendingOffset){
     return;
   }
-  collectionLoaded = true;
-  this->collection = collection;
+  pendingOffset = -1;
 
-  std::vector<Item> newItems;
-  if (collection.waypoints){
-    for (const auto &wpt : *collection.waypoints){
-      newItems.push_back(wpt);
-    }
+  if (refreshPending || ordering != this->ordering || waypointFirst != this->waypointFirst){
+    // response is outdated already
+    refreshPending = false;
+    refresh();
+    return;
+  }
+  if (!ok){
+    qWarning() << "Collection load fails";
   }
-  if (collection.tracks){
-    for (const auto &trk : *collection.tracks){
-      newItems.push_back(trk);
+
+  collectionLoaded = true;
+  this->collection = *collection;
+  totalCount = collection->waypointCount + collection->trackCount;
+
+  if (offset == 0){
+    if (resetPending){
+      resetPending = false;
+      beginResetModel();
+      items = *newItems;
+      endResetModel();
+    } else {
+      handleChanges(items, *newItems);
     }
+  } else if (offset == qint64(items.size()) && !newItems->empty()){
+    beginInsertRows(QModelIndex(), items.size(), items.size() + newItems->size() - 1);
+    items.insert(items.end(), newItems->begin(), newItems->end());
+    endInsertRows();
   }
 
-  sort(newItems);
+  emit loadingChanged();
+}
 
-  handleChanges(items, newItems);
+bool CollectionModel::canFetchMore([[maybe_unused]] const QModelIndex &parent) const
+{
+  return collectionLoaded && pendingOffset < 0 && qint64(items.size()) < totalCount;
+}
 
-  if (!ok){
-    qWarning() << "Collection load fails";
+void CollectionModel::fetchMore([[maybe_unused]] const QModelIndex &parent)
+{
+  if (canFetchMore(parent)){
+    requestItems(items.size(), PageSize);
   }
-  emit loadingChanged();
 }
 
 int CollectionModel::rowCount([[maybe_unused]] const QModelIndex &parentIndex) const
@@ -410,11 +428,23 @@ Qt::ItemFlags CollectionModel::flags(const QModelIndex &index) const
 void CollectionModel::setCollectionId(QString id)
 {
   bool ok;
-  collection.id = id.toLongLong(&ok);
+  qint64 collectionId = id.toLongLong(&ok);
   if (!ok)
-    collection.id = -1;
+    collectionId = -1;
 
-  emit collectionDetailRequest(collection);
+  if (collectionId != collection.id){
+    beginResetModel();
+    collection = Collection(collectionId);
+    collectionLoaded = false;
+    items.clear();
+    totalCount = 0;
+    endResetModel();
+    // response of pending request for previous collection will be ignored
+    pendingOffset = -1;
+    refreshPending = false;
+    resetPending = false;
+  }
+  refresh();
 }
 
 bool CollectionModel::isLoading() const
@@ -452,9 +482,9 @@ void CollectionModel::setWaypointFirst(bool b)
   if (b != waypointFirst){
     waypointFirst=b;
 
-    emit beginResetModel();
-    sort(items);
-    emit endResetModel();
+    // items are ordered by database, model is reset when reordered window is loaded
+    resetPending = true;
+    refresh();
 
     emit orderingChanged();
   }
@@ -465,9 +495,9 @@ void CollectionModel::setOrdering(Ordering ordering)
   if (ordering != this->ordering){
     this->ordering = ordering;
 
-    emit beginResetModel();
-    sort(items);
-    emit endResetModel();
+    // items are ordered by database, model is reset when reordered window is loaded
+    resetPending = true;
+    refresh();
 
     emit orderingChanged();
   }
@@ -551,10 +581,9 @@ void CollectionModel::exportToFile(QString fileName, QString directory, bool inc
     return;
   }
   QFileInfo file(QDir(dir.absoluteFilePath()), safeName + ".gpx");
-  collectionExporting = true;
-  emit exportingChanged();
+  startExport(file.absoluteFilePath());
   std::optional<double> accuracyFilterOpt = accuracyFilter <= 0 ? std::nullopt : std::make_optional(accuracyFilter);
-  emit exportCollectionRequest(collection.id, file.absoluteFilePath(), includeWaypoints, accuracyFilterOpt);
+  emit exportCollectionRequest(collection.id, file.absoluteFilePath(), includeWaypoints, accuracyFilterOpt, exportBreaker);
 }
 
 void CollectionModel::exportTrackToFile(QString trackIdStr, QString fileName, QString directory, bool includeWaypoints, int accuracyFilter)
@@ -579,10 +608,38 @@ void CollectionModel::exportTrackToFile(QString trackIdStr, QString fileName, QS
     return;
   }
   QFileInfo file(QDir(dir.absoluteFilePath()), safeName + ".gpx");
+  startExport(file.absoluteFilePath());
+  std::optional<double> accuracyFilterOpt = accuracyFilter <= 0 ? std::nullopt : std::make_optional(accuracyFilter);
+  emit exportTrackRequest(collection.id, trackId, file.absoluteFilePath(), includeWaypoints, accuracyFilterOpt, exportBreaker);
+}
+
+void CollectionModel::startExport(const QString &file)
+{
+  if (exportBreaker) {
+    // only one export is tracked by the model
+    exportBreaker->Break();
+  }
+  exportBreaker = std::make_shared<osmscout::ThreadSafeBreaker>();
+  exportFile = file;
+  exportedPoints = 0;
   collectionExporting = true;
   emit exportingChanged();
-  std::optional<double> accuracyFilterOpt = accuracyFilter <= 0 ? std::nullopt : std::make_optional(accuracyFilter);
-  emit exportTrackRequest(collection.id, trackId, file.absoluteFilePath(), includeWaypoints, accuracyFilterOpt);
+  emit exportProgressChanged();
+}
+
+void CollectionModel::cancelExport()
+{
+  if (exportBreaker) {
+    exportBreaker->Break();
+  }
+}
+
+void CollectionModel::onExportProgress(QString file, qint64 pointsWritten)
+{
+  if (file == exportFile) {
+    exportedPoints = pointsWritten;
+    emit exportProgressChanged();
+  }
 }
 
 void CollectionModel::onCollectionExported(qint64 collectionId, QString file, bool success)
@@ -590,8 +647,11 @@ void CollectionModel::onCollectionExported(qint64 collectionId, QString file, bo
   if (success) {
     emit exported(collectionId, file);
   }
-  collectionExporting = false;
-  emit exportingChanged();
+  if (file == exportFile) {
+    exportBreaker.reset();
+    collectionExporting = false;
+    emit exportingChanged();
+  }
 }
 
 void CollectionModel::onTrackExported(qint64 trackId, QString file, bool success)
@@ -599,8 +659,11 @@ void CollectionModel::onTrackExported(qint64 trackId, QString file, bool success
   if (success) {
     emit trackExported(trackId, file);
   }
-  collectionExporting = false;
-  emit exportingChanged();
+  if (file == exportFile) {
+    exportBreaker.reset();
+    collectionExporting = false;
+    emit exportingChanged();
+  }
 }
 
 QStringList CollectionModel::getExportSuggestedDirectories()
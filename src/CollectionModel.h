@@ -32,6 +32,7 @@ class CollectionModel : public QAbstractListModel {
   Q_OBJECT
   Q_PROPERTY(bool loading READ isLoading NOTIFY loadingChanged)
   Q_PROPERTY(bool exporting READ isExporting NOTIFY exportingChanged)
+  Q_PROPERTY(qint64 exportedPoints READ getExportedPoints NOTIFY exportProgressChanged)
   Q_PROPERTY(bool collectionVisible READ isVisible NOTIFY loadingChanged)
   Q_PROPERTY(QString collectionId READ getCollectionId WRITE setCollectionId)
   Q_PROPERTY(QString name READ getCollectionName NOTIFY loadingChanged)
@@ -44,14 +45,15 @@ class CollectionModel : public QAbstractListModel {
 signals:
   void loadingChanged();
   void exportingChanged();
-  void collectionDetailRequest(Collection);
+  void exportProgressChanged();
+  void collectionItemsRequest(Collection collection, int ordering, bool waypointFirst, qint64 offset, qint64 limit);
   void deleteWaypointRequest(qint64 collectionId, qint64 id);
   void deleteTrackRequest(qint64 collectionId, qint64 id);
   void createWaypointRequest(qint64 collectionId, double lat, double lon, QString name, QString description, QString symbol);
   void editWaypointRequest(qint64 collectionId, qint64 id, QString name, QString description, QString symbol);
   void editTrackRequest(qint64 collectionId, qint64 id, QString name, QString description);
-  void exportCollectionRequest(qint64 collectionId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter);
-  void exportTrackRequest(qint64 collectionId, qint64 trackId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter);
+  void exportCollectionRequest(qint64 collectionId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter, osmscout::BreakerRef breaker);
+  void exportTrackRequest(qint64 collectionId, qint64 trackId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter, osmscout::BreakerRef breaker);
   void error(QString message);
   void moveWaypointRequest(qint64 waypointId, qint64 collectionId);
   void moveTrackRequest(qint64 trackId, qint64 collectionId);
@@ -64,7 +66,9 @@ signals:
 public slots:
   void storageInitialised();
   void storageInitialisationError(QString);
-  void onCollectionDetailsLoaded(Collection collection, bool ok);
+  void onCollectionChanged(qint64 collectionId);
+  void onCollectionItemsLoaded(CollectionSnapshot collection, int ordering, bool waypointFirst, qint64 offset,
+                               CollectionItemsSnapshot items, bool ok);
   void createWaypoint(double lat, double lon, QString name, QString description, QString symbol);
   void deleteWaypoint(QString id);
   void deleteTrack(QString id);
@@ -74,6 +78,8 @@ public slots:
   void exportTrackToFile(QString id, QString name, QString directory, bool includeWaypoints, int accuracyFilter);
   void onCollectionExported(qint64 collectionId, QString file, bool);
   void onTrackExported(qint64 trackId, QString file, bool success);
+  void onExportProgress(QString file, qint64 pointsWritten);
+  void cancelExport();
   void moveWaypoint(QString waypointId, QString collectionId);
   void moveTrack(QString trackId, QString collectionId);
   void setWaypointVisibility(QString id, bool visible);
@@ -115,12 +121,17 @@ public:
   };
   Q_ENUM(Roles)
 
-  using Item = std::variant<Track, Waypoint>;
+  using Item = CollectionItem;
+
+  /** count of items loaded by one fetchMore call */
+  static constexpr qint64 PageSize = 100;
 
   Q_INVOKABLE virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
   Q_INVOKABLE virtual QVariant data(const QModelIndex &index, int role) const;
   virtual QHash<int, QByteArray> roleNames() const;
   Q_INVOKABLE virtual Qt::ItemFlags flags(const QModelIndex &index) const;
+  bool canFetchMore(const QModelIndex &parent) const override;
+  void fetchMore(const QModelIndex &parent) override;
 
   QString getCollectionId() const
   {
@@ -136,6 +147,12 @@ public:
   bool isVisible() const;
 
   bool isExporting();
+
+  qint64 getExportedPoints() const
+  {
+    return exportedPoints;
+  }
+
   Q_INVOKABLE QStringList getExportSuggestedDirectories();
 
   bool getWaypointFirst() const
@@ -161,7 +178,21 @@ private:
    */
   void handleChanges(std::vector<Item> &current, const std::vector<Item> &newItems);
 
-  void sort(std::vector<Item> &items) const;
+  /**
+   * Request page of items, just one request is processed at a time.
+   * When some request is pending, refresh is postponed until its response.
+   */
+  void requestItems(qint64 offset, qint64 limit);
+
+  /**
+   * Reload all loaded items (at least one page) from the database.
+   */
+  void refresh();
+
+  /**
+   * Setup state for new export, previous one is canceled
+   */
+  void startExport(const QString &file);
 
 private:
   Collection collection;
@@ -169,6 +200,14 @@ private:
 
   bool collectionLoaded{false};
   bool collectionExporting{false};
+  osmscout::BreakerRef exportBreaker;
+  QString exportFile;
+  qint64 exportedPoints{0};
+
+  qint64 totalCount{0}; //!< count of items in collection, items contains just loaded window
+  qint64 pendingOffset{-1}; //!< offset of pending request, -1 when there is none
+  bool refreshPending{false};
+  bool resetPending{false}; //!< ordering was changed, model will be reset by next refresh
 
   bool waypointFirst{true};
   Ordering ordering{DateAscent};
@@ -24,6 +24,8 @@
 
 #include <QDebug>
 
+#include <algorithm>
+
 using namespace osmscout;
 
 CollectionTrackModel::CollectionTrackModel()
@@ -41,7 +43,7 @@ CollectionTrackModel::CollectionTrackModel()
 
   connect(this, &CollectionTrackModel::trackDataRequest,
           storage, &Storage::loadTrackData,
-          Qt::QueuedConnection);
+          Qt::DirectConnection);
 
   connect(this, &CollectionTrackModel::cropStartRequest,
           storage, &Storage::cropTrackStart,
@@ -59,10 +61,18 @@ CollectionTrackModel::CollectionTrackModel()
           storage, &Storage::filterTrackNodes,
           Qt::QueuedConnection);
 
+  connect(this, &CollectionTrackModel::archiveRequest,
+          storage, &Storage::archiveTrack,
+          Qt::QueuedConnection);
+
   connect(storage, &Storage::trackDataLoaded,
           this, &CollectionTrackModel::onTrackDataLoaded,
           Qt::QueuedConnection);
 
+  connect(storage, &Storage::trackPointsLoaded,
+          this, &CollectionTrackModel::onTrackPointsLoaded,
+          Qt::QueuedConnection);
+
   connect(this, &CollectionTrackModel::setColorRequest,
           storage, &Storage::setTrackColor,
           Qt::QueuedConnection);
@@ -227,27 +237,96 @@ void CollectionTrackModel::onTrackDataLoaded(Track track, std::optional<double>
   if (track.id != this->track.id || accuracyFilter != this->accuracyFilter){
     return;
   }
+  if (!complete && !loading) {
+    return; // metadata of load requested by someone else
+  }
   // TODO: error handling when !ok
   loading = !complete;
-  if (complete) {
-    GeoBox originalBox = this->track.statistics.bbox;
-    this->track = track;
-    if (originalBox.IsValid() != track.statistics.bbox.IsValid() ||
-        originalBox.GetMinCoord() != track.statistics.bbox.GetMinCoord() ||
-        originalBox.GetMaxCoord() != track.statistics.bbox.GetMaxCoord()) {
-      emit bboxChanged();
+  GeoBox originalBox = this->track.statistics.bbox;
+  this->track = track;
+  if (!complete) {
+    // metadata, points will follow by onTrackPointsLoaded
+    this->track.data = std::make_shared<gpx::Track>();
+    firstUpdatedSegment = 0;
+    partialUpdatePending = false;
+    partialUpdateTimer.invalidate();
+  }
+  if (originalBox.IsValid() != track.statistics.bbox.IsValid() ||
+      originalBox.GetMinCoord() != track.statistics.bbox.GetMinCoord() ||
+      originalBox.GetMaxCoord() != track.statistics.bbox.GetMaxCoord()) {
+    emit bboxChanged();
+  }
+  if (complete && track.archive && accuracyFilter) {
+    // filtered points cannot be addressed in the archive, they are copied
+    auto data = std::make_shared<gpx::Track>();
+    for (const auto &view: track.archive->segments) {
+      gpx::TrackSegment &segment = data->segments.emplace_back();
+      view.visitBatches(accuracyFilter, [&segment](const std::vector<gpx::TrackPoint> &points) {
+        segment.points.insert(segment.points.end(), points.begin(), points.end());
+      });
     }
+    this->track.data = data;
+    this->track.archive.reset();
+  }
+  if (complete) {
+    // complete data may differ from partial (track was edited meanwhile), update everything
+    firstUpdatedSegment = 0;
+    notifyDataUpdated(true);
   }
   emit loadingChanged();
 }
 
+void CollectionTrackModel::onTrackPointsLoaded(qint64 trackId, std::optional<double> accuracyFilter, int segment, qint64 offset,
+                                               std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> points)
+{
+  if (!loading || trackId != track.id || accuracyFilter != this->accuracyFilter || !track.data || !points){
+    return;
+  }
+  auto &segments = track.data->segments;
+  if (segment < 0 || size_t(segment) + 1 < segments.size()) {
+    return; // chunk of concurrent load
+  }
+  qint64 expectedOffset = size_t(segment) < segments.size() ? qint64(segments[segment].points.size()) : 0;
+  if (offset != expectedOffset) {
+    return; // chunk of concurrent load
+  }
+  if (!partialUpdatePending) {
+    firstUpdatedSegment = std::min(segment, int(segments.size()));
+  }
+  if (size_t(segment) >= segments.size()) {
+    segments.resize(segment + 1);
+  }
+  auto &segmentPoints = segments[segment].points;
+  segmentPoints.insert(segmentPoints.end(), points->begin(), points->end());
+  partialUpdatePending = true;
+
+  // first chunk is rendered immediately, following ones are throttled
+  notifyDataUpdated(!partialUpdateTimer.isValid());
+}
+
+void CollectionTrackModel::notifyDataUpdated(bool force)
+{
+  if (!force && partialUpdateTimer.isValid() && partialUpdateTimer.elapsed() < PartialUpdateIntervalMs) {
+    return;
+  }
+  partialUpdateTimer.start();
+  partialUpdatePending = false;
+  emit dataUpdated(firstUpdatedSegment);
+}
+
 int CollectionTrackModel::getSegmentCount() const
 {
+  if (track.archive){
+    return track.archive->segments.size();
+  }
   return track.data ? track.data->segments.size() : 0;
 }
 
 quint64 CollectionTrackModel::getPointCount() const
 {
+  if (track.archive){
+    return track.archive->pointCount();
+  }
   if (!track.data){
     return 0;
   }
@@ -257,16 +336,23 @@ quint64 CollectionTrackModel::getPointCount() const
 
 QObject* CollectionTrackModel::createOverlayForSegment(int segment)
 {
-  if (!track.data)
-    return nullptr;
-  if (segment < 0 || (size_t)segment >= track.data->segments.size())
+  if (segment < 0 || segment >= getSegmentCount())
     return nullptr;
 
-  gpx::TrackSegment &seg = track.data->segments[segment];
   std::vector<osmscout::Point> points;
-  points.reserve(seg.points.size());
-  for (auto const &p:seg.points){
-    points.emplace_back(0, p.coord);
+  if (track.archive){
+    // archived points are read from the mapped archive
+    const TrackArchive::SegmentView &view = track.archive->segments[segment];
+    points.reserve(view.size());
+    for (size_t i=0; i < view.size(); i++){
+      points.emplace_back(0, view.coord(i));
+    }
+  } else {
+    gpx::TrackSegment &seg = track.data->segments[segment];
+    points.reserve(seg.points.size());
+    for (auto const &p:seg.points){
+      points.emplace_back(0, p.coord);
+    }
   }
   auto trkOverlay = new OverlayWay(points);
   if (track.color.has_value()) {
@@ -277,6 +363,17 @@ QObject* CollectionTrackModel::createOverlayForSegment(int segment)
 
 QPointF CollectionTrackModel::getPoint(quint64 index) const
 {
+  if (track.archive){
+    for (auto const &view:track.archive->segments){
+      if (index>=view.size()){
+        index-=view.size();
+      } else {
+        osmscout::GeoCoord coord=view.coord(index);
+        return QPointF(coord.GetLat(), coord.GetLon());
+      }
+    }
+    return QPointF();
+  }
   if (!track.data)
     return QPointF();
 
@@ -321,6 +418,14 @@ void CollectionTrackModel::split(quint64 position)
   emit loadingChanged();
 }
 
+void CollectionTrackModel::archive()
+{
+  if (track.id < 0){
+    return;
+  }
+  emit archiveRequest(track);
+}
+
 void CollectionTrackModel::filterNodes(double accuracyFilter)
 {
   if (track.id < 0){
@@ -23,6 +23,7 @@
 
 #include <QObject>
 #include <QtCore/QAbstractItemModel>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QSet>
 #include <QPointF>
 
@@ -58,6 +59,12 @@ class CollectionTrackModel : public QObject {
 signals:
   void loadingChanged();
   void bboxChanged();
+  /**
+   * Track data was updated, segments before firstSegment are untouched
+   * from previous notification. It is emitted repeatedly during loading,
+   * so the track may be rendered before it is loaded completely.
+   */
+  void dataUpdated(int firstSegment);
   void trackDataRequest(Track track, std::optional<double>);
 
   // track edits
@@ -66,11 +73,14 @@ signals:
   void splitRequest(Track track, quint64 position);
   void filterNodesRequest(Track track, std::optional<double> accuracyFilter);
   void setColorRequest(Track track, std::optional<osmscout::Color> colorOpt);
+  void archiveRequest(Track track);
 
 public slots:
   void storageInitialised();
   void storageInitialisationError(QString);
   void onTrackDataLoaded(Track track, std::optional<double>, bool complete, bool ok);
+  void onTrackPointsLoaded(qint64 trackId, std::optional<double> accuracyFilter, int segment, qint64 offset,
+                           std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> points);
 
 public:
   CollectionTrackModel();
@@ -112,9 +122,21 @@ public:
   Q_INVOKABLE void split(quint64 position);
   Q_INVOKABLE void filterNodes(double accuracyFilter);
   Q_INVOKABLE void setupColor(const QString &color);
+  /** move points of closed track to read-only archive, see Storage::archiveTrack */
+  Q_INVOKABLE void archive();
 
 private:
+  void notifyDataUpdated(bool force);
+
+private:
+  static constexpr qint64 PartialUpdateIntervalMs = 200;
+
   bool loading{false};
   std::optional<double> accuracyFilter{std::nullopt};
   Track track;
+
+  // progressive loading state
+  QElapsedTimer partialUpdateTimer;
+  int firstUpdatedSegment{0};
+  bool partialUpdatePending{false};
 };
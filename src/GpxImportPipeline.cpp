@@ -0,0 +1,181 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "GpxImportPipeline.h"
+#include "TrackPointCodec.h"
+
+#include <QElapsedTimer>
+
+using namespace osmscout;
+
+GpxImportPipeline::GpxImportPipeline(QIODevice *device, size_t chunkSize):
+  reader(device, BatchSize), chunkSize(chunkSize)
+{}
+
+GpxImportPipeline::~GpxImportPipeline()
+{
+  abort();
+  join();
+}
+
+void GpxImportPipeline::start()
+{
+  parseThread = std::thread(&GpxImportPipeline::parseRun, this);
+  statisticsThread = std::thread(&GpxImportPipeline::statisticsRun, this);
+}
+
+bool GpxImportPipeline::pop(GpxImportRecord &record)
+{
+  return records.pop(record);
+}
+
+void GpxImportPipeline::abort()
+{
+  records.close();
+  items.close();
+}
+
+bool GpxImportPipeline::join()
+{
+  if (parseThread.joinable()) {
+    parseThread.join();
+  }
+  if (statisticsThread.joinable()) {
+    statisticsThread.join();
+  }
+  return parsed;
+}
+
+void GpxImportPipeline::parseRun()
+{
+  QElapsedTimer timer;
+  timer.start();
+  bool result = reader.read([this](GpxImportItem &&item) {
+    parse.items++;
+    parse.points += item.points.size();
+    return items.push(std::move(item));
+  });
+  items.close();
+  parse.activeNs = timer.nsecsElapsed() - items.pushWait();
+  parsed = result;
+}
+
+void GpxImportPipeline::statisticsRun()
+{
+  using Type = GpxImportItem::Type;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  TrackStatisticsAccumulator accumulator; // segment statistics
+  std::vector<TrackStatistics> segmentStats;
+  TrackSimplifier simplifier;
+  std::vector<gpx::TrackPoint> chunkPoints;
+  chunkPoints.reserve(chunkSize);
+  qint64 chunkIndex = 0;
+  qint64 segmentPoints = 0;
+  Distance segmentLength;
+  std::optional<GeoCoord> lastCoord;
+
+  auto pushRecord = [this](GpxImportRecord &&record) {
+    stats.items++;
+    return records.push(std::move(record));
+  };
+  auto pushChunk = [&]() {
+    if (chunkPoints.empty()) {
+      return true;
+    }
+    GpxImportRecord record;
+    record.type = Type::Points;
+    record.chunkIndex = chunkIndex++;
+    record.firstPoint = segmentPoints;
+    record.chunkPointCount = qint64(chunkPoints.size());
+    segmentPoints += record.chunkPointCount;
+    record.chunk = TrackPointCodec::encode(chunkPoints);
+    simplifier.append(chunkPoints);
+    chunkPoints.clear();
+    return pushRecord(std::move(record));
+  };
+
+  GpxImportItem item;
+  bool ok = true;
+  while (ok && items.pop(item)) {
+    if (item.type == Type::Points) {
+      stats.points += item.points.size();
+      for (auto &point: item.points) {
+        accumulator.update(point);
+        if (lastCoord) {
+          segmentLength += GetEllipsoidalDistance(*lastCoord, point.coord);
+        }
+        lastCoord = point.coord;
+        chunkPoints.push_back(std::move(point));
+        if (chunkPoints.size() >= chunkSize && !pushChunk()) {
+          ok = false;
+          break;
+        }
+      }
+      continue;
+    }
+
+    GpxImportRecord record;
+    record.type = item.type;
+    switch (item.type) {
+      case Type::SegmentStart:
+        chunkIndex = 0;
+        segmentPoints = 0;
+        accumulator = TrackStatisticsAccumulator();
+        simplifier.clear();
+        segmentLength = Distance();
+        lastCoord = std::nullopt;
+        break;
+      case Type::SegmentEnd:
+        ok = pushChunk();
+        accumulator.segmentEnd();
+        record.statistics = accumulator.accumulate();
+        segmentStats.push_back(record.statistics);
+        record.segmentLength = segmentLength;
+        record.lods = simplifier.encodeLevels();
+        break;
+      case Type::TrackStart:
+        segmentStats.clear();
+        record.item = std::move(item);
+        break;
+      case Type::TrackEnd:
+        record.statistics = TrackStatistics::merge(segmentStats);
+        break;
+      default:
+        record.item = std::move(item);
+        break;
+    }
+    ok = ok && pushRecord(std::move(record));
+  }
+
+  // unblock the parser when writer aborted
+  items.close();
+  records.close();
+  stats.activeNs = timer.nsecsElapsed() - items.popWait() - records.pushWait();
+}
+
+QDebug operator<<(QDebug out, const GpxImportPipeline::StageStatistics &stage)
+{
+  QDebugStateSaver saver(out);
+  out.nospace() << stage.name << ": " << stage.items << " items, " << stage.points << " points, "
+                << (stage.activeNs / 1000000) << " ms, " << qint64(stage.pointsPerSecond()) << " points/s";
+  return out;
+}
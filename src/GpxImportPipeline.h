@@ -0,0 +1,161 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include "BoundedQueue.h"
+#include "GpxStreamReader.h"
+#include "Storage.h"
+#include "TrackSimplifier.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QIODevice>
+
+#include <atomic>
+#include <thread>
+
+/**
+ * Output of GpxImportPipeline, consumed by Storage (writer stage).
+ * Points are already packed by TrackPointCodec, segment and track records
+ * have computed statistics.
+ */
+struct GpxImportRecord
+{
+  using Type = GpxImportItem::Type;
+
+  Type type{Type::Metadata};
+  GpxImportItem item; //!< source item for Metadata, Waypoint and TrackStart, without points
+
+  // Type::Points
+  qint64 chunkIndex{0};
+  qint64 firstPoint{0}; //!< sequence of the first chunk point in segment
+  qint64 chunkPointCount{0};
+  QByteArray chunk;
+
+  osmscout::Distance segmentLength; //!< Type::SegmentEnd
+  std::vector<QByteArray> lods; //!< Type::SegmentEnd, simplified segment levels, see TrackSimplifier
+  TrackStatistics statistics; //!< Type::SegmentEnd and Type::TrackEnd
+};
+
+/**
+ * GPX import split to stages running in own threads, connected by lock-free queues:
+ *
+ *  1. XML parsing (GpxStreamReader)
+ *  2. track statistics, segment lengths, levels of detail and packing points to chunks
+ *  3. SQLite write, done by caller thread via pop
+ *
+ * Memory usage of parsed items and packed chunks is bounded by queue capacities.
+ * Levels of detail of the current segment (TrackSimplifier) are kept until segment end,
+ * so memory grows with the longest segment - level 0 may keep most of its points.
+ */
+class GpxImportPipeline
+{
+public:
+  struct StageStatistics
+  {
+    const char *name;
+    qint64 items{0};
+    qint64 points{0};
+    qint64 activeNs{0}; //!< processing time, without waiting for queues
+
+    double pointsPerSecond() const
+    {
+      return activeNs == 0 ? 0 : double(points) / (double(activeNs) / 1e9);
+    }
+  };
+
+public:
+  static constexpr size_t BatchSize = 1000; // points
+  static constexpr size_t QueueCapacity = 16;
+
+  GpxImportPipeline(QIODevice *device, size_t chunkSize);
+  GpxImportPipeline(const GpxImportPipeline&) = delete;
+  GpxImportPipeline(GpxImportPipeline&&) = delete;
+
+  /**
+   * Aborts and joins stage threads when they are still running.
+   */
+  ~GpxImportPipeline();
+
+  GpxImportPipeline& operator=(const GpxImportPipeline&) = delete;
+  GpxImportPipeline& operator=(GpxImportPipeline&&) = delete;
+
+  void start();
+
+  /**
+   * Next record for the writer. Waits until record is available.
+   * @return false when there are no more records
+   */
+  bool pop(GpxImportRecord &record);
+
+  /**
+   * Stop the stages, when writer failed.
+   */
+  void abort();
+
+  /**
+   * Wait for stage threads.
+   * @return true when whole file was parsed successfully
+   */
+  bool join();
+
+  QString errorString() const
+  {
+    return reader.errorString();
+  }
+
+  /**
+   * Statistics of parse and statistics stages, valid after join
+   */
+  StageStatistics parseStage() const
+  {
+    return parse;
+  }
+
+  StageStatistics statisticsStage() const
+  {
+    return stats;
+  }
+
+  /**
+   * Time spent by writer (pop caller) by waiting for records
+   */
+  qint64 writeWaitNs() const
+  {
+    return records.popWait();
+  }
+
+private:
+  void parseRun();
+  void statisticsRun();
+
+private:
+  GpxStreamReader reader;
+  size_t chunkSize;
+  BoundedQueue<GpxImportItem> items{QueueCapacity};
+  BoundedQueue<GpxImportRecord> records{QueueCapacity};
+  std::thread parseThread;
+  std::thread statisticsThread;
+  std::atomic<bool> parsed{false};
+  StageStatistics parse{"parse"};
+  StageStatistics stats{"statistics"};
+};
+
+QDebug operator<<(QDebug out, const GpxImportPipeline::StageStatistics &stage);
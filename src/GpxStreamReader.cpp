@@ -0,0 +1,394 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "GpxStreamReader.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+using namespace osmscout;
+
+namespace {
+/**
+ * Days since unix epoch for proleptic Gregorian calendar date,
+ * see http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+ */
+int64_t daysFromCivil(int64_t y, unsigned m, unsigned d)
+{
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = unsigned(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + int64_t(doe) - 719468;
+}
+
+bool readDigits(const QString &str, int pos, int count, int &value)
+{
+  if (pos + count > str.size()) {
+    return false;
+  }
+  value = 0;
+  for (int i = pos; i < pos + count; i++) {
+    int digit = str[i].digitValue();
+    if (digit < 0) {
+      return false;
+    }
+    value = value * 10 + digit;
+  }
+  return true;
+}
+
+std::optional<Timestamp> parseIsoTime(const QString &str)
+{
+  using namespace std::chrono;
+
+  int year, month, day, hour, minute, second;
+  if (str.size() < 19) {
+    return std::nullopt;
+  }
+  if (!(readDigits(str, 0, 4, year) && str[4] == '-' &&
+        readDigits(str, 5, 2, month) && str[7] == '-' &&
+        readDigits(str, 8, 2, day) && (str[10] == 'T' || str[10] == ' ') &&
+        readDigits(str, 11, 2, hour) && str[13] == ':' &&
+        readDigits(str, 14, 2, minute) && str[16] == ':' &&
+        readDigits(str, 17, 2, second))) {
+    return std::nullopt;
+  }
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return std::nullopt;
+  }
+
+  int pos = 19;
+  int64_t millis = 0;
+  if (pos < str.size() && str[pos] == '.') {
+    pos++;
+    // sub-millisecond precision is truncated
+    int scale = 100;
+    while (pos < str.size() && str[pos].isDigit()) {
+      millis += str[pos].digitValue() * scale;
+      scale /= 10;
+      pos++;
+    }
+  }
+
+  // time without zone is considered as UTC, as GPX specification requires
+  int64_t offsetMinutes = 0;
+  if (pos < str.size()) {
+    int offsetHour, offsetMinute;
+    if (str[pos] == 'Z' && pos + 1 == str.size()) {
+      // UTC
+    } else if ((str[pos] == '+' || str[pos] == '-') &&
+               readDigits(str, pos + 1, 2, offsetHour) &&
+               ((pos + 6 == str.size() && str[pos + 3] == ':' && readDigits(str, pos + 4, 2, offsetMinute)) ||
+                (pos + 5 == str.size() && readDigits(str, pos + 3, 2, offsetMinute)))) {
+      offsetMinutes = (offsetHour * 60 + offsetMinute) * (str[pos] == '-' ? -1 : 1);
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  int64_t seconds = ((daysFromCivil(year, unsigned(month), unsigned(day)) * 24 + hour) * 60 + minute) * 60 + second;
+  return Timestamp(milliseconds(seconds * 1000 + millis - offsetMinutes * 60000));
+}
+}
+
+GpxStreamReader::GpxStreamReader(QIODevice *device, size_t batchSize):
+  xml(device), batchSize(std::max(size_t(1), batchSize))
+{
+  batch.reserve(this->batchSize);
+}
+
+std::optional<Timestamp> GpxStreamReader::parseTime(const QString &str)
+{
+  using namespace std::chrono;
+
+  if (auto time = parseIsoTime(str); time) {
+    return time;
+  }
+  QDateTime dateTime = QDateTime::fromString(str, Qt::ISODate);
+  if (!dateTime.isValid()) {
+    return std::nullopt;
+  }
+  return Timestamp(milliseconds(dateTime.toMSecsSinceEpoch()));
+}
+
+bool GpxStreamReader::read(const Sink &sink)
+{
+  this->sink = &sink;
+  if (!xml.readNextStartElement() || xml.name() != QLatin1String("gpx")) {
+    error = xml.hasError() ? xml.errorString() : QString("Not a GPX document");
+    this->sink = nullptr;
+    return false;
+  }
+
+  while (!aborted && xml.readNextStartElement()) {
+    QStringRef name = xml.name();
+    if (name == QLatin1String("metadata")) {
+      readMetadata();
+    } else if (name == QLatin1String("name")) {
+      // GPX 1.0 have name and desc directly in gpx element
+      metadata.name = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else if (name == QLatin1String("desc")) {
+      metadata.desc = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else if (name == QLatin1String("wpt")) {
+      if (emitMetadata()) {
+        readWaypoint();
+      }
+    } else if (name == QLatin1String("trk")) {
+      if (emitMetadata()) {
+        readTrack();
+      }
+    } else {
+      xml.skipCurrentElement();
+    }
+  }
+
+  if (!aborted && xml.hasError()) {
+    error = QString("%1 (line %2)").arg(xml.errorString()).arg(xml.lineNumber());
+  }
+  bool result = !aborted && !xml.hasError() && emitMetadata();
+  this->sink = nullptr;
+  return result;
+}
+
+bool GpxStreamReader::emitItem(GpxImportItem &&item)
+{
+  assert(sink != nullptr);
+  if (!aborted && !(*sink)(std::move(item))) {
+    aborted = true;
+  }
+  return !aborted;
+}
+
+bool GpxStreamReader::emitMetadata()
+{
+  if (metadataEmitted) {
+    return !aborted;
+  }
+  metadataEmitted = true;
+  metadata.type = GpxImportItem::Type::Metadata;
+  return emitItem(std::move(metadata));
+}
+
+bool GpxStreamReader::emitPoints()
+{
+  if (batch.empty()) {
+    return !aborted;
+  }
+  GpxImportItem item;
+  item.type = GpxImportItem::Type::Points;
+  item.points = std::move(batch);
+  batch = std::vector<gpx::TrackPoint>();
+  batch.reserve(batchSize);
+  return emitItem(std::move(item));
+}
+
+void GpxStreamReader::readMetadata()
+{
+  while (xml.readNextStartElement()) {
+    QStringRef name = xml.name();
+    if (name == QLatin1String("name")) {
+      metadata.name = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else if (name == QLatin1String("desc")) {
+      metadata.desc = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else {
+      xml.skipCurrentElement();
+    }
+  }
+}
+
+bool GpxStreamReader::readCoord(GeoCoord &coord)
+{
+  QXmlStreamAttributes attributes = xml.attributes();
+  bool latOk = false;
+  bool lonOk = false;
+  double lat = attributes.value(QLatin1String("lat")).toDouble(&latOk);
+  double lon = attributes.value(QLatin1String("lon")).toDouble(&lonOk);
+  if (!latOk || !lonOk || lat < -90 || lat > 90 || lon < -180 || lon > 180) {
+    return false;
+  }
+  coord.Set(lat, lon);
+  return true;
+}
+
+std::optional<double> GpxStreamReader::readDouble()
+{
+  bool ok = false;
+  double value = xml.readElementText(QXmlStreamReader::SkipChildElements).trimmed().toDouble(&ok);
+  if (!ok) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+void GpxStreamReader::readWaypoint()
+{
+  GeoCoord coord;
+  bool valid = readCoord(coord);
+  gpx::Waypoint wpt(coord);
+  while (xml.readNextStartElement()) {
+    QStringRef name = xml.name();
+    if (name == QLatin1String("ele")) {
+      wpt.elevation = readDouble();
+    } else if (name == QLatin1String("time")) {
+      wpt.time = parseTime(xml.readElementText(QXmlStreamReader::SkipChildElements).trimmed());
+    } else if (name == QLatin1String("name")) {
+      wpt.name = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else if (name == QLatin1String("desc")) {
+      wpt.description = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else if (name == QLatin1String("sym")) {
+      wpt.symbol = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else {
+      xml.skipCurrentElement();
+    }
+  }
+  if (!valid) {
+    qWarning() << "Skipping waypoint with invalid coordinates, line" << xml.lineNumber();
+    return;
+  }
+
+  GpxImportItem item;
+  item.type = GpxImportItem::Type::Waypoint;
+  item.waypoint = std::move(wpt);
+  emitItem(std::move(item));
+}
+
+void GpxStreamReader::readTrack()
+{
+  GpxImportItem start;
+  start.type = GpxImportItem::Type::TrackStart;
+  bool started = false;
+  auto emitStart = [&]() {
+    if (!started) {
+      started = true;
+      return emitItem(std::move(start));
+    }
+    return !aborted;
+  };
+
+  while (!aborted && xml.readNextStartElement()) {
+    QStringRef name = xml.name();
+    if (name == QLatin1String("name")) {
+      start.name = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else if (name == QLatin1String("desc")) {
+      start.desc = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else if (name == QLatin1String("type")) {
+      start.trackType = xml.readElementText(QXmlStreamReader::SkipChildElements).toStdString();
+    } else if (name == QLatin1String("extensions")) {
+      readExtensions(start.color);
+    } else if (name == QLatin1String("trkseg")) {
+      if (emitStart()) {
+        readSegment();
+      }
+    } else {
+      xml.skipCurrentElement();
+    }
+  }
+
+  if (emitStart()) {
+    GpxImportItem end;
+    end.type = GpxImportItem::Type::TrackEnd;
+    emitItem(std::move(end));
+  }
+}
+
+void GpxStreamReader::readSegment()
+{
+  GpxImportItem start;
+  start.type = GpxImportItem::Type::SegmentStart;
+  if (!emitItem(std::move(start))) {
+    return;
+  }
+
+  while (!aborted && xml.readNextStartElement()) {
+    if (xml.name() == QLatin1String("trkpt")) {
+      readTrackPoint();
+      if (batch.size() >= batchSize) {
+        emitPoints();
+      }
+    } else {
+      xml.skipCurrentElement();
+    }
+  }
+
+  if (emitPoints()) {
+    GpxImportItem end;
+    end.type = GpxImportItem::Type::SegmentEnd;
+    emitItem(std::move(end));
+  }
+}
+
+void GpxStreamReader::readTrackPoint()
+{
+  GeoCoord coord;
+  if (!readCoord(coord)) {
+    qWarning() << "Skipping track point with invalid coordinates, line" << xml.lineNumber();
+    xml.skipCurrentElement();
+    return;
+  }
+
+  batch.emplace_back(coord);
+  gpx::TrackPoint &point = batch.back();
+  while (xml.readNextStartElement()) {
+    QStringRef name = xml.name();
+    if (name == QLatin1String("ele")) {
+      point.elevation = readDouble();
+    } else if (name == QLatin1String("time")) {
+      point.time = parseTime(xml.readElementText(QXmlStreamReader::SkipChildElements).trimmed());
+    } else if (name == QLatin1String("hdop")) {
+      point.hdop = readDouble();
+    } else if (name == QLatin1String("vdop")) {
+      point.vdop = readDouble();
+    } else if (name == QLatin1String("pdop")) {
+      point.pdop = readDouble();
+    } else {
+      xml.skipCurrentElement();
+    }
+  }
+}
+
+void GpxStreamReader::readExtensions(std::optional<Color> &color)
+{
+  while (xml.readNextStartElement()) {
+    QStringRef name = xml.name();
+    if (name == QLatin1String("DisplayColor") || name == QLatin1String("color")) {
+      // Garmin extension uses color keywords (DarkRed...), gpx_style hex string without hash
+      QString str = xml.readElementText(QXmlStreamReader::SkipChildElements).trimmed();
+      if (str.size() == 6 && !str.startsWith('#')) {
+        bool hex = false;
+        str.toUInt(&hex, 16);
+        if (hex) {
+          str.prepend('#');
+        }
+      }
+      Color parsed;
+      if (Color::FromW3CKeywordString(str.toLower().toStdString(), parsed) ||
+          Color::FromHexString(str.toStdString(), parsed)) {
+        color = parsed;
+      }
+    } else {
+      readExtensions(color);
+    }
+  }
+}
@@ -0,0 +1,125 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <osmscoutgpx/Track.h>
+#include <osmscoutgpx/TrackPoint.h>
+#include <osmscoutgpx/Waypoint.h>
+
+#include <QIODevice>
+#include <QString>
+#include <QXmlStreamReader>
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Item produced by GpxStreamReader. Items are produced in document order:
+ * Metadata first (always), then waypoints and tracks. Track is sequence of
+ * TrackStart, (SegmentStart, Points*, SegmentEnd)*, TrackEnd.
+ */
+struct GpxImportItem
+{
+  enum class Type {
+    Metadata,     //!< name and desc of the file
+    Waypoint,     //!< waypoint
+    TrackStart,   //!< name, desc, trackType and color of the track
+    SegmentStart,
+    Points,       //!< batch of segment points
+    SegmentEnd,
+    TrackEnd
+  };
+
+  Type type{Type::Metadata};
+  std::optional<std::string> name;
+  std::optional<std::string> desc;
+  std::optional<std::string> trackType;
+  std::optional<osmscout::Color> color;
+  std::optional<osmscout::gpx::Waypoint> waypoint;
+  std::vector<osmscout::gpx::TrackPoint> points;
+};
+
+/**
+ * Streaming GPX reader. Unlike osmscout::gpx::ImportGpx, it doesn't build
+ * whole document in memory, track points are passed to the sink in batches
+ * of limited size as they are parsed.
+ *
+ * Routes are skipped, the same as by Storage import.
+ */
+class GpxStreamReader
+{
+public:
+  /**
+   * Sink returns false when reading should be aborted.
+   */
+  using Sink = std::function<bool(GpxImportItem&&)>;
+
+public:
+  GpxStreamReader(QIODevice *device, size_t batchSize);
+  GpxStreamReader(const GpxStreamReader&) = delete;
+  GpxStreamReader(GpxStreamReader&&) = delete;
+  ~GpxStreamReader() = default;
+
+  GpxStreamReader& operator=(const GpxStreamReader&) = delete;
+  GpxStreamReader& operator=(GpxStreamReader&&) = delete;
+
+  /**
+   * Read the document and pass items to the sink.
+   * @return false on parse error (see errorString) or when sink aborted reading
+   */
+  bool read(const Sink &sink);
+
+  QString errorString() const
+  {
+    return error;
+  }
+
+  /**
+   * Parse GPX (ISO 8601) time. Common format "yyyy-MM-ddTHH:mm:ss[.zzz][Z|+HH:mm]"
+   * is parsed directly, other forms through QDateTime.
+   */
+  static std::optional<osmscout::Timestamp> parseTime(const QString &str);
+
+private:
+  bool emitItem(GpxImportItem &&item);
+  bool emitMetadata();
+  bool emitPoints();
+  void readMetadata();
+  void readWaypoint();
+  void readTrack();
+  void readSegment();
+  void readTrackPoint();
+  void readExtensions(std::optional<osmscout::Color> &color);
+  bool readCoord(osmscout::GeoCoord &coord);
+  std::optional<double> readDouble();
+
+private:
+  QXmlStreamReader xml;
+  size_t batchSize;
+  const Sink *sink{nullptr};
+  bool aborted{false};
+  QString error;
+
+  bool metadataEmitted{false};
+  GpxImportItem metadata;
+  std::vector<osmscout::gpx::TrackPoint> batch;
+};
@@ -0,0 +1,208 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "GpxStreamWriter.h"
+
+#include <chrono>
+
+using namespace osmscout;
+
+namespace {
+constexpr char const *GpxNamespace = "http://www.topografix.com/GPX/1/1";
+constexpr char const *StyleNamespace = "http://www.topografix.com/GPX/gpx_style/0/2";
+
+/**
+ * Proleptic Gregorian calendar date from days since unix epoch,
+ * see http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+ */
+void civilFromDays(int64_t z, int64_t &y, unsigned &m, unsigned &d)
+{
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = unsigned(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = int64_t(yoe) + era * 400 + (m <= 2);
+}
+
+void appendDigits(QString &str, int64_t value, int count)
+{
+  QChar buffer[8];
+  for (int i = count - 1; i >= 0; i--) {
+    buffer[i] = QChar('0' + int(value % 10));
+    value /= 10;
+  }
+  str.append(buffer, count);
+}
+}
+
+GpxStreamWriter::GpxStreamWriter(QIODevice *device):
+  xml(device)
+{
+  xml.setAutoFormatting(true);
+  xml.setAutoFormattingIndent(1);
+}
+
+QString GpxStreamWriter::formatTime(const Timestamp &time)
+{
+  using namespace std::chrono;
+
+  int64_t millis = duration_cast<milliseconds>(time.time_since_epoch()).count();
+  int64_t days = millis / 86400000;
+  int64_t dayMillis = millis % 86400000;
+  if (dayMillis < 0) {
+    days--;
+    dayMillis += 86400000;
+  }
+  int64_t year;
+  unsigned month;
+  unsigned day;
+  civilFromDays(days, year, month, day);
+  if (year < 0 || year > 9999) {
+    return QString();
+  }
+
+  QString str;
+  str.reserve(24);
+  appendDigits(str, year, 4);
+  str.append('-');
+  appendDigits(str, month, 2);
+  str.append('-');
+  appendDigits(str, day, 2);
+  str.append('T');
+  appendDigits(str, dayMillis / 3600000, 2);
+  str.append(':');
+  appendDigits(str, (dayMillis / 60000) % 60, 2);
+  str.append(':');
+  appendDigits(str, (dayMillis / 1000) % 60, 2);
+  str.append('.');
+  appendDigits(str, dayMillis % 1000, 3);
+  str.append('Z');
+  return str;
+}
+
+void GpxStreamWriter::startDocument(const std::optional<std::string> &name,
+                                    const std::optional<std::string> &desc)
+{
+  xml.writeStartDocument();
+  xml.writeDefaultNamespace(GpxNamespace);
+  xml.writeNamespace(StyleNamespace, "gpx_style");
+  xml.writeStartElement(GpxNamespace, "gpx");
+  xml.writeAttribute("version", "1.1");
+  xml.writeAttribute("creator", "OSM Scout for Sailfish OS");
+
+  if (name || desc) {
+    xml.writeStartElement(GpxNamespace, "metadata");
+    writeText("name", name);
+    writeText("desc", desc);
+    xml.writeEndElement(); // metadata
+  }
+}
+
+void GpxStreamWriter::endDocument()
+{
+  xml.writeEndElement(); // gpx
+  xml.writeEndDocument();
+}
+
+void GpxStreamWriter::writeWaypoint(const gpx::Waypoint &waypoint)
+{
+  xml.writeStartElement(GpxNamespace, "wpt");
+  writeCoord(waypoint.coord);
+  writeNumber("ele", waypoint.elevation, 2);
+  if (waypoint.time) {
+    xml.writeTextElement(GpxNamespace, "time", formatTime(*waypoint.time));
+  }
+  writeText("name", waypoint.name);
+  writeText("desc", waypoint.description);
+  writeText("sym", waypoint.symbol);
+  xml.writeEndElement(); // wpt
+}
+
+void GpxStreamWriter::startTrack(const std::optional<std::string> &name,
+                                 const std::optional<std::string> &desc,
+                                 const std::optional<std::string> &type,
+                                 const std::optional<Color> &color)
+{
+  xml.writeStartElement(GpxNamespace, "trk");
+  writeText("name", name);
+  writeText("desc", desc);
+  writeText("type", type);
+  if (color) {
+    // gpx_style color is hex RRGGBB, without hash
+    QString hex = QString::fromStdString(color->ToHexString()).mid(1, 6).toUpper();
+    xml.writeStartElement(GpxNamespace, "extensions");
+    xml.writeStartElement(StyleNamespace, "line");
+    xml.writeTextElement(StyleNamespace, "color", hex);
+    xml.writeEndElement(); // line
+    xml.writeEndElement(); // extensions
+  }
+}
+
+void GpxStreamWriter::endTrack()
+{
+  xml.writeEndElement(); // trk
+}
+
+void GpxStreamWriter::startSegment()
+{
+  xml.writeStartElement(GpxNamespace, "trkseg");
+}
+
+void GpxStreamWriter::endSegment()
+{
+  xml.writeEndElement(); // trkseg
+}
+
+void GpxStreamWriter::writePoint(const gpx::TrackPoint &point)
+{
+  xml.writeStartElement(GpxNamespace, "trkpt");
+  writeCoord(point.coord);
+  writeNumber("ele", point.elevation, 2);
+  if (point.time) {
+    xml.writeTextElement(GpxNamespace, "time", formatTime(*point.time));
+  }
+  writeNumber("hdop", point.hdop, 2);
+  writeNumber("vdop", point.vdop, 2);
+  writeNumber("pdop", point.pdop, 2);
+  xml.writeEndElement(); // trkpt
+}
+
+void GpxStreamWriter::writeText(const QString &element, const std::optional<std::string> &text)
+{
+  if (text) {
+    xml.writeTextElement(GpxNamespace, element, QString::fromStdString(*text));
+  }
+}
+
+void GpxStreamWriter::writeNumber(const QString &element, const std::optional<double> &value, int precision)
+{
+  if (value) {
+    xml.writeTextElement(GpxNamespace, element, QString::number(*value, 'f', precision));
+  }
+}
+
+void GpxStreamWriter::writeCoord(const GeoCoord &coord)
+{
+  xml.writeAttribute("lat", QString::number(coord.GetLat(), 'f', 7));
+  xml.writeAttribute("lon", QString::number(coord.GetLon(), 'f', 7));
+}
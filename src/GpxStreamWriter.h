@@ -0,0 +1,84 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <osmscoutgpx/Track.h>
+#include <osmscoutgpx/TrackPoint.h>
+#include <osmscoutgpx/Waypoint.h>
+
+#include <QIODevice>
+#include <QString>
+#include <QXmlStreamWriter>
+
+#include <optional>
+#include <string>
+
+/**
+ * Streaming GPX 1.1 writer. Document is written to the device
+ * as the methods are called, nothing is buffered in memory.
+ *
+ * Track color is written as gpx_style extension, that is readable by GpxStreamReader.
+ */
+class GpxStreamWriter
+{
+public:
+  explicit GpxStreamWriter(QIODevice *device);
+  GpxStreamWriter(const GpxStreamWriter&) = delete;
+  GpxStreamWriter(GpxStreamWriter&&) = delete;
+  ~GpxStreamWriter() = default;
+
+  GpxStreamWriter& operator=(const GpxStreamWriter&) = delete;
+  GpxStreamWriter& operator=(GpxStreamWriter&&) = delete;
+
+  void startDocument(const std::optional<std::string> &name,
+                     const std::optional<std::string> &desc);
+  void endDocument();
+
+  void writeWaypoint(const osmscout::gpx::Waypoint &waypoint);
+
+  void startTrack(const std::optional<std::string> &name,
+                  const std::optional<std::string> &desc,
+                  const std::optional<std::string> &type,
+                  const std::optional<osmscout::Color> &color);
+  void endTrack();
+
+  void startSegment();
+  void endSegment();
+
+  void writePoint(const osmscout::gpx::TrackPoint &point);
+
+  bool hasError() const
+  {
+    return xml.hasError();
+  }
+
+  /**
+   * Format time as "yyyy-MM-ddTHH:mm:ss.zzzZ", without QDateTime
+   */
+  static QString formatTime(const osmscout::Timestamp &time);
+
+private:
+  void writeText(const QString &element, const std::optional<std::string> &text);
+  void writeNumber(const QString &element, const std::optional<double> &value, int precision);
+  void writeCoord(const osmscout::GeoCoord &coord);
+
+private:
+  QXmlStreamWriter xml;
+};
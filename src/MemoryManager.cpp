@@ -18,6 +18,7 @@
 */
 
 #include "MemoryManager.h"
+#include "Storage.h"
 
 #include <osmscoutclientqt/OSMScoutQt.h>
 
@@ -65,6 +66,13 @@ MemoryManager::MemoryManager()
   connect(this, &MemoryManager::flushCachesRequest,
           dbThread.get(), &DBThread::FlushCaches,
           Qt::QueuedConnection);
+
+  Storage *storage = Storage::getInstance();
+  if (storage != nullptr) {
+    connect(this, &MemoryManager::flushCachesRequest,
+            storage, &Storage::flushCaches,
+            Qt::QueuedConnection);
+  }
 }
 
 void MemoryManager::onTimeout()
@@ -37,7 +37,7 @@ NearWaypointModel::NearWaypointModel()
 
   connect(this, &NearWaypointModel::nearbyWaypointsRequest,
           storage, &Storage::loadNearbyWaypoints,
-          Qt::QueuedConnection);
+          Qt::DirectConnection);
 
   storageInitialised();
 }
@@ -56,7 +56,7 @@ void NearWaypointModel::load()
   }
   searching=true;
   emit SearchingChanged(searching);
-  emit nearbyWaypointsRequest(searchCenter, maxDistance);
+  emit nearbyWaypointsRequest(searchCenter, maxDistance, limit);
 }
 
 void NearWaypointModel::onNearbyWaypoints(const osmscout::GeoCoord &center,
@@ -56,6 +56,11 @@ class NearWaypointModel : public QAbstractListModel {
    */
   Q_PROPERTY(double   maxDistance READ GetMaxDistance WRITE SetMaxDistance)
 
+  /**
+   * Maximal count of nearest waypoints, unlimited when it is not positive (default)
+   */
+  Q_PROPERTY(int      limit       READ GetLimit    WRITE SetLimit)
+
 public:
   constexpr static double INVALID_COORD = -1000.0;
 
@@ -64,7 +69,7 @@ signals:
 
   void SearchingChanged(bool);
 
-  void nearbyWaypointsRequest(const osmscout::GeoCoord &center, const osmscout::Distance &distance);
+  void nearbyWaypointsRequest(const osmscout::GeoCoord &center, const osmscout::Distance &distance, int limit);
 
 public slots:
   void storageInitialised();
@@ -138,12 +143,26 @@ public:
     }
   }
 
+  inline int GetLimit() const
+  {
+    return limit;
+  }
+
+  void SetLimit(int l)
+  {
+    if (limit!=l){
+      limit=l;
+      load();
+    }
+  }
+
 private:
   void load();
 
 private:
   bool searching{false};
   osmscout::Distance maxDistance{osmscout::Distance::Of<osmscout::Kilometer>(1)};
+  int limit{0};
   osmscout::GeoCoord searchCenter{INVALID_COORD,INVALID_COORD};
   std::vector<Storage::WaypointNearby> items;
 };
@@ -30,6 +30,7 @@
 
 // collections
 #include "Storage.h"
+#include "StorageMetricsBridge.h"
 #include "CollectionModel.h"
 #include "CollectionListModel.h"
 #include "CollectionTrackModel.h"
@@ -170,8 +171,12 @@ Q_DECL_EXPORT int main(int argc, char* argv[])
   OSMScoutQt::RegisterQmlTypes("harbour.osmscout.map", 1, 0);
 
   qRegisterMetaType<MapView*>("MapView*");
-  qRegisterMetaType<std::vector<Collection>>("std::vector<Collection>");
+  qRegisterMetaType<CollectionSnapshot>("CollectionSnapshot");
+  qRegisterMetaType<CollectionListSnapshot>("CollectionListSnapshot");
+  qRegisterMetaType<TrackListSnapshot>("TrackListSnapshot");
+  qRegisterMetaType<CollectionItemsSnapshot>("CollectionItemsSnapshot");
   qRegisterMetaType<std::vector<SearchItem>>("std::vector<SearchItem>");
+  qRegisterMetaType<SearchResultsSnapshot>("SearchResultsSnapshot");
   qRegisterMetaType<std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>>>("std::shared_ptr<std::vector<osmscout::gpx::TrackPoint> >");
   qRegisterMetaType<std::optional<double>>("std::optional<double>");
   qRegisterMetaType<TrackStatistics>("TrackStatistics");
@@ -180,6 +185,7 @@ Q_DECL_EXPORT int main(int argc, char* argv[])
   qRegisterMetaType<Waypoint>("Waypoint");
   qRegisterMetaType<std::vector<Storage::WaypointNearby>>("std::vector<Storage::WaypointNearby>");
   qRegisterMetaType<std::optional<osmscout::Color>>("std::optional<osmscout::Color>");
+  qRegisterMetaType<osmscout::BreakerRef>("osmscout::BreakerRef");
 
   qmlRegisterType<CollectionListModel>("harbour.osmscout.map", 1, 0, "CollectionListModel");
   qmlRegisterType<CollectionModel>("harbour.osmscout.map", 1, 0, "CollectionModel");
@@ -191,6 +197,7 @@ Q_DECL_EXPORT int main(int argc, char* argv[])
   qmlRegisterType<LocFile>("harbour.osmscout.map", 1, 0, "LocFile");
   qmlRegisterType<TrackElevationChartWidget>("harbour.osmscout.map", 1, 0, "TrackElevationChart");
   qmlRegisterType<PositionSimulator>("harbour.osmscout.map", 1, 0, "PositionSimulator");
+  qmlRegisterType<StorageMetricsBridge>("harbour.osmscout.map", 1, 0, "StorageMetrics");
 
   qmlRegisterSingletonType<AppSettings>("harbour.osmscout.map", 1, 0, "AppSettings", appSettingsSingletontypeProvider);
 
@@ -287,6 +294,12 @@ Q_DECL_EXPORT int main(int argc, char* argv[])
   }
 
   Storage::initInstance(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+  QObject::connect(app, &QGuiApplication::applicationStateChanged, [](Qt::ApplicationState state){
+    if (Storage *storage = Storage::getInstance(); storage != nullptr) {
+      QMetaObject::invokeMethod(storage, "setApplicationActive", Qt::QueuedConnection,
+                                Q_ARG(bool, state == Qt::ApplicationActive));
+    }
+  });
   MemoryManager memoryManager; // lives in UI thread
 
   int result;
@@ -37,17 +37,25 @@ inline QDateTime timestampToDateTime(const std::optional<osmscout::Timestamp> ti
   return QDateTime();
 }
 
-inline QString dateTimeToSQL(const QDateTime &dateTime)
+/**
+ * Time columns are stored as integer milliseconds since unix epoch (UTC).
+ * Invalid date time is stored as NULL.
+ */
+inline QVariant dateTimeToSQL(const QDateTime &dateTime)
 {
-  // sqlite store timestamp as string (omfg...)
-  // so, do it in UTC to avoid troubles with timezones
-
-  // QtSQL don't store timezone (Qt < 5.12),
-  // we have to serialise QDateTime to string yourself
-  // https://bugreports.qt.io/browse/QTBUG-60456
+  if (!dateTime.isValid()) {
+    return QVariant(QVariant::LongLong);
+  }
+  return QVariant(qint64(dateTime.toMSecsSinceEpoch()));
+}
 
-  // use Qt::ISODateWithMs with newer Qt
-  return dateTime.toUTC().toString("yyyy-MM-ddTHH:mm:ss.zzzZ");
+inline QVariant timestampToSQL(const std::optional<osmscout::Timestamp> &timestamp)
+{
+  if (!timestamp.has_value()) {
+    return QVariant(QVariant::LongLong);
+  }
+  using namespace std::chrono;
+  return QVariant(qint64(duration_cast<milliseconds>(timestamp->time_since_epoch()).count()));
 }
 
 inline QString colorToSQL(const osmscout::Color &color)
@@ -111,27 +119,29 @@ inline bool varToBool(const QVariant &var, bool def = false)
 }
 
 /**
- * there is slow conversion: QString -> QDateTime
- * consider to use SQL strftime('%s', ...) and varLongToOptTimestamp then
+ * Convert time column (milliseconds since epoch) to QDateTime, see dateTimeToSQL
  */
 inline QDateTime varToDateTime(const QVariant &var, QDateTime def = QDateTime())
 {
   if (!var.isNull() &&
       var.isValid() &&
-      var.canConvert(QMetaType::QDateTime)) {
-    return var.toDateTime();
+      var.canConvert(QMetaType::LongLong)) {
+    return QDateTime::fromMSecsSinceEpoch(var.toLongLong());
   }
 
   return def;
 }
 
+/**
+ * Convert time column (milliseconds since epoch) to Timestamp, see timestampToSQL
+ */
 inline std::optional<osmscout::Timestamp> varLongToOptTimestamp(const QVariant &var)
 {
   if (!var.isNull() &&
       var.isValid() &&
       var.canConvert(QMetaType::LongLong)) {
 
-    auto duration = std::chrono::seconds(varToLong(var));
+    auto duration = std::chrono::milliseconds(varToLong(var));
     static_assert(std::is_same<osmscout::Timestamp::clock, std::chrono::system_clock>::value, "Timestamp clock have use unix epoch");
     return osmscout::Timestamp(duration);
   }
@@ -0,0 +1,110 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "StatementCache.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+StatementCache::Statement::Statement(const QSqlQuery &query, const std::shared_ptr<Entry> &entry):
+  QSqlQuery(query), entry(entry)
+{}
+
+StatementCache::Statement::~Statement()
+{
+  // query stays prepared, just release its result and read locks
+  finish();
+  if (entry) {
+    entry->inUse = false;
+  }
+}
+
+StatementCache::StatementCache(const QSqlDatabase &db, int capacity):
+  db(db), capacity(capacity)
+{}
+
+StatementCache::~StatementCache()
+{
+  clear();
+}
+
+StatementCache::Statement StatementCache::prepare(const QString &sql)
+{
+  usageCounter++;
+  auto it = entries.find(sql);
+  if (it != entries.end() && !it.value()->inUse) {
+    std::shared_ptr<Entry> entry = it.value();
+    stats.hits++;
+    stats.savedNs += entry->prepareNs;
+    entry->inUse = true;
+    entry->lastUsage = usageCounter;
+    return Statement(entry->query, entry);
+  }
+
+  stats.misses++;
+  QElapsedTimer timer;
+  timer.start();
+  QSqlQuery query(db);
+  bool prepared = query.prepare(sql);
+  qint64 prepareNs = timer.nsecsElapsed();
+  stats.prepareNs += prepareNs;
+
+  if (!prepared || it != entries.end()) {
+    // don't cache failed statement (caller will handle the error),
+    // or statement that is borrowed already (nested usage)
+    return Statement(query, nullptr);
+  }
+
+  if (entries.size() >= capacity) {
+    evict();
+  }
+  auto entry = std::make_shared<Entry>();
+  entry->query = query;
+  entry->inUse = true;
+  entry->prepareNs = prepareNs;
+  entry->lastUsage = usageCounter;
+  entries.insert(sql, entry);
+  return Statement(query, entry);
+}
+
+void StatementCache::evict()
+{
+  // remove least recently used statement that is not borrowed
+  auto victim = entries.end();
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (!it.value()->inUse &&
+        (victim == entries.end() || it.value()->lastUsage < victim.value()->lastUsage)) {
+      victim = it;
+    }
+  }
+  if (victim != entries.end()) {
+    entries.erase(victim);
+  }
+}
+
+void StatementCache::clear()
+{
+  if (stats.hits + stats.misses > 0) {
+    qDebug() << "Statement cache hit rate:" << (stats.hitRate() * 100) << "%"
+             << "(" << stats.hits << "hits," << stats.misses << "misses),"
+             << "prepare time:" << (stats.prepareNs / 1000000.0) << "ms,"
+             << "saved:" << (stats.savedNs / 1000000.0) << "ms";
+  }
+  entries.clear();
+}
@@ -0,0 +1,167 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include "StorageMetrics.h"
+
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+#include <QHash>
+#include <QString>
+#include <QVariant>
+
+#include <algorithm>
+#include <memory>
+
+/**
+ * Cache of prepared statements for one database connection, keyed by SQL text.
+ * It is not thread safe, it should be used just from the thread owning the connection.
+ *
+ * Statement returned by prepare is exclusively borrowed until its destruction.
+ * When the same SQL is requested while the cached statement is still borrowed
+ * (nested usage), fresh uncached statement is prepared.
+ */
+class StatementCache
+{
+private:
+  struct Entry
+  {
+    QSqlQuery query;
+    bool inUse{false};
+    qint64 prepareNs{0};
+    quint64 lastUsage{0};
+  };
+
+public:
+  static constexpr int DefaultCapacity = 64;
+
+  struct Statistics
+  {
+    qint64 hits{0};
+    qint64 misses{0};
+    qint64 prepareNs{0}; //!< time spent in prepare
+    qint64 savedNs{0}; //!< estimated prepare time saved by cache hits
+
+    double hitRate() const
+    {
+      qint64 total = hits + misses;
+      return total == 0 ? 0 : double(hits) / double(total);
+    }
+  };
+
+  /**
+   * Prepared query borrowed from the cache. It is returned to the cache
+   * on destruction, after finish() call that releases its resources (read locks).
+   */
+  class Statement: public QSqlQuery
+  {
+  private:
+    std::shared_ptr<Entry> entry;
+
+  public:
+    Statement(const QSqlQuery &query, const std::shared_ptr<Entry> &entry);
+    Statement(const Statement&) = delete;
+    Statement(Statement&&) = delete;
+    ~Statement();
+
+    Statement& operator=(const Statement&) = delete;
+    Statement& operator=(Statement&&) = delete;
+
+    using QSqlQuery::exec;
+
+    /**
+     * Execute prepared statement, rows affected by modifying statement
+     * are counted by StorageMetrics.
+     */
+    bool exec()
+    {
+      bool result = QSqlQuery::exec();
+      if (result && !isSelect()) {
+        StorageMetrics::rowsWritten(std::max(numRowsAffected(), 0));
+      }
+      return result;
+    }
+
+    /**
+     * Move to next row, it is counted as read row by StorageMetrics.
+     */
+    bool next()
+    {
+      bool result = QSqlQuery::next();
+      if (result) {
+        StorageMetrics::rowsRead(1);
+      }
+      return result;
+    }
+
+    /**
+     * Bind values to placeholders by its index (order in SQL).
+     * It is faster than binding by placeholder name.
+     */
+    template<typename... Args>
+    Statement& bindValues(const Args&... args)
+    {
+      int pos = 0;
+      (bindValue(pos++, QVariant::fromValue(args)), ...);
+      return *this;
+    }
+
+    /**
+     * Bind values by index and execute the statement.
+     */
+    template<typename... Args>
+    bool execValues(const Args&... args)
+    {
+      bindValues(args...);
+      return exec();
+    }
+  };
+
+public:
+  explicit StatementCache(const QSqlDatabase &db, int capacity = DefaultCapacity);
+  StatementCache(const StatementCache&) = delete;
+  StatementCache(StatementCache&&) = delete;
+  ~StatementCache();
+
+  StatementCache& operator=(const StatementCache&) = delete;
+  StatementCache& operator=(StatementCache&&) = delete;
+
+  Statement prepare(const QString &sql);
+
+  /**
+   * Drop all cached statements. It should be called before the connection is closed.
+   */
+  void clear();
+
+  Statistics statistics() const
+  {
+    return stats;
+  }
+
+private:
+  void evict();
+
+private:
+  QSqlDatabase db;
+  int capacity;
+  QHash<QString, std::shared_ptr<Entry>> entries;
+  quint64 usageCounter{0};
+  Statistics stats;
+};
@@ -19,44 +19,265 @@
 
 #include "Storage.h"
 #include "QVariantConverters.h"
+#include "TrackPointCodec.h"
+#include "GpxImportPipeline.h"
+#include "GpxStreamWriter.h"
+#include "TrackSimplifier.h"
 
 #include <osmscoutclientqt/OSMScoutQt.h>
 #include <osmscoutgpx/GpxFile.h>
-#include <osmscoutgpx/Import.h>
-#include <osmscoutgpx/Export.h>
 
+#include <QCollator>
 #include <QDebug>
+#include <QFile>
+#include <QRegExp>
+#include <QJsonDocument>
 #include <QThread>
+#include <QTimer>
+#include <QtSql/QSqlDriver>
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlRecord>
 
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
 namespace {
-  static constexpr int DbSchema = 3;
+  static constexpr int DbSchema = 7;
   static constexpr int TrackPointBatchSize = 10000;
-  static constexpr int WayPointBatchSize = 100;
+  static constexpr int TrackPointChunkSize = 4096;
+  static constexpr int ReadConnectionCount = 2;
+  static constexpr double NearbyWaypointsInitialRadius = 250; // meters
+  static constexpr qint64 ExportProgressStep = 10000; // points
+  static constexpr std::array<int, 3> ItemsInBatchSizes{8, 32, 128}; // sizes of IN lists loading collection items, ascending
+  static constexpr qint64 MigrationBatchPoints = 50000; // points processed in one migration transaction (at least one segment)
+
+  // connection tuning, defaults may be overridden by environment variables for benchmarking.
+  // Values are picked from scripts/storage-replay.py on desktop (x86_64, SQLite 3.40.1,
+  // 50 MiB database: 4 collections, 400 tracks of 10000 points, 20000 waypoints),
+  // totals of the cold pass / warm medians in ms:
+  //
+  //   cache KiB  mmap MiB | details cold | lod cold (50 tracks) | data cold (20 tracks) | data warm
+  //   2048       0        |  18.9 - 19.6 |  3.9 - 6.0           |  3.2 - 3.7            |  0.049 - 0.055
+  //   4096       0        |  16.2 - 16.9 |  3.1 - 4.1           |  2.1 - 2.6            |  0.036 - 0.038
+  //   8192       0        |  16.5 - 17.5 |  3.1 - 4.0           |  1.9 - 2.7            |  0.038 - 0.059
+  //   16384      0        |  16.4 - 17.0 |  3.3                 |  2.1 - 2.3            |  0.053 - 0.057
+  //   4096       16       |  18.4 - 19.0 |  2.9 - 3.5           |  1.8 - 2.2            |  0.035
+  //   4096       64       |  22.3 - 24.2 |  0.8                 |  0.7 - 0.8            |  0.028 - 0.029
+  //   4096       256      |  23.6 - 33.4 |  0.8 - 0.9           |  0.7                  |  0.027 - 0.029
+  //
+  // Cache larger than 4 MiB brings nothing measurable, mmap covering the database makes point
+  // loading ~3x faster (first collection load pays page faults), 256 MiB is not better than 64 MiB.
+  // Warm collection details, nearby waypoints and search do not depend on these values.
+  // Desktop numbers don't replace measurement on the phone (scripts/storage-sweep.sh).
+  static constexpr int CacheSizeKiB = 4096; // page cache of every connection
+  static constexpr int MmapSizeMiB = 64; // memory mapped part of database file
+  static constexpr int JournalSizeLimitKiB = 4096; // WAL file is truncated to this size after checkpoint
+  static constexpr int AnalysisLimit = 1000; // rows examined per index by ANALYZE
+
+  static constexpr int MaintenanceIdleMs = 30000; // idle time before maintenance, application in foreground
+  static constexpr int MaintenanceBackgroundIdleMs = 1000; // idle time before maintenance, application in background
+  static constexpr int MaintenanceSliceMs = 50; // duration of one maintenance slice
+  static constexpr int MaintenancePauseMs = 200; // pause between slices, pending requests are processed meanwhile
+  static constexpr int MaintenanceVacuumPages = 128; // pages released by one incremental_vacuum call
+
+  // statement cache of read connection, set in reader threads only
+  thread_local StatementCache *threadStatementCache = nullptr;
+
+  /** decode points packed by TrackPointCodec, decoded bytes are counted by StorageMetrics */
+  bool decodePoints(const QByteArray &data, std::vector<osmscout::gpx::TrackPoint> &points)
+  {
+    StorageMetrics::bytesDecoded(data.size());
+    return TrackPointCodec::decode(data, points);
+  }
+
+  int envValue(const char *name, int defaultValue)
+  {
+    bool ok = false;
+    int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok ? value : defaultValue;
+  }
+
+  /**
+   * Page cache and mmap size of the connection.
+   * Defaults can be changed by OSMSCOUT_STORAGE_CACHE_KIB and OSMSCOUT_STORAGE_MMAP_MIB.
+   */
+  void applyConnectionPragmas(QSqlDatabase &db)
+  {
+    int cacheKiB = envValue("OSMSCOUT_STORAGE_CACHE_KIB", CacheSizeKiB);
+    int mmapMiB = envValue("OSMSCOUT_STORAGE_MMAP_MIB", MmapSizeMiB);
+    QStringList pragmas;
+    pragmas << QString("PRAGMA cache_size = -%1;").arg(cacheKiB) // negative value is size in KiB
+            << QString("PRAGMA mmap_size = %1;").arg(qint64(mmapMiB) * 1024 * 1024)
+            << "PRAGMA temp_store = MEMORY;";
+    for (const QString &pragma: pragmas) {
+      QSqlQuery q = db.exec(pragma);
+      if (q.lastError().isValid()) {
+        qWarning() << pragma << "failed:" << q.lastError();
+      }
+    }
+  }
+
+  // false when LOCALE collation could not be registered on some connection
+  std::atomic_bool localeCollation{true};
+
+  int localeCompare(void *collator, int len1, const void *str1, int len2, const void *str2)
+  {
+    // strings are UTF-16 in native byte order, lengths are in bytes
+    return static_cast<const QCollator*>(collator)->compare(
+      static_cast<const QChar*>(str1), len1 / int(sizeof(QChar)),
+      static_cast<const QChar*>(str2), len2 / int(sizeof(QChar)));
+  }
+
+  void deleteCollator(void *collator)
+  {
+    delete static_cast<QCollator*>(collator);
+  }
+
+  /**
+   * Register LOCALE collation, comparing strings by QCollator of system locale
+   * (the same ordering as models use). Every connection needs own collator,
+   * QCollator is not thread safe.
+   *
+   * Connection handle is used by SQLite library linked to the application, it is valid
+   * just when QSQLITE driver uses the same library (Qt may be built with bundled SQLite).
+   * Otherwise, names are ordered by NOCASE collation.
+   */
+  void registerLocaleCollation(QSqlDatabase &db)
+  {
+    QSqlQuery version = db.exec("SELECT sqlite_version(), sqlite_source_id();");
+    if (!version.next() ||
+        version.value(0).toString() != QString::fromLatin1(sqlite3_libversion()) ||
+        version.value(1).toString() != QString::fromLatin1(sqlite3_sourceid())) {
+      qWarning() << "SQLite of Qt driver" << version.value(0).toString() << version.value(1).toString()
+                 << "differs from linked" << sqlite3_libversion() << sqlite3_sourceid()
+                 << ", names will be ordered without locale";
+      localeCollation = false;
+      return;
+    }
+    version.finish();
+
+    QVariant handle = db.driver()->handle();
+    sqlite3 *sqlite = nullptr;
+    if (handle.isValid() && qstrcmp(handle.typeName(), "sqlite3*") == 0) {
+      sqlite = *static_cast<sqlite3* const*>(handle.constData());
+    }
+    if (sqlite == nullptr) {
+      qWarning() << "Cannot access SQLite handle, names will be ordered without locale";
+      localeCollation = false;
+      return;
+    }
+    QCollator *collator = new QCollator();
+    if (sqlite3_create_collation_v2(sqlite, "LOCALE", SQLITE_UTF16, collator, localeCompare, deleteCollator) != SQLITE_OK) {
+      // destructor is not called on failure
+      delete collator;
+      qWarning() << "Registering LOCALE collation failed:" << sqlite3_errmsg(sqlite);
+      localeCollation = false;
+    }
+  }
 
   double durationSeconds(const osmscout::Timestamp::duration &d)
   {
     using namespace std::chrono;
     return duration_cast<duration<double,std::ratio<1,1>>>(d).count();
   }
+
+  /**
+   * Simplified levels of segment, packed by TrackPointCodec
+   */
+  std::vector<QByteArray> encodeSegmentLods(const std::vector<osmscout::gpx::TrackPoint> &points)
+  {
+    TrackSimplifier simplifier;
+    std::vector<osmscout::gpx::TrackPoint> chunk;
+    for (size_t i = 0; i < points.size(); i += TrackPointChunkSize) {
+      chunk.assign(points.begin() + i, points.begin() + std::min(points.size(), i + TrackPointChunkSize));
+      simplifier.append(chunk);
+    }
+    return simplifier.encodeLevels();
+  }
+
+  TrackStatistics computeSegmentStatistics(const std::vector<osmscout::gpx::TrackPoint> &points)
+  {
+    TrackStatisticsAccumulator acc;
+    for (const auto &point: points){
+      acc.update(point);
+    }
+    acc.segmentEnd();
+    return acc.accumulate();
+  }
 }
 
 using namespace osmscout;
 using namespace converters;
 
-static Storage* storage = nullptr;
+namespace {
+/**
+ * Read statistics columns, shared by track and track_segment_stats tables
+ */
+TrackStatistics makeTrackStatistics(const QSqlQuery &sql)
+{
+  GeoBox bbox(GeoCoord(varToDouble(sql.value("bbox_min_lat")),
+                       varToDouble(sql.value("bbox_min_lon"))),
+              GeoCoord(varToDouble(sql.value("bbox_max_lat")),
+                       varToDouble(sql.value("bbox_max_lon"))));
+
+  if (bbox.GetMinCoord().GetLat() < -90 || bbox.GetMinCoord().GetLon() < -180){
+    bbox.Invalidate();
+  }
+
+  return TrackStatistics(
+    varToDateTime(sql.value("from_time")),
+    varToDateTime(sql.value("to_time")),
+    Distance::Of<Meter>(varToDouble(sql.value("distance"))),
+    Distance::Of<Meter>(varToDouble(sql.value("raw_distance"))),
+    std::chrono::milliseconds(varToLong(sql.value("duration"))),
+    std::chrono::milliseconds(varToLong(sql.value("moving_duration"))),
+    varToDouble(sql.value("max_speed")),
+    varToDouble(sql.value("average_speed")),
+    varToDouble(sql.value("moving_average_speed")),
+    Distance::Of<Meter>(varToDouble(sql.value("ascent"))),
+    Distance::Of<Meter>(varToDouble(sql.value("descent"))),
+    varToDistanceOpt(sql.value("min_elevation")),
+    varToDistanceOpt(sql.value("max_elevation")),
+    bbox);
+}
 
-void ErrorCallback::Error(const std::string &err)
+/**
+ * Bind statistics to named placeholders (:from_time, :to_time ... :bbox_max_lon)
+ */
+void bindTrackStatistics(QSqlQuery &sql, const TrackStatistics &statistics)
 {
-  gpx::ProcessCallback::Error(err);
-  emit error(QString::fromStdString(err));
+  sql.bindValue(":from_time", dateTimeToSQL(statistics.from));
+  sql.bindValue(":to_time", dateTimeToSQL(statistics.to));
+  sql.bindValue(":distance", statistics.distance.AsMeter());
+  sql.bindValue(":raw_distance", statistics.rawDistance.AsMeter());
+  sql.bindValue(":duration", statistics.durationMillis());
+  sql.bindValue(":moving_duration", statistics.movingDurationMillis());
+  sql.bindValue(":max_speed", statistics.maxSpeed);
+  sql.bindValue(":average_speed", statistics.averageSpeed);
+  sql.bindValue(":moving_average_speed", statistics.movingAverageSpeed);
+  sql.bindValue(":ascent", statistics.ascent.AsMeter());
+  sql.bindValue(":descent", statistics.descent.AsMeter());
+  sql.bindValue(":min_elevation", statistics.minElevation.has_value() ? QVariant::fromValue(statistics.minElevation->AsMeter()) : QVariant());
+  sql.bindValue(":max_elevation", statistics.maxElevation.has_value() ? QVariant::fromValue(statistics.maxElevation->AsMeter()) : QVariant());
+
+  sql.bindValue(":bbox_min_lat", statistics.bbox.IsValid() ? statistics.bbox.GetMinLat() : -1000);
+  sql.bindValue(":bbox_min_lon", statistics.bbox.IsValid() ? statistics.bbox.GetMinLon() : -1000);
+  sql.bindValue(":bbox_max_lat", statistics.bbox.IsValid() ? statistics.bbox.GetMaxLat() : -1000);
+  sql.bindValue(":bbox_max_lon", statistics.bbox.IsValid() ? statistics.bbox.GetMaxLon() : -1000);
 }
+}
+
+static Storage* storage = nullptr;
 
 void MaxSpeedBuffer::flush()
 {
   lastPoint.reset();
-  bufferTime.zero();
+  distanceFifo.clear();
+  timeFifo.clear();
+  bufferTime = Timestamp::duration::zero();
   bufferDistance = Distance::Of<Meter>(0);
 }
 
@@ -216,15 +437,15 @@ QString sqlCreateTrack(){
   sql.append(",").append( "`name` varchar(255) NOT NULL");
   sql.append(",").append( "`description` varchar(255) NULL");
   sql.append(",").append( "`open` tinyint(1) NOT NULL");
-  sql.append(",").append( "`creation_time` datetime NOT NULL");
-  sql.append(",").append( "`modification_time` datetime NOT NULL");
+  sql.append(",").append( "`creation_time` INTEGER NOT NULL");
+  sql.append(",").append( "`modification_time` INTEGER NOT NULL");
   sql.append(",").append( "`color` varchar(12) NULL");
   sql.append(",").append( "`type` varchar(80) NULL");
   sql.append(",").append( "`visible` tinyint(1) NOT NULL"); // track is visible when collection.visible && track.visible
 
   // statistics
-  sql.append(",").append( "`from_time` datetime NULL");
-  sql.append(",").append( "`to_time` datetime NULL");
+  sql.append(",").append( "`from_time` INTEGER NULL");
+  sql.append(",").append( "`to_time` INTEGER NULL");
   sql.append(",").append( "`distance` DOUBLE NOT NULL");
   sql.append(",").append( "`raw_distance` DOUBLE NOT NULL");
   sql.append(",").append( "`duration` INTEGER NOT NULL");
@@ -253,7 +474,7 @@ QString sqlCreateTrackSegment(){
   sql.append("(").append( "`id` INTEGER PRIMARY KEY");
   sql.append(",").append( "`track_id` INTEGER NOT NULL REFERENCES track(id) ON DELETE CASCADE");
   sql.append(",").append( "`open` tinyint(1) NOT NULL");
-  sql.append(",").append( "`creation_time` datetime NOT NULL");
+  sql.append(",").append( "`creation_time` INTEGER NOT NULL");
   sql.append(",").append( "`distance` double NOT NULL");
   sql.append(");");
   return sql;
@@ -262,7 +483,7 @@ QString sqlCreateTrackSegment(){
 QString sqlCreateTrackPoint(){
   QString sql("CREATE TABLE `track_point`");
   sql.append("(").append( "`segment_id` INTEGER NOT NULL REFERENCES track_segment(id) ON DELETE CASCADE");
-  sql.append(",").append( "`timestamp` datetime NULL");
+  sql.append(",").append( "`timestamp` INTEGER NULL");
   sql.append(",").append( "`latitude` double NOT NULL");
   sql.append(",").append( "`longitude` double NOT NULL");
   sql.append(",").append( "`elevation` double NULL ");
@@ -275,12 +496,66 @@ QString sqlCreateTrackPoint(){
   return sql;
 }
 
+QString sqlCreateTrackSegmentData(){
+  // track points packed by TrackPointCodec, in chunks of TrackPointChunkSize points (at most);
+  // first_point is sequence number of the first chunk point in the segment, chunks are ordered by it
+  // and point ranges are addressed by it (see deleteSegmentPoints)
+  QString sql("CREATE TABLE `track_segment_data`");
+  sql.append("(").append( "`segment_id` INTEGER NOT NULL REFERENCES track_segment(id) ON DELETE CASCADE");
+  sql.append(",").append( "`chunk` INTEGER NOT NULL");
+  sql.append(",").append( "`first_point` INTEGER NOT NULL");
+  sql.append(",").append( "`point_count` INTEGER NOT NULL");
+  sql.append(",").append( "`data` BLOB NOT NULL");
+  sql.append(",").append( "PRIMARY KEY (`segment_id`, `chunk`)");
+  sql.append(");");
+  return sql;
+}
+
+QString sqlCreateTrackSegmentLod(){
+  // simplified segment points (see TrackSimplifier) packed by TrackPointCodec,
+  // present for closed tracks only
+  QString sql("CREATE TABLE `track_segment_lod`");
+  sql.append("(").append( "`segment_id` INTEGER NOT NULL REFERENCES track_segment(id) ON DELETE CASCADE");
+  sql.append(",").append( "`level` INTEGER NOT NULL");
+  sql.append(",").append( "`point_count` INTEGER NOT NULL");
+  sql.append(",").append( "`data` BLOB NOT NULL");
+  sql.append(",").append( "PRIMARY KEY (`segment_id`, `level`)");
+  sql.append(");");
+  return sql;
+}
+
+QString sqlCreateTrackSegmentStats(){
+  // statistics of single segment, track statistics are merged from them (see TrackStatistics::merge);
+  // missing for open segments and segments modified by edits, they are computed on demand
+  QString sql("CREATE TABLE `track_segment_stats`");
+  sql.append("(").append( "`segment_id` INTEGER PRIMARY KEY REFERENCES track_segment(id) ON DELETE CASCADE");
+  sql.append(",").append( "`from_time` INTEGER NULL");
+  sql.append(",").append( "`to_time` INTEGER NULL");
+  sql.append(",").append( "`distance` DOUBLE NOT NULL");
+  sql.append(",").append( "`raw_distance` DOUBLE NOT NULL");
+  sql.append(",").append( "`duration` INTEGER NOT NULL");
+  sql.append(",").append( "`moving_duration` INTEGER NOT NULL");
+  sql.append(",").append( "`max_speed` DOUBLE NOT NULL");
+  sql.append(",").append( "`average_speed` DOUBLE NOT NULL");
+  sql.append(",").append( "`moving_average_speed` DOUBLE NOT NULL");
+  sql.append(",").append( "`ascent` DOUBLE NOT NULL");
+  sql.append(",").append( "`descent` DOUBLE NOT NULL");
+  sql.append(",").append( "`min_elevation` DOUBLE NULL");
+  sql.append(",").append( "`max_elevation` DOUBLE NULL");
+  sql.append(",").append( "`bbox_min_lat` DOUBLE NOT NULL");
+  sql.append(",").append( "`bbox_min_lon` DOUBLE NOT NULL");
+  sql.append(",").append( "`bbox_max_lat` DOUBLE NOT NULL");
+  sql.append(",").append( "`bbox_max_lon` DOUBLE NOT NULL");
+  sql.append(");");
+  return sql;
+}
+
 QString sqlCreateWaypoint(){
   QString sql("CREATE TABLE `waypoint`");
   sql.append("(").append( "`id` INTEGER PRIMARY KEY");
   sql.append(",").append( "`collection_id` INTEGER NOT NULL REFERENCES collection(id) ON DELETE CASCADE");
-  sql.append(",").append( "`modification_time` datetime NOT NULL");
-  sql.append(",").append( "`timestamp` datetime NULL");
+  sql.append(",").append( "`modification_time` INTEGER NOT NULL");
+  sql.append(",").append( "`timestamp` INTEGER NULL");
   sql.append(",").append( "`latitude` double NOT NULL");
   sql.append(",").append( "`longitude` double NOT NULL");
   sql.append(",").append( "`elevation` double NULL");
@@ -296,11 +571,301 @@ QString sqlCreateWaypoint(){
 QString sqlCreateSearchHistory(){
   QString sql("CREATE TABLE `search_history` ");
   sql.append("(").append( "`pattern` varchar(255) NOT NULL PRIMARY KEY");
-  sql.append(",").append( "`last_usage` datetime NOT NULL");
+  sql.append(",").append( "`last_usage` INTEGER NOT NULL");
+  sql.append(");");
+
+  return sql;
+}
+
+QString sqlTimeToMillis(const QString &column){
+  // julianday understands format written by older versions ("yyyy-MM-ddTHH:mm:ss.zzzZ"),
+  // 2440587.5 is julian day of unix epoch
+  return QString("CAST(ROUND((julianday(`%1`) - 2440587.5) * 86400000.0) AS INTEGER)").arg(column);
+}
+
+QString sqlTimeColumnToMillis(const QString &table, const QString &column){
+  return QString("UPDATE `%1` SET `%2` = %3 ")
+    .append("WHERE typeof(`%2`) = 'text' AND julianday(`%2`) IS NOT NULL")
+    .arg(table, column, sqlTimeToMillis(column));
+}
+
+QString sqlCreateTrackJournal(){
+  // position of track journal (see TrackJournal) compacted into the database,
+  // it is updated in the same transaction as compacted points
+  QString sql("CREATE TABLE `track_journal`");
+  sql.append("(").append( "`id` INTEGER PRIMARY KEY");
+  sql.append(",").append( "`generation` INTEGER NOT NULL");
+  sql.append(",").append( "`offset` INTEGER NOT NULL");
   sql.append(");");
+  return sql;
+}
 
+QString sqlCreateTrackArchive(){
+  // points of archived track are stored in the file (see TrackArchive), not in track_segment_data
+  QString sql("CREATE TABLE `track_archive`");
+  sql.append("(").append( "`track_id` INTEGER PRIMARY KEY REFERENCES track(id) ON DELETE CASCADE");
+  sql.append(",").append( "`file` varchar(255) NOT NULL");
+  sql.append(",").append( "`point_count` INTEGER NOT NULL");
+  sql.append(");");
   return sql;
 }
+
+QStringList sqlCreateWaypointIndex(){
+  // R*Tree stores coordinates as 32bit floats, rounded outwards,
+  // so query results may contain few more waypoints on the edge
+  QStringList queries;
+  queries << "CREATE VIRTUAL TABLE `waypoint_rtree` USING rtree(`id`, `min_lat`, `max_lat`, `min_lon`, `max_lon`);";
+  queries << QString("INSERT INTO `waypoint_rtree` (`id`, `min_lat`, `max_lat`, `min_lon`, `max_lon`) ")
+    .append("SELECT `id`, `latitude`, `latitude`, `longitude`, `longitude` FROM `waypoint`;");
+
+  queries << QString("CREATE TRIGGER `waypoint_rtree_insert` AFTER INSERT ON `waypoint` BEGIN ")
+    .append("INSERT INTO `waypoint_rtree` (`id`, `min_lat`, `max_lat`, `min_lon`, `max_lon`) ")
+    .append("VALUES (new.`id`, new.`latitude`, new.`latitude`, new.`longitude`, new.`longitude`); ")
+    .append("END;");
+  queries << QString("CREATE TRIGGER `waypoint_rtree_update` AFTER UPDATE OF `latitude`, `longitude` ON `waypoint` BEGIN ")
+    .append("UPDATE `waypoint_rtree` SET `min_lat` = new.`latitude`, `max_lat` = new.`latitude`, ")
+    .append("`min_lon` = new.`longitude`, `max_lon` = new.`longitude` WHERE `id` = new.`id`; ")
+    .append("END;");
+  queries << QString("CREATE TRIGGER `waypoint_rtree_delete` AFTER DELETE ON `waypoint` BEGIN ")
+    .append("DELETE FROM `waypoint_rtree` WHERE `id` = old.`id`; ")
+    .append("END;");
+  return queries;
+}
+
+QStringList sqlCreateTrackIndex(){
+  // tracks without valid bbox (bbox_min_lat is -1000) are not indexed
+  QStringList queries;
+  queries << "CREATE VIRTUAL TABLE `track_rtree` USING rtree(`id`, `min_lat`, `max_lat`, `min_lon`, `max_lon`);";
+  queries << QString("INSERT INTO `track_rtree` (`id`, `min_lat`, `max_lat`, `min_lon`, `max_lon`) ")
+    .append("SELECT `id`, `bbox_min_lat`, `bbox_max_lat`, `bbox_min_lon`, `bbox_max_lon` FROM `track` ")
+    .append("WHERE `bbox_min_lat` >= -90;");
+
+  QString insert = QString("INSERT INTO `track_rtree` (`id`, `min_lat`, `max_lat`, `min_lon`, `max_lon`) ")
+    .append("SELECT new.`id`, new.`bbox_min_lat`, new.`bbox_max_lat`, new.`bbox_min_lon`, new.`bbox_max_lon` ")
+    .append("WHERE new.`bbox_min_lat` >= -90; ");
+
+  queries << QString("CREATE TRIGGER `track_rtree_insert` AFTER INSERT ON `track` BEGIN ")
+    .append(insert)
+    .append("END;");
+  queries << QString("CREATE TRIGGER `track_rtree_update` AFTER UPDATE OF `bbox_min_lat`, `bbox_min_lon`, `bbox_max_lat`, `bbox_max_lon` ON `track` BEGIN ")
+    .append("DELETE FROM `track_rtree` WHERE `id` = old.`id`; ")
+    .append(insert)
+    .append("END;");
+  queries << QString("CREATE TRIGGER `track_rtree_delete` AFTER DELETE ON `track` BEGIN ")
+    .append("DELETE FROM `track_rtree` WHERE `id` = old.`id`; ")
+    .append("END;");
+  return queries;
+}
+
+QStringList sqlCreateSearchIndex(){
+  // external content tables, text is not duplicated, index is kept in sync by triggers.
+  // Prefix indexes make short prefix queries fast
+  QStringList queries;
+  queries << QString("CREATE VIRTUAL TABLE `waypoint_fts` USING fts5(`name`, `description`, `symbol`, ")
+    .append("content='waypoint', content_rowid='id', prefix='2 3');");
+  queries << "INSERT INTO `waypoint_fts` (`waypoint_fts`) VALUES ('rebuild');";
+
+  QString waypointInsert = QString("INSERT INTO `waypoint_fts` (`rowid`, `name`, `description`, `symbol`) ")
+    .append("VALUES (new.`id`, new.`name`, new.`description`, new.`symbol`); ");
+  QString waypointDelete = QString("INSERT INTO `waypoint_fts` (`waypoint_fts`, `rowid`, `name`, `description`, `symbol`) ")
+    .append("VALUES ('delete', old.`id`, old.`name`, old.`description`, old.`symbol`); ");
+  queries << QString("CREATE TRIGGER `waypoint_fts_insert` AFTER INSERT ON `waypoint` BEGIN ")
+    .append(waypointInsert)
+    .append("END;");
+  queries << QString("CREATE TRIGGER `waypoint_fts_update` AFTER UPDATE OF `name`, `description`, `symbol` ON `waypoint` BEGIN ")
+    .append(waypointDelete)
+    .append(waypointInsert)
+    .append("END;");
+  queries << QString("CREATE TRIGGER `waypoint_fts_delete` AFTER DELETE ON `waypoint` BEGIN ")
+    .append(waypointDelete)
+    .append("END;");
+
+  queries << QString("CREATE VIRTUAL TABLE `track_fts` USING fts5(`name`, `description`, ")
+    .append("content='track', content_rowid='id', prefix='2 3');");
+  queries << "INSERT INTO `track_fts` (`track_fts`) VALUES ('rebuild');";
+
+  QString trackInsert = QString("INSERT INTO `track_fts` (`rowid`, `name`, `description`) ")
+    .append("VALUES (new.`id`, new.`name`, new.`description`); ");
+  QString trackDelete = QString("INSERT INTO `track_fts` (`track_fts`, `rowid`, `name`, `description`) ")
+    .append("VALUES ('delete', old.`id`, old.`name`, old.`description`); ");
+  queries << QString("CREATE TRIGGER `track_fts_insert` AFTER INSERT ON `track` BEGIN ")
+    .append(trackInsert)
+    .append("END;");
+  queries << QString("CREATE TRIGGER `track_fts_update` AFTER UPDATE OF `name`, `description` ON `track` BEGIN ")
+    .append(trackDelete)
+    .append(trackInsert)
+    .append("END;");
+  queries << QString("CREATE TRIGGER `track_fts_delete` AFTER DELETE ON `track` BEGIN ")
+    .append(trackDelete)
+    .append("END;");
+  return queries;
+}
+
+/**
+ * FTS5 query from user input: every word is quoted (so FTS syntax characters are not interpreted)
+ * and matched as prefix, all words have to match.
+ */
+QString ftsQuery(const QString &pattern){
+  QStringList terms;
+  for (const QString &word: pattern.split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+    QString term = word;
+    terms << QString("\"%1\"*").arg(term.replace("\"", "\"\""));
+  }
+  return terms.join(" ");
+}
+
+QStringList sqlCreateCollectionStats(){
+  // per-collection aggregates, maintained by triggers, so listing of collections don't need
+  // to scan waypoints and tracks. Counters are updated incrementally, time span
+  // of tracks is recomputed for affected collection (using idx_track_collection_id)
+  QStringList queries;
+  queries << "CREATE INDEX IF NOT EXISTS `idx_track_collection_id` ON `track` (`collection_id`);";
+  queries << "CREATE INDEX IF NOT EXISTS `idx_waypoint_collection_id` ON `waypoint` (`collection_id`);";
+
+  QString sql("CREATE TABLE `collection_stats`");
+  sql.append("(").append( "`collection_id` INTEGER PRIMARY KEY REFERENCES collection(id) ON DELETE CASCADE");
+  sql.append(",").append( "`waypoint_count` INTEGER NOT NULL DEFAULT 0");
+  sql.append(",").append( "`waypoint_hidden` INTEGER NOT NULL DEFAULT 0");
+  sql.append(",").append( "`track_count` INTEGER NOT NULL DEFAULT 0");
+  sql.append(",").append( "`track_hidden` INTEGER NOT NULL DEFAULT 0");
+  sql.append(",").append( "`distance` double NOT NULL DEFAULT 0");
+  sql.append(",").append( "`from_time` INTEGER NULL");
+  sql.append(",").append( "`to_time` INTEGER NULL");
+  sql.append(");");
+  queries << sql;
+
+  queries << QString("INSERT INTO `collection_stats` (")
+    .append("`collection_id`, `waypoint_count`, `waypoint_hidden`, `track_count`, `track_hidden`, `distance`, `from_time`, `to_time`")
+    .append(") SELECT `id`, ")
+    .append("(SELECT COUNT(*) FROM `waypoint` WHERE `collection_id` = `collection`.`id`), ")
+    .append("(SELECT COUNT(*) FROM `waypoint` WHERE `collection_id` = `collection`.`id` AND NOT `visible`), ")
+    .append("(SELECT COUNT(*) FROM `track` WHERE `collection_id` = `collection`.`id`), ")
+    .append("(SELECT COUNT(*) FROM `track` WHERE `collection_id` = `collection`.`id` AND NOT `visible`), ")
+    .append("(SELECT COALESCE(SUM(`distance`), 0) FROM `track` WHERE `collection_id` = `collection`.`id`), ")
+    .append("(SELECT MIN(`from_time`) FROM `track` WHERE `collection_id` = `collection`.`id`), ")
+    .append("(SELECT MAX(`to_time`) FROM `track` WHERE `collection_id` = `collection`.`id`) ")
+    .append("FROM `collection`;");
+
+  queries << QString("CREATE TRIGGER `collection_stats_insert` AFTER INSERT ON `collection` BEGIN ")
+    .append("INSERT INTO `collection_stats` (`collection_id`) VALUES (new.`id`); ")
+    .append("END;");
+
+  auto waypointDiff = [](const QString &row, const QString &sign) {
+    return QString("UPDATE `collection_stats` SET ")
+      .append("`waypoint_count` = `waypoint_count` %1 1, ").arg(sign)
+      .append("`waypoint_hidden` = `waypoint_hidden` %1 (NOT %2.`visible`) ").arg(sign).arg(row)
+      .append("WHERE `collection_id` = %1.`collection_id`; ").arg(row);
+  };
+  queries << QString("CREATE TRIGGER `collection_stats_waypoint_insert` AFTER INSERT ON `waypoint` BEGIN ")
+    .append(waypointDiff("new", "+"))
+    .append("END;");
+  queries << QString("CREATE TRIGGER `collection_stats_waypoint_update` AFTER UPDATE OF `collection_id`, `visible` ON `waypoint` BEGIN ")
+    .append(waypointDiff("old", "-"))
+    .append(waypointDiff("new", "+"))
+    .append("END;");
+  queries << QString("CREATE TRIGGER `collection_stats_waypoint_delete` AFTER DELETE ON `waypoint` BEGIN ")
+    .append(waypointDiff("old", "-"))
+    .append("END;");
+
+  auto trackDiff = [](const QString &row, const QString &sign) {
+    return QString("UPDATE `collection_stats` SET ")
+      .append("`track_count` = `track_count` %1 1, ").arg(sign)
+      .append("`track_hidden` = `track_hidden` %1 (NOT %2.`visible`), ").arg(sign).arg(row)
+      .append("`distance` = `distance` %1 %2.`distance`, ").arg(sign).arg(row)
+      .append("`from_time` = (SELECT MIN(`from_time`) FROM `track` WHERE `collection_id` = %1.`collection_id`), ").arg(row)
+      .append("`to_time` = (SELECT MAX(`to_time`) FROM `track` WHERE `collection_id` = %1.`collection_id`) ").arg(row)
+      .append("WHERE `collection_id` = %1.`collection_id`; ").arg(row);
+  };
+  queries << QString("CREATE TRIGGER `collection_stats_track_insert` AFTER INSERT ON `track` BEGIN ")
+    .append(trackDiff("new", "+"))
+    .append("END;");
+  queries << QString("CREATE TRIGGER `collection_stats_track_update` AFTER UPDATE OF `collection_id`, `visible`, `distance`, `from_time`, `to_time` ON `track` BEGIN ")
+    .append(trackDiff("old", "-"))
+    .append(trackDiff("new", "+"))
+    .append("END;");
+  queries << QString("CREATE TRIGGER `collection_stats_track_delete` AFTER DELETE ON `track` BEGIN ")
+    .append(trackDiff("old", "-"))
+    .append("END;");
+  return queries;
+}
+}
+
+/**
+ * Reader thread with read-only database connection
+ */
+class StorageReader: public QObject
+{
+public:
+  StorageReader(const QString &databasePath, const QString &connectionName);
+  ~StorageReader() override;
+
+  void open();
+
+  /**
+   * Thread-safe. Task is processed in the reader thread, failure is called
+   * instead when the read connection is not open.
+   */
+  void submit(const std::function<void()> &task, const std::function<void()> &failure);
+
+  int pending() const
+  {
+    return pendingTasks;
+  }
+
+private:
+  QString databasePath;
+  QString connectionName;
+  QSqlDatabase db;
+  std::unique_ptr<StatementCache> statementCache;
+  std::atomic_int pendingTasks{0};
+};
+
+StorageReader::StorageReader(const QString &databasePath, const QString &connectionName):
+  databasePath(databasePath), connectionName(connectionName)
+{}
+
+StorageReader::~StorageReader()
+{
+  if (threadStatementCache == statementCache.get()) {
+    threadStatementCache = nullptr;
+  }
+  statementCache.reset();
+  if (db.isValid()) {
+    if (db.isOpen()) {
+      db.close();
+    }
+    db = QSqlDatabase(); // invalidate instance
+    QSqlDatabase::removeDatabase(connectionName);
+  }
+  thread()->quit();
+}
+
+void StorageReader::open()
+{
+  db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+  db.setDatabaseName(databasePath);
+  db.setConnectOptions("QSQLITE_OPEN_READONLY");
+  if (!db.open()){
+    qWarning() << "Open read connection" << connectionName << "failed" << db.lastError();
+    return;
+  }
+  applyConnectionPragmas(db);
+  registerLocaleCollation(db);
+  statementCache = std::make_unique<StatementCache>(db);
+  threadStatementCache = statementCache.get();
+}
+
+void StorageReader::submit(const std::function<void()> &task, const std::function<void()> &failure)
+{
+  pendingTasks++;
+  QTimer::singleShot(0, this, [this, task, failure](){
+    if (statementCache) {
+      task();
+    } else {
+      failure();
+    }
+    pendingTasks--;
+  });
 }
 
 Storage::Storage(QThread *thread,
@@ -319,6 +884,23 @@ Storage::~Storage()
     thread->quit();
   }
 
+  {
+    QMutexLocker locker(&readersMutex);
+    for (StorageReader *reader: readers) {
+      // reader closes its connection and quits its thread on deletion
+      QThread *readerThread = reader->thread();
+      reader->deleteLater();
+      readerThread->wait();
+    }
+    readers.clear();
+  }
+
+  QJsonObject metricsJson = metrics.toJson();
+  if (!metricsJson.isEmpty()) {
+    qDebug() << "Storage metrics:" << QJsonDocument(metricsJson).toJson(QJsonDocument::Compact);
+  }
+
+  statementCache.reset(); // all cached queries have to be released before closing
   if (db.isValid()) {
     if (db.isOpen()) {
       db.close();
@@ -356,6 +938,14 @@ bool Storage::updateSchema(){
     }
   }
 
+  if (tables.isEmpty()){
+    // new database, free pages are released by idle maintenance then
+    QSqlQuery q = db.exec("PRAGMA auto_vacuum = INCREMENTAL;");
+    if (q.lastError().isValid()){
+      qWarning() << "Setting auto vacuum failed" << q.lastError();
+    }
+  }
+
   if (!tables.contains("version")){
     QString sql("CREATE TABLE `version` ( `version` int NOT NULL);");
     QSqlQuery q = db.exec(sql);
@@ -389,13 +979,15 @@ bool Storage::updateSchema(){
   // - enable foreign keys
   // - commit
   // - profit
+  //
+  // Legacy track_point table (replaced by track_segment_data in v4) is not rebuilt or converted here,
+  // it may be huge. Its points are moved to chunks in background batches after initialisation
+  // (see startMigration) and read with nullable, converted timestamps meanwhile.
   QStringList updateQueries;
-  bool updateTrackPointTable = false;
   bool updateWaypointTable = false;
   bool updateTrackTable = false;
   if (currentSchema < 2){
     // from schema v2 may be timestamps null
-    updateTrackPointTable = true;
     updateWaypointTable = true;
   }
 
@@ -405,21 +997,13 @@ bool Storage::updateSchema(){
     updateWaypointTable = true;
   }
 
-  if (updateTrackPointTable) {
-    // alter track_point
-    updateQueries << "ALTER TABLE `track_point` RENAME TO `_track_point`";
-    updateQueries << sqlCreateTrackPoint();
-    updateQueries << "INSERT INTO `track_point` SELECT * FROM `_track_point`";
-    updateQueries << "DROP TABLE `_track_point`";
-  }
-
   if (updateWaypointTable) {
     // alter waypoint
     updateQueries << "ALTER TABLE `waypoint` RENAME TO `_waypoint`";
     updateQueries << sqlCreateWaypoint();
 
     // in v3 we added one column (visible), so we need to explicitly name columns (from v2)
-    static_assert(DbSchema==3);
+    static_assert(DbSchema==7);
     updateQueries << (QString("INSERT INTO `waypoint` (")
       .append("`id`, `collection_id`, `modification_time`, `timestamp`, `latitude`,")
       .append("`longitude`, `elevation`, `name`, `description`,")
@@ -439,7 +1023,7 @@ bool Storage::updateSchema(){
     updateQueries << sqlCreateTrack();
 
     // in v3 we added three columns, so we need to explicitly name columns (from v2)
-    static_assert(DbSchema==3);
+    static_assert(DbSchema==7);
     updateQueries << (QString("INSERT INTO `track` (")
       .append("`id`, `collection_id`, `name`, `description`, `open`, `creation_time`, ")
       .append("`modification_time`, `color`, `type`, `visible`, ")
@@ -459,6 +1043,33 @@ bool Storage::updateSchema(){
     updateQueries << "DROP TABLE `_track`";
   }
 
+  if (currentSchema < 5) {
+    // from schema v5 time columns are stored as milliseconds since epoch, instead of ISO strings
+    static const std::vector<std::pair<QString, QStringList>> timeColumns{
+      {"track", {"creation_time", "modification_time", "from_time", "to_time"}},
+      {"track_segment", {"creation_time"}},
+      {"waypoint", {"modification_time", "timestamp"}},
+      {"search_history", {"last_usage"}}
+    };
+    for (const auto &[table, columns]: timeColumns) {
+      if (!tables.contains(table)) {
+        continue;
+      }
+      for (const auto &column: columns) {
+        updateQueries << sqlTimeColumnToMillis(table, column);
+      }
+    }
+  }
+
+  if (currentSchema < 7 && tables.contains("track_segment_data")) {
+    // from schema v7 chunks have explicit sequence of its first point
+    updateQueries << "ALTER TABLE `track_segment_data` ADD COLUMN `first_point` INTEGER NOT NULL DEFAULT 0";
+    updateQueries << QString("UPDATE `track_segment_data` SET `first_point` = (")
+      .append("SELECT COALESCE(SUM(`d`.`point_count`), 0) FROM `track_segment_data` AS `d` ")
+      .append("WHERE `d`.`segment_id` = `track_segment_data`.`segment_id` AND `d`.`chunk` < `track_segment_data`.`chunk`")
+      .append(")");
+  }
+
   if (currentSchema < DbSchema){
     updateQueries << QString("INSERT INTO `version` (`version`) VALUES (%1)").arg(DbSchema);
     currentSchema = DbSchema;
@@ -541,6 +1152,61 @@ bool Storage::updateSchema(){
     }
   }
 
+  if (!tables.contains("track_segment_data")){
+    qDebug()<< "creating track_segment_data table";
+
+    QSqlQuery q = db.exec(sqlCreateTrackSegmentData());
+    if (q.lastError().isValid()){
+      qWarning() << "Storage: creating track segment data table failed" << q.lastError();
+      db.close();
+      return false;
+    }
+  }
+
+  if (!tables.contains("track_segment_lod")){
+    qDebug()<< "creating track_segment_lod table";
+
+    QSqlQuery q = db.exec(sqlCreateTrackSegmentLod());
+    if (q.lastError().isValid()){
+      qWarning() << "Storage: creating track segment lod table failed" << q.lastError();
+      db.close();
+      return false;
+    }
+  }
+
+  if (!tables.contains("track_segment_stats")){
+    qDebug()<< "creating track_segment_stats table";
+
+    QSqlQuery q = db.exec(sqlCreateTrackSegmentStats());
+    if (q.lastError().isValid()){
+      qWarning() << "Storage: creating track segment stats table failed" << q.lastError();
+      db.close();
+      return false;
+    }
+  }
+
+  if (!tables.contains("track_journal")){
+    qDebug()<< "creating track_journal table";
+
+    QSqlQuery q = db.exec(sqlCreateTrackJournal());
+    if (q.lastError().isValid()){
+      qWarning() << "Storage: creating track journal table failed" << q.lastError();
+      db.close();
+      return false;
+    }
+  }
+
+  if (!tables.contains("track_archive")){
+    qDebug()<< "creating track_archive table";
+
+    QSqlQuery q = db.exec(sqlCreateTrackArchive());
+    if (q.lastError().isValid()){
+      qWarning() << "Storage: creating track archive table failed" << q.lastError();
+      db.close();
+      return false;
+    }
+  }
+
   if (!tables.contains("waypoint")){
     qDebug()<< "creating waypoints table";
 
@@ -581,28 +1247,404 @@ bool Storage::updateSchema(){
     }
   }
 
-  return true;
-}
+  if (!indexes.contains("idx_track_segment_data_first_point")){
+    qDebug() << "creating idx_track_segment_data_first_point index";
 
-bool Storage::listIndexes(QStringList &indexes)
-{
-  QString sql("SELECT name FROM sqlite_master WHERE type = 'index';");
+    QSqlQuery q = db.exec("CREATE INDEX idx_track_segment_data_first_point ON track_segment_data (segment_id, first_point)");
+    if (q.lastError().isValid()){
+      qWarning() << "Storage: creating idx_track_segment_data_first_point index failed" << q.lastError();
+      db.close();
+      return false;
+    }
+  }
 
-  QSqlQuery q = db.exec(sql);
-  if (q.lastError().isValid()) {
-    qWarning() << "Storage: cannot load indexes" << q.lastError();
+  // track_point table is kept as source of migration to schema v4
+  QSqlQuery sqlLegacy = db.exec("SELECT 1 FROM `track_point` LIMIT 1");
+  if (sqlLegacy.lastError().isValid()){
+    qWarning() << "Storage: checking legacy track points failed" << sqlLegacy.lastError();
+    db.close();
     return false;
   }
-  while (q.next()) {
-    indexes << varToString(q.value("name"));
+  legacyPoints = sqlLegacy.next();
+  sqlLegacy.finish();
+
+  if (!tables.contains("waypoint_rtree")){
+    qDebug()<< "creating waypoint_rtree index";
+    waypointIndex = execInTransaction(sqlCreateWaypointIndex());
+    if (!waypointIndex){
+      // sqlite may be compiled without R*Tree module, nearby search will use full scan then
+      qWarning() << "Storage: creating waypoint index failed";
+    }
+  } else {
+    waypointIndex = true;
+  }
+
+  if (!tables.contains("collection_stats")){
+    qDebug()<< "creating collection_stats table";
+    if (!execInTransaction(sqlCreateCollectionStats())){
+      qWarning() << "Storage: creating collection stats failed";
+      db.close();
+      return false;
+    }
+  }
+
+  if (!tables.contains("waypoint_fts")){
+    qDebug()<< "creating full-text search index";
+    searchIndex = execInTransaction(sqlCreateSearchIndex());
+    if (!searchIndex){
+      // sqlite may be compiled without FTS5 module, search will use full scan then
+      qWarning() << "Storage: creating search index failed";
+    }
+  } else {
+    searchIndex = true;
+  }
+
+  if (!tables.contains("track_rtree")){
+    qDebug()<< "creating track_rtree index";
+    trackIndex = execInTransaction(sqlCreateTrackIndex());
+    if (!trackIndex){
+      qWarning() << "Storage: creating track index failed";
+    }
+  } else {
+    trackIndex = true;
   }
+
   return true;
 }
 
-void Storage::init()
+bool Storage::execInTransaction(const QStringList &queries)
 {
-  if (!checkAccess("init", false)){
-    return;
+  db.transaction();
+  for (const QString &query: queries) {
+    QSqlQuery sql(db);
+    sql.prepare(query);
+    sql.exec();
+    if (sql.lastError().isValid()) {
+      qWarning() << "Query" << query << "failed" << sql.lastError();
+      db.rollback();
+      return false;
+    }
+  }
+  if (!db.commit()) {
+    qWarning() << "Transaction commit failed" << db.lastError();
+    return false;
+  }
+  return true;
+}
+
+void Storage::startMigration()
+{
+  // Interrupted migration continues on next start: every batch moves whole segments in own transaction,
+  // so the data itself are checkpoint of the migration.
+  migrationSteps.clear();
+  migrationSteps.push_back(MigrationStep{
+    tr("Migrating track points"),
+    // track_point table is kept as source of migration to schema v4
+    "SELECT COUNT(DISTINCT `segment_id`) FROM `track_point`",
+    "SELECT `segment_id` FROM `track_point` WHERE `segment_id` > :cursor ORDER BY `segment_id` LIMIT 1",
+    [this](qint64 segmentId, qint64 &points) {
+      gpx::TrackSegment segment;
+      if (!loadLegacyTrackPoints(segmentId, segment) ||
+          !storeTrackPoints(segment.points, segmentId)) {
+        return false;
+      }
+      points += qint64(segment.points.size());
+      return true;
+    }});
+
+  QString closedSegments = QString("FROM `track_segment` ")
+    .append("JOIN `track` ON `track`.`id` = `track_segment`.`track_id` ")
+    .append("WHERE NOT `track`.`open` AND NOT EXISTS (")
+    .append(" SELECT 1 FROM `%1` WHERE `segment_id` = `track_segment`.`id`")
+    .append(")");
+  auto nextSegment = [](const QString &from) {
+    return QString("SELECT `track_segment`.`id` ").append(from)
+      .append(" AND `track_segment`.`id` > :cursor ORDER BY `track_segment`.`id` LIMIT 1");
+  };
+
+  // closed tracks from schema v5 don't have levels of detail
+  QString withoutLod = closedSegments.arg("track_segment_lod");
+  migrationSteps.push_back(MigrationStep{
+    tr("Building track levels of detail"),
+    QString("SELECT COUNT(*) ").append(withoutLod),
+    nextSegment(withoutLod),
+    [this](qint64 segmentId, qint64 &points) {
+      gpx::TrackSegment segment;
+      if (!loadTrackPoints(segmentId, segment) ||
+          !storeSegmentLods(segmentId, encodeSegmentLods(segment.points))) {
+        return false;
+      }
+      points += qint64(segment.points.size());
+      return true;
+    }});
+
+  // segment statistics are computed on demand otherwise, on first edit of the track
+  QString withoutStats = closedSegments.arg("track_segment_stats");
+  migrationSteps.push_back(MigrationStep{
+    tr("Computing segment statistics"),
+    QString("SELECT COUNT(*) ").append(withoutStats),
+    nextSegment(withoutStats),
+    [this](qint64 segmentId, qint64 &points) {
+      gpx::TrackSegment segment;
+      if (!loadTrackPoints(segmentId, segment) ||
+          !storeSegmentStatistics(segmentId, computeSegmentStatistics(segment.points))) {
+        return false;
+      }
+      points += qint64(segment.points.size());
+      return true;
+    }});
+
+  migrationStep = 0;
+  migrationCursor = -1;
+  migrationDone = 0;
+  migrationTotal = -1;
+  QTimer::singleShot(0, this, &Storage::migrationBatch);
+}
+
+void Storage::migrationBatch()
+{
+  if (!checkAccess(__FUNCTION__)){
+    return;
+  }
+
+  auto finish = [this](bool success) {
+    migrationSteps.clear();
+    emit migrationFinished(success);
+  };
+
+  while (migrationStep < migrationSteps.size()) {
+    const MigrationStep &step = migrationSteps[migrationStep];
+    if (migrationTotal < 0) {
+      QSqlQuery sqlCount = db.exec(step.countSql);
+      if (sqlCount.lastError().isValid() || !sqlCount.next()) {
+        qWarning() << "Storage: counting migration step" << step.name << "failed" << sqlCount.lastError();
+        return finish(false);
+      }
+      migrationTotal = varToLong(sqlCount.value(0));
+      if (migrationTotal > 0) {
+        qDebug() << step.name << migrationTotal << "segments";
+      }
+    }
+    if (migrationTotal > 0) {
+      break;
+    }
+    // step is done, continue with next one
+    if (migrationStep == 0) {
+      // legacy points are migrated by the first step
+      legacyPoints = false;
+    }
+    migrationStep++;
+    migrationCursor = -1;
+    migrationDone = 0;
+    migrationTotal = -1;
+  }
+  if (migrationStep >= migrationSteps.size()) {
+    return finish(true);
+  }
+
+  const MigrationStep &step = migrationSteps[migrationStep];
+  QElapsedTimer timer;
+  timer.start();
+  qint64 points = 0;
+  qint64 segments = 0;
+  db.transaction();
+  while (points < MigrationBatchPoints) {
+    auto sql = prepare(step.nextSql);
+    sql.execValues(migrationCursor);
+    if (sql.lastError().isValid()) {
+      qWarning() << "Storage:" << step.name << "failed" << sql.lastError();
+      db.rollback();
+      return finish(false);
+    }
+    if (!sql.next()) {
+      break;
+    }
+    qint64 segmentId = varToLong(sql.value(0));
+    sql.finish();
+    if (!step.migrate(segmentId, points)) {
+      qWarning() << "Storage:" << step.name << "of segment" << segmentId << "failed";
+      db.rollback();
+      return finish(false);
+    }
+    migrationCursor = segmentId;
+    segments++;
+  }
+  if (!db.commit()) {
+    qWarning() << "Storage: migration commit failed" << db.lastError();
+    return finish(false);
+  }
+
+  if (segments == 0) {
+    // all segments are processed, count may be lower by segments deleted meanwhile
+    migrationDone = migrationTotal;
+    migrationTotal = 0;
+  } else {
+    migrationDone = std::min(migrationDone + segments, migrationTotal);
+    qDebug() << step.name << migrationDone << "/" << migrationTotal << "segments," << points << "points in" << timer.elapsed() << "ms";
+  }
+  emit migrationProgress(step.name, migrationDone, std::max(migrationDone, migrationTotal));
+
+  // next batch is processed after pending events, storage stays responsive during the migration
+  QTimer::singleShot(0, this, &Storage::migrationBatch);
+}
+
+bool Storage::buildTrackLods(qint64 trackId)
+{
+  auto sql = prepare("SELECT `id` FROM `track_segment` WHERE `track_id` = :trackId ORDER BY `id`;");
+  sql.execValues(trackId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading segments for track id" << trackId << "failed";
+    emit error(tr("Loading segments for track id %1 failed: %2").arg(trackId).arg(sql.lastError().text()));
+    return false;
+  }
+  std::vector<qint64> segments;
+  while (sql.next()) {
+    segments.push_back(varToLong(sql.value(0)));
+  }
+  sql.finish();
+
+  db.transaction();
+  for (qint64 segmentId: segments) {
+    gpx::TrackSegment segment;
+    if (!loadTrackPoints(segmentId, segment) ||
+        !storeSegmentLods(segmentId, encodeSegmentLods(segment.points))) {
+      db.rollback();
+      return false;
+    }
+  }
+  if (!db.commit()) {
+    qWarning() << "Transaction commit failed" << db.lastError();
+    return false;
+  }
+  return true;
+}
+
+bool Storage::storeSegmentLods(qint64 segmentId, const std::vector<QByteArray> &lods)
+{
+  if (!deleteSegmentLods(segmentId)) {
+    return false;
+  }
+
+  auto sql = prepare(QString("INSERT INTO `track_segment_lod` ")
+               .append("(`segment_id`, `level`, `point_count`, `data`) ")
+               .append("VALUES ")
+               .append("(:segment_id, :level, :point_count, :data)"));
+  for (size_t level = 0; level < lods.size(); level++) {
+    sql.execValues(segmentId, qint64(level), TrackPointCodec::pointCount(lods[level]), lods[level]);
+    if (sql.lastError().isValid()) {
+      qWarning() << "Storing lod of segment" << segmentId << "failed" << sql.lastError();
+      emit error(tr("Storing lod of segment %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Storage::storeSegmentStatistics(qint64 segmentId, const TrackStatistics &statistics)
+{
+  auto sql = prepare(QString("INSERT OR REPLACE INTO `track_segment_stats` (")
+                   .append("`segment_id`, `from_time`, `to_time`, `distance`, `raw_distance`, `duration`, `moving_duration`, ")
+                   .append("`max_speed`, `average_speed`, `moving_average_speed`, `ascent`, `descent`, `min_elevation`, `max_elevation`, ")
+                   .append("`bbox_min_lat`, `bbox_min_lon`, `bbox_max_lat`, `bbox_max_lon`")
+                   .append(") VALUES (")
+                   .append(":segment_id, :from_time, :to_time, :distance, :raw_distance, :duration, :moving_duration, ")
+                   .append(":max_speed, :average_speed, :moving_average_speed, :ascent, :descent, :min_elevation, :max_elevation, ")
+                   .append(":bbox_min_lat, :bbox_min_lon, :bbox_max_lat, :bbox_max_lon")
+                   .append(")"));
+  sql.bindValue(":segment_id", segmentId);
+  bindTrackStatistics(sql, statistics);
+  sql.exec();
+  if (sql.lastError().isValid()) {
+    qWarning() << "Storing statistics of segment" << segmentId << "failed" << sql.lastError();
+    emit error(tr("Storing statistics of segment %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+  return true;
+}
+
+bool Storage::deleteSegmentStatistics(qint64 segmentId)
+{
+  auto sql = prepare("DELETE FROM `track_segment_stats` WHERE `segment_id` = :segmentId");
+  sql.execValues(segmentId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Deleting statistics of segment" << segmentId << "failed: " << sql.lastError();
+    emit error(tr("Deleting statistics of segment %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+  return true;
+}
+
+bool Storage::mergeSegmentStatistics(qint64 trackId, TrackStatistics &statistics)
+{
+  auto sql = prepare(QString("SELECT `track_segment`.`id` AS `id`, `track_segment_stats`.* FROM `track_segment` ")
+                       .append("LEFT JOIN `track_segment_stats` ON `track_segment_stats`.`segment_id` = `track_segment`.`id` ")
+                       .append("WHERE `track_segment`.`track_id` = :trackId ")
+                       .append("ORDER BY `track_segment`.`id`;"));
+  sql.execValues(trackId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading segment statistics for track id" << trackId << "failed" << sql.lastError();
+    emit error(tr("Loading segments for track id %1 failed: %2").arg(trackId).arg(sql.lastError().text()));
+    return false;
+  }
+  std::vector<TrackStatistics> segments;
+  std::vector<std::pair<size_t, qint64>> missing;
+  while (sql.next()) {
+    if (sql.value("segment_id").isNull()) {
+      missing.emplace_back(segments.size(), varToLong(sql.value("id")));
+      segments.emplace_back();
+    } else {
+      segments.push_back(makeTrackStatistics(sql));
+    }
+  }
+  sql.finish();
+
+  // just segments without statistics are read
+  for (const auto &[index, segmentId]: missing) {
+    gpx::TrackSegment segment;
+    if (!loadTrackPoints(segmentId, segment)) {
+      return false;
+    }
+    segments[index] = computeSegmentStatistics(segment.points);
+    if (!storeSegmentStatistics(segmentId, segments[index])) {
+      return false;
+    }
+  }
+
+  statistics = TrackStatistics::merge(segments);
+  return true;
+}
+
+bool Storage::deleteSegmentLods(qint64 segmentId)
+{
+  auto sql = prepare("DELETE FROM `track_segment_lod` WHERE `segment_id` = :segmentId");
+  sql.execValues(segmentId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Deleting lod of segment" << segmentId << "failed: " << sql.lastError();
+    emit error(tr("Deleting lod of segment %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+  return true;
+}
+
+bool Storage::listIndexes(QStringList &indexes)
+{
+  QString sql("SELECT name FROM sqlite_master WHERE type = 'index';");
+
+  QSqlQuery q = db.exec(sql);
+  if (q.lastError().isValid()) {
+    qWarning() << "Storage: cannot load indexes" << q.lastError();
+    return false;
+  }
+  while (q.next()) {
+    indexes << varToString(q.value("name"));
+  }
+  return true;
+}
+
+void Storage::init()
+{
+  if (!checkAccess("init", false)){
+    return;
   }
 
   // Find QSLite driver
@@ -621,6 +1663,7 @@ void Storage::init()
   path.append(QDir::separator()).append("storage.db");
   path = QDir::toNativeSeparators(path);
   db.setDatabaseName(path);
+  databasePath = path;
 
   if (!db.open()){
     qWarning() << "Open database failed" << db.lastError();
@@ -628,6 +1671,16 @@ void Storage::init()
     return;
   }
   qDebug() << "Storage database opened:" << path;
+  applyConnectionPragmas(db);
+  registerLocaleCollation(db);
+  for (const QString &pragma: {QString("PRAGMA journal_size_limit = %1;").arg(qint64(JournalSizeLimitKiB) * 1024),
+                               QString("PRAGMA analysis_limit = %1;").arg(AnalysisLimit)}) {
+    QSqlQuery q = db.exec(pragma);
+    if (q.lastError().isValid()) {
+      qWarning() << pragma << "failed:" << q.lastError();
+    }
+  }
+  statementCache = std::make_unique<StatementCache>(db);
   if (!updateSchema()){
     emit initialisationError("update schema");
     return;
@@ -638,12 +1691,112 @@ void Storage::init()
     qWarning() << "Enabling foreign keys fails:" << q.lastError();
   }
 
+  // points recorded before crash are stored before the recent open track is requested
+  if (journal.open(directory.filePath("track-journal.bin"))) {
+    QSet<qint64> collections;
+    if (!compactJournalPrivate(-1, std::nullopt, collections)) {
+      qWarning() << "Replay of track journal failed";
+    }
+  }
+
   ok = db.isValid() && db.isOpen();
+  if (ok) {
+    openReadConnections();
+  }
   emit initialised();
+
+  if (ok) {
+    startMigration();
+
+    maintenanceTimer = new QTimer(this);
+    maintenanceTimer->setSingleShot(true);
+    connect(maintenanceTimer, &QTimer::timeout, this, &Storage::maintenanceSlice);
+    lastActivityNs = StorageMetrics::now();
+    maintenanceTimer->start(MaintenanceIdleMs);
+  }
+}
+
+void Storage::openReadConnections()
+{
+  // with write-ahead log, readers don't block writer and writer don't block readers
+  QSqlQuery q = db.exec("PRAGMA journal_mode = WAL;");
+  if (q.lastError().isValid() || !q.next() || varToString(q.value(0)).toLower() != "wal"){
+    qWarning() << "Enabling WAL journal mode fails:" << q.lastError() << "; reads will be processed by Storage thread";
+    return;
+  }
+  q = db.exec("PRAGMA synchronous = NORMAL;");
+  if (q.lastError().isValid()){
+    qWarning() << "Setting synchronous mode fails:" << q.lastError();
+  }
+
+  QMutexLocker locker(&readersMutex);
+  for (int i = 0; i < ReadConnectionCount; i++) {
+    QThread *readerThread = OSMScoutQt::GetInstance().makeThread(QString("StorageReader%1").arg(i));
+    StorageReader *reader = new StorageReader(databasePath, QString("storage-read-%1").arg(i));
+    reader->moveToThread(readerThread);
+    connect(readerThread, &QThread::started,
+            reader, &StorageReader::open);
+    readerThread->start();
+    readers.push_back(reader);
+  }
+}
+
+void Storage::dispatchRead(const QString &slotName,
+                           const std::function<void()> &task,
+                           const std::function<void()> &failure)
+{
+  StorageReader *reader = nullptr;
+  {
+    QMutexLocker locker(&readersMutex);
+    for (StorageReader *candidate: readers) {
+      if (reader == nullptr || candidate->pending() < reader->pending()) {
+        reader = candidate;
+      }
+    }
+    qint64 submitted = StorageMetrics::now();
+    lastActivityNs = submitted;
+    auto measuredTask = [this, slotName, task, submitted](){
+      StorageMetrics::Scope scope(metrics, slotName, StorageMetrics::now() - submitted);
+      task();
+    };
+    if (reader != nullptr) {
+      reader->submit(measuredTask, failure);
+      return;
+    }
+  }
+
+  // read connections are not available (yet), process request in Storage thread
+  qint64 submitted = StorageMetrics::now();
+  QTimer::singleShot(0, this, [this, slotName, task, failure, submitted](){
+    if (checkAccess(slotName)) {
+      StorageMetrics::Scope scope(metrics, slotName, StorageMetrics::now() - submitted);
+      task();
+    } else {
+      failure();
+    }
+  });
+}
+
+StatementCache::Statement Storage::prepare(const QString &sql)
+{
+  if (threadStatementCache != nullptr) {
+    return threadStatementCache->prepare(sql);
+  }
+  assert(statementCache);
+  assert(thread == QThread::currentThread());
+  return statementCache->prepare(sql);
+}
+
+bool Storage::event(QEvent *event)
+{
+  // scope is named by checkAccess, events that are not slot calls are not recorded
+  StorageMetrics::Scope scope(metrics);
+  return QObject::event(event);
 }
 
 bool Storage::checkAccess(QString slotName, bool requireOpen)
 {
+  StorageMetrics::setName(slotName);
   if (thread != QThread::currentThread()){
     qWarning() << this << "::" << slotName << "from non incorrect thread;" << thread << "!=" << QThread::currentThread();
     return false;
@@ -652,50 +1805,233 @@ bool Storage::checkAccess(QString slotName, bool requireOpen)
     qWarning() << "Database is not open, " << this << "::" << slotName << "";
     return false;
   }
+  if (slotName != "maintenanceSlice" && slotName != "migrationBatch") {
+    lastActivityNs = StorageMetrics::now();
+    scheduleMaintenance();
+  }
+  return true;
+}
+
+void Storage::setApplicationActive(bool active)
+{
+  if (!checkAccess(__FUNCTION__)){
+    return;
+  }
+  applicationActive = active;
+  if (!active && maintenanceTimer != nullptr && maintenanceTimer->remainingTime() > MaintenanceBackgroundIdleMs) {
+    maintenanceTimer->start(MaintenanceBackgroundIdleMs);
+  }
+}
+
+void Storage::scheduleMaintenance()
+{
+  maintenancePending = true;
+  if (maintenanceTimer != nullptr && !maintenanceTimer->isActive()) {
+    maintenanceTimer->start(applicationActive ? MaintenanceIdleMs : MaintenanceBackgroundIdleMs);
+  }
+}
+
+void Storage::maintenanceSlice()
+{
+  if (!checkAccess(__FUNCTION__)){
+    return;
+  }
+
+  qint64 requiredIdleMs = applicationActive ? MaintenanceIdleMs : MaintenanceBackgroundIdleMs;
+  qint64 idleMs = (StorageMetrics::now() - lastActivityNs) / 1000000;
+  if (!migrationSteps.empty()) {
+    // legacy data are migrated yet
+    maintenanceTimer->start(requiredIdleMs);
+    return;
+  }
+  if (idleMs < requiredIdleMs) {
+    // there was recent request, pause maintenance
+    maintenanceTimer->start(requiredIdleMs - idleMs);
+    return;
+  }
+
+  if (maintenanceStep == MaintenanceStep::Checkpoint) {
+    // requests arriving from now require another maintenance round
+    maintenancePending = false;
+  }
+  QElapsedTimer slice;
+  slice.start();
+  while (maintenanceStep != MaintenanceStep::Done && slice.elapsed() < MaintenanceSliceMs) {
+    if (maintenanceStepSlice()) {
+      maintenanceStep = MaintenanceStep(int(maintenanceStep) + 1);
+    }
+  }
+  if (maintenanceStep != MaintenanceStep::Done) {
+    maintenanceTimer->start(MaintenancePauseMs);
+    return;
+  }
+
+  qDebug() << "Storage maintenance finished";
+  maintenanceStep = MaintenanceStep::Checkpoint;
+  if (maintenancePending) {
+    maintenanceTimer->start(requiredIdleMs);
+  }
+}
+
+bool Storage::maintenanceStepSlice()
+{
+  auto pragmaValue = [this](const QString &pragma) -> qint64 {
+    QSqlQuery q = db.exec(pragma);
+    if (q.lastError().isValid() || !q.next()) {
+      qWarning() << pragma << "failed:" << q.lastError();
+      return -1;
+    }
+    return varToLong(q.value(0));
+  };
+
+  switch (maintenanceStep) {
+    case MaintenanceStep::Checkpoint: {
+      // passive checkpoint don't wait for readers, WAL file is truncated to journal_size_limit
+      QSqlQuery q = db.exec("PRAGMA wal_checkpoint(PASSIVE);");
+      if (q.lastError().isValid()) {
+        qWarning() << "WAL checkpoint failed:" << q.lastError();
+      }
+      return true;
+    }
+    case MaintenanceStep::Optimize: {
+      // optimize analyses just tables that would benefit from it, complete analysis is required for the first time
+      QSqlQuery q = db.exec(pragmaValue("SELECT COUNT(*) FROM `sqlite_master` WHERE `name` = 'sqlite_stat1';") > 0 ?
+                            "PRAGMA optimize;" : "ANALYZE;");
+      if (q.lastError().isValid()) {
+        qWarning() << "Database optimize failed:" << q.lastError();
+      }
+      return true;
+    }
+    case MaintenanceStep::Vacuum: {
+      qint64 mode = pragmaValue("PRAGMA auto_vacuum;");
+      qint64 freePages = pragmaValue("PRAGMA freelist_count;");
+      if (freePages <= 0) {
+        return true;
+      }
+      if (mode == 2) { // incremental
+        QSqlQuery q = db.exec(QString("PRAGMA incremental_vacuum(%1);").arg(MaintenanceVacuumPages));
+        while (q.next()) {} // pages are released while stepping the statement
+        if (q.lastError().isValid()) {
+          qWarning() << "Incremental vacuum failed:" << q.lastError();
+          return true;
+        }
+        return false;
+      }
+      // database created without auto vacuum, it may be converted by compactDatabase on user request
+      return true;
+    }
+    case MaintenanceStep::ArchiveCleanup:
+      removeUnusedArchives();
+      return true;
+    case MaintenanceStep::Done:
+      break;
+  }
   return true;
 }
 
 void Storage::loadCollections()
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionsLoaded(std::vector<Collection>(), false);
+    emit collectionsLoaded(std::make_shared<const std::vector<Collection>>(), false);
+    return;
+  }
+  metrics.increment("collectionReloadsRequested");
+  if (collectionsReloadPending) {
+    metrics.increment("collectionReloadsCoalesced");
+  }
+  collectionsReloadPending = true;
+  scheduleReloads();
+}
+
+void Storage::scheduleReloads()
+{
+  if (reloadsScheduled) {
     return;
   }
+  reloadsScheduled = true;
+  reloadsScheduledNs = StorageMetrics::now();
+  QTimer::singleShot(0, this, &Storage::processReloads);
+}
+
+void Storage::collectionModified(qint64 collectionId)
+{
+  changedPending.insert(collectionId);
+  scheduleReloads();
+}
 
+void Storage::processReloads()
+{
+  reloadsScheduled = false;
+  QSet<qint64> changedIds;
+  std::swap(changedIds, changedPending);
+  QSet<qint64> collectionIds;
+  std::swap(collectionIds, detailsReloadPending);
+  bool collections = collectionsReloadPending;
+  collectionsReloadPending = false;
+
+  // just notification, consumers request items or details they need
+  for (qint64 collectionId: changedIds) {
+    emit collectionChanged(collectionId);
+  }
+
+  // Loads are executed here, not in the requesting slots (loadCollections, loadCollectionDetails),
+  // so they are measured by own scopes. Queue wait is time since the first coalesced request.
+  qint64 queueWaitNs = StorageMetrics::now() - reloadsScheduledNs;
+  for (qint64 collectionId: collectionIds) {
+    StorageMetrics::Scope scope(metrics, "loadCollectionDetailsPrivate", queueWaitNs);
+    metrics.increment("collectionReloadsExecuted");
+    Collection collection(collectionId);
+    if (loadCollectionDetailsPrivate(collection)) {
+      emit collectionDetailsLoaded(std::make_shared<const Collection>(std::move(collection)), true);
+    }else{
+      emit collectionDetailsLoaded(std::make_shared<const Collection>(std::move(collection)), false);
+    }
+  }
+  if (collections) {
+    StorageMetrics::Scope scope(metrics, "loadCollectionsPrivate", queueWaitNs);
+    metrics.increment("collectionReloadsExecuted");
+    loadCollectionsPrivate();
+  }
+}
+
+void Storage::loadCollectionsPrivate()
+{
+  // aggregates are maintained by triggers, see sqlCreateCollectionStats
   auto sql = QString("SELECT `id`, `visible`, `name`, `description`, ")
-    .append("(SELECT COUNT(*) FROM `waypoint` AS `wpt` WHERE `wpt`.`collection_id` = `collection`.`id` AND NOT `wpt`.`visible`) AS `wpt_hidden`, ")
-    .append("(SELECT COUNT(*) FROM `track`    AS `trk` WHERE `trk`.`collection_id` = `collection`.`id` AND NOT `trk`.`visible`) AS `trk_hidden` ")
-    .append("FROM `collection`;");
+    .append("`waypoint_count`, `waypoint_hidden`, `track_count`, `track_hidden`, `distance`, `from_time`, `to_time` ")
+    .append("FROM `collection` LEFT JOIN `collection_stats` ON `collection_stats`.`collection_id` = `collection`.`id`;");
 
-  QSqlQuery q = db.exec(sql);
+  auto q = prepare(sql);
+  q.exec();
   if (q.lastError().isValid()) {
-    emit collectionsLoaded(std::vector<Collection>(), false);
+    qWarning() << "Loading collections failed" << q.lastError();
+    emit collectionsLoaded(std::make_shared<const std::vector<Collection>>(), false);
+    return;
   }
   std::vector<Collection> result;
   while (q.next()) {
-    bool visibleAll = varToLong(q.value("wpt_hidden")) == 0 && varToLong(q.value("trk_hidden")) == 0;
-    result.emplace_back(
-      varToLong(q.value("id")),
-      varToBool(q.value("visible")),
-      visibleAll,
-      varToString(q.value("name")),
-      varToString(q.value("description"))
+    qint64 waypointHidden = varToLong(q.value(5), 0);
+    qint64 trackHidden = varToLong(q.value(7), 0);
+    Collection &collection = result.emplace_back(
+      varToLong(q.value(0)),
+      varToBool(q.value(1)),
+      waypointHidden == 0 && trackHidden == 0,
+      varToString(q.value(2)),
+      varToString(q.value(3))
     );
-  }
-  emit collectionsLoaded(result, true);
+    collection.waypointCount = varToLong(q.value(4), 0);
+    collection.hiddenWaypointCount = waypointHidden;
+    collection.trackCount = varToLong(q.value(6), 0);
+    collection.hiddenTrackCount = trackHidden;
+    collection.distance = Meters(varToDouble(q.value(8)));
+    collection.from = varToDateTime(q.value(9));
+    collection.to = varToDateTime(q.value(10));
+  }
+  emit collectionsLoaded(std::make_shared<const std::vector<Collection>>(std::move(result)), true);
 }
 
 Track Storage::makeTrack(QSqlQuery &sqlTrack) const
 {
-  GeoBox bbox(GeoCoord(varToDouble(sqlTrack.value("bbox_min_lat")),
-                       varToDouble(sqlTrack.value("bbox_min_lon"))),
-              GeoCoord(varToDouble(sqlTrack.value("bbox_max_lat")),
-                       varToDouble(sqlTrack.value("bbox_max_lon"))));
-
-  if (bbox.GetMinCoord().GetLat() < -90 || bbox.GetMinCoord().GetLon() < -180){
-    bbox.Invalidate();
-  }
-
   return Track(varToLong(sqlTrack.value("id")),
                varToLong(sqlTrack.value("collection_id")),
                varToString(sqlTrack.value("name")),
@@ -706,28 +2042,12 @@ Track Storage::makeTrack(QSqlQuery &sqlTrack) const
                varToString(sqlTrack.value("type")),
                varToColorOpt(sqlTrack.value("color")),
                varToBool(sqlTrack.value("visible")),
-               TrackStatistics(
-                 varToDateTime(sqlTrack.value("from_time")),
-                 varToDateTime(sqlTrack.value("to_time")),
-                 Distance::Of<Meter>(varToDouble(sqlTrack.value("distance"))),
-                 Distance::Of<Meter>(varToDouble(sqlTrack.value("raw_distance"))),
-                 std::chrono::milliseconds(varToLong(sqlTrack.value("duration"))),
-                 std::chrono::milliseconds(varToLong(sqlTrack.value("moving_duration"))),
-                 varToDouble(sqlTrack.value("max_speed")),
-                 varToDouble(sqlTrack.value("average_speed")),
-                 varToDouble(sqlTrack.value("moving_average_speed")),
-                 Distance::Of<Meter>(varToDouble(sqlTrack.value("ascent"))),
-                 Distance::Of<Meter>(varToDouble(sqlTrack.value("descent"))),
-                 varToDistanceOpt(sqlTrack.value("min_elevation")),
-                 varToDistanceOpt(sqlTrack.value("max_elevation")),
-
-                 bbox));
+               makeTrackStatistics(sqlTrack));
 }
 
 std::shared_ptr<std::vector<Track>> Storage::loadTracks(qint64 collectionId)
 {
-  QSqlQuery sqlTrack(db);
-  sqlTrack.prepare("SELECT * FROM `track` WHERE collection_id = :collectionId;");
+  auto sqlTrack = prepare("SELECT * FROM `track` WHERE collection_id = :collectionId;");
   sqlTrack.bindValue(":collectionId", collectionId);
   sqlTrack.exec();
 
@@ -757,7 +2077,7 @@ Waypoint Storage::makeWaypoint(QSqlQuery &sql) const
 
   QVariant timestampVar = sql.value("timestamp");
   if (!timestampVar.isNull()) {
-    wpt.time = dateTimeToTimestamp(varToDateTime(timestampVar));
+    wpt.time = varLongToOptTimestamp(timestampVar);
   }
   wpt.elevation = varToDoubleOpt(sql.value("elevation"));
 
@@ -769,8 +2089,7 @@ Waypoint Storage::makeWaypoint(QSqlQuery &sql) const
 
 std::shared_ptr<std::vector<Waypoint>> Storage::loadWaypoints(qint64 collectionId)
 {
-  QSqlQuery sql(db);
-  sql.prepare("SELECT * FROM `waypoint` WHERE collection_id = :collectionId;");
+  auto sql = prepare("SELECT * FROM `waypoint` WHERE collection_id = :collectionId;");
   sql.bindValue(":collectionId", collectionId);
   sql.exec();
 
@@ -787,27 +2106,43 @@ std::shared_ptr<std::vector<Waypoint>> Storage::loadWaypoints(qint64 collectionI
   return result;
 }
 
-bool Storage::loadCollectionDetailsPrivate(Collection &collection)
+bool Storage::loadCollectionMetadata(Collection &collection)
 {
-  QSqlQuery sql(db);
-  sql.prepare("SELECT `name`, `description`, `visible` FROM `collection` WHERE id = :collectionId;");
-  sql.bindValue(":collectionId", collection.id);
-  sql.exec();
+  auto sql = prepare(QString("SELECT `name`, `description`, `visible`, ")
+    .append("`waypoint_count`, `waypoint_hidden`, `track_count`, `track_hidden`, `distance`, `from_time`, `to_time` ")
+    .append("FROM `collection` LEFT JOIN `collection_stats` ON `collection_stats`.`collection_id` = `collection`.`id` ")
+    .append("WHERE `id` = :collectionId;"));
+  sql.execValues(collection.id);
   if (sql.lastError().isValid()) {
     qWarning() << "Loading collection id" << collection.id << "fails";
     emit error(tr("Loading collection id %1 fails").arg(collection.id));
     return false;
   }
-  std::vector<Collection> result;
   if (!sql.next()) {
     qWarning() << "Collection id" << collection.id << "don't exists";
     emit error(tr("Collection id %1 don't exists").arg(collection.id));
     return false;
   }
 
-  collection.name = varToString(sql.value("name"));
-  collection.description = varToString(sql.value("description"));
-  collection.visible = varToBool(sql.value("visible"));
+  collection.name = varToString(sql.value(0));
+  collection.description = varToString(sql.value(1));
+  collection.visible = varToBool(sql.value(2));
+  collection.waypointCount = varToLong(sql.value(3), 0);
+  collection.hiddenWaypointCount = varToLong(sql.value(4), 0);
+  collection.trackCount = varToLong(sql.value(5), 0);
+  collection.hiddenTrackCount = varToLong(sql.value(6), 0);
+  collection.visibleAll = collection.hiddenWaypointCount == 0 && collection.hiddenTrackCount == 0;
+  collection.distance = Meters(varToDouble(sql.value(7)));
+  collection.from = varToDateTime(sql.value(8));
+  collection.to = varToDateTime(sql.value(9));
+  return true;
+}
+
+bool Storage::loadCollectionDetailsPrivate(Collection &collection)
+{
+  if (!loadCollectionMetadata(collection)) {
+    return false;
+  }
 
   collection.tracks = loadTracks(collection.id);
   collection.waypoints = loadWaypoints(collection.id);
@@ -817,46 +2152,345 @@ bool Storage::loadCollectionDetailsPrivate(Collection &collection)
 void Storage::loadCollectionDetails(Collection collection)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionDetailsLoaded(collection, false);
+    emit collectionDetailsLoaded(std::make_shared<const Collection>(std::move(collection)), false);
     return;
   }
+  metrics.increment("collectionReloadsRequested");
+  if (detailsReloadPending.contains(collection.id)) {
+    metrics.increment("collectionReloadsCoalesced");
+  }
+  detailsReloadPending.insert(collection.id);
+  scheduleReloads();
+}
+
+bool Storage::loadCollectionItemsPrivate(qint64 collectionId,
+                                         int ordering,
+                                         bool waypointFirst,
+                                         qint64 offset,
+                                         qint64 limit,
+                                         std::vector<CollectionItem> &items)
+{
+  // kind 0 is waypoint, so waypoints are first when ordered by kind,
+  // kind and id are tie-breakers to make paging stable
+  QString orderBy = waypointFirst ? "`kind`, " : "";
+  // names are compared by QCollator, like CollectionModel does
+  QString collation = localeCollation ? "LOCALE" : "NOCASE";
+  switch (ordering) {
+    case 0: orderBy.append("`time` ASC"); break;
+    case 1: orderBy.append("`time` DESC"); break;
+    case 2: orderBy.append(QString("`name` COLLATE %1 ASC").arg(collation)); break;
+    case 3: orderBy.append(QString("`name` COLLATE %1 DESC").arg(collation)); break;
+    default:
+      qWarning() << "Unknown ordering" << ordering;
+      return false;
+  }
+  orderBy.append(", `kind`, `id`");
+
+  auto sql = prepare(QString("SELECT `kind`, `id` FROM (")
+    .append("SELECT 0 AS `kind`, `id`, `timestamp` AS `time`, `name` FROM `waypoint` WHERE `collection_id` = :waypointCollectionId ")
+    .append("UNION ALL ")
+    .append("SELECT 1 AS `kind`, `id`, `creation_time` AS `time`, `name` FROM `track` WHERE `collection_id` = :trackCollectionId")
+    .append(") ORDER BY ").append(orderBy)
+    .append(" LIMIT :limit OFFSET :offset;"));
+  sql.execValues(collectionId, collectionId, limit, offset);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading items of collection id" << collectionId << "failed" << sql.lastError();
+    emit error(tr("Loading items of collection id %1 failed: %2").arg(collectionId).arg(sql.lastError().text()));
+    return false;
+  }
+
+  std::vector<std::pair<bool, qint64>> keys;
+  keys.reserve(size_t(limit));
+  while (sql.next()) {
+    keys.emplace_back(varToLong(sql.value(0)) == 0, varToLong(sql.value(1)));
+  }
+  sql.finish();
+
+  // Page is small, whole rows are loaded by primary keys (one statement for waypoints
+  // and one for tracks) - it is cheaper than sorting whole rows. Tables share column names,
+  // so rows of both kinds cannot be read by name from one joined statement.
+  QList<qint64> waypointIds;
+  QList<qint64> trackIds;
+  for (const auto &[waypoint, id]: keys) {
+    (waypoint ? waypointIds : trackIds) << id;
+  }
+  QHash<qint64, Waypoint> waypoints;
+  QHash<qint64, Track> tracks;
+  auto loadRows = [&](const QString &table, const QList<qint64> &ids, const std::function<void(QSqlQuery&)> &row) {
+    // Placeholder list is padded by NULLs to one of few fixed sizes, so just few distinct statements
+    // are kept in the statement cache. Larger pages are loaded in batches of the largest size.
+    for (int from = 0; from < ids.size(); from += ItemsInBatchSizes.back()) {
+      int count = std::min(ids.size() - from, ItemsInBatchSizes.back());
+      int size = *std::find_if(ItemsInBatchSizes.begin(), ItemsInBatchSizes.end(),
+                               [count](int s) { return s >= count; });
+      QStringList placeholders;
+      for (int i = 0; i < size; i++) {
+        placeholders << "?";
+      }
+      auto sqlItems = prepare(QString("SELECT * FROM `%1` WHERE `id` IN (%2);").arg(table, placeholders.join(", ")));
+      for (int i = 0; i < size; i++) {
+        sqlItems.bindValue(i, i < count ? QVariant(ids[from + i]) : QVariant()); // NULL never matches
+      }
+      sqlItems.exec();
+      if (sqlItems.lastError().isValid()) {
+        qWarning() << "Loading items of collection id" << collectionId << "failed" << sqlItems.lastError();
+        emit error(tr("Loading items of collection id %1 failed: %2").arg(collectionId).arg(sqlItems.lastError().text()));
+        return false;
+      }
+      while (sqlItems.next()) {
+        row(sqlItems);
+      }
+    }
+    return true;
+  };
+  if (!loadRows("waypoint", waypointIds, [&](QSqlQuery &row) {
+        Waypoint waypoint = makeWaypoint(row);
+        waypoints.insert(waypoint.id, std::move(waypoint));
+      }) ||
+      !loadRows("track", trackIds, [&](QSqlQuery &row) {
+        Track track = makeTrack(row);
+        tracks.insert(track.id, std::move(track));
+      })) {
+    return false;
+  }
+
+  items.reserve(keys.size());
+  for (const auto &[waypoint, id]: keys) {
+    // item removed meanwhile is skipped
+    if (waypoint) {
+      auto it = waypoints.find(id);
+      if (it != waypoints.end()) {
+        items.emplace_back(std::move(it.value()));
+      }
+    } else {
+      auto it = tracks.find(id);
+      if (it != tracks.end()) {
+        items.emplace_back(std::move(it.value()));
+      }
+    }
+  }
+  return true;
+}
+
+void Storage::loadCollectionItems(Collection collection, int ordering, bool waypointFirst, qint64 offset, qint64 limit)
+{
+  dispatchRead(__FUNCTION__, [this, collection, ordering, waypointFirst, offset, limit]() mutable {
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<CollectionItem> items;
+    bool result = loadCollectionMetadata(collection) &&
+                  loadCollectionItemsPrivate(collection.id, ordering, waypointFirst, offset, limit, items);
+    qDebug() << "Collection" << collection.id << "items" << offset << "-" << (offset + qint64(items.size()))
+             << "loading:" << timer.elapsed() << "ms";
+    emit collectionItemsLoaded(std::make_shared<const Collection>(std::move(collection)), ordering, waypointFirst, offset,
+                               std::make_shared<const std::vector<CollectionItem>>(std::move(items)), result);
+  }, [this, collection, ordering, waypointFirst, offset](){
+    emit collectionItemsLoaded(std::make_shared<const Collection>(collection), ordering, waypointFirst, offset,
+                               std::make_shared<const std::vector<CollectionItem>>(), false);
+  });
+}
+
+// QSqlQuery::size() is not supported with SQLite.
+// But you can get the number of rows with a workaround
+// https://stackoverflow.com/questions/26495049/qsqlquery-size-always-returns-1
+int Storage::querySize(QSqlQuery &query)
+{
+  int initialPos = query.at();
+  int size = 0;
+  if (query.last()) {
+    size = query.at() + 1;
+  } else {
+    size = 0;
+  }
+  // Important to restore initial pos
+  query.seek(initialPos);
+  return size;
+}
+
+bool Storage::loadTrackPoints(qint64 segmentId, gpx::TrackSegment &segment, const ChunkCallback &chunkLoaded)
+{
+  if (legacyPoints) {
+    // Segment that was not migrated yet. Migration moves whole segment from legacy table
+    // in one transaction, so the legacy table have to be checked first.
+    size_t from = segment.points.size();
+    if (!loadLegacyTrackPoints(segmentId, segment)) {
+      return false;
+    }
+    if (segment.points.size() > from) {
+      if (chunkLoaded) {
+        chunkLoaded(from);
+      }
+      return true;
+    }
+  }
 
-  if (loadCollectionDetailsPrivate(collection)) {
-    emit collectionDetailsLoaded(collection, true);
-  }else{
-    emit collectionDetailsLoaded(collection, false);
+  bool reserved = false;
+  return visitSegmentData(segmentId,
+    [&](const QByteArray &data, qint64 pointCount) {
+      if (!reserved) {
+        // first chunk is full when there are more chunks, it is good estimate
+        segment.points.reserve(segment.points.size() + pointCount);
+        reserved = true;
+      }
+      size_t from = segment.points.size();
+      if (!decodePoints(data, segment.points)) {
+        qWarning() << "Decoding nodes for segment id" << segmentId << "failed";
+        emit error(tr("Decoding nodes for segment id %1 failed").arg(segmentId));
+        return false;
+      }
+      if (chunkLoaded) {
+        chunkLoaded(from);
+      }
+      return true;
+    },
+    [&](const TrackArchive::SegmentView &view) {
+      // columns are read from the mapped file directly, there is nothing to decode
+      size_t from = segment.points.size();
+      view.appendTo(segment.points);
+      if (chunkLoaded) {
+        chunkLoaded(from);
+      }
+      return true;
+    });
+}
+
+bool Storage::visitSegmentData(qint64 segmentId,
+                               const DataChunkVisitor &chunkVisitor,
+                               const ArchivedSegmentVisitor &archiveVisitor)
+{
+  // Chunks, archive file and level of detail (present for closed segment with points) are selected
+  // by one statement, it reads single database snapshot. Separate statements may observe
+  // the segment before archiving (no archive) and after it (no chunks), see archiveTrack.
+  auto sql = prepare(QString("SELECT 0 AS `part`, `first_point`, `point_count`, `data`, NULL AS `file` ")
+                       .append("FROM `track_segment_data` WHERE `segment_id` = ? ")
+                       .append("UNION ALL ")
+                       .append("SELECT 1, 0, `track_archive`.`point_count`, NULL, `track_archive`.`file` FROM `track_segment` ")
+                       .append("JOIN `track_archive` ON `track_archive`.`track_id` = `track_segment`.`track_id` ")
+                       .append("WHERE `track_segment`.`id` = ? ")
+                       .append("UNION ALL ")
+                       .append("SELECT 2, 0, (SELECT MAX(`point_count`) FROM `track_segment_lod` WHERE `segment_id` = ?), NULL, NULL ")
+                       .append("ORDER BY 1, 2;"));
+  sql.execValues(segmentId, segmentId, segmentId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading nodes for segment id" << segmentId << "failed";
+    emit error(tr("Loading nodes for segment id %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+
+  bool hasPoints = false;
+  while (sql.next()) {
+    int part = sql.value(0).toInt();
+    if (part == 0) {
+      hasPoints = true;
+      if (!chunkVisitor(sql.value(3).toByteArray(), varToLong(sql.value(2)))) {
+        return false;
+      }
+    } else if (part == 1) {
+      if (hasPoints) {
+        continue; // archive row without chunks only, archived track has its chunks deleted
+      }
+      hasPoints = true;
+      QString file = sql.value(4).toString();
+      std::shared_ptr<const TrackArchive> archive = openArchive(file);
+      std::optional<TrackArchive::SegmentView> view;
+      if (archive) {
+        view = archive->findSegment(segmentId);
+      }
+      if (!view) {
+        qWarning() << "Loading nodes for segment id" << segmentId << "from archive" << file << "failed";
+        emit error(tr("Loading nodes for segment id %1 from archive failed").arg(segmentId));
+        return false;
+      }
+      if (!archiveVisitor(*view)) {
+        return false;
+      }
+    } else if (!hasPoints && !sql.value(2).isNull() && varToLong(sql.value(2)) > 0) {
+      // level of detail exists, but segment points are missing
+      qWarning() << "Nodes of segment id" << segmentId << "are missing";
+      emit error(tr("Nodes of segment id %1 are missing").arg(segmentId));
+      return false;
+    }
+  }
+  return true;
+}
+
+std::shared_ptr<const TrackArchive> Storage::openArchive(const QString &file)
+{
+  QString path = directory.filePath(QString("archive/") + file);
+  QMutexLocker locker(&archiveCacheMutex);
+  auto it = std::find_if(archiveCache.begin(), archiveCache.end(),
+                         [&path](const auto &archive) { return archive->path() == path; });
+  if (it != archiveCache.end()) {
+    std::rotate(archiveCache.begin(), it, it + 1);
+    return archiveCache.front();
+  }
+
+  auto archive = std::make_shared<TrackArchive>();
+  if (!archive->open(path)) {
+    return nullptr;
+  }
+  archiveCache.insert(archiveCache.begin(), archive);
+  if (archiveCache.size() > ArchiveCacheCapacity) {
+    archiveCache.pop_back();
+  }
+  return archive;
+}
+
+bool Storage::loadArchivedTrack(qint64 trackId, std::shared_ptr<const ArchivedTrackData> &archived)
+{
+  archived.reset();
+  // track without archive has no rows, archive row and segment chunks are swapped in one transaction
+  auto sql = prepare(QString("SELECT `track_segment`.`id`, `track_archive`.`file` FROM `track_segment` ")
+                       .append("JOIN `track_archive` ON `track_archive`.`track_id` = `track_segment`.`track_id` ")
+                       .append("WHERE `track_segment`.`track_id` = :trackId ORDER BY `track_segment`.`id`;"));
+  sql.execValues(trackId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading archive of track" << trackId << "failed" << sql.lastError();
+    emit error(tr("Loading archive of track %1 failed: %2").arg(trackId).arg(sql.lastError().text()));
+    return false;
+  }
+
+  auto result = std::make_shared<ArchivedTrackData>();
+  while (sql.next()) {
+    qint64 segmentId = varToLong(sql.value(0));
+    if (!result->archive) {
+      QString file = sql.value(1).toString();
+      result->archive = openArchive(file);
+      if (!result->archive) {
+        qWarning() << "Loading archive of track" << trackId << "failed";
+        emit error(tr("Loading archive of track %1 failed: %2").arg(trackId).arg(file));
+        return false;
+      }
+    }
+    std::optional<TrackArchive::SegmentView> view = result->archive->findSegment(segmentId);
+    if (!view) {
+      qWarning() << "Loading nodes for segment id" << segmentId << "from archive failed";
+      emit error(tr("Loading nodes for segment id %1 from archive failed").arg(segmentId));
+      return false;
+    }
+    result->segments.push_back(*view);
   }
-}
-
-// QSqlQuery::size() is not supported with SQLite.
-// But you can get the number of rows with a workaround
-// https://stackoverflow.com/questions/26495049/qsqlquery-size-always-returns-1
-int Storage::querySize(QSqlQuery &query)
-{
-  int initialPos = query.at();
-  int size = 0;
-  if (query.last()) {
-    size = query.at() + 1;
-  } else {
-    size = 0;
+  if (result->archive) {
+    archived = std::move(result);
   }
-  // Important to restore initial pos
-  query.seek(initialPos);
-  return size;
+  return true;
 }
 
-void Storage::loadTrackPoints(qint64 segmentId, gpx::TrackSegment &segment)
+bool Storage::loadLegacyTrackPoints(qint64 segmentId, gpx::TrackSegment &segment)
 {
   // QElapsedTimer timer;
   // timer.start();
-  QSqlQuery sql(db);
-  sql.prepare("SELECT CAST(STRFTIME('%s',`timestamp`, 'UTC') AS INTEGER) AS `timestamp`, `latitude`, `longitude`, `elevation`, `horiz_accuracy`, `vert_accuracy` FROM `track_point` WHERE segment_id = :segmentId;");
+  // timestamps may be stored as strings yet (schema older than v5)
+  auto sql = prepare(QString("SELECT ")
+                       .append("CASE WHEN typeof(`timestamp`) = 'text' THEN %1 ELSE `timestamp` END AS `timestamp`, ").arg(sqlTimeToMillis("timestamp"))
+                       .append("`latitude`, `longitude`, `elevation`, `horiz_accuracy`, `vert_accuracy` ")
+                       .append("FROM `track_point` WHERE segment_id = :segmentId ORDER BY `rowid`;"));
   sql.bindValue(":segmentId", segmentId);
   sql.exec();
   if (sql.lastError().isValid()) {
     qWarning() << "Loading nodes for segment id" << segmentId << "failed";
     emit error(tr("Loading nodes for segment id %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
-    return;
+    return false;
   }
 
   // qDebug() << "    segment" << segmentId << "sql:" << timer.elapsed() << "ms";
@@ -891,21 +2525,15 @@ void Storage::loadTrackPoints(qint64 segmentId, gpx::TrackSegment &segment)
     point.vdop = varToDoubleOpt(sql.value(iVertAcc));
   }
   // qDebug() << "    segment" << segmentId << "loading:" << timer.elapsed() << "ms";
+  return true;
 }
 
-bool Storage::loadTrackDataPrivate(Track &track, std::optional<double> accuracyFilter)
+bool Storage::loadTrackMetadata(Track &track)
 {
-  qDebug() << "Loading track data" << track.id;
-  QElapsedTimer timer;
-  timer.start();
-
-  QSqlQuery sqlTrack(db);
-  sqlTrack.prepare("SELECT * FROM `track` WHERE id = :trackId;");
+  auto sqlTrack = prepare("SELECT * FROM `track` WHERE id = :trackId;");
   sqlTrack.bindValue(":trackId", track.id);
   sqlTrack.exec();
 
-  // qDebug() << "  track sql" << track.id << ":" << timer.elapsed() << "ms";
-
   if (sqlTrack.lastError().isValid()) {
     qWarning() << "Loading track id" << track.id << "fails: " << sqlTrack.lastError();
     emit error(tr("Loading track id %1 fails").arg(track.id));
@@ -919,10 +2547,11 @@ bool Storage::loadTrackDataPrivate(Track &track, std::optional<double> accuracyF
   }
 
   track = makeTrack(sqlTrack);
-  // qDebug() << "  make track" << track.id << ":" << timer.elapsed() << "ms";
-
-  emit trackDataLoaded(track, accuracyFilter, false, true);
+  return true;
+}
 
+void Storage::initTrackData(Track &track)
+{
   track.data = std::make_shared<gpx::Track>();
 
   // duplicate some properties to data
@@ -934,9 +2563,38 @@ bool Storage::loadTrackDataPrivate(Track &track, std::optional<double> accuracyF
     track.data->type = track.type.toStdString();
   }
   track.data->displayColor = track.color;
+}
+
+bool Storage::loadTrackDataPrivate(Track &track, std::optional<double> accuracyFilter, bool progressive)
+{
+  qDebug() << "Loading track data" << track.id;
+  QElapsedTimer timer;
+  timer.start();
+
+  if (!loadTrackMetadata(track)) {
+    return false;
+  }
+  // qDebug() << "  make track" << track.id << ":" << timer.elapsed() << "ms";
+
+  emit trackDataLoaded(track, accuracyFilter, false, true);
+
+  if (!loadTrackSegments(track, accuracyFilter, progressive)) {
+    return false;
+  }
+  filterTrackData(track, accuracyFilter);
+
+  qDebug() << "  track" << track.id << "data loading:" << timer.elapsed() << "ms";
+  return true;
+}
+
+bool Storage::loadTrackSegments(Track &track, std::optional<double> accuracyFilter, bool progressive)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  initTrackData(track);
 
-  QSqlQuery sql(db);
-  sql.prepare("SELECT `id` FROM `track_segment` WHERE track_id = :trackId;");
+  auto sql = prepare("SELECT `id` FROM `track_segment` WHERE track_id = :trackId ORDER BY `id`;");
   sql.bindValue(":trackId", track.id);
   sql.exec();
 
@@ -944,58 +2602,237 @@ bool Storage::loadTrackDataPrivate(Track &track, std::optional<double> accuracyF
   if (sql.lastError().isValid()) {
     qWarning() << "Loading segments for track id" << track.id << "failed";
     emit error(tr("Loading segments for track id %1 failed: %2").arg(track.id).arg(sql.lastError().text()));
-  }else{
-    while (sql.next()) {
-      track.data->segments.emplace_back();
-      long segmentId = varToLong(sql.value("id"));
-      // qDebug() << "  track_segment " << segmentId << "before:" << timer.elapsed() << "ms";
-      loadTrackPoints(segmentId, track.data->segments.back());
-      // qDebug() << "  track_segment " << segmentId << "after:" << timer.elapsed() << "ms";
+    return false;
+  }
+
+  bool firstChunk = true;
+  while (sql.next()) {
+    track.data->segments.emplace_back();
+    int segmentIndex = int(track.data->segments.size()) - 1;
+    const gpx::TrackSegment &segment = track.data->segments.back();
+    long segmentId = varToLong(sql.value("id"));
+
+    ChunkCallback chunkLoaded;
+    qint64 emittedPoints = 0;
+    if (progressive) {
+      // copy of decoded chunk is emitted immediately, so consumers may render
+      // the track before all its segments are decoded
+      chunkLoaded = [&](size_t from) {
+        auto points = std::make_shared<std::vector<gpx::TrackPoint>>(segment.points.begin() + from, segment.points.end());
+        if (accuracyFilter) {
+          osmscout::gpx::FilterInaccuratePoints(*points, *accuracyFilter);
+        }
+        if (points->empty()) {
+          return;
+        }
+        if (firstChunk) {
+          qDebug() << "  track" << track.id << "first chunk:" << timer.elapsed() << "ms";
+          firstChunk = false;
+        }
+        qint64 offset = emittedPoints;
+        emittedPoints += qint64(points->size());
+        emit trackPointsLoaded(track.id, accuracyFilter, segmentIndex, offset, points);
+      };
+    }
+    // qDebug() << "  track_segment " << segmentId << "before:" << timer.elapsed() << "ms";
+    if (!loadTrackPoints(segmentId, track.data->segments.back(), chunkLoaded)) {
+      return false;
     }
+    // qDebug() << "  track_segment " << segmentId << "after:" << timer.elapsed() << "ms";
   }
+  return true;
+}
 
+void Storage::filterTrackData(Track &track, std::optional<double> accuracyFilter) const
+{
   if (accuracyFilter){
     track.data->FilterPoints([accuracyFilter](std::vector<osmscout::gpx::TrackPoint> &points){
       osmscout::gpx::FilterInaccuratePoints(points, *accuracyFilter);
     });
     track.statistics = computeTrackStatistics(*(track.data));
   }
+}
+
+void Storage::loadTrackDataCached(Track track,
+                                  std::optional<double> accuracyFilter,
+                                  const std::function<void(Track&, bool)> &result)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  if (!loadTrackMetadata(track)) {
+    result(track, false);
+    return;
+  }
+  emit trackDataLoaded(track, accuracyFilter, false, true);
+
+  // every consumer gets own copy of cached points, it may be modified by filter
+  auto finish = [this, accuracyFilter, result](Track track, const TrackDataCache::Data &data) {
+    if (!data) {
+      result(track, false);
+      return;
+    }
+    track.data = std::make_shared<gpx::Track>(*data);
+    filterTrackData(track, accuracyFilter);
+    result(track, true);
+  };
+
+  if (track.open) {
+    // points of open track are appended continuously, don't cache them
+    bool ok = loadTrackSegments(track, accuracyFilter, true);
+    filterTrackData(track, accuracyFilter);
+    result(track, ok);
+    return;
+  }
+
+  // points of archived track are read by consumers from the mapped archive,
+  // they are not copied to the cache, nor emitted progressively
+  std::shared_ptr<const ArchivedTrackData> archived;
+  if (!loadArchivedTrack(track.id, archived)) {
+    result(track, false);
+    return;
+  }
+  if (archived) {
+    track.archive = archived;
+    if (accuracyFilter) {
+      TrackStatisticsAccumulator acc;
+      for (const auto &view: archived->segments) {
+        view.visitBatches(accuracyFilter, [&acc](const std::vector<gpx::TrackPoint> &points) {
+          for (const auto &point: points) {
+            acc.update(point);
+          }
+        });
+        acc.segmentEnd();
+      }
+      track.statistics = acc.accumulate();
+    }
+    qDebug() << "  track" << track.id << "archive views:" << timer.elapsed() << "ms";
+    result(track, true);
+    return;
+  }
+
+  TrackDataCache::Key key = TrackDataCache::key(track.id, track.lastModification);
+  TrackDataCache::Data data;
+  switch (trackDataCache.acquire(key, data, [finish, track](const TrackDataCache::Data &data) { finish(track, data); })) {
+    case TrackDataCache::Lookup::Hit:
+      qDebug() << "  track" << track.id << "data from cache:" << timer.elapsed() << "ms";
+      finish(track, data);
+      return;
+    case TrackDataCache::Lookup::Pending:
+      return; // finish is called by the thread loading the same data
+    case TrackDataCache::Lookup::Load:
+      break;
+  }
 
+  bool ok = loadTrackSegments(track, accuracyFilter, true);
+  if (ok) {
+    data = std::move(track.data);
+  }
+  // notify waiters first, it is not necessary to wait for the filter
+  trackDataCache.finish(key, data);
   qDebug() << "  track" << track.id << "data loading:" << timer.elapsed() << "ms";
-  return true;
+  finish(track, data);
 }
 
 void Storage::loadTrackData(Track track, std::optional<double> accuracyFilter)
 {
-  if (!checkAccess(__FUNCTION__)){
+  dispatchRead(__FUNCTION__, [this, track, accuracyFilter]() {
+    loadTrackDataCached(track, accuracyFilter, [this, accuracyFilter](Track &track, bool ok) {
+      emit trackDataLoaded(track, accuracyFilter, true, ok);
+    });
+  }, [this, track, accuracyFilter](){
     emit trackDataLoaded(track, accuracyFilter, true, false);
-    return;
+  });
+}
+
+bool Storage::loadTrackLodPrivate(Track &track, int level)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  if (!loadTrackMetadata(track)) {
+    return false;
   }
+  initTrackData(track);
 
-  if (loadTrackDataPrivate(track, accuracyFilter)) {
-    emit trackDataLoaded(track, accuracyFilter, true, true);
-  }else{
-    emit trackDataLoaded(track, accuracyFilter, true, false);
+  auto sql = prepare("SELECT `id` FROM `track_segment` WHERE track_id = :trackId ORDER BY `id`;");
+  sql.execValues(track.id);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading segments for track id" << track.id << "failed";
+    emit error(tr("Loading segments for track id %1 failed: %2").arg(track.id).arg(sql.lastError().text()));
+    return false;
+  }
+
+  qint64 pointCount = 0;
+  while (sql.next()) {
+    qint64 segmentId = varToLong(sql.value(0));
+    track.data->segments.emplace_back();
+    gpx::TrackSegment &segment = track.data->segments.back();
+
+    auto sqlLod = prepare("SELECT `data` FROM `track_segment_lod` WHERE `segment_id` = :segmentId AND `level` = :level;");
+    sqlLod.execValues(segmentId, qint64(level));
+    if (sqlLod.lastError().isValid()) {
+      qWarning() << "Loading lod for segment id" << segmentId << "failed";
+      emit error(tr("Loading lod for segment id %1 failed: %2").arg(segmentId).arg(sqlLod.lastError().text()));
+      return false;
+    }
+    if (sqlLod.next()) {
+      if (!decodePoints(sqlLod.value(0).toByteArray(), segment.points)) {
+        qWarning() << "Decoding lod for segment id" << segmentId << "failed";
+        emit error(tr("Decoding lod for segment id %1 failed").arg(segmentId));
+        return false;
+      }
+    } else {
+      // open track, it is simplified on the fly
+      if (!loadTrackPoints(segmentId, segment)) {
+        return false;
+      }
+      segment.points = TrackSimplifier::simplify(segment.points, TrackSimplifier::Tolerances[level]);
+    }
+    pointCount += qint64(segment.points.size());
   }
+
+  qDebug() << "  track" << track.id << "lod" << level << "loading:" << timer.elapsed() << "ms," << pointCount << "points";
+  return true;
+}
+
+void Storage::loadTrackLod(Track track, int zoom)
+{
+  dispatchRead(__FUNCTION__, [this, track, zoom]() mutable {
+    int level = TrackSimplifier::levelForZoom(zoom);
+    if (level < 0) {
+      loadTrackDataCached(track, std::nullopt, [this, zoom](Track &track, bool ok) {
+        emit trackLodLoaded(track, zoom, ok);
+      });
+      return;
+    }
+    bool result = loadTrackLodPrivate(track, level);
+    emit trackLodLoaded(track, zoom, result);
+  }, [this, track, zoom](){
+    emit trackLodLoaded(track, zoom, false);
+  });
+}
+
+void Storage::flushCaches(qint64 idleMs)
+{
+  trackDataCache.flush(std::chrono::milliseconds(idleMs));
 }
 
 void Storage::updateOrCreateCollection(Collection collection)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionsLoaded(std::vector<Collection>(), false);
+    emit collectionsLoaded(std::make_shared<const std::vector<Collection>>(), false);
     return;
   }
 
-  QSqlQuery sql(db);
+  auto sql = prepare(collection.id < 0 ?
+    "INSERT INTO `collection` (`name`, `description`, `visible`) VALUES (:name, :description, :visible);" :
+    "UPDATE `collection` SET `name` = :name, `description` = :description, `visible` = :visible WHERE (`id` = :id);");
   if (collection.id < 0){
-    sql.prepare(
-      "INSERT INTO `collection` (`name`, `description`, `visible`) VALUES (:name, :description, :visible);");
     sql.bindValue(":name", collection.name);
     sql.bindValue(":description", collection.description);
     sql.bindValue(":visible", collection.visible);
   }else {
-    sql.prepare(
-      "UPDATE `collection` SET `name` = :name, `description` = :description, `visible` = :visible WHERE (`id` = :id);");
     sql.bindValue(":id", collection.id);
     sql.bindValue(":name", collection.name);
     sql.bindValue(":description", collection.description);
@@ -1017,19 +2854,17 @@ void Storage::updateOrCreateCollection(Collection collection)
   }
 
   loadCollections();
-  loadCollectionDetails(Collection(collection.id));
+  collectionModified(collection.id);
 }
 
 void Storage::deleteCollection(qint64 id)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionsLoaded(std::vector<Collection>(), false);
+    emit collectionsLoaded(std::make_shared<const std::vector<Collection>>(), false);
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare(
-    "DELETE FROM `collection` WHERE (`id` = :id)");
+  auto sql = prepare("DELETE FROM `collection` WHERE (`id` = :id)");
   sql.bindValue(":id", id);
   sql.exec();
   if (sql.lastError().isValid()){
@@ -1045,12 +2880,11 @@ void Storage::deleteCollection(qint64 id)
 void Storage::visibleAll(qint64 id, bool value)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionsLoaded(std::vector<Collection>(), false);
+    emit collectionsLoaded(std::make_shared<const std::vector<Collection>>(), false);
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("UPDATE `track` SET `visible` = :value WHERE (`collection_id` = :id)");
+  auto sql = prepare("UPDATE `track` SET `visible` = :value WHERE (`collection_id` = :id)");
   sql.bindValue(":id", id);
   sql.bindValue(":value", value ? 1 : 0);
   sql.exec();
@@ -1059,13 +2893,13 @@ void Storage::visibleAll(qint64 id, bool value)
     emit error(tr("Updating visibility of tracks failed: %1").arg(sql.lastError().text()));
   }
 
-  sql.prepare("UPDATE `waypoint` SET `visible` = :value WHERE (`collection_id` = :id)");
-  sql.bindValue(":id", id);
-  sql.bindValue(":value", value ? 1 : 0);
-  sql.exec();
-  if (sql.lastError().isValid()){
-    qWarning() << "Updating visibility of waypoints failed: " << sql.lastError();
-    emit error(tr("Updating visibility of waypoints failed: %1").arg(sql.lastError().text()));
+  auto sqlWpt = prepare("UPDATE `waypoint` SET `visible` = :value WHERE (`collection_id` = :id)");
+  sqlWpt.bindValue(":id", id);
+  sqlWpt.bindValue(":value", value ? 1 : 0);
+  sqlWpt.exec();
+  if (sqlWpt.lastError().isValid()){
+    qWarning() << "Updating visibility of waypoints failed: " << sqlWpt.lastError();
+    emit error(tr("Updating visibility of waypoints failed: %1").arg(sqlWpt.lastError().text()));
   }
 
   loadCollections();
@@ -1074,12 +2908,11 @@ void Storage::visibleAll(qint64 id, bool value)
 void Storage::waypointVisibility(qint64 wptId, bool visible)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionsLoaded(std::vector<Collection>(), false);
+    emit collectionsLoaded(std::make_shared<const std::vector<Collection>>(), false);
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("UPDATE `waypoint` SET `visible` = :value WHERE (`id` = :id)");
+  auto sql = prepare("UPDATE `waypoint` SET `visible` = :value WHERE (`id` = :id)");
   sql.bindValue(":id", wptId);
   sql.bindValue(":value", visible ? 1 : 0);
   sql.exec();
@@ -1088,17 +2921,17 @@ void Storage::waypointVisibility(qint64 wptId, bool visible)
     emit error(tr("Updating visibility of waypoint failed: %1").arg(sql.lastError().text()));
   }
 
-  sql.prepare("SELECT `collection_id` FROM `waypoint` WHERE (`id` = :id)");
-  sql.bindValue(":id", wptId);
-  sql.exec();
-  if (sql.lastError().isValid()){
-    qWarning() << "Waypoint select failed: " << sql.lastError();
-    emit error(tr("Waypoint select failed: %1").arg(sql.lastError().text()));
+  auto sqlSelect = prepare("SELECT `collection_id` FROM `waypoint` WHERE (`id` = :id)");
+  sqlSelect.bindValue(":id", wptId);
+  sqlSelect.exec();
+  if (sqlSelect.lastError().isValid()){
+    qWarning() << "Waypoint select failed: " << sqlSelect.lastError();
+    emit error(tr("Waypoint select failed: %1").arg(sqlSelect.lastError().text()));
   }
 
-  if (sql.next()) {
-    long id = varToLong(sql.value("collection_id"));
-    loadCollectionDetails(Collection(id));
+  if (sqlSelect.next()) {
+    long id = varToLong(sqlSelect.value("collection_id"));
+    collectionModified(id);
   }
   loadCollections();
 }
@@ -1106,12 +2939,11 @@ void Storage::waypointVisibility(qint64 wptId, bool visible)
 void Storage::trackVisibility(qint64 trackId, bool visible)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionsLoaded(std::vector<Collection>(), false);
+    emit collectionsLoaded(std::make_shared<const std::vector<Collection>>(), false);
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("UPDATE `track` SET `visible` = :value WHERE (`id` = :id)");
+  auto sql = prepare("UPDATE `track` SET `visible` = :value WHERE (`id` = :id)");
   sql.bindValue(":id", trackId);
   sql.bindValue(":value", visible ? 1 : 0);
   sql.exec();
@@ -1120,77 +2952,21 @@ void Storage::trackVisibility(qint64 trackId, bool visible)
     emit error(tr("Updating visibility of track failed: %1").arg(sql.lastError().text()));
   }
 
-  sql.prepare("SELECT `collection_id` FROM `track` WHERE (`id` = :id)");
-  sql.bindValue(":id", trackId);
-  sql.exec();
-  if (sql.lastError().isValid()){
-    qWarning() << "Track select failed: " << sql.lastError();
-    emit error(tr("Track select failed: %1").arg(sql.lastError().text()));
+  auto sqlSelect = prepare("SELECT `collection_id` FROM `track` WHERE (`id` = :id)");
+  sqlSelect.bindValue(":id", trackId);
+  sqlSelect.exec();
+  if (sqlSelect.lastError().isValid()){
+    qWarning() << "Track select failed: " << sqlSelect.lastError();
+    emit error(tr("Track select failed: %1").arg(sqlSelect.lastError().text()));
   }
 
-  if (sql.next()) {
-    long id = varToLong(sql.value("collection_id"));
-    loadCollectionDetails(Collection(id));
+  if (sqlSelect.next()) {
+    long id = varToLong(sqlSelect.value("collection_id"));
+    collectionModified(id);
   }
   loadCollections();
 }
 
-bool Storage::importWaypoints(const gpx::GpxFile &gpxFile, qint64 collectionId)
-{
-  using namespace std::string_literals;
-
-  int wptNum = 0;
-  db.transaction();
-  QSqlQuery sqlWpt(db);
-  sqlWpt.prepare(
-    "INSERT INTO `waypoint` (`collection_id`, `timestamp`, `modification_time`, `latitude`, `longitude`, `elevation`, `name`, `description`, `symbol`, `visible`) "
-    "VALUES                 (:collection_id,  :timestamp,  :modification_time,  :latitude,  :longitude,  :elevation,  :name,  :description,  :symbol, :visible)");
-  for (const auto &wpt: gpxFile.waypoints) {
-    wptNum++;
-
-    QString wptName = QString::fromStdString(wpt.name.value_or(""s));
-    if (wptName.isEmpty())
-      wptName = tr("waypoint %1").arg(wptNum);
-
-    sqlWpt.bindValue(":collection_id", collectionId);
-    sqlWpt.bindValue(":timestamp", dateTimeToSQL(timestampToDateTime(wpt.time)));
-    sqlWpt.bindValue(":modification_time", dateTimeToSQL(QDateTime::currentDateTime()));
-    sqlWpt.bindValue(":latitude", wpt.coord.GetLat());
-    sqlWpt.bindValue(":longitude", wpt.coord.GetLon());
-    sqlWpt.bindValue(":elevation", (wpt.elevation ? *wpt.elevation : QVariant()));
-    sqlWpt.bindValue(":name", wptName);
-    sqlWpt.bindValue(":description",
-                     (wpt.description ? QString::fromStdString(*wpt.description) : QVariant()));
-    sqlWpt.bindValue(":symbol", (wpt.symbol ? QString::fromStdString(*wpt.symbol) : QVariant()));
-    sqlWpt.bindValue(":visible", true);
-
-    sqlWpt.exec();
-    if (sqlWpt.lastError().isValid()) {
-      qWarning() << "Import of waypoints failed" << sqlWpt.lastError();
-      emit error(tr("Import of waypoints failed: %1").arg(sqlWpt.lastError().text()));
-      if (!db.rollback()) {
-        qWarning() << "Transaction rollback failed" << db.lastError();
-      }
-      return false;
-    }
-    // commit batch WayPointBatchSize queries
-    if (wptNum % WayPointBatchSize == 0) {
-      if (!db.commit()) {
-        emit error(tr("Transaction commit failed: %1").arg(db.lastError().text()));
-        qWarning() << "Transaction commit failed" << db.lastError();
-        return false;
-      }
-      db.transaction();
-    }
-  }
-  if (!db.commit()) {
-    emit error(tr("Transaction commit failed: %1").arg(db.lastError().text()));
-    qWarning() << "Transaction commit failed" << db.lastError();
-    return false;
-  }
-  return true;
-}
-
 TrackStatisticsAccumulator::TrackStatisticsAccumulator(const TrackStatistics &statistics):
   // duration accumulator
   from{dateTimeToTimestampOpt(statistics.from)},
@@ -1321,6 +3097,69 @@ TrackStatistics TrackStatisticsAccumulator::accumulate() const
     bbox);
 }
 
+TrackStatistics TrackStatistics::merge(const std::vector<TrackStatistics> &segments)
+{
+  QDateTime from;
+  QDateTime to;
+  Distance distance;
+  Distance rawDistance;
+  Timestamp::duration movingDuration{0};
+  double maxSpeed{0};
+  Distance ascent;
+  Distance descent;
+  std::optional<Distance> minElevation;
+  std::optional<Distance> maxElevation;
+  GeoBox bbox;
+
+  for (const auto &segment: segments){
+    if (!from.isValid()){
+      from = segment.from;
+    }
+    if (segment.to.isValid()){
+      to = segment.to;
+    }
+    distance += segment.distance;
+    rawDistance += segment.rawDistance;
+    movingDuration += segment.movingDuration;
+    maxSpeed = std::max(maxSpeed, segment.maxSpeed);
+    ascent += segment.ascent;
+    descent += segment.descent;
+    if (segment.minElevation){
+      minElevation = minElevation ? std::min(*minElevation, *segment.minElevation) : *segment.minElevation;
+    }
+    if (segment.maxElevation){
+      maxElevation = maxElevation ? std::max(*maxElevation, *segment.maxElevation) : *segment.maxElevation;
+    }
+    if (segment.bbox.IsValid()){
+      bbox.Include(segment.bbox);
+    }
+  }
+
+  Timestamp::duration duration{0};
+  if (from.isValid() && to.isValid()){
+    duration = std::chrono::milliseconds(from.msecsTo(to));
+  }
+
+  double durationInSeconds = durationSeconds(duration);
+  double movingDurationInSeconds = durationSeconds(movingDuration);
+
+  return TrackStatistics(
+    from,
+    to,
+    distance,
+    rawDistance,
+    duration,
+    movingDuration,
+    maxSpeed,
+    /*averageSpeed*/ durationInSeconds == 0 ? -1 : distance.AsMeter() / durationInSeconds,
+    /*movingAverageSpeed*/ movingDurationInSeconds == 0 ? -1 : distance.AsMeter() / movingDurationInSeconds,
+    ascent,
+    descent,
+    minElevation,
+    maxElevation,
+    bbox);
+}
+
 TrackStatistics Storage::computeTrackStatistics(const gpx::Track &trk) const
 {
   QElapsedTimer timer;
@@ -1341,11 +3180,9 @@ TrackStatistics Storage::computeTrackStatistics(const gpx::Track &trk) const
   return acc.accumulate();
 }
 
-QSqlQuery Storage::trackInsertSql()
+StatementCache::Statement Storage::trackInsertSql()
 {
-  QSqlQuery sqlTrk(db);
-
-  sqlTrk.prepare(QString("INSERT INTO `track` (")
+  return prepare(QString("INSERT INTO `track` (")
                    .append("`collection_id`, `name`, `description`, `open`, `creation_time`, `modification_time`, ")
                    .append("`color`, `type`, `visible`, ")
                    .append("`from_time`, ")
@@ -1381,8 +3218,6 @@ QSqlQuery Storage::trackInsertSql()
                    .append(":max_elevation, ")
                    .append(":bboxMinLat, :bboxMinLon, :bboxMaxLat, :bboxMaxLon")
                    .append(")"));
-
-  return sqlTrk;
 }
 
 void Storage::prepareTrackInsert(QSqlQuery &sqlTrk,
@@ -1428,127 +3263,128 @@ void Storage::prepareTrackInsert(QSqlQuery &sqlTrk,
   sqlTrk.bindValue(":bboxMaxLon", stat.bbox.IsValid() ? stat.bbox.GetMaxLon() : -1000);
 }
 
-bool Storage::importTracks(const gpx::GpxFile &gpxFile, qint64 collectionId)
+bool Storage::importTrackPoints(const std::vector<gpx::TrackPoint> &points, qint64 segmentId)
 {
-  using namespace std::string_literals;
-
-  int trkNum = 0;
-  QSqlQuery sqlTrk=trackInsertSql();
-
-  QSqlQuery sqlSeg(db);
-  sqlSeg.prepare("INSERT INTO `track_segment` (`track_id`, `open`, `creation_time`, `distance`) VALUES (:track_id, :open, :creation_time, :distance)");
-
-  for (const auto &trk: gpxFile.tracks){
-    trkNum++;
-
-    QString trackName = QString::fromStdString(trk.name.value_or(""s));
-    if (trackName.isEmpty())
-      trackName = tr("track %1").arg(trkNum);
-
-    TrackStatistics stat = computeTrackStatistics(trk);
-    QStringOpt desc = trk.desc ?
-                      QStringOpt(QString::fromStdString(*trk.desc)) :
-                      std::nullopt;
+  if (points.empty()){
+    return true;
+  }
 
+  db.transaction();
+  if (!appendTrackPoints(points, segmentId)) {
+    if (!db.rollback()) {
+      qWarning() << "Transaction rollback failed" << db.lastError();
+    }
+    return false;
+  }
 
-    QString type = trk.type.has_value() ? QString::fromStdString(*trk.type) : QString();
-    prepareTrackInsert(sqlTrk, collectionId, trackName, desc,
-                       trk.displayColor, type, true,
-                       stat, false);
+  if (!db.commit()) {
+    emit error(tr("Transaction commit failed: %1").arg(db.lastError().text()));
+    qWarning() << "Transaction commit failed" << db.lastError();
+    return false;
+  }
+  return true;
+}
 
-    sqlTrk.exec();
-    if (sqlTrk.lastError().isValid()) {
-      qWarning() << "Import of tracks failed" << sqlTrk.lastError();
-      emit error(tr("Import of tracks failed: %1").arg(sqlTrk.lastError().text()));
-      return false;
-    }
+bool Storage::appendTrackPoints(const std::vector<gpx::TrackPoint> &points, qint64 segmentId)
+{
+  if (points.empty()){
+    return true;
+  }
 
-    qint64 trackId = varToLong(sqlTrk.lastInsertId());
+  // levels of detail and statistics are not valid anymore, they are built again when the track is closed
+  // or when they are requested
+  if (!deleteSegmentLods(segmentId) || !deleteSegmentStatistics(segmentId)) {
+    return false;
+  }
 
-    for (auto const &seg: trk.segments){
-      sqlSeg.bindValue(":track_id", trackId);
-      sqlSeg.bindValue(":open", false);
+  // chunk numbers are increasing with first_point
+  auto sqlLast = prepare("SELECT `chunk`, `first_point`, `point_count`, `data` FROM `track_segment_data` WHERE `segment_id` = :segmentId ORDER BY `first_point` DESC LIMIT 1;");
+  sqlLast.execValues(segmentId);
+  if (sqlLast.lastError().isValid()) {
+    qWarning() << "Import of track points failed" << sqlLast.lastError();
+    emit error(tr("Import of track points failed: %1").arg(sqlLast.lastError().text()));
+    return false;
+  }
 
-      // TODO: do we need segment statics?
-      sqlSeg.bindValue(":creation_time", dateTimeToSQL(QDateTime::currentDateTime()));
-      sqlSeg.bindValue(":distance", seg.GetLength().AsMeter());
-      sqlSeg.exec();
-      if (sqlSeg.lastError().isValid()) {
-        qWarning() << "Import of segments failed" << sqlSeg.lastError();
-        emit error(tr("Import of segments failed: %1").arg(sqlSeg.lastError().text()));
+  size_t imported = 0;
+  qint64 nextChunk = 0;
+  qint64 nextPoint = 0;
+  if (sqlLast.next()) {
+    qint64 lastChunk = varToLong(sqlLast.value("chunk"));
+    qint64 pointCount = varToLong(sqlLast.value("point_count"));
+    nextChunk = lastChunk + 1;
+    nextPoint = varToLong(sqlLast.value("first_point")) + pointCount;
+    if (pointCount < TrackPointChunkSize) {
+      // fill up the last chunk
+      std::vector<gpx::TrackPoint> chunkPoints;
+      if (!decodePoints(sqlLast.value("data").toByteArray(), chunkPoints)) {
+        qWarning() << "Decoding nodes for segment id" << segmentId << "failed";
+        emit error(tr("Decoding nodes for segment id %1 failed").arg(segmentId));
         return false;
       }
-      qint64 segmentId = varToLong(sqlSeg.lastInsertId());
+      imported = std::min(points.size(), size_t(TrackPointChunkSize - pointCount));
+      nextPoint += qint64(imported);
+      chunkPoints.insert(chunkPoints.end(), points.begin(), points.begin() + imported);
 
-      if (!importTrackPoints(seg.points, segmentId)){
-        qWarning() << "Import of track points failed" << sqlSeg.lastError();
-        emit error(tr("Import of track points failed: %1").arg(sqlSeg.lastError().text()));
+      auto sqlUpdate = prepare("UPDATE `track_segment_data` SET `point_count` = :point_count, `data` = :data WHERE `segment_id` = :segment_id AND `chunk` = :chunk");
+      sqlUpdate.execValues(qint64(chunkPoints.size()), TrackPointCodec::encode(chunkPoints), segmentId, lastChunk);
+      if (sqlUpdate.lastError().isValid()) {
+        qWarning() << "Import of track points failed" << sqlUpdate.lastError();
+        emit error(tr("Import of track points failed: %1").arg(sqlUpdate.lastError().text()));
         return false;
       }
-      qDebug() << "Imported" << seg.points.size() << "points to segment" << segmentId << "for track" << trackId;
     }
-    qDebug() << "Imported track " << trackId;
   }
-  return true;
+
+  return insertTrackPointChunks(points, imported, segmentId, nextChunk, nextPoint);
 }
 
-bool Storage::importTrackPoints(const std::vector<gpx::TrackPoint> &points, qint64 segmentId)
+bool Storage::insertTrackPointChunks(const std::vector<gpx::TrackPoint> &points,
+                                     size_t from,
+                                     qint64 segmentId,
+                                     qint64 firstChunk,
+                                     qint64 firstPoint)
 {
-  if (points.empty()){
-    return true;
-  }
-
-  size_t pointNum = 0;
-  db.transaction();
-  QSqlQuery sql(db);
-  sql.prepare(QString("INSERT INTO `track_point` ")
-               .append("(`segment_id`, `timestamp`, `latitude`, `longitude`, `elevation`, `horiz_accuracy`, `vert_accuracy`) ")
+  auto sql = prepare(QString("INSERT INTO `track_segment_data` ")
+               .append("(`segment_id`, `chunk`, `first_point`, `point_count`, `data`) ")
                .append("VALUES ")
-               .append("(:segment_id, :timestamp, :latitude, :longitude, :elevation, :horiz_accuracy, :vert_accuracy)"));
-
-  for (const auto &point: points){
-    pointNum ++;
+               .append("(:segment_id, :chunk, :first_point, :point_count, :data)"));
 
-    sql.bindValue(":segment_id", segmentId);
-    sql.bindValue(":timestamp", dateTimeToSQL(timestampToDateTime(point.time)));
-    sql.bindValue(":latitude", point.coord.GetLat());
-    sql.bindValue(":longitude", point.coord.GetLon());
-    sql.bindValue(":elevation", point.elevation.has_value() ? *point.elevation : QVariant());
-    // read TrackPoint notes
-    sql.bindValue(":horiz_accuracy", point.hdop.has_value() ? *point.hdop : QVariant());
-    sql.bindValue(":vert_accuracy", point.vdop.has_value() ? *point.vdop : QVariant());
-
-    sql.exec();
+  qint64 chunk = firstChunk;
+  for (size_t i = from; i < points.size(); i += TrackPointChunkSize, chunk++){
+    size_t to = std::min(points.size(), i + TrackPointChunkSize);
+    sql.execValues(segmentId, chunk, firstPoint + qint64(i - from), qint64(to - i), TrackPointCodec::encode(points, i, to));
     if (sql.lastError().isValid()) {
       qWarning() << "Import of track points failed" << sql.lastError();
       emit error(tr("Import of track points failed: %1").arg(sql.lastError().text()));
-      if (!db.rollback()) {
-        qWarning() << "Transaction rollback failed" << db.lastError();
-      }
       return false;
     }
-    // commit batch TrackPointBatchSize queries
-    if (pointNum % TrackPointBatchSize == 0) {
-      if (!db.commit()) {
-        emit error(tr("Transaction commit failed: %1").arg(db.lastError().text()));
-        qWarning() << "Transaction commit failed" << db.lastError();
-        return false;
-      }
-      db.transaction();
-    }
   }
-  if (!db.commit()) {
-    emit error(tr("Transaction commit failed: %1").arg(db.lastError().text()));
-    qWarning() << "Transaction commit failed" << db.lastError();
-    return false;
+  return true;
+}
+
+bool Storage::storeTrackPoints(const std::vector<gpx::TrackPoint> &points, qint64 segmentId)
+{
+  for (const QString &table: {QString("track_segment_data"), QString("track_point")}) {
+    auto sql = prepare(QString("DELETE FROM `%1` WHERE `segment_id` = :segmentId").arg(table));
+    sql.bindValue(":segmentId", segmentId);
+    sql.exec();
+    if (sql.lastError().isValid()) {
+      qWarning() << "Deleting points of segment" << segmentId << "failed: " << sql.lastError();
+      emit error(tr("Deleting points of segment %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+      return false;
+    }
   }
-  return true;
+
+  return insertTrackPointChunks(points, 0, segmentId, 0, 0) &&
+         storeSegmentLods(segmentId, encodeSegmentLods(points)) &&
+         storeSegmentStatistics(segmentId, computeSegmentStatistics(points));
 }
 
 void Storage::importCollection(QString filePath)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionsLoaded(std::vector<Collection>(), false);
+    emit collectionsLoaded(std::make_shared<const std::vector<Collection>>(), false);
     return;
   }
 
@@ -1556,75 +3392,208 @@ void Storage::importCollection(QString filePath)
   timer.start();
   qDebug() << "Importing collection from" << filePath;
 
-  gpx::GpxFile gpxFile;
-  std::shared_ptr<ErrorCallback> callback = std::make_shared<ErrorCallback>();
-  connect(callback.get(), &ErrorCallback::error, this, &Storage::error);
-
-  if (!gpx::ImportGpx(filePath.toStdString(),
-                      gpxFile,
-                      nullptr,
-                      std::static_pointer_cast<gpx::ProcessCallback, ErrorCallback>(callback))){
-
-    qWarning() << "Gpx import failed " << filePath;
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning() << "Cannot open" << filePath << file.errorString();
+    emit error(tr("Cannot open file %1: %2").arg(filePath).arg(file.errorString()));
     loadCollections();
     return;
   }
 
-  // import collection
-  QSqlQuery sql(db);
-  sql.prepare("INSERT INTO `collection` (`name`, `description`, `visible`) VALUES (:name, :description, 0);");
-  sql.bindValue(":name", gpxFile.name.has_value() ?
-                         QString::fromStdString(*gpxFile.name) : QFileInfo(filePath).baseName());
-  sql.bindValue(":description", gpxFile.desc.has_value() && !gpxFile.desc->empty() ?
-                                QString::fromStdString(*gpxFile.desc) :
-                                tr("Imported from %1").arg(filePath));
+  // file is parsed and track statistics computed in pipeline threads, records are written here.
+  // Memory usage is limited by queue capacities and by the simplified levels
+  // of the current segment, that are stored on segment end (see GpxImportPipeline)
+  GpxImportPipeline pipeline(&file, TrackPointChunkSize);
+  pipeline.start();
 
-  sql.exec();
-  if (sql.lastError().isValid()){
-    qWarning() << "Creating collection failed" << sql.lastError();
-    emit error(tr("Creating collection failed: %1").arg(sql.lastError().text()));
-    loadCollections();
-    return;
+  GpxImportPipeline::StageStatistics writeStage{"write"};
+  GpxImportState state;
+  state.filePath = filePath;
+  bool imported = db.transaction();
+  GpxImportRecord record;
+  while (imported && pipeline.pop(record)) {
+    writeStage.items++;
+    imported = importRecord(state, record);
   }
-  qint64 collectionId = varToLong(sql.lastInsertId());
-  if (collectionId < 0){
-    qWarning() << "Invalid collection id" << collectionId;
-    emit error(tr("Invalid collection id: %1").arg(collectionId));
-    loadCollections();
-    return;
+  if (!imported) {
+    pipeline.abort();
   }
+  bool parsed = pipeline.join();
+  writeStage.points = state.pointCount;
+  writeStage.activeNs = timer.nsecsElapsed() - pipeline.writeWaitNs();
 
-  // import waypoints
-  if (!gpxFile.waypoints.empty()) {
-    if (!importWaypoints(gpxFile, collectionId)){
-      loadCollections();
-      return;
-    }
+  if (imported && !parsed) {
+    qWarning() << "Gpx import failed" << filePath << pipeline.errorString();
+    emit error(tr("Import of %1 failed: %2").arg(filePath).arg(pipeline.errorString()));
+    imported = false;
   }
-  qDebug() << "Imported" << gpxFile.waypoints.size() << "waypoints to collection" << collectionId << "from" << filePath;
-
-  // import tracks
-  if (!gpxFile.tracks.empty()) {
-    if (!importTracks(gpxFile, collectionId)){
-      loadCollections();
-      return;
+  if (imported && !db.commit()) {
+    qWarning() << "Transaction commit failed" << db.lastError();
+    emit error(tr("Transaction commit failed: %1").arg(db.lastError().text()));
+    imported = false;
+  }
+  if (!imported) {
+    if (!db.rollback()) {
+      qWarning() << "Transaction rollback failed" << db.lastError();
     }
+    loadCollections();
+    return;
   }
-  qDebug() << "Imported" << gpxFile.tracks.size() << "tracks to collection" << collectionId
+
+  qDebug() << "Imported" << state.waypointCount << "waypoints and" << state.trackCount << "tracks"
+           << "(" << state.pointCount << "points) to collection" << state.collectionId
            << "from" << filePath << "in" << timer.elapsed() << "ms";
+  qDebug() << "Import throughput" << pipeline.parseStage() << "|" << pipeline.statisticsStage() << "|" << writeStage;
 
   loadCollections();
 }
 
+bool Storage::importRecord(GpxImportState &state, GpxImportRecord &record)
+{
+  using namespace std::string_literals;
+  using Type = GpxImportRecord::Type;
+
+  switch (record.type) {
+    case Type::Metadata: {
+      auto sql = prepare("INSERT INTO `collection` (`name`, `description`, `visible`) VALUES (:name, :description, 0);");
+      sql.bindValue(":name", record.item.name.has_value() && !record.item.name->empty() ?
+                             QString::fromStdString(*record.item.name) : QFileInfo(state.filePath).baseName());
+      sql.bindValue(":description", record.item.desc.has_value() && !record.item.desc->empty() ?
+                                    QString::fromStdString(*record.item.desc) :
+                                    tr("Imported from %1").arg(state.filePath));
+      sql.exec();
+      if (sql.lastError().isValid()){
+        qWarning() << "Creating collection failed" << sql.lastError();
+        emit error(tr("Creating collection failed: %1").arg(sql.lastError().text()));
+        return false;
+      }
+      state.collectionId = varToLong(sql.lastInsertId());
+      if (state.collectionId < 0){
+        qWarning() << "Invalid collection id" << state.collectionId;
+        emit error(tr("Invalid collection id: %1").arg(state.collectionId));
+        return false;
+      }
+      return true;
+    }
+
+    case Type::Waypoint: {
+      assert(record.item.waypoint.has_value());
+      const gpx::Waypoint &wpt = *record.item.waypoint;
+      state.waypointCount++;
+
+      QString wptName = QString::fromStdString(wpt.name.value_or(""s));
+      if (wptName.isEmpty())
+        wptName = tr("waypoint %1").arg(state.waypointCount);
+
+      auto sqlWpt = prepare(
+        "INSERT INTO `waypoint` (`collection_id`, `timestamp`, `modification_time`, `latitude`, `longitude`, `elevation`, `name`, `description`, `symbol`, `visible`) "
+        "VALUES                 (:collection_id,  :timestamp,  :modification_time,  :latitude,  :longitude,  :elevation,  :name,  :description,  :symbol, :visible)");
+      sqlWpt.bindValue(":collection_id", state.collectionId);
+      sqlWpt.bindValue(":timestamp", timestampToSQL(wpt.time));
+      sqlWpt.bindValue(":modification_time", dateTimeToSQL(QDateTime::currentDateTime()));
+      sqlWpt.bindValue(":latitude", wpt.coord.GetLat());
+      sqlWpt.bindValue(":longitude", wpt.coord.GetLon());
+      sqlWpt.bindValue(":elevation", (wpt.elevation ? *wpt.elevation : QVariant()));
+      sqlWpt.bindValue(":name", wptName);
+      sqlWpt.bindValue(":description",
+                       (wpt.description ? QString::fromStdString(*wpt.description) : QVariant()));
+      sqlWpt.bindValue(":symbol", (wpt.symbol ? QString::fromStdString(*wpt.symbol) : QVariant()));
+      sqlWpt.bindValue(":visible", true);
+      sqlWpt.exec();
+      if (sqlWpt.lastError().isValid()) {
+        qWarning() << "Import of waypoints failed" << sqlWpt.lastError();
+        emit error(tr("Import of waypoints failed: %1").arg(sqlWpt.lastError().text()));
+        return false;
+      }
+      return true;
+    }
+
+    case Type::TrackStart: {
+      state.trackCount++;
+
+      QString trackName = QString::fromStdString(record.item.name.value_or(""s));
+      if (trackName.isEmpty())
+        trackName = tr("track %1").arg(state.trackCount);
+
+      QStringOpt desc = record.item.desc ?
+                        QStringOpt(QString::fromStdString(*record.item.desc)) :
+                        std::nullopt;
+      QString type = record.item.trackType.has_value() ? QString::fromStdString(*record.item.trackType) : QString();
+
+      // statistics are not known yet, they are updated on track end
+      auto sqlTrk = trackInsertSql();
+      prepareTrackInsert(sqlTrk, state.collectionId, trackName, desc,
+                         record.item.color, type, true,
+                         TrackStatistics(), false);
+      sqlTrk.exec();
+      if (sqlTrk.lastError().isValid()) {
+        qWarning() << "Import of tracks failed" << sqlTrk.lastError();
+        emit error(tr("Import of tracks failed: %1").arg(sqlTrk.lastError().text()));
+        return false;
+      }
+      state.trackId = varToLong(sqlTrk.lastInsertId());
+      return true;
+    }
+
+    case Type::SegmentStart: {
+      auto sqlSeg = prepare("INSERT INTO `track_segment` (`track_id`, `open`, `creation_time`, `distance`) VALUES (:track_id, :open, :creation_time, :distance)");
+      sqlSeg.bindValue(":track_id", state.trackId);
+      sqlSeg.bindValue(":open", false);
+      sqlSeg.bindValue(":creation_time", dateTimeToSQL(QDateTime::currentDateTime()));
+      sqlSeg.bindValue(":distance", 0);
+      sqlSeg.exec();
+      if (sqlSeg.lastError().isValid()) {
+        qWarning() << "Import of segments failed" << sqlSeg.lastError();
+        emit error(tr("Import of segments failed: %1").arg(sqlSeg.lastError().text()));
+        return false;
+      }
+      state.segmentId = varToLong(sqlSeg.lastInsertId());
+      return true;
+    }
+
+    case Type::Points: {
+      auto sql = prepare(QString("INSERT INTO `track_segment_data` ")
+                   .append("(`segment_id`, `chunk`, `first_point`, `point_count`, `data`) ")
+                   .append("VALUES ")
+                   .append("(:segment_id, :chunk, :first_point, :point_count, :data)"));
+      sql.execValues(state.segmentId, record.chunkIndex, record.firstPoint, record.chunkPointCount, record.chunk);
+      if (sql.lastError().isValid()) {
+        qWarning() << "Import of track points failed" << sql.lastError();
+        emit error(tr("Import of track points failed: %1").arg(sql.lastError().text()));
+        return false;
+      }
+      state.pointCount += record.chunkPointCount;
+      return true;
+    }
+
+    case Type::SegmentEnd: {
+      auto sqlSeg = prepare("UPDATE `track_segment` SET `distance` = :distance WHERE `id` = :id");
+      sqlSeg.execValues(record.segmentLength.AsMeter(), state.segmentId);
+      if (sqlSeg.lastError().isValid()) {
+        qWarning() << "Import of segments failed" << sqlSeg.lastError();
+        emit error(tr("Import of segments failed: %1").arg(sqlSeg.lastError().text()));
+        return false;
+      }
+      qDebug() << "Imported segment" << state.segmentId << "for track" << state.trackId;
+      return storeSegmentLods(state.segmentId, record.lods) &&
+             storeSegmentStatistics(state.segmentId, record.statistics);
+    }
+
+    case Type::TrackEnd:
+      qDebug() << "Imported track " << state.trackId;
+      return updateTrackStatistics(state.trackId, record.statistics);
+  }
+  return true;
+}
+
 void Storage::deleteWaypoint(qint64 collectionId, qint64 waypointId)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionDetailsLoaded(Collection(collectionId), false);
+    emit collectionDetailsLoaded(std::make_shared<const Collection>(collectionId), false);
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("DELETE FROM `waypoint` WHERE `id` = :id AND `collection_id` = :collection_id;");
+  auto sql = prepare("DELETE FROM `waypoint` WHERE `id` = :id AND `collection_id` = :collection_id;");
   sql.bindValue(":id", waypointId);
   sql.bindValue(":collection_id", collectionId);
   sql.exec();
@@ -1632,23 +3601,22 @@ void Storage::deleteWaypoint(qint64 collectionId, qint64 waypointId)
   if (sql.lastError().isValid()) {
     qWarning() << "Deleting waypoint failed" << sql.lastError();
     emit error(tr("Deleting waypoint failed: %1").arg(sql.lastError().text()));
-    loadCollectionDetails(Collection(collectionId));
+    collectionModified(collectionId);
   } else {
     emit waypointDeleted(collectionId, waypointId);
   }
 
-  loadCollectionDetails(Collection(collectionId));
+  collectionModified(collectionId);
 }
 
 void Storage::createWaypoint(qint64 collectionId, double lat, double lon, QString name, QString description, QString symbol)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionDetailsLoaded(Collection(collectionId), false);
+    emit collectionDetailsLoaded(std::make_shared<const Collection>(collectionId), false);
     return;
   }
 
-  QSqlQuery sqlWpt(db);
-  sqlWpt.prepare(
+  auto sqlWpt = prepare(
     "INSERT INTO `waypoint` (`collection_id`, `timestamp`, `modification_time`, `latitude`, `longitude`, `name`, `description`, `visible`, `symbol`) "
     "VALUES                 (:collection_id,  :timestamp,  :modification_time,  :latitude,  :longitude,  :name,  :description, :visible, :symbol)");
 
@@ -1671,17 +3639,17 @@ void Storage::createWaypoint(qint64 collectionId, double lat, double lon, QStrin
     emit waypointCreated(collectionId, wptId, name);
   }
 
-  loadCollectionDetails(Collection(collectionId));
+  collectionModified(collectionId);
 }
 
 void Storage::createTrack(qint64 collectionId, QString name, QString description, bool open)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionDetailsLoaded(Collection(collectionId), false);
+    emit collectionDetailsLoaded(std::make_shared<const Collection>(collectionId), false);
     return;
   }
 
-  QSqlQuery sqlTrk = trackInsertSql();
+  auto sqlTrk = trackInsertSql();
 
   QStringOpt desc = description.isEmpty() ?
                     std::nullopt :
@@ -1700,17 +3668,16 @@ void Storage::createTrack(qint64 collectionId, QString name, QString description
     emit trackCreated(collectionId, trackId, name);
   }
 
-  loadCollectionDetails(Collection(collectionId));
+  collectionModified(collectionId);
 }
 
 void Storage::closeTrack(qint64 collectionId, qint64 trackId){
   if (!checkAccess(__FUNCTION__)){
-    emit collectionDetailsLoaded(Collection(collectionId), false);
+    emit collectionDetailsLoaded(std::make_shared<const Collection>(collectionId), false);
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("UPDATE `track` SET `open` = 'FALSE' WHERE `id` = :id AND `collection_id` = :collection_id;");
+  auto sql = prepare("UPDATE `track` SET `open` = 'FALSE' WHERE `id` = :id AND `collection_id` = :collection_id;");
   sql.bindValue(":id", trackId);
   sql.bindValue(":collection_id", collectionId);
   sql.exec();
@@ -1718,23 +3685,27 @@ void Storage::closeTrack(qint64 collectionId, qint64 trackId){
   if (sql.lastError().isValid()) {
     qWarning() << "Closing track failed" << sql.lastError();
     emit error(tr("Closing track failed: %1").arg(sql.lastError().text()));
-    loadCollectionDetails(Collection(collectionId));
+    collectionModified(collectionId);
     return;
   }
 
-  loadCollectionDetails(Collection(collectionId));
+  if (!buildTrackLods(trackId)) {
+    // track is closed, missing levels are built on next start
+    qWarning() << "Building lod of track" << trackId << "failed";
+  }
+
+  collectionModified(collectionId);
 }
 
 
 void Storage::deleteTrack(qint64 collectionId, qint64 trackId)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionDetailsLoaded(Collection(collectionId), false);
+    emit collectionDetailsLoaded(std::make_shared<const Collection>(collectionId), false);
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("DELETE FROM `track` WHERE `id` = :id AND `collection_id` = :collection_id;");
+  auto sql = prepare("DELETE FROM `track` WHERE `id` = :id AND `collection_id` = :collection_id;");
   sql.bindValue(":id", trackId);
   sql.bindValue(":collection_id", collectionId);
   sql.exec();
@@ -1742,23 +3713,22 @@ void Storage::deleteTrack(qint64 collectionId, qint64 trackId)
   if (sql.lastError().isValid()) {
     qWarning() << "Deleting track failed" << sql.lastError();
     emit error(tr("Deleting track failed: %1").arg(sql.lastError().text()));
-    loadCollectionDetails(Collection(collectionId));
+    collectionModified(collectionId);
   } else {
     emit trackDeleted(collectionId, trackId);
   }
 
-  loadCollectionDetails(Collection(collectionId));
+  collectionModified(collectionId);
 }
 
 void Storage::editWaypoint(qint64 collectionId, qint64 id, QString name, QString description, QString symbol)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionDetailsLoaded(Collection(collectionId), false);
+    emit collectionDetailsLoaded(std::make_shared<const Collection>(collectionId), false);
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("UPDATE `waypoint` SET "
+  auto sql = prepare("UPDATE `waypoint` SET "
               "`name` = :name, `description` = :description, `modification_time` = :modification_time, `symbol` = :symbol "
               "WHERE `id` = :id AND `collection_id` = :collection_id;");
   sql.bindValue(":id", id);
@@ -1772,21 +3742,20 @@ void Storage::editWaypoint(qint64 collectionId, qint64 id, QString name, QString
   if (sql.lastError().isValid()) {
     qWarning() << "Edit waypoint failed" << sql.lastError();
     emit error(tr("Edit waypoint failed: %1").arg(sql.lastError().text()));
-    loadCollectionDetails(Collection(collectionId));
+    collectionModified(collectionId);
   }
 
-  loadCollectionDetails(Collection(collectionId));
+  collectionModified(collectionId);
 }
 
 void Storage::editTrack(qint64 collectionId, qint64 id, QString name, QString description)
 {
   if (!checkAccess(__FUNCTION__)){
-    emit collectionDetailsLoaded(Collection(collectionId), false);
+    emit collectionDetailsLoaded(std::make_shared<const Collection>(collectionId), false);
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("UPDATE `track` SET `name` = :name, `description` = :description, `modification_time` = :modification_time WHERE `id` = :id AND `collection_id` = :collection_id;");
+  auto sql = prepare("UPDATE `track` SET `name` = :name, `description` = :description, `modification_time` = :modification_time WHERE `id` = :id AND `collection_id` = :collection_id;");
   sql.bindValue(":id", id);
   sql.bindValue(":collection_id", collectionId);
   sql.bindValue(":name", name);
@@ -1797,98 +3766,216 @@ void Storage::editTrack(qint64 collectionId, qint64 id, QString name, QString de
   if (sql.lastError().isValid()) {
     qWarning() << "Edit track failed" << sql.lastError();
     emit error(tr("Edit track failed: %1").arg(sql.lastError().text()));
-    loadCollectionDetails(Collection(collectionId));
+    collectionModified(collectionId);
   }
 
-  loadCollectionDetails(Collection(collectionId));
+  collectionModified(collectionId);
 }
 
 bool Storage::exportPrivate(qint64 collectionId,
                             const QString &file,
                             const std::optional<qint64> &trackId,
                             bool includeWaypoints,
-                            std::optional<double> accuracyFilter)
+                            std::optional<double> accuracyFilter,
+                            const osmscout::BreakerRef &breaker)
 {
   QElapsedTimer timer;
   timer.start();
   qDebug() << "Exporting collection" << collectionId << "to" << file;
 
-  // load data
-  Collection collection(collectionId);
-  gpx::GpxFile gpxFile;
-  if (!loadCollectionDetailsPrivate(collection)){
+  auto nonEmpty = [](const QString &str) -> std::optional<std::string> {
+    if (str.isEmpty()) {
+      return std::nullopt;
+    }
+    return str.toStdString();
+  };
+  auto aborted = [&breaker]() {
+    return breaker && breaker->IsAborted();
+  };
+
+  auto sqlCollection = prepare("SELECT `name`, `description` FROM `collection` WHERE `id` = :id;");
+  sqlCollection.execValues(collectionId);
+  if (sqlCollection.lastError().isValid()) {
+    qWarning() << "Loading collection id" << collectionId << "failed: " << sqlCollection.lastError();
+    emit error(tr("Loading collection id %1 failed").arg(collectionId));
     return false;
   }
-
-  if (!collection.name.isEmpty()) {
-    gpxFile.name = collection.name.toStdString();
+  if (!sqlCollection.next()) {
+    qWarning() << "Collection id" << collectionId << "don't exists";
+    emit error(tr("Collection id %1 don't exists").arg(collectionId));
+    return false;
   }
-  if (!collection.description.isEmpty()) {
-    gpxFile.desc = collection.description.toStdString();
+
+  // gpx is written while walking cursors, just one chunk of points is in memory
+  QFile output(file);
+  if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning() << "Cannot open" << file << output.errorString();
+    emit error(tr("Cannot open file %1: %2").arg(file).arg(output.errorString()));
+    return false;
   }
+  auto fail = [&output]() {
+    output.close();
+    output.remove();
+    return false;
+  };
+
+  GpxStreamWriter writer(&output);
+  writer.startDocument(nonEmpty(varToString(sqlCollection.value("name"))),
+                       nonEmpty(varToString(sqlCollection.value("description"))));
 
-  assert(collection.waypoints);
   if (includeWaypoints) {
-    gpxFile.waypoints.reserve(collection.waypoints->size());
-    for (const Waypoint &w: *(collection.waypoints)) {
-      gpxFile.waypoints.push_back(w.data);
+    auto sqlWpt = prepare("SELECT * FROM `waypoint` WHERE `collection_id` = :collectionId ORDER BY `id`;");
+    sqlWpt.execValues(collectionId);
+    if (sqlWpt.lastError().isValid()) {
+      qWarning() << "Loading waypoints for collection id" << collectionId << "fails";
+      emit error(tr("Loading waypoints for collection id %1 fails").arg(collectionId));
+      return fail();
+    }
+    while (sqlWpt.next()) {
+      if (aborted()) {
+        qDebug() << "Export to" << file << "canceled";
+        return fail();
+      }
+      writer.writeWaypoint(makeWaypoint(sqlWpt).data);
     }
   }
-  collection.waypoints.reset();
 
-  // load track data
-  assert(collection.tracks);
-  gpxFile.tracks.reserve(collection.tracks->size());
-  for (Track &t : *(collection.tracks)){
-    if (!trackId || *trackId == t.id) {
-      if (!loadTrackDataPrivate(t, accuracyFilter)) {
-        return false;
-      }
-      assert(t.data);
+  auto sqlTrack = prepare(trackId ?
+                          "SELECT * FROM `track` WHERE `collection_id` = :collectionId AND `id` = :trackId;" :
+                          "SELECT * FROM `track` WHERE `collection_id` = :collectionId ORDER BY `id`;");
+  sqlTrack.bindValue(0, collectionId);
+  if (trackId) {
+    sqlTrack.bindValue(1, *trackId);
+  }
+  sqlTrack.exec();
+  if (sqlTrack.lastError().isValid()) {
+    qWarning() << "Loading tracks for collection id" << collectionId << "fails";
+    emit error(tr("Loading tracks for collection id %1 fails").arg(collectionId));
+    return fail();
+  }
 
-      // drop empty segments
-      t.data->segments.erase(std::remove_if(t.data->segments.begin(),t.data->segments.end(),
-                                            [](const gpx::TrackSegment &s){ return s.points.empty(); }),
-                             t.data->segments.end());
+  qint64 pointsWritten = 0;
+  qint64 lastProgress = 0;
+  std::vector<gpx::TrackPoint> points;
+  points.reserve(TrackPointChunkSize);
+  while (sqlTrack.next()) {
+    Track track = makeTrack(sqlTrack);
+    writer.startTrack(nonEmpty(track.name), nonEmpty(track.description), nonEmpty(track.type), track.color);
+
+    auto sqlSeg = prepare("SELECT `id` FROM `track_segment` WHERE `track_id` = :trackId ORDER BY `id`;");
+    sqlSeg.execValues(track.id);
+    if (sqlSeg.lastError().isValid()) {
+      qWarning() << "Loading segments for track id" << track.id << "failed";
+      emit error(tr("Loading segments for track id %1 failed: %2").arg(track.id).arg(sqlSeg.lastError().text()));
+      return fail();
+    }
+    while (sqlSeg.next()) {
+      qint64 segmentId = varToLong(sqlSeg.value(0));
+      bool segmentStarted = false;
+      auto writePoints = [&]() {
+        if (accuracyFilter) {
+          gpx::FilterInaccuratePoints(points, *accuracyFilter);
+        }
+        // empty segments are dropped
+        if (!points.empty() && !segmentStarted) {
+          writer.startSegment();
+          segmentStarted = true;
+        }
+        for (const auto &point: points) {
+          writer.writePoint(point);
+        }
+        pointsWritten += points.size();
+        points.clear();
+        if (pointsWritten - lastProgress >= ExportProgressStep) {
+          lastProgress = pointsWritten;
+          emit exportProgress(file, pointsWritten);
+        }
+      };
+
+      bool legacySegment = false;
+      if (legacyPoints) {
+        // segment that was not migrated yet, see loadTrackPoints
+        gpx::TrackSegment legacy;
+        if (!loadLegacyTrackPoints(segmentId, legacy)) {
+          return fail();
+        }
+        legacySegment = !legacy.points.empty();
+        points = std::move(legacy.points);
+        writePoints();
+      }
 
-      gpxFile.tracks.push_back(std::move(*(t.data)));
+      if (!legacySegment) {
+        bool loaded = visitSegmentData(segmentId,
+          [&](const QByteArray &data, qint64) {
+            if (aborted()) {
+              qDebug() << "Export to" << file << "canceled";
+              return false;
+            }
+            if (!decodePoints(data, points)) {
+              qWarning() << "Decoding nodes for segment id" << segmentId << "failed";
+              emit error(tr("Decoding nodes for segment id %1 failed").arg(segmentId));
+              return false;
+            }
+            writePoints();
+            return true;
+          },
+          [&](const TrackArchive::SegmentView &view) {
+            // archived points are read from the mapped file in batches, segment is not materialized
+            for (size_t i = 0; i < view.size(); i++) {
+              points.push_back(view.point(i));
+              if (points.size() == size_t(TrackPointChunkSize)) {
+                if (aborted()) {
+                  qDebug() << "Export to" << file << "canceled";
+                  return false;
+                }
+                writePoints();
+              }
+            }
+            writePoints();
+            return true;
+          });
+        if (!loaded) {
+          return fail();
+        }
+      }
+      if (segmentStarted) {
+        writer.endSegment();
+      }
     }
+    writer.endTrack();
   }
 
-  // export
-  qDebug() << "Writing gpx file" << file;
-  std::shared_ptr<ErrorCallback> callback = std::make_shared<ErrorCallback>();
-  connect(callback.get(), &ErrorCallback::error, this, &Storage::error);
-
-  bool success = gpx::ExportGpx(gpxFile,
-                                file.toStdString(),
-                                nullptr,
-                                std::static_pointer_cast<gpx::ProcessCallback, ErrorCallback>(callback));
+  writer.endDocument();
+  if (writer.hasError()) {
+    qWarning() << "Writing" << file << "failed" << output.errorString();
+    emit error(tr("Writing file %1 failed: %2").arg(file).arg(output.errorString()));
+    return fail();
+  }
+  output.close();
+  emit exportProgress(file, pointsWritten);
 
-  qDebug() << "Exported in" << timer.elapsed() << "ms";
-  return success;
+  qDebug() << "Exported" << pointsWritten << "points in" << timer.elapsed() << "ms";
+  return true;
 }
 
-void Storage::exportCollection(qint64 collectionId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter)
+void Storage::exportCollection(qint64 collectionId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter, osmscout::BreakerRef breaker)
 {
-  if (!checkAccess(__FUNCTION__)){
+  dispatchRead(__FUNCTION__, [=](){
+    bool success = exportPrivate(collectionId, file, std::nullopt, includeWaypoints, accuracyFilter, breaker);
+    emit collectionExported(collectionId, file, success);
+  }, [=](){
     emit collectionExported(collectionId, file, false);
-    return;
-  }
-
-  bool success = exportPrivate(collectionId, file, std::nullopt, includeWaypoints, accuracyFilter);
-  emit collectionExported(collectionId, file, success);
+  });
 }
 
-void Storage::exportTrack(qint64 collectionId, qint64 trackId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter)
+void Storage::exportTrack(qint64 collectionId, qint64 trackId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter, osmscout::BreakerRef breaker)
 {
-  if (!checkAccess(__FUNCTION__)){
+  dispatchRead(__FUNCTION__, [=](){
+    bool success = exportPrivate(collectionId, file, trackId, includeWaypoints, accuracyFilter, breaker);
+    emit trackExported(trackId, file, success);
+  }, [=](){
     emit trackExported(trackId, file, false);
-    return;
-  }
-
-  bool success = exportPrivate(collectionId, file, trackId, includeWaypoints, accuracyFilter);
-  emit trackExported(trackId, file, success);
+  });
 }
 
 void Storage::moveWaypoint(qint64 waypointId, qint64 collectionId)
@@ -1897,8 +3984,7 @@ void Storage::moveWaypoint(qint64 waypointId, qint64 collectionId)
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("SELECT `collection_id` FROM `waypoint` WHERE `id` = :id;");
+  auto sql = prepare("SELECT `collection_id` FROM `waypoint` WHERE `id` = :id;");
   sql.bindValue(":id", waypointId);
   sql.exec();
 
@@ -1917,8 +4003,7 @@ void Storage::moveWaypoint(qint64 waypointId, qint64 collectionId)
 
   qDebug() << "Moving waypoint" << waypointId << "from collection" << sourceCollectionId << "to" << collectionId;
 
-  QSqlQuery sqlUpdate(db);
-  sqlUpdate.prepare("UPDATE `waypoint` SET `collection_id` = :collection_id  WHERE `id` = :id;");
+  auto sqlUpdate = prepare("UPDATE `waypoint` SET `collection_id` = :collection_id  WHERE `id` = :id;");
   sqlUpdate.bindValue(":id", waypointId);
   sqlUpdate.bindValue(":collection_id", collectionId);
   sqlUpdate.exec();
@@ -1929,19 +4014,8 @@ void Storage::moveWaypoint(qint64 waypointId, qint64 collectionId)
     return;
   }
 
-  Collection collection(sourceCollectionId);
-  if (loadCollectionDetailsPrivate(collection)) {
-    emit collectionDetailsLoaded(collection, true);
-  }else{
-    emit collectionDetailsLoaded(collection, false);
-  }
-
-  collection.id = collectionId;
-  if (loadCollectionDetailsPrivate(collection)) {
-    emit collectionDetailsLoaded(collection, true);
-  }else{
-    emit collectionDetailsLoaded(collection, false);
-  }
+  collectionModified(sourceCollectionId);
+  collectionModified(collectionId);
 }
 
 void Storage::moveTrack(qint64 trackId, qint64 collectionId)
@@ -1950,8 +4024,7 @@ void Storage::moveTrack(qint64 trackId, qint64 collectionId)
     return;
   }
 
-  QSqlQuery sql(db);
-  sql.prepare("SELECT `collection_id` FROM `track` WHERE `id` = :id;");
+  auto sql = prepare("SELECT `collection_id` FROM `track` WHERE `id` = :id;");
   sql.bindValue(":id", trackId);
   sql.exec();
 
@@ -1970,8 +4043,7 @@ void Storage::moveTrack(qint64 trackId, qint64 collectionId)
 
   qDebug() << "Moving track" << trackId << "from collection" << sourceCollectionId << "to" << collectionId;
 
-  QSqlQuery sqlUpdate(db);
-  sqlUpdate.prepare("UPDATE `track` SET `collection_id` = :collection_id  WHERE `id` = :id;");
+  auto sqlUpdate = prepare("UPDATE `track` SET `collection_id` = :collection_id  WHERE `id` = :id;");
   sqlUpdate.bindValue(":id", trackId);
   sqlUpdate.bindValue(":collection_id", collectionId);
   sqlUpdate.exec();
@@ -1982,24 +4054,12 @@ void Storage::moveTrack(qint64 trackId, qint64 collectionId)
     return;
   }
 
-  Collection collection(sourceCollectionId);
-  if (loadCollectionDetailsPrivate(collection)) {
-    emit collectionDetailsLoaded(collection, true);
-  }else{
-    emit collectionDetailsLoaded(collection, false);
-  }
-
-  collection.id = collectionId;
-  if (loadCollectionDetailsPrivate(collection)) {
-    emit collectionDetailsLoaded(collection, true);
-  }else{
-    emit collectionDetailsLoaded(collection, false);
-  }
+  collectionModified(sourceCollectionId);
+  collectionModified(collectionId);
 }
 
 bool Storage::updateTrackStatistics(qint64 trackId, const TrackStatistics &statistics){
-  QSqlQuery sql(db);
-  sql.prepare(QString("UPDATE `track` SET ")
+  auto sql = prepare(QString("UPDATE `track` SET ")
                 .append("`from_time` = :from_time, ")
                 .append("`to_time` = :to_time, ")
                 .append("`distance` = :distance, ")
@@ -2020,25 +4080,7 @@ bool Storage::updateTrackStatistics(qint64 trackId, const TrackStatistics &stati
                 .append("`modification_time` = :modification_time ")
                 .append("WHERE `id` = :id"));
 
-  sql.bindValue(":from_time", dateTimeToSQL(statistics.from));
-  sql.bindValue(":to_time", dateTimeToSQL(statistics.to));
-  sql.bindValue(":distance", statistics.distance.AsMeter());
-  sql.bindValue(":raw_distance", statistics.rawDistance.AsMeter());
-  sql.bindValue(":duration", statistics.durationMillis());
-  sql.bindValue(":moving_duration", statistics.movingDurationMillis());
-  sql.bindValue(":max_speed", statistics.maxSpeed);
-  sql.bindValue(":average_speed", statistics.averageSpeed);
-  sql.bindValue(":moving_average_speed", statistics.movingAverageSpeed);
-  sql.bindValue(":ascent", statistics.ascent.AsMeter());
-  sql.bindValue(":descent", statistics.descent.AsMeter());
-  sql.bindValue(":min_elevation", statistics.minElevation.has_value() ? QVariant::fromValue(statistics.minElevation->AsMeter()) : QVariant());
-  sql.bindValue(":max_elevation", statistics.maxElevation.has_value() ? QVariant::fromValue(statistics.maxElevation->AsMeter()) : QVariant());
-
-  sql.bindValue(":bbox_min_lat", statistics.bbox.IsValid() ? statistics.bbox.GetMinLat() : -1000);
-  sql.bindValue(":bbox_min_lon", statistics.bbox.IsValid() ? statistics.bbox.GetMinLon() : -1000);
-  sql.bindValue(":bbox_max_lat", statistics.bbox.IsValid() ? statistics.bbox.GetMaxLat() : -1000);
-  sql.bindValue(":bbox_max_lon", statistics.bbox.IsValid() ? statistics.bbox.GetMaxLon() : -1000);
-
+  bindTrackStatistics(sql, statistics);
   sql.bindValue(":modification_time", dateTimeToSQL(QDateTime::currentDateTime()));
 
   sql.bindValue(":id", trackId);
@@ -2052,96 +4094,305 @@ bool Storage::updateTrackStatistics(qint64 trackId, const TrackStatistics &stati
   return true;
 }
 
-void Storage::cropTrackPrivate(qint64 trackId, quint64 position, bool cropStart)
+bool Storage::loadSegmentPointCounts(qint64 trackId, std::vector<std::pair<qint64, qint64>> &segments)
 {
-  QSqlQuery sql(db);
-  sql.prepare(QString("SELECT `id`, `track_id`, (")
+  // point count of segment is sequence after its last chunk, legacy points are counted for not migrated segments
+  auto sql = prepare(QString("SELECT `id`, COALESCE((")
+                .append(" SELECT `first_point` + `point_count` FROM `track_segment_data` WHERE `segment_id` = `track_segment`.`id`")
+                .append(" ORDER BY `first_point` DESC LIMIT 1")
+                .append("), 0) + (")
                 .append(" SELECT COUNT(*) FROM `track_point` WHERE `segment_id` = `track_segment`.`id`")
                 .append(") AS `point_cnt` ")
                 .append("FROM `track_segment` ")
-                .append("WHERE `track_id` = :id"));
+                .append("WHERE `track_id` = :id ")
+                .append("ORDER BY `id`"));
+  sql.execValues(trackId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading track id" << trackId << "fails" << sql.lastError();
+    emit error(tr("Loading track id %1 fails").arg(trackId));
+    return false;
+  }
+  while (sql.next()) {
+    segments.emplace_back(varToLong(sql.value(0)), varToLong(sql.value(1)));
+  }
+  return true;
+}
 
-  sql.bindValue(":id", trackId);
-  sql.exec();
+bool Storage::ensureSegmentChunks(qint64 segmentId)
+{
+  if (!legacyPoints) {
+    return true;
+  }
+  auto sql = prepare("SELECT 1 FROM `track_point` WHERE `segment_id` = :segmentId LIMIT 1;");
+  sql.execValues(segmentId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading nodes for segment id" << segmentId << "failed" << sql.lastError();
+    emit error(tr("Loading nodes for segment id %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+  if (!sql.next()) {
+    return true;
+  }
+  sql.finish();
+  // segment that was not migrated yet
+  gpx::TrackSegment segment;
+  return loadLegacyTrackPoints(segmentId, segment) &&
+         storeTrackPoints(segment.points, segmentId);
+}
 
+bool Storage::loadSegmentChunk(qint64 segmentId, qint64 position, std::vector<SegmentChunk> &chunks)
+{
+  // chunk containing the position, but not starting on it
+  auto sql = prepare(QString("SELECT `chunk`, `first_point`, `data` FROM `track_segment_data` ")
+                       .append("WHERE `segment_id` = :segmentId AND `first_point` < :position AND `first_point` + `point_count` > :position ")
+                       .append("ORDER BY `first_point` DESC LIMIT 1;"));
+  sql.execValues(segmentId, position, position);
   if (sql.lastError().isValid()) {
-    qWarning() << "Loading track id" << trackId << "fails";
-    emit error(tr("Loading track id %1 fails").arg(trackId));
+    qWarning() << "Loading nodes for segment id" << segmentId << "failed" << sql.lastError();
+    emit error(tr("Loading nodes for segment id %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+  if (sql.next()) {
+    if (!chunks.empty() && chunks.back().chunk == varToLong(sql.value(0))) {
+      return true; // loaded already
+    }
+    SegmentChunk &chunk = chunks.emplace_back();
+    chunk.chunk = varToLong(sql.value(0));
+    chunk.firstPoint = varToLong(sql.value(1));
+    if (!decodePoints(sql.value(2).toByteArray(), chunk.points)) {
+      qWarning() << "Decoding nodes for segment id" << segmentId << "failed";
+      emit error(tr("Decoding nodes for segment id %1 failed").arg(segmentId));
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Storage::updateSegmentChunk(qint64 segmentId, const SegmentChunk &chunk)
+{
+  auto sql = prepare(chunk.points.empty() ?
+    "DELETE FROM `track_segment_data` WHERE `segment_id` = :segmentId AND `chunk` = :chunk;" :
+    "UPDATE `track_segment_data` SET `first_point` = :first_point, `point_count` = :point_count, `data` = :data WHERE `segment_id` = :segmentId AND `chunk` = :chunk;");
+  if (chunk.points.empty()) {
+    sql.execValues(segmentId, chunk.chunk);
+  } else {
+    sql.execValues(chunk.firstPoint, qint64(chunk.points.size()), TrackPointCodec::encode(chunk.points), segmentId, chunk.chunk);
+  }
+  if (sql.lastError().isValid()) {
+    qWarning() << "Updating chunk of segment" << segmentId << "failed:" << sql.lastError();
+    emit error(tr("Updating points of segment %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+  return true;
+}
+
+bool Storage::shiftSegmentPoints(qint64 segmentId, qint64 from, qint64 delta)
+{
+  auto sql = prepare("UPDATE `track_segment_data` SET `first_point` = `first_point` + :delta WHERE `segment_id` = :segmentId AND `first_point` >= :from;");
+  sql.execValues(delta, segmentId, from);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Updating chunks of segment" << segmentId << "failed:" << sql.lastError();
+    emit error(tr("Updating points of segment %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+  return true;
+}
+
+bool Storage::deleteSegmentPoints(qint64 segmentId, qint64 from, qint64 to)
+{
+  if (!ensureSegmentChunks(segmentId)) {
+    return false;
+  }
+
+  // just chunks crossing range boundaries are decoded
+  std::vector<SegmentChunk> chunks;
+  if (!loadSegmentChunk(segmentId, from, chunks) ||
+      !loadSegmentChunk(segmentId, to, chunks)) {
+    return false;
+  }
+
+  // chunks inside the range
+  auto sql = prepare(QString("DELETE FROM `track_segment_data` ")
+                       .append("WHERE `segment_id` = :segmentId AND `first_point` >= :from AND `first_point` < :to ")
+                       .append("AND `first_point` + `point_count` <= :to;"));
+  sql.execValues(segmentId, from, to, to);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Deleting points of segment" << segmentId << "failed:" << sql.lastError();
+    emit error(tr("Deleting points of segment %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+
+  for (SegmentChunk &chunk: chunks) {
+    qint64 end = chunk.firstPoint + qint64(chunk.points.size());
+    qint64 eraseFrom = std::max(from, chunk.firstPoint) - chunk.firstPoint;
+    qint64 eraseTo = std::min(to, end) - chunk.firstPoint;
+    chunk.points.erase(chunk.points.begin() + eraseFrom, chunk.points.begin() + eraseTo);
+    if (chunk.firstPoint >= from) {
+      // tail of chunk after the range, it is shifted with following chunks
+      chunk.firstPoint = to;
+    }
+    if (!updateSegmentChunk(segmentId, chunk)) {
+      return false;
+    }
+  }
+
+  // levels of detail and statistics are not valid anymore, caller should build them again
+  return shiftSegmentPoints(segmentId, to, from - to) &&
+         deleteSegmentLods(segmentId) &&
+         deleteSegmentStatistics(segmentId);
+}
+
+bool Storage::moveSegmentHead(qint64 segmentId, qint64 position, qint64 targetSegmentId)
+{
+  if (!ensureSegmentChunks(segmentId)) {
+    return false;
+  }
+
+  std::vector<SegmentChunk> chunks;
+  if (!loadSegmentChunk(segmentId, position, chunks)) {
+    return false;
+  }
+
+  // chunks before position are moved without decoding, they keep its chunk number and sequence
+  auto sql = prepare(QString("UPDATE `track_segment_data` SET `segment_id` = :targetSegmentId ")
+                       .append("WHERE `segment_id` = :segmentId AND `first_point` < :position ")
+                       .append("AND `first_point` + `point_count` <= :position;"));
+  sql.execValues(targetSegmentId, segmentId, position, position);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Moving points of segment" << segmentId << "failed:" << sql.lastError();
+    emit error(tr("Updating points of segment %1 failed: %2").arg(segmentId).arg(sql.lastError().text()));
+    return false;
+  }
+
+  for (SegmentChunk &chunk: chunks) {
+    // split chunk on position, head part is inserted to target segment with the same chunk number,
+    // so chunk numbers are still increasing with sequence in both segments
+    size_t headSize = size_t(position - chunk.firstPoint);
+    std::vector<gpx::TrackPoint> head(chunk.points.begin(), chunk.points.begin() + headSize);
+    if (!insertTrackPointChunks(head, 0, targetSegmentId, chunk.chunk, chunk.firstPoint)) {
+      return false;
+    }
+    chunk.points.erase(chunk.points.begin(), chunk.points.begin() + headSize);
+    chunk.firstPoint = position;
+    if (!updateSegmentChunk(segmentId, chunk)) {
+      return false;
+    }
+  }
+
+  return shiftSegmentPoints(segmentId, position, -position) &&
+         deleteSegmentLods(segmentId) &&
+         deleteSegmentStatistics(segmentId);
+}
+
+bool Storage::updateEditedTrack(qint64 trackId, const QSet<qint64> &modifiedSegments)
+{
+  auto sql = prepare("SELECT `id` FROM `track_segment` WHERE `track_id` = :trackId ORDER BY `id`;");
+  sql.execValues(trackId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading segments for track id" << trackId << "failed";
+    emit error(tr("Loading segments for track id %1 failed: %2").arg(trackId).arg(sql.lastError().text()));
+    return false;
+  }
+  std::vector<qint64> segments;
+  while (sql.next()) {
+    segments.push_back(varToLong(sql.value(0)));
+  }
+  sql.finish();
+
+  // Just points of modified segments are loaded, levels of detail and statistics of others are untouched.
+  // Modified segment is decoded whole, its simplification and statistics are not local to the edited range.
+  for (qint64 segmentId: segments) {
+    if (!modifiedSegments.contains(segmentId)) {
+      continue;
+    }
+    gpx::TrackSegment segment;
+    if (!loadTrackPoints(segmentId, segment) ||
+        !storeSegmentLods(segmentId, encodeSegmentLods(segment.points)) ||
+        !storeSegmentStatistics(segmentId, computeSegmentStatistics(segment.points))) {
+      return false;
+    }
+  }
+  // statistics of untouched segments are reused
+  TrackStatistics statistics;
+  return mergeSegmentStatistics(trackId, statistics) &&
+         updateTrackStatistics(trackId, statistics);
+}
+
+void Storage::cropTrackPrivate(qint64 trackId, quint64 position, bool cropStart)
+{
+  std::vector<std::pair<qint64, qint64>> segments;
+  if (!unarchiveTrack(trackId) || !loadSegmentPointCounts(trackId, segments)) {
     return;
   }
 
   auto deleteSegment = [this](qint64 segmentId){
-    QSqlQuery sql(db);
-    sql.prepare("DELETE FROM `track_segment` WHERE `id` = :id");
+    auto sql = prepare("DELETE FROM `track_segment` WHERE `id` = :id");
     sql.bindValue(":id", segmentId);
     sql.exec();
     //qDebug() << sql.executedQuery() << " ... " << sql.boundValues();
     if (sql.lastError().isValid()) {
       qWarning() << "Deleting segment" << segmentId << "failed: " << sql.lastError();
+      return false;
     }
+    return true;
   };
 
-  auto deleteSegmentPart = [this, &cropStart](qint64 segmentId, quint64 count){
-    QSqlQuery sql(db);
-    sql.prepare(QString("DELETE FROM `track_point` WHERE `segment_id` = :segmentId1 AND `rowid` IN (")
-                  .append("SELECT `rowid` FROM `track_point` WHERE `segment_id` = :segmentId2 ")
-                  .append("ORDER BY `rowid` ").append(cropStart ? "ASC " : "DESC ")
-                  .append("LIMIT :cnt")
-                  .append(")"));
-    sql.bindValue(":segmentId1", segmentId);
-    sql.bindValue(":segmentId2", segmentId);
-    sql.bindValue(":cnt", count);
-    sql.exec();
-    //qDebug() << sql.executedQuery() << " ... " << sql.boundValues();
-    if (sql.lastError().isValid()) {
-      qWarning() << "Deleting part of segment" << segmentId << "failed: " << sql.lastError();
-    }
-  };
-
+  QSet<qint64> modifiedSegments;
+  bool success = true;
+  db.transaction();
   if (cropStart) {
-    while (sql.next() && position > 0) {
-      qint64 segmentId = varToLong(sql.value("id"));
-      qint64 pointCnt = varToLong(sql.value("point_cnt"));
-      if ((qint64)position > pointCnt){
-        deleteSegment(segmentId);
+    for (const auto &[segmentId, pointCnt]: segments) {
+      if (position == 0 || !success) {
+        break;
+      }
+      if ((qint64)position >= pointCnt){
+        success = deleteSegment(segmentId);
         position -= pointCnt;
       } else {
-        deleteSegmentPart(segmentId, position);
+        success = deleteSegmentPoints(segmentId, 0, position);
+        modifiedSegments.insert(segmentId);
         position = 0;
       }
     }
   } else {
-    while (sql.next()){
-      qint64 segmentId = varToLong(sql.value("id"));
-      qint64 pointCnt = varToLong(sql.value("point_cnt"));
-      if ((qint64)position < pointCnt){
-        deleteSegmentPart(segmentId, pointCnt - position);
+    for (const auto &[segmentId, pointCnt]: segments) {
+      if (!success) {
+        break;
+      }
+      if ((qint64)position < pointCnt && position > 0){
+        success = deleteSegmentPoints(segmentId, position, pointCnt);
+        modifiedSegments.insert(segmentId);
         position = 0;
       } else if (position == 0){
-        deleteSegment(segmentId);
+        success = deleteSegment(segmentId);
       } else {
         position -= pointCnt;
       }
     }
   }
+  // statistics are updated in the same transaction, so interrupted crop cannot leave them stale
+  success = success && updateEditedTrack(trackId, modifiedSegments);
+  if (success) {
+    if (!db.commit()) {
+      qWarning() << "Crop of track" << trackId << "failed: " << db.lastError();
+      success = false;
+    }
+  } else {
+    qWarning() << "Crop of track" << trackId << "failed";
+    db.rollback();
+  }
 
   Track track;
   track.id = trackId;
-  if (!loadTrackDataPrivate(track, std::nullopt)){
-    loadCollectionDetails(Collection(track.collectionId));
-    emit trackDataLoaded(track, std::nullopt, true, true);
-    return;
-  }
-
-  track.statistics = computeTrackStatistics(*track.data);
-  if (!updateTrackStatistics(trackId, track.statistics)){
-    loadCollectionDetails(Collection(track.collectionId));
+  if (!success || !loadTrackMetadata(track)){
+    collectionModified(track.collectionId);
     emit trackDataLoaded(track, std::nullopt, true, false);
     return;
   }
 
-  loadCollectionDetails(Collection(track.collectionId));
-  emit trackDataLoaded(track, std::nullopt, true, true);
+  collectionModified(track.collectionId);
+  // modified track is reloaded by reader, through the track data cache
+  loadTrackData(track, std::nullopt);
 }
 
 void Storage::cropTrackStart(Track track, quint64 position)
@@ -2167,41 +4418,86 @@ void Storage::splitTrack(Track track, quint64 position)
     return;
   }
 
-  if (!loadTrackDataPrivate(track, std::nullopt)){
-    loadCollectionDetails(Collection(track.collectionId));
-    emit trackDataLoaded(track, std::nullopt, true, true);
+  std::vector<std::pair<qint64, qint64>> segments;
+  if (!loadTrackMetadata(track) || !unarchiveTrack(track.id) || !loadSegmentPointCounts(track.id, segments)){
+    collectionModified(track.collectionId);
+    emit trackDataLoaded(track, std::nullopt, true, false);
     return;
   }
 
-  // copy tail to new track
-  gpx::Track trackTail;
+  auto fail = [&](){
+    db.rollback();
+    collectionModified(track.collectionId);
+    emit trackDataLoaded(track, std::nullopt, true, false);
+  };
+
+  db.transaction();
+
+  // new track for the tail, its statistics are computed when points are moved
+  auto sqlTrk = trackInsertSql();
   //: name for new track created by splitting
-  trackTail.name = Storage::tr("%1, part 2").arg(track.name).toStdString();
-  trackTail.desc = track.description.toStdString();
-  quint64 skip=position;
-  for (const auto &seg: track.data->segments){
-    if (skip==0){
-      trackTail.segments.push_back(seg);
-    } else if (skip < seg.points.size()) {
-      auto &segTail=trackTail.segments.emplace_back();
-      segTail.points.insert(segTail.points.end(),
-                            seg.points.begin()+skip, seg.points.end());
+  QString tailName = Storage::tr("%1, part 2").arg(track.name);
+  QStringOpt tailDesc = track.description.isEmpty() ? std::nullopt : QStringOpt(track.description);
+  prepareTrackInsert(sqlTrk, track.collectionId, tailName, tailDesc,
+                     std::nullopt, QString(), true, track.statistics, false);
+  sqlTrk.exec();
+  if (sqlTrk.lastError().isValid()) {
+    qWarning() << "Split of track" << track.id << "failed" << sqlTrk.lastError();
+    emit error(tr("Split of track failed: %1").arg(sqlTrk.lastError().text()));
+    return fail();
+  }
+  qint64 tailId = varToLong(sqlTrk.lastInsertId());
+  sqlTrk.finish();
+
+  // Segments after the position are moved to new track. Segment containing the position
+  // is moved as well, its head is moved to new segment of original track. Segments of the track
+  // are ordered by id, so ordering of both tracks is kept.
+  QSet<qint64> modifiedSegments;
+  auto moveSegment = prepare("UPDATE `track_segment` SET `track_id` = :trackId WHERE `id` = :id");
+  quint64 skip = position;
+  for (const auto &[segmentId, pointCnt]: segments) {
+    if (skip >= quint64(pointCnt)) {
+      skip -= pointCnt;
+      continue;
+    }
+    if (skip > 0) {
+      qint64 headSegmentId;
+      if (!createSegment(track.id, headSegmentId, false) ||
+          !moveSegmentHead(segmentId, qint64(skip), headSegmentId)) {
+        return fail();
+      }
+      modifiedSegments << segmentId << headSegmentId;
       skip = 0;
-    } else {
-      skip -= seg.points.size();
     }
+    moveSegment.execValues(tailId, segmentId);
+    if (moveSegment.lastError().isValid()) {
+      qWarning() << "Moving segment" << segmentId << "failed" << moveSegment.lastError();
+      emit error(tr("Split of track failed: %1").arg(moveSegment.lastError().text()));
+      return fail();
+    }
+  }
+  moveSegment.finish();
+
+  // statistics of both tracks are updated in the same transaction as the points
+  if (!updateEditedTrack(tailId, modifiedSegments) ||
+      !updateEditedTrack(track.id, modifiedSegments)) {
+    return fail();
+  }
+
+  if (!db.commit()) {
+    qWarning() << "Split of track" << track.id << "failed" << db.lastError();
+    return fail();
   }
 
-  // import tail as new track
-  gpx::GpxFile gpxFile;
-  gpxFile.tracks.push_back(trackTail);
-  if (!importTracks(gpxFile, track.collectionId)){
-    loadCollectionDetails(Collection(track.collectionId));
+  if (!loadTrackMetadata(track)) {
+    collectionModified(track.collectionId);
+    emit trackDataLoaded(track, std::nullopt, true, false);
     return;
   }
 
-  // crop end from original track
-  cropTrackPrivate(track.id, position, false);
+  collectionModified(track.collectionId);
+  // modified track is reloaded by reader, through the track data cache
+  loadTrackData(track, std::nullopt);
 }
 
 void Storage::filterTrackNodes(Track track, std::optional<double> accuracyFilter)
@@ -2214,50 +4510,82 @@ void Storage::filterTrackNodes(Track track, std::optional<double> accuracyFilter
     return;
   }
 
-  // drop inaccurate nodes by SQL query
-  QSqlQuery sql(db);
-  sql.prepare(QString("DELETE FROM `track_point` WHERE `horiz_accuracy` > :filter ")
-              .append("AND `segment_id` IN (")
-              .append("SELECT `id` FROM `track_segment` WHERE `track_id` = :trackId")
-              .append(");"));
+  if (!unarchiveTrack(track.id)) {
+    collectionModified(track.collectionId);
+    emit trackDataLoaded(track, std::nullopt, true, false);
+    return;
+  }
 
-  sql.bindValue(":filter", *accuracyFilter);
+  // drop inaccurate nodes, segment by segment
+  auto sql = prepare("SELECT `id` FROM `track_segment` WHERE `track_id` = :trackId ORDER BY `id`;");
   sql.bindValue(":trackId", track.id);
   sql.exec();
-  // qDebug() << sql.executedQuery() << " ... " << sql.boundValues();
 
   if (sql.lastError().isValid()) {
-    loadCollectionDetails(Collection(track.collectionId));
+    collectionModified(track.collectionId);
     emit trackDataLoaded(track, std::nullopt, true, false);
     qWarning() << "Filter nodes failed: " << sql.lastError();
     return;
   }
 
-  if (!loadTrackDataPrivate(track, std::nullopt)){
-    loadCollectionDetails(Collection(track.collectionId));
+  std::vector<qint64> segments;
+  while (sql.next()) {
+    segments.push_back(varToLong(sql.value("id")));
+  }
+
+  double filter = *accuracyFilter;
+  db.transaction();
+  for (qint64 segmentId: segments) {
+    gpx::TrackSegment segment;
+    if (!loadTrackPoints(segmentId, segment)) {
+      db.rollback();
+      collectionModified(track.collectionId);
+      emit trackDataLoaded(track, std::nullopt, true, false);
+      return;
+    }
+    size_t size = segment.points.size();
+    segment.points.erase(std::remove_if(segment.points.begin(), segment.points.end(),
+                                        [filter](const gpx::TrackPoint &p){
+                                          return p.hdop.has_value() && *p.hdop > filter;
+                                        }),
+                         segment.points.end());
+    if (size != segment.points.size() && !storeTrackPoints(segment.points, segmentId)) {
+      db.rollback();
+      collectionModified(track.collectionId);
+      emit trackDataLoaded(track, std::nullopt, true, false);
+      qWarning() << "Filter nodes failed";
+      return;
+    }
+  }
+  // statistics of filtered segments are stored already
+  TrackStatistics statistics;
+  if (!mergeSegmentStatistics(track.id, statistics) ||
+      !updateTrackStatistics(track.id, statistics)) {
+    db.rollback();
+    collectionModified(track.collectionId);
     emit trackDataLoaded(track, std::nullopt, true, false);
     return;
   }
+  if (!db.commit()) {
+    collectionModified(track.collectionId);
+    emit trackDataLoaded(track, std::nullopt, true, false);
+    qWarning() << "Filter nodes failed: " << db.lastError();
+    return;
+  }
 
-  track.statistics = computeTrackStatistics(*track.data);
-  if (!updateTrackStatistics(track.id, track.statistics)){
-    loadCollectionDetails(Collection(track.collectionId));
+  if (!loadTrackDataPrivate(track, std::nullopt)){
+    collectionModified(track.collectionId);
     emit trackDataLoaded(track, std::nullopt, true, false);
     return;
   }
 
-  loadCollectionDetails(Collection(track.collectionId));
+  collectionModified(track.collectionId);
   emit trackDataLoaded(track, std::nullopt, true, true);
 }
 
 void Storage::setTrackColor(Track track, std::optional<osmscout::Color> colorOpt){
-  QSqlQuery sql(db);
-  if (colorOpt) {
-    sql.prepare("UPDATE `track` SET `color` = :color, `modification_time` = :modification_time WHERE `id` = :trackId");
-    sql.bindValue(":color", QString::fromStdString(colorOpt->ToHexString()));
-  } else {
-    sql.prepare("UPDATE `track` SET `color` = NULL, `modification_time` = :modification_time WHERE `id` = :trackId");
-  }
+  auto sql = prepare("UPDATE `track` SET `color` = :color, `modification_time` = :modification_time WHERE `id` = :trackId");
+  sql.bindValue(":color", colorOpt ? QVariant(QString::fromStdString(colorOpt->ToHexString())) : QVariant());
 
   sql.bindValue(":trackId", track.id);
   sql.bindValue(":modification_time", dateTimeToSQL(QDateTime::currentDateTime()));
@@ -2265,29 +4593,232 @@ void Storage::setTrackColor(Track track, std::optional<osmscout::Color> colorOpt
   // qDebug() << sql.executedQuery() << " ... " << sql.boundValues();
 
   if (sql.lastError().isValid()) {
-    loadCollectionDetails(Collection(track.collectionId));
+    collectionModified(track.collectionId);
     emit trackDataLoaded(track, std::nullopt, true, false);
     qWarning() << "Setting color failed: " << sql.lastError();
     return;
   }
 
   if (!loadTrackDataPrivate(track, std::nullopt)){
-    loadCollectionDetails(Collection(track.collectionId));
+    collectionModified(track.collectionId);
     emit trackDataLoaded(track, std::nullopt, true, false);
     return;
   }
 
-  loadCollectionDetails(Collection(track.collectionId));
+  collectionModified(track.collectionId);
   emit trackDataLoaded(track, std::nullopt, true, true);
 }
 
+void Storage::compactDatabase()
+{
+  if (!checkAccess(__FUNCTION__)){
+    emit databaseCompacted(false);
+    return;
+  }
+  QElapsedTimer timer;
+  timer.start();
+  // VACUUM rebuilds whole database file, auto_vacuum mode is changed by it
+  QSqlQuery q = db.exec("PRAGMA auto_vacuum = INCREMENTAL;");
+  if (!q.lastError().isValid()) {
+    q = db.exec("VACUUM;");
+  }
+  if (q.lastError().isValid()) {
+    qWarning() << "Database vacuum failed:" << q.lastError();
+    emit error(tr("Database compaction failed: %1").arg(q.lastError().text()));
+    emit databaseCompacted(false);
+    return;
+  }
+  qDebug() << "Vacuum took" << timer.elapsed() << "ms";
+  emit databaseCompacted(true);
+}
+
+void Storage::archiveTrack(Track track)
+{
+  if (!checkAccess(__FUNCTION__)){
+    return;
+  }
+  if (!loadTrackMetadata(track)) {
+    return;
+  }
+  if (track.open) {
+    qWarning() << "Open track" << track.id << "cannot be archived";
+    emit error(tr("Open track cannot be archived"));
+    return;
+  }
+
+  auto sqlArchived = prepare("SELECT 1 FROM `track_archive` WHERE `track_id` = :trackId;");
+  sqlArchived.execValues(track.id);
+  if (sqlArchived.lastError().isValid()) {
+    qWarning() << "Archiving track" << track.id << "failed" << sqlArchived.lastError();
+    emit error(tr("Archiving track failed: %1").arg(sqlArchived.lastError().text()));
+    return;
+  }
+  if (sqlArchived.next()) {
+    return; // archived already
+  }
+  sqlArchived.finish();
+
+  auto sqlSegments = prepare("SELECT `id` FROM `track_segment` WHERE `track_id` = :trackId ORDER BY `id`;");
+  sqlSegments.execValues(track.id);
+  if (sqlSegments.lastError().isValid()) {
+    qWarning() << "Archiving track" << track.id << "failed" << sqlSegments.lastError();
+    emit error(tr("Archiving track failed: %1").arg(sqlSegments.lastError().text()));
+    return;
+  }
+  std::vector<qint64> segmentIds;
+  while (sqlSegments.next()) {
+    segmentIds.push_back(varToLong(sqlSegments.value(0)));
+  }
+  sqlSegments.finish();
+
+  gpx::Track trk;
+  size_t pointCount = 0;
+  for (qint64 segmentId: segmentIds) {
+    gpx::TrackSegment &segment = trk.segments.emplace_back();
+    if (!loadTrackPoints(segmentId, segment)) {
+      return;
+    }
+    pointCount += segment.points.size();
+  }
+
+  QDir archiveDir(directory.filePath("archive"));
+  if (!archiveDir.mkpath(archiveDir.path())) {
+    qWarning() << "Failed to create directory" << archiveDir;
+    emit error(tr("Archiving track failed: %1").arg(archiveDir.path()));
+    return;
+  }
+  // new file name for every archive, so the file mapped by reader is never rewritten
+  QString file = QString("track-%1-%2.bin").arg(track.id).arg(QDateTime::currentMSecsSinceEpoch());
+  if (!TrackArchive::write(archiveDir.filePath(file), segmentIds, trk)) {
+    emit error(tr("Archiving track failed: %1").arg(archiveDir.filePath(file)));
+    return;
+  }
+  std::shared_ptr<const TrackArchive> archive = openArchive(file);
+  if (!archive || archive->pointCount() != pointCount) {
+    qWarning() << "Verification of track archive" << file << "failed";
+    emit error(tr("Archiving track failed: %1").arg(archiveDir.filePath(file)));
+    QFile::remove(archiveDir.filePath(file));
+    return;
+  }
+
+  auto fail = [&](const QSqlError &err) {
+    qWarning() << "Archiving track" << track.id << "failed" << err;
+    emit error(tr("Archiving track failed: %1").arg(err.text()));
+    db.rollback();
+    // file is removed by idle maintenance, it may be mapped by reader already
+  };
+
+  db.transaction();
+  auto sqlArchive = prepare("INSERT INTO `track_archive` (`track_id`, `file`, `point_count`) VALUES (:trackId, :file, :pointCount);");
+  sqlArchive.execValues(track.id, file, qint64(pointCount));
+  if (sqlArchive.lastError().isValid()) {
+    return fail(sqlArchive.lastError());
+  }
+  for (const QString &table: {QString("track_segment_data"), QString("track_point")}) {
+    auto sql = prepare(QString("DELETE FROM `%1` WHERE `segment_id` IN (SELECT `id` FROM `track_segment` WHERE `track_id` = :trackId);").arg(table));
+    sql.execValues(track.id);
+    if (sql.lastError().isValid()) {
+      return fail(sql.lastError());
+    }
+  }
+  if (!db.commit()) {
+    return fail(db.lastError());
+  }
+  qDebug() << "Track" << track.id << "archived," << pointCount << "points in" << file;
+}
+
+bool Storage::unarchiveTrack(qint64 trackId)
+{
+  auto sql = prepare("SELECT `file` FROM `track_archive` WHERE `track_id` = :trackId;");
+  sql.execValues(trackId);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading archive of track" << trackId << "failed" << sql.lastError();
+    emit error(tr("Loading archive of track %1 failed: %2").arg(trackId).arg(sql.lastError().text()));
+    return false;
+  }
+  if (!sql.next()) {
+    return true; // not archived
+  }
+  QString file = sql.value(0).toString();
+  sql.finish();
+
+  std::shared_ptr<const TrackArchive> archive = openArchive(file);
+  if (!archive) {
+    qWarning() << "Loading archive of track" << trackId << "failed";
+    emit error(tr("Loading archive of track %1 failed: %2").arg(trackId).arg(file));
+    return false;
+  }
+
+  db.transaction();
+  std::vector<gpx::TrackPoint> points;
+  points.reserve(TrackPointChunkSize);
+  for (size_t i = 0; i < archive->segmentCount(); i++) {
+    TrackArchive::SegmentView view = archive->segment(i);
+    // points are packed to chunks directly from the mapped file, one chunk at a time
+    for (size_t from = 0; from < view.size(); from += TrackPointChunkSize) {
+      size_t to = std::min(view.size(), from + TrackPointChunkSize);
+      points.clear();
+      for (size_t p = from; p < to; p++) {
+        points.push_back(view.point(p));
+      }
+      if (!insertTrackPointChunks(points, 0, view.segmentId(), qint64(from / TrackPointChunkSize), qint64(from))) {
+        db.rollback();
+        return false;
+      }
+    }
+  }
+  auto sqlDelete = prepare("DELETE FROM `track_archive` WHERE `track_id` = :trackId;");
+  sqlDelete.execValues(trackId);
+  if (sqlDelete.lastError().isValid() || !db.commit()) {
+    QSqlError err = sqlDelete.lastError().isValid() ? sqlDelete.lastError() : db.lastError();
+    qWarning() << "Restoring archive of track" << trackId << "failed" << err;
+    emit error(tr("Restoring archive of track %1 failed: %2").arg(trackId).arg(err.text()));
+    db.rollback();
+    return false;
+  }
+  // archive file is removed by idle maintenance
+  return true;
+}
+
+void Storage::removeUnusedArchives()
+{
+  QDir archiveDir(directory.filePath("archive"));
+  if (!archiveDir.exists()) {
+    return;
+  }
+  QSqlQuery q = db.exec("SELECT `file` FROM `track_archive`;");
+  if (q.lastError().isValid()) {
+    qWarning() << "Loading track archives failed:" << q.lastError();
+    return;
+  }
+  QSet<QString> used;
+  while (q.next()) {
+    used << q.value(0).toString();
+  }
+
+  // temporary files are leftovers of interrupted write
+  for (const QString &file: archiveDir.entryList({"*.bin", "*.tmp"}, QDir::Files)) {
+    if (used.contains(file)) {
+      continue;
+    }
+    QString path = archiveDir.filePath(file);
+    {
+      QMutexLocker locker(&archiveCacheMutex);
+      archiveCache.erase(std::remove_if(archiveCache.begin(), archiveCache.end(),
+                                        [&path](const auto &archive) { return archive->path() == path; }),
+                         archiveCache.end());
+    }
+    qDebug() << "Removing unused track archive" << path;
+    QFile::remove(path);
+  }
+}
+
 void Storage::loadRecentOpenTrack(){
   if (!checkAccess(__FUNCTION__)){
     return;
   }
 
-  QSqlQuery sqlTrack(db);
-  sqlTrack.prepare("SELECT * FROM `track` WHERE `open` ORDER BY `creation_time` DESC LIMIT 1;");
+  auto sqlTrack = prepare("SELECT * FROM `track` WHERE `open` ORDER BY `creation_time` DESC LIMIT 1;");
   sqlTrack.exec();
 
   if (sqlTrack.lastError().isValid()) {
@@ -2303,13 +4834,12 @@ void Storage::loadRecentOpenTrack(){
   }
 }
 
-bool Storage::createSegment(qint64 trackId, qint64 &segmentId)
+bool Storage::createSegment(qint64 trackId, qint64 &segmentId, bool open)
 {
-  QSqlQuery sqlSeg(db);
-  sqlSeg.prepare("INSERT INTO `track_segment` (`track_id`, `open`, `creation_time`, `distance`) VALUES (:track_id, :open, :creation_time, :distance)");
+  auto sqlSeg = prepare("INSERT INTO `track_segment` (`track_id`, `open`, `creation_time`, `distance`) VALUES (:track_id, :open, :creation_time, :distance)");
 
   sqlSeg.bindValue(":track_id", trackId);
-  sqlSeg.bindValue(":open", true);
+  sqlSeg.bindValue(":open", open);
 
   // TODO: do we need segment statics?
   sqlSeg.bindValue(":creation_time", dateTimeToSQL(QDateTime::currentDateTime()));
@@ -2324,6 +4854,141 @@ bool Storage::createSegment(qint64 trackId, qint64 &segmentId)
   return true;
 }
 
+void Storage::compactJournal(qint64 trackId, TrackStatistics statistics)
+{
+  if (!checkAccess(__FUNCTION__)){
+    return;
+  }
+
+  QSet<qint64> collections;
+  if (!compactJournalPrivate(trackId, statistics, collections)) {
+    emit error(tr("Failed to append nodes to track"));
+  }
+  for (qint64 collectionId: collections) {
+    collectionModified(collectionId);
+  }
+}
+
+bool Storage::compactJournalPrivate(qint64 trackId,
+                                    const std::optional<TrackStatistics> &statistics,
+                                    QSet<qint64> &collections)
+{
+  qint64 storedGeneration = -1;
+  qint64 storedOffset = -1;
+  auto sqlOffset = prepare("SELECT `generation`, `offset` FROM `track_journal` WHERE `id` = 0;");
+  sqlOffset.exec();
+  if (sqlOffset.lastError().isValid()) {
+    qWarning() << "Loading track journal position failed" << sqlOffset.lastError();
+    return false;
+  }
+  if (sqlOffset.next()) {
+    storedGeneration = varToLong(sqlOffset.value("generation"));
+    storedOffset = varToLong(sqlOffset.value("offset"));
+  }
+  sqlOffset.finish();
+
+  // records compacted already are skipped, journal generation is changed just by reset from this thread
+  std::vector<TrackJournal::Record> records;
+  qint64 generation;
+  qint64 end;
+  if (!journal.read(journal.currentGeneration() == storedGeneration ? storedOffset : -1, records, generation, end)) {
+    return false;
+  }
+  if (records.empty()) {
+    journal.reset(generation, end);
+    return true;
+  }
+
+  db.transaction();
+  auto rollback = [this](){
+    if (!db.rollback()) {
+      qWarning() << "Transaction rollback failed" << db.lastError();
+    }
+  };
+
+  // consecutive points of the same track segment are appended together
+  QSet<qint64> tracks;
+  for (size_t i = 0; i < records.size();) {
+    qint64 recordTrackId = records[i].trackId;
+    size_t next = i + 1;
+    while (next < records.size() && records[next].trackId == recordTrackId && !records[next].newSegment) {
+      next++;
+    }
+
+    qint64 collectionId;
+    if (!trackCollection(recordTrackId, collectionId)) {
+      // track was deleted meanwhile
+      i = next;
+      continue;
+    }
+
+    qint64 segmentId = -1;
+    if (!records[i].newSegment) {
+      auto sqlSegment = prepare("SELECT MAX(`id`) AS `segment_id` FROM `track_segment` WHERE `track_id` = :id;");
+      sqlSegment.execValues(recordTrackId);
+      if (sqlSegment.lastError().isValid()) {
+        qWarning() << "Evaluating last segment failed" << sqlSegment.lastError();
+        rollback();
+        return false;
+      }
+      if (sqlSegment.next() && !sqlSegment.value("segment_id").isNull()) {
+        segmentId = varToLong(sqlSegment.value("segment_id"));
+      }
+    }
+    if (segmentId < 0 && !createSegment(recordTrackId, segmentId)) {
+      rollback();
+      return false;
+    }
+
+    std::vector<gpx::TrackPoint> points;
+    points.reserve(next - i);
+    for (size_t j = i; j < next; j++) {
+      points.push_back(records[j].point);
+    }
+    if (!appendTrackPoints(points, segmentId)) {
+      rollback();
+      return false;
+    }
+    tracks.insert(recordTrackId);
+    collections.insert(collectionId);
+    i = next;
+  }
+
+  for (qint64 id: tracks) {
+    // statistics accumulated by tracker are used when available, merged from segments otherwise
+    TrackStatistics trackStatistics;
+    if (id == trackId && statistics) {
+      trackStatistics = *statistics;
+    } else if (!mergeSegmentStatistics(id, trackStatistics)) {
+      rollback();
+      return false;
+    }
+    if (!updateTrackStatistics(id, trackStatistics)) {
+      rollback();
+      return false;
+    }
+  }
+
+  auto sqlStore = prepare("INSERT OR REPLACE INTO `track_journal` (`id`, `generation`, `offset`) VALUES (0, :generation, :offset);");
+  sqlStore.execValues(generation, end);
+  if (sqlStore.lastError().isValid()) {
+    qWarning() << "Storing track journal position failed" << sqlStore.lastError();
+    rollback();
+    return false;
+  }
+
+  if (!db.commit()) {
+    qWarning() << "Transaction commit failed" << db.lastError();
+    emit error(tr("Transaction commit failed: %1").arg(db.lastError().text()));
+    return false;
+  }
+  qDebug() << "Compacted" << records.size() << "points from track journal";
+
+  // fails when tracker appended meanwhile, journal is reset by the next compaction then
+  journal.reset(generation, end);
+  return true;
+}
+
 void Storage::appendNodes(qint64 trackId,
                           std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> batch,
                           TrackStatistics statistics,
@@ -2335,10 +5000,8 @@ void Storage::appendNodes(qint64 trackId,
 
   assert(batch);
 
-  QSqlQuery sqlSegment(db);
-  sqlSegment.prepare("SELECT MAX(`id`) AS `segment_id` FROM `track_segment` WHERE `track_id` = :id;");
-  sqlSegment.bindValue(":id", trackId);
-  sqlSegment.exec();
+  auto sqlSegment = prepare("SELECT MAX(`id`) AS `segment_id` FROM `track_segment` WHERE `track_id` = :id;");
+  sqlSegment.execValues(trackId);
 
   if (sqlSegment.lastError().isValid()) {
     qWarning() << "Evaluating last segment failed" << sqlSegment.lastError();
@@ -2382,19 +5045,17 @@ void Storage::appendNodes(qint64 trackId,
   }
 
   if (!updateTrackStatistics(trackId, statistics)) {
-    loadCollectionDetails(Collection(collectionId));
+    collectionModified(collectionId);
     return;
   }
 
-  loadCollectionDetails(Collection(collectionId));
+  collectionModified(collectionId);
 }
 
 bool Storage::trackCollection(qint64 trackId, qint64 &collectionId)
 {
-  QSqlQuery sqlSegment(db);
-  sqlSegment.prepare("SELECT `collection_id` FROM `track` WHERE `id` = :id;");
-  sqlSegment.bindValue(":id", trackId);
-  sqlSegment.exec();
+  auto sqlSegment = prepare("SELECT `collection_id` FROM `track` WHERE `id` = :id;");
+  sqlSegment.execValues(trackId);
 
   if (sqlSegment.lastError().isValid()) {
     qWarning() << "Cannot obtain collection id" << sqlSegment.lastError();
@@ -2423,8 +5084,7 @@ void Storage::loadSearchHistory(){
   }
 
   std::vector<SearchItem> items;
-  QSqlQuery sqlRecent(db);
-  sqlRecent.prepare("SELECT `pattern`, `last_usage` FROM `search_history` ORDER BY `last_usage` DESC LIMIT 50;");
+  auto sqlRecent = prepare("SELECT `pattern`, `last_usage` FROM `search_history` ORDER BY `last_usage` DESC LIMIT 50;");
   sqlRecent.exec();
   if (sqlRecent.lastError().isValid()) {
     qWarning() << "Cannot load search history" << sqlRecent.lastError();
@@ -2449,10 +5109,9 @@ void Storage::addSearchPattern(QString pattern){
     return;
   }
 
-  QSqlQuery sqlInsert(db);
-  sqlInsert.prepare("INSERT OR REPLACE INTO `search_history` (`pattern`, `last_usage`) VALUES(:pattern, :last_usage);");
+  auto sqlInsert = prepare("INSERT OR REPLACE INTO `search_history` (`pattern`, `last_usage`) VALUES(:pattern, :last_usage);");
   sqlInsert.bindValue(":pattern", pattern);
-  sqlInsert.bindValue(":last_usage", QDateTime::currentDateTime());
+  sqlInsert.bindValue(":last_usage", dateTimeToSQL(QDateTime::currentDateTime()));
   sqlInsert.exec();
 
   if (sqlInsert.lastError().isValid()) {
@@ -2462,8 +5121,7 @@ void Storage::addSearchPattern(QString pattern){
   }
 
   // cleanup 100 oldest entries, keep 50 recent
-  QSqlQuery sqlRecent(db);
-  sqlRecent.prepare(QString("DELETE FROM `search_history` WHERE `pattern` IN ")
+  auto sqlRecent = prepare(QString("DELETE FROM `search_history` WHERE `pattern` IN ")
                        .append("(SELECT `pattern` FROM `search_history` ORDER BY `last_usage` DESC LIMIT 50,100);"));
   sqlRecent.exec();
 
@@ -2481,8 +5139,7 @@ void Storage::removeSearchPattern(QString pattern){
     return;
   }
 
-  QSqlQuery sqlInsert(db);
-  sqlInsert.prepare("DELETE FROM `search_history` WHERE `pattern` = :pattern;");
+  auto sqlInsert = prepare("DELETE FROM `search_history` WHERE `pattern` = :pattern;");
   sqlInsert.bindValue(":pattern", pattern);
   sqlInsert.exec();
 
@@ -2495,55 +5152,241 @@ void Storage::removeSearchPattern(QString pattern){
   loadSearchHistory();
 }
 
-void Storage::loadNearbyWaypoints(const osmscout::GeoCoord &center, const osmscout::Distance &distance)
+void Storage::loadNearbyWaypoints(const osmscout::GeoCoord &center, const osmscout::Distance &distance, int limit)
 {
-  if (!checkAccess(__FUNCTION__)){
-    return;
+  dispatchRead(__FUNCTION__, [=](){
+    loadNearbyWaypointsPrivate(center, distance, limit);
+  }, [=](){
+    emit nearbyWaypoints(center, distance, std::vector<WaypointNearby>());
+  });
+}
+
+void Storage::searchItems(const QString &pattern, int limit)
+{
+  dispatchRead(__FUNCTION__, [=](){
+    std::vector<SearchResult> results;
+    bool success = searchItemsPrivate(pattern, limit, results);
+    emit itemsFound(pattern, std::make_shared<const std::vector<SearchResult>>(std::move(results)), success);
+  }, [=](){
+    emit itemsFound(pattern, std::make_shared<const std::vector<SearchResult>>(), false);
+  });
+}
+
+bool Storage::searchItemsPrivate(const QString &pattern, int limit, std::vector<SearchResult> &results)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  QString query = searchIndex ? ftsQuery(pattern) : pattern.trimmed();
+  if (query.isEmpty()) {
+    return true;
+  }
+  qint64 sqlLimit = limit > 0 ? limit : -1; // negative LIMIT is unlimited in SQLite
+
+  // column weights: name is the most relevant
+  QString waypointSql;
+  QString trackSql;
+  if (searchIndex) {
+    waypointSql = QString("SELECT `waypoint`.*, bm25(`waypoint_fts`, 10.0, 2.0, 1.0) AS `rank` FROM `waypoint_fts` ")
+      .append("JOIN `waypoint` ON `waypoint`.`id` = `waypoint_fts`.`rowid` ")
+      .append("WHERE `waypoint_fts` MATCH :query ORDER BY `rank` LIMIT :limit;");
+    trackSql = QString("SELECT `track`.*, bm25(`track_fts`, 10.0, 2.0) AS `rank` FROM `track_fts` ")
+      .append("JOIN `track` ON `track`.`id` = `track_fts`.`rowid` ")
+      .append("WHERE `track_fts` MATCH :query ORDER BY `rank` LIMIT :limit;");
+  } else {
+    // without index, just name prefix matches are ranked before other matches
+    waypointSql = QString("SELECT *, (CASE WHEN `name` LIKE :query || '%' THEN -1 ELSE 0 END) AS `rank` FROM `waypoint` ")
+      .append("WHERE `name` LIKE '%' || :query2 || '%' OR `description` LIKE '%' || :query3 || '%' OR `symbol` LIKE '%' || :query4 || '%' ")
+      .append("ORDER BY `rank` LIMIT :limit;");
+    trackSql = QString("SELECT *, (CASE WHEN `name` LIKE :query || '%' THEN -1 ELSE 0 END) AS `rank` FROM `track` ")
+      .append("WHERE `name` LIKE '%' || :query2 || '%' OR `description` LIKE '%' || :query3 || '%' ")
+      .append("ORDER BY `rank` LIMIT :limit;");
+  }
+
+  auto sqlWaypoints = prepare(waypointSql);
+  if (searchIndex) {
+    sqlWaypoints.execValues(query, sqlLimit);
+  } else {
+    sqlWaypoints.execValues(query, query, query, query, sqlLimit);
+  }
+  if (sqlWaypoints.lastError().isValid()) {
+    qWarning() << "Waypoint search failed" << sqlWaypoints.lastError();
+    emit error(tr("Waypoint search failed: %1").arg(sqlWaypoints.lastError().text()));
+    return false;
   }
+  while (sqlWaypoints.next()) {
+    results.push_back(SearchResult{varToLong(sqlWaypoints.value("collection_id")),
+                                   varToDouble(sqlWaypoints.value("rank")),
+                                   makeWaypoint(sqlWaypoints)});
+  }
+  sqlWaypoints.finish();
 
-  osmscout::GeoBox bbox=osmscout::GeoBox::BoxByCenterAndRadius(center, distance);
+  auto sqlTracks = prepare(trackSql);
+  if (searchIndex) {
+    sqlTracks.execValues(query, sqlLimit);
+  } else {
+    sqlTracks.execValues(query, query, query, sqlLimit);
+  }
+  if (sqlTracks.lastError().isValid()) {
+    qWarning() << "Track search failed" << sqlTracks.lastError();
+    emit error(tr("Track search failed: %1").arg(sqlTracks.lastError().text()));
+    return false;
+  }
+  while (sqlTracks.next()) {
+    Track track = makeTrack(sqlTracks);
+    qint64 collectionId = track.collectionId;
+    results.push_back(SearchResult{collectionId,
+                                   varToDouble(sqlTracks.value("rank")),
+                                   std::move(track)});
+  }
 
-  std::vector<WaypointNearby> waypoints;
-  QSqlQuery sql(db);
-  sql.prepare(QString("SELECT * FROM `waypoint` WHERE ")
-                      .append("`latitude` >= :minLat AND ")
-                      .append("`latitude` <= :maxLat AND ")
-                      .append("`longitude` >= :minLon AND ")
-                      .append("`longitude` <= :maxLon")
-                      .append(";"));
-
-  sql.bindValue(":minLat", bbox.GetMinLat());
-  sql.bindValue(":maxLat", bbox.GetMaxLat());
-  sql.bindValue(":minLon", bbox.GetMinLon());
-  sql.bindValue(":maxLon", bbox.GetMaxLon());
+  // both lists are ordered already, merge them
+  std::stable_sort(results.begin(), results.end(), [](const SearchResult &a, const SearchResult &b){
+    return a.rank < b.rank;
+  });
+  if (limit > 0 && results.size() > size_t(limit)) {
+    results.resize(limit);
+  }
+  qDebug() << "Found" << results.size() << "items matching" << pattern << "in" << timer.elapsed() << "ms";
+  return true;
+}
 
-  sql.exec();
+bool Storage::loadWaypointsInRadius(const osmscout::GeoCoord &center,
+                                    const osmscout::Distance &radius,
+                                    std::vector<WaypointNearby> &waypoints)
+{
+  osmscout::GeoBox bbox=osmscout::GeoBox::BoxByCenterAndRadius(center, radius);
+
+  QString sqlStr;
+  if (waypointIndex) {
+    sqlStr = QString("SELECT `waypoint`.* FROM `waypoint_rtree` ")
+      .append("JOIN `waypoint` ON `waypoint`.`id` = `waypoint_rtree`.`id` WHERE ")
+      .append("`waypoint_rtree`.`max_lat` >= :minLat AND ")
+      .append("`waypoint_rtree`.`min_lat` <= :maxLat AND ")
+      .append("`waypoint_rtree`.`max_lon` >= :minLon AND ")
+      .append("`waypoint_rtree`.`min_lon` <= :maxLon")
+      .append(";");
+  } else {
+    sqlStr = QString("SELECT * FROM `waypoint` WHERE ")
+      .append("`latitude` >= :minLat AND ")
+      .append("`latitude` <= :maxLat AND ")
+      .append("`longitude` >= :minLon AND ")
+      .append("`longitude` <= :maxLon")
+      .append(";");
+  }
+
+  auto sql = prepare(sqlStr);
+  sql.execValues(bbox.GetMinLat(), bbox.GetMaxLat(), bbox.GetMinLon(), bbox.GetMaxLon());
   if (sql.lastError().isValid()) {
     qWarning() << "Cannot load nearby waypoints" << sql.lastError();
     emit error("Cannot load nearby waypoints");
-    return;
+    return false;
   }
 
   while (sql.next()) {
     auto wpt = makeWaypoint(sql);
     auto wptDist = osmscout::GetSphericalDistance(center, wpt.data.coord);
-    if (wptDist <= distance) {
+    if (wptDist <= radius) {
       waypoints.push_back(std::make_tuple(
         wptDist,
         wpt));
     }
   }
+  return true;
+}
+
+void Storage::loadNearbyWaypointsPrivate(const osmscout::GeoCoord &center, const osmscout::Distance &distance, int limit)
+{
+  std::vector<WaypointNearby> waypoints;
+
+  // k-nearest search: radius is expanding until there is enough waypoints
+  // within the radius, all waypoints closer than that are found already
+  osmscout::Distance radius = distance;
+  if (limit > 0 && NearbyWaypointsInitialRadius < distance.AsMeter()) {
+    radius = osmscout::Meters(NearbyWaypointsInitialRadius);
+  }
+  while (true) {
+    waypoints.clear();
+    if (!loadWaypointsInRadius(center, radius, waypoints)) {
+      return;
+    }
+    if (radius >= distance || (limit > 0 && waypoints.size() >= size_t(limit))) {
+      break;
+    }
+    radius = osmscout::Meters(std::min(distance.AsMeter(), radius.AsMeter() * 4));
+  }
 
-  std::sort(waypoints.begin(), waypoints.end(), [&center](const WaypointNearby &a, const WaypointNearby &b){
+  std::sort(waypoints.begin(), waypoints.end(), [](const WaypointNearby &a, const WaypointNearby &b){
     return std::get<0>(a) < std::get<0>(b);
   });
+  if (limit > 0 && waypoints.size() > size_t(limit)) {
+    waypoints.resize(limit);
+  }
 
   qDebug() << "Found" << waypoints.size() << "waypoints in"
-           << distance.AsMeter() << "meters from"
+           << radius.AsMeter() << "meters from"
            << QString::fromStdString(center.GetDisplayText());
   emit nearbyWaypoints(center, distance, waypoints);
 }
 
+void Storage::loadTracksInBox(const osmscout::GeoBox &box, int zoom)
+{
+  dispatchRead(__FUNCTION__, [=](){
+    std::vector<Track> tracks;
+    bool success = loadTracksInBoxPrivate(box, zoom, tracks);
+    emit tracksInBoxLoaded(box, zoom, std::make_shared<const std::vector<Track>>(std::move(tracks)), success);
+  }, [=](){
+    emit tracksInBoxLoaded(box, zoom, std::make_shared<const std::vector<Track>>(), false);
+  });
+}
+
+bool Storage::loadTracksInBoxPrivate(const osmscout::GeoBox &box, int zoom, std::vector<Track> &tracks)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  QString sqlStr("SELECT `track`.* FROM ");
+  if (trackIndex) {
+    sqlStr.append("`track_rtree` ")
+      .append("JOIN `track` ON `track`.`id` = `track_rtree`.`id` ")
+      .append("JOIN `collection` ON `collection`.`id` = `track`.`collection_id` WHERE ")
+      .append("`track_rtree`.`max_lat` >= :minLat AND ")
+      .append("`track_rtree`.`min_lat` <= :maxLat AND ")
+      .append("`track_rtree`.`max_lon` >= :minLon AND ")
+      .append("`track_rtree`.`min_lon` <= :maxLon AND ");
+  } else {
+    sqlStr.append("`track` ")
+      .append("JOIN `collection` ON `collection`.`id` = `track`.`collection_id` WHERE ")
+      .append("`track`.`bbox_min_lat` >= -90 AND ")
+      .append("`track`.`bbox_max_lat` >= :minLat AND ")
+      .append("`track`.`bbox_min_lat` <= :maxLat AND ")
+      .append("`track`.`bbox_max_lon` >= :minLon AND ")
+      .append("`track`.`bbox_min_lon` <= :maxLon AND ");
+  }
+  // skip tracks smaller than one pixel on given zoom level
+  sqlStr.append("(`track`.`bbox_max_lat` - `track`.`bbox_min_lat` >= :minSize OR ")
+    .append("`track`.`bbox_max_lon` - `track`.`bbox_min_lon` >= :minSize2) AND ")
+    .append("`track`.`visible` AND `collection`.`visible`;");
+
+  double minSize = 360.0 / (256.0 * std::pow(2.0, std::max(0, zoom)));
+
+  auto sql = prepare(sqlStr);
+  sql.execValues(box.GetMinLat(), box.GetMaxLat(), box.GetMinLon(), box.GetMaxLon(), minSize, minSize);
+  if (sql.lastError().isValid()) {
+    qWarning() << "Loading tracks in box failed" << sql.lastError();
+    emit error(tr("Loading tracks in box failed: %1").arg(sql.lastError().text()));
+    return false;
+  }
+
+  while (sql.next()) {
+    tracks.push_back(makeTrack(sql));
+  }
+  qDebug() << "Found" << tracks.size() << "tracks in"
+           << QString::fromStdString(box.GetDisplayText())
+           << "(zoom" << zoom << ") in" << timer.elapsed() << "ms";
+  return true;
+}
+
 Storage::operator bool() const
 {
   return ok;
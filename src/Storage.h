@@ -23,31 +23,33 @@
 #include <osmscoutgpx/Utils.h>
 #include <osmscoutgpx/GpxFile.h>
 #include <osmscout/util/GeoBox.h>
+#include <osmscout/util/Breaker.h>
+
+#include "StatementCache.h"
+#include "StorageMetrics.h"
+#include "TrackArchive.h"
+#include "TrackDataCache.h"
+#include "TrackJournal.h"
 
 #include <QObject>
 
 #include <QtSql/QSqlDatabase>
 #include <QtSql/QSqlError>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSet>
+#include <QTimer>
 #include <QtCore/QDateTime>
 
 #include <atomic>
+#include <functional>
+#include <memory>
 #include <optional>
+#include <variant>
 
-class ErrorCallback: public QObject, public osmscout::gpx::ProcessCallback
-{
-  Q_OBJECT
-  Q_DISABLE_COPY(ErrorCallback)
-
-signals:
-  void error(QString);
-
-public:
-  ErrorCallback() = default;
-  virtual ~ErrorCallback() = default;
-
-  virtual void Error(const std::string &error) override;
-};
+class StorageReader;
+struct GpxImportRecord;
 
 class TrackStatistics
 {
@@ -102,6 +104,12 @@ public:
     return std::chrono::duration_cast<std::chrono::milliseconds>(movingDuration).count();
   }
 
+  /**
+   * Merge statistics of track segments (in track order). Accumulator state is flushed
+   * on segment end, so merged statistics are equal to statistics accumulated for whole track.
+   */
+  static TrackStatistics merge(const std::vector<TrackStatistics> &segments);
+
   bool operator==(const TrackStatistics &o){
     bool bboxEquals = bbox.IsValid() == o.bbox.IsValid();
     if (bboxEquals && bbox.IsValid()) {
@@ -291,6 +299,20 @@ private:
   ElevationFilter elevationFilter;
 };
 
+/**
+ * State of GPX import writer, see Storage::importCollection
+ */
+struct GpxImportState
+{
+  QString filePath;
+  qint64 collectionId{-1};
+  qint64 trackId{-1};
+  qint64 segmentId{-1};
+  int waypointCount{0};
+  int trackCount{0};
+  qint64 pointCount{0};
+};
+
 class Track
 {
 public:
@@ -328,6 +350,7 @@ public:
 
   TrackStatistics statistics;
   std::shared_ptr<osmscout::gpx::Track> data;
+  std::shared_ptr<const ArchivedTrackData> archive; //!< set instead of data for loaded archived track
 };
 
 class Waypoint
@@ -373,15 +396,45 @@ public:
   QString name;
   QString description;
 
-  std::shared_ptr<std::vector<Track>> tracks;
-  std::shared_ptr<std::vector<Waypoint>> waypoints;
+  // aggregates, filled by collection list loading
+  qint64 waypointCount{0};
+  qint64 hiddenWaypointCount{0};
+  qint64 trackCount{0};
+  qint64 hiddenTrackCount{0};
+  osmscout::Distance distance; //!< sum of track distances
+  QDateTime from; //!< start of the oldest track
+  QDateTime to; //!< end of the newest track
+
+  std::shared_ptr<const std::vector<Track>> tracks;
+  std::shared_ptr<const std::vector<Waypoint>> waypoints;
 };
 
+/** collection entry, see Storage::loadCollectionItems */
+using CollectionItem = std::variant<Track, Waypoint>;
+
+/**
+ * Immutable snapshots emitted by Storage signals. Queued connection copies just
+ * the pointer, so one loaded result is shared by all receivers.
+ */
+using CollectionSnapshot = std::shared_ptr<const Collection>;
+using CollectionListSnapshot = std::shared_ptr<const std::vector<Collection>>;
+using TrackListSnapshot = std::shared_ptr<const std::vector<Track>>;
+using CollectionItemsSnapshot = std::shared_ptr<const std::vector<CollectionItem>>;
+
 struct SearchItem {
   QString pattern;
   QDateTime lastUsage;
 };
 
+/** full-text search result, see Storage::searchItems */
+struct SearchResult {
+  qint64 collectionId{-1};
+  double rank{0}; //!< bm25 score, lower is better
+  CollectionItem item;
+};
+
+using SearchResultsSnapshot = std::shared_ptr<const std::vector<SearchResult>>;
+
 class Storage : public QObject{
   Q_OBJECT
   Q_DISABLE_COPY(Storage)
@@ -397,11 +450,44 @@ signals:
   void initialised();
   void initialisationError(QString error);
 
-  void collectionsLoaded(std::vector<Collection> collections, bool ok);
-  void collectionDetailsLoaded(Collection collection, bool ok);
+  /**
+   * Progress of background data migration, it is started after initialisation.
+   * Data that are not migrated yet stay readable.
+   *
+   * @param step human readable name of current step
+   * @param done processed segments of current step
+   * @param total segments of current step
+   */
+  void migrationProgress(QString step, qint64 done, qint64 total);
+  void migrationFinished(bool ok);
+
+  void collectionsLoaded(CollectionListSnapshot collections, bool ok);
+  void collectionDetailsLoaded(CollectionSnapshot collection, bool ok);
+  /**
+   * Content of the collection was modified. It is cheap notification (coalesced per event loop turn),
+   * consumers should request collection items or details they need.
+   */
+  void collectionChanged(qint64 collectionId);
+  /**
+   * Page of collection items. Collection contains metadata and aggregates,
+   * total item count is waypointCount + trackCount.
+   */
+  void collectionItemsLoaded(CollectionSnapshot collection, int ordering, bool waypointFirst, qint64 offset,
+                             CollectionItemsSnapshot items, bool ok);
   void trackDataLoaded(Track track, std::optional<double>, bool complete, bool ok);
+  /**
+   * Chunk of track points decoded during progressive loading (see loadTrackData).
+   * Points belongs to given segment (index in the track) from offset, after filtering
+   * by accuracy filter. Points are emitted in order, before complete trackDataLoaded signal.
+   * Chunks of concurrent loads of the same track may interleave, consumer should
+   * accept just chunk with expected segment and offset.
+   */
+  void trackPointsLoaded(qint64 trackId, std::optional<double> accuracyFilter, int segment, qint64 offset,
+                         std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> points);
+  void trackLodLoaded(Track track, int zoom, bool ok);
   void collectionExported(qint64 collectionId, QString file, bool success);
   void trackExported(qint64 trackId, QString file, bool success);
+  void exportProgress(QString file, qint64 pointsWritten);
 
   void trackCreated(qint64 collectionId, qint64 trackId, QString name);
   void waypointCreated(qint64 collectionId, qint64 waypointId, QString name);
@@ -414,8 +500,14 @@ signals:
 
   void searchHistory(std::vector<SearchItem> items);
 
+  void itemsFound(QString pattern, SearchResultsSnapshot results, bool ok);
+
   void nearbyWaypoints(const osmscout::GeoCoord &center, const osmscout::Distance &distance, const std::vector<Storage::WaypointNearby> &waypoints);
 
+  void tracksInBoxLoaded(const osmscout::GeoBox &box, int zoom, TrackListSnapshot tracks, bool ok);
+
+  void databaseCompacted(bool ok);
+
   void error(QString);
 
 public slots:
@@ -424,21 +516,54 @@ public slots:
   /**
    * load collection list
    * emits collectionsLoaded
+   *
+   * Load is executed in next event loop turn, repeated requests are coalesced.
    */
   void loadCollections();
 
   /**
    * load list of tracks and waypoints
    * emits collectionDetailsLoaded
+   *
+   * Load is executed in next event loop turn, repeated requests
+   * for the same collection are coalesced.
    */
   void loadCollectionDetails(Collection collection);
 
+  /**
+   * load page of collection items (tracks and waypoints) ordered by database,
+   * ordering values matches CollectionModel::Ordering
+   * emits collectionItemsLoaded
+   *
+   * Read slot, processed by read-only connection pool, see dispatchRead
+   */
+  void loadCollectionItems(Collection collection, int ordering, bool waypointFirst, qint64 offset, qint64 limit);
+
   /**
    * load track data
-   * emits trackDataLoaded
+   * emits trackDataLoaded (metadata), trackPointsLoaded for every decoded chunk
+   * and complete trackDataLoaded finally. Points of archived track are not copied,
+   * complete track has archive views instead of data (see ArchivedTrackData)
+   *
+   * Read slot, processed by read-only connection pool, see dispatchRead
    */
   void loadTrackData(Track track, std::optional<double> accuracyFilter);
 
+  /**
+   * load track data simplified for map zoom level (see TrackSimplifier),
+   * raw points are loaded progressively for high zoom levels (archive views for archived track)
+   * emits trackLodLoaded
+   *
+   * Read slot, processed by read-only connection pool, see dispatchRead
+   */
+  void loadTrackLod(Track track, int zoom);
+
+  /**
+   * release cached track data not used longer than idleMs,
+   * it is requested by MemoryManager
+   */
+  void flushCaches(qint64 idleMs);
+
   /**
    * update collection or create it (if id < 0)
    * emits collectionsLoaded signal
@@ -458,12 +583,12 @@ public slots:
   void visibleAll(qint64 id, bool);
 
   /**
-   * emits collectionDetailsLoaded, collectionsLoaded
+   * emits collectionChanged, collectionsLoaded
    */
   void waypointVisibility(qint64 wptId, bool visible);
 
   /**
-   * emits collectionDetailsLoaded, collectionsLoaded
+   * emits collectionChanged, collectionsLoaded
    */
   void trackVisibility(qint64 trackId, bool visible);
 
@@ -476,55 +601,61 @@ public slots:
 
   /**
    * delete waypoint
-   * emits collectionDetailsLoaded, waypointDeleted
+   * emits collectionChanged, waypointDeleted
    */
   void deleteWaypoint(qint64 collectionId, qint64 waypointId);
 
   /**
    * delete waypoint
-   * emits collectionDetailsLoaded, trackDeleted
+   * emits collectionChanged, trackDeleted
    */
   void deleteTrack(qint64 collectionId, qint64 trackId);
 
   /**
    * close track
-   * emits collectionDetailsLoaded
+   * emits collectionChanged
    */
   void closeTrack(qint64 collectionId, qint64 trackId);
 
   /**
    * create waypoint
-   * emits waypointCreated (or error), collectionDetailsLoaded
+   * emits waypointCreated (or error), collectionChanged
    */
   void createWaypoint(qint64 collectionId, double lat, double lon, QString name, QString description, QString symbol);
 
   /**
    * create empty track
-   * emits trackCreated (or error), collectionDetailsLoaded
+   * emits trackCreated (or error), collectionChanged
    */
   void createTrack(qint64 collectionId, QString name, QString description, bool open);
 
   /**
    * edit waypoint
-   * emits collectionDetailsLoaded
+   * emits collectionChanged
    */
   void editWaypoint(qint64 collectionId, qint64 id, QString name, QString description, QString symbol);
 
   /**
    * edit track
-   * emits collectionDetailsLoaded
+   * emits collectionChanged
    */
   void editTrack(qint64 collectionId, qint64 id, QString name, QString description);
 
   /**
-   * emits collectionExported
+   * emits exportProgress and collectionExported,
+   * export may be canceled by the breaker, partial file is removed then
+   *
+   * Read slot, processed by read-only connection pool, see dispatchRead
    */
-  void exportCollection(qint64 collectionId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter);
+  void exportCollection(qint64 collectionId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter, osmscout::BreakerRef breaker);
 
   /**
-   * emits trackExported
+   * emits exportProgress and trackExported,
+   * export may be canceled by the breaker, partial file is removed then
+   *
+   * Read slot, processed by read-only connection pool, see dispatchRead
    */
-  void exportTrack(qint64 collectionId, qint64 trackId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter);
+  void exportTrack(qint64 collectionId, qint64 trackId, QString file, bool includeWaypoints, std::optional<double> accuracyFilter, osmscout::BreakerRef breaker);
 
   /**
    * emit collectionDetailsLoaded for source and target collection
@@ -536,7 +667,7 @@ public slots:
   void moveTrack(qint64 trackId, qint64 collectionId);
 
   /**
-   * emits collectionDetailsLoaded and trackDataLoaded
+   * emits collectionChanged and trackDataLoaded
    *
    * @param track
    * @param position (exclusive, point on that position, and following is keep)
@@ -544,7 +675,7 @@ public slots:
   void cropTrackStart(Track track, quint64 position);
 
   /**
-   * emits collectionDetailsLoaded and trackDataLoaded
+   * emits collectionChanged and trackDataLoaded
    *
    * @param track
    * @param position (inclusive, point on that position and following is removed)
@@ -552,7 +683,7 @@ public slots:
   void cropTrackEnd(Track track, quint64 position);
 
   /**
-   * emits collectionDetailsLoaded and trackDataLoaded (2x)
+   * emits collectionChanged and trackDataLoaded (2x)
    *
    * @param track
    * @param position (exclusive, point on that position is keep)
@@ -560,7 +691,7 @@ public slots:
   void splitTrack(Track track, quint64 position);
 
   /**
-   * emits collectionDetailsLoaded and trackDataLoaded
+   * emits collectionChanged and trackDataLoaded
    *
    * @param track
    * @param accuracyFilter
@@ -568,13 +699,20 @@ public slots:
   void filterTrackNodes(Track track, std::optional<double> accuracyFilter);
 
   /**
-   * emits collectionDetailsLoaded and trackDataLoaded
+   * emits collectionChanged and trackDataLoaded
    *
    * @param track
    * @param colorOpt
    */
   void setTrackColor(Track track, std::optional<osmscout::Color> colorOpt);
 
+  /**
+   * Move points of closed track to read-only archive file (see TrackArchive).
+   * Metadata, levels of detail and statistics of the track stay in the database.
+   * Archived points are restored to the database when the track is edited.
+   */
+  void archiveTrack(Track track);
+
   /**
    * emit openTrackLoaded()
    */
@@ -592,6 +730,15 @@ public slots:
                    TrackStatistics statistics,
                    bool createNewSegment);
 
+  /**
+   * Append points from the track journal (see TrackJournal) to tracks and update
+   * their statistics, statistics of trackId (accumulated by tracker) are used.
+   * Journal is reset when all its points are compacted.
+   *
+   * emit collectionDetailsLoaded
+   */
+  void compactJournal(qint64 trackId, TrackStatistics statistics);
+
   /**
    * emit searchHistory
    */
@@ -616,10 +763,54 @@ public slots:
    * Result is sorted by distance from center.
    *
    * emit nearbyWaypoints
+   *
+   * Read slot, processed by read-only connection pool, see dispatchRead
    * @param center
    * @param distance
+   * @param limit maximum count of nearest waypoints, unlimited when it is not positive
+   */
+  void loadNearbyWaypoints(const osmscout::GeoCoord &center, const osmscout::Distance &distance, int limit);
+
+  /**
+   * Full-text search of waypoints (name, description, symbol) and tracks (name, description)
+   * in all collections. Every word of the pattern is matched as prefix, results are ordered
+   * by relevance.
+   *
+   * emit itemsFound
+   *
+   * Read slot, processed by read-only connection pool, see dispatchRead
+   * @param pattern
+   * @param limit maximum count of results, unlimited when it is not positive
    */
-  void loadNearbyWaypoints(const osmscout::GeoCoord &center, const osmscout::Distance &distance);
+  void searchItems(const QString &pattern, int limit);
+
+  /**
+   * Load visible tracks (from visible collections) with bounding box
+   * intersecting the box. Tracks smaller than one pixel on the zoom level are skipped.
+   * Track data are not loaded.
+   *
+   * emit tracksInBoxLoaded
+   *
+   * Read slot, processed by read-only connection pool, see dispatchRead
+   * @param box
+   * @param zoom magnification level
+   */
+  void loadTracksInBox(const osmscout::GeoBox &box, int zoom);
+
+  /**
+   * Application moved to foreground / background. Idle maintenance
+   * starts sooner when application is in background.
+   */
+  void setApplicationActive(bool active);
+
+  /**
+   * Rebuild the database file (VACUUM) and switch it to incremental auto vacuum,
+   * so idle maintenance may release free pages since then. It blocks Storage thread
+   * and needs free disk space up to the database size, so it is started by user only.
+   *
+   * emit databaseCompacted
+   */
+  void compactDatabase();
 
 public:
   Storage(QThread *thread,
@@ -632,8 +823,53 @@ public:
   static Storage* getInstance();
   static void clearInstance();
 
+  TrackDataCache::Statistics trackDataCacheStatistics() const
+  {
+    return trackDataCache.statistics();
+  }
+
+  /** journal of recorded points, it is thread safe */
+  TrackJournal& trackJournal()
+  {
+    return journal;
+  }
+
+  /** latency and row counters of slots and read tasks, it is thread safe */
+  StorageMetrics& storageMetrics()
+  {
+    return metrics;
+  }
+
+protected:
+  /** measure every slot invoked by queued connection, see StorageMetrics */
+  bool event(QEvent *event) override;
+
 private:
-  QSqlQuery trackInsertSql();
+  /**
+   * Prepared statement from the cache of the connection.
+   * Read connection is used when it is called from the reader thread.
+   */
+  StatementCache::Statement prepare(const QString &sql);
+
+  /**
+   * Read slots are thread-safe, they should be connected with Qt::DirectConnection.
+   * Task is dispatched to the least busy reader thread with own read-only connection,
+   * so it is not blocked by long-running write (import for example) in WAL mode.
+   * When read connections are not available, task is processed by the Storage thread.
+   */
+  void dispatchRead(const QString &slotName,
+                    const std::function<void()> &task,
+                    const std::function<void()> &failure);
+
+  void openReadConnections();
+  void loadNearbyWaypointsPrivate(const osmscout::GeoCoord &center, const osmscout::Distance &distance, int limit);
+  bool searchItemsPrivate(const QString &pattern, int limit, std::vector<SearchResult> &results);
+  bool loadTracksInBoxPrivate(const osmscout::GeoBox &box, int zoom, std::vector<Track> &tracks);
+  bool loadWaypointsInRadius(const osmscout::GeoCoord &center,
+                             const osmscout::Distance &radius,
+                             std::vector<WaypointNearby> &waypoints);
+
+  StatementCache::Statement trackInsertSql();
 
   void prepareTrackInsert(QSqlQuery &sqlTrk,
                           qint64 collectionId,
@@ -649,34 +885,231 @@ private:
   Waypoint makeWaypoint(QSqlQuery &sql) const;
   std::shared_ptr<std::vector<Track>> loadTracks(qint64 collectionId);
   std::shared_ptr<std::vector<Waypoint>> loadWaypoints(qint64 collectionId);
-  void loadTrackPoints(qint64 segmentId, osmscout::gpx::TrackSegment &segment);
+  /** called after every decoded chunk with index of its first point in segment */
+  using ChunkCallback = std::function<void(size_t)>;
+
+  /** decoded chunk of track_segment_data */
+  struct SegmentChunk
+  {
+    qint64 chunk{0};
+    qint64 firstPoint{0};
+    std::vector<osmscout::gpx::TrackPoint> points;
+  };
+
+  bool loadTrackPoints(qint64 segmentId, osmscout::gpx::TrackSegment &segment,
+                       const ChunkCallback &chunkLoaded = nullptr);
+  bool loadLegacyTrackPoints(qint64 segmentId, osmscout::gpx::TrackSegment &segment);
+  using DataChunkVisitor = std::function<bool(const QByteArray &data, qint64 pointCount)>;
+  using ArchivedSegmentVisitor = std::function<bool(const TrackArchive::SegmentView &view)>;
+  /**
+   * Visit stored points of the segment: packed chunks of the database or the archived segment.
+   * Both are looked up by single statement, so concurrent (un)archiving cannot hide the points.
+   * Closed segment without any points is reported as error. Visitor may stop by returning false.
+   */
+  bool visitSegmentData(qint64 segmentId,
+                        const DataChunkVisitor &chunkVisitor,
+                        const ArchivedSegmentVisitor &archiveVisitor);
+  /** mapped archive file, recently used archives are kept open. It is thread safe. */
+  std::shared_ptr<const TrackArchive> openArchive(const QString &file);
+  /**
+   * Views of archived track segments, archived is nullptr when the track is not archived.
+   * Segments and archive file are looked up by single statement.
+   */
+  bool loadArchivedTrack(qint64 trackId, std::shared_ptr<const ArchivedTrackData> &archived);
+  /** restore points of archived track to the database, it is running in own transaction */
+  bool unarchiveTrack(qint64 trackId);
+  /** remove archive files that are not referenced by the database */
+  void removeUnusedArchives();
   bool checkAccess(QString slotName, bool requireOpen = true);
-  bool importWaypoints(const osmscout::gpx::GpxFile &file, qint64 collectionId);
-  bool importTracks(const osmscout::gpx::GpxFile &file, qint64 collectionId);
   bool importTrackPoints(const std::vector<osmscout::gpx::TrackPoint> &points, qint64 segId);
+  /** append points to the segment, it have to be called in transaction */
+  bool appendTrackPoints(const std::vector<osmscout::gpx::TrackPoint> &points, qint64 segId);
+  bool compactJournalPrivate(qint64 trackId,
+                             const std::optional<TrackStatistics> &statistics,
+                             QSet<qint64> &collections);
+  bool importRecord(GpxImportState &state, GpxImportRecord &record);
+
+  /**
+   * Replace all points of the segment. It is not running in own transaction.
+   */
+  bool storeTrackPoints(const std::vector<osmscout::gpx::TrackPoint> &points, qint64 segId);
+  bool insertTrackPointChunks(const std::vector<osmscout::gpx::TrackPoint> &points,
+                              size_t from,
+                              qint64 segId,
+                              qint64 firstChunk,
+                              qint64 firstPoint);
+
+  /**
+   * Replace levels of detail of the segment. It is not running in own transaction.
+   */
+  bool storeSegmentLods(qint64 segmentId, const std::vector<QByteArray> &lods);
+  bool deleteSegmentLods(qint64 segmentId);
+
+  /**
+   * Replace statistics of the segment. It is not running in own transaction.
+   */
+  bool storeSegmentStatistics(qint64 segmentId, const TrackStatistics &statistics);
+  bool deleteSegmentStatistics(qint64 segmentId);
+
+  /**
+   * Merge track statistics from its segment statistics, missing segment statistics
+   * are computed and stored. It is not running in own transaction.
+   */
+  bool mergeSegmentStatistics(qint64 trackId, TrackStatistics &statistics);
+  bool buildTrackLods(qint64 trackId);
   TrackStatistics computeTrackStatistics(const osmscout::gpx::Track &trk) const;
+  /**
+   * Start background migration of legacy data, processed in batches by migrationBatch
+   * from the Storage event loop.
+   */
+  void startMigration();
+  void migrationBatch();
+  /**
+   * Request maintenance after database activity, it is started by maintenanceTimer
+   * when Storage is idle.
+   */
+  void scheduleMaintenance();
+  /**
+   * Time-boxed slice of idle maintenance (WAL checkpoint, statistics for query planner,
+   * incremental vacuum, removal of unused track archives).
+   * It is paused when there was recent request.
+   */
+  void maintenanceSlice();
+  /** @return true when current maintenance step is finished */
+  bool maintenanceStepSlice();
+  /** notify consumers about modified collection, see collectionChanged */
+  void collectionModified(qint64 collectionId);
+  void scheduleReloads();
+  void processReloads();
+  void loadCollectionsPrivate();
+  bool loadCollectionMetadata(Collection &collection);
   bool loadCollectionDetailsPrivate(Collection &collection);
-  bool loadTrackDataPrivate(Track &track, std::optional<double> accuracyFilter);
-  bool createSegment(qint64 trackId, qint64 &segmentId);
+  bool loadCollectionItemsPrivate(qint64 collectionId,
+                                  int ordering,
+                                  bool waypointFirst,
+                                  qint64 offset,
+                                  qint64 limit,
+                                  std::vector<CollectionItem> &items);
+  bool loadTrackMetadata(Track &track);
+  void initTrackData(Track &track);
+  bool loadTrackDataPrivate(Track &track, std::optional<double> accuracyFilter, bool progressive = false);
+  /**
+   * Load raw points of all segments to new track data. When progressive,
+   * chunks filtered by accuracy filter are emitted by trackPointsLoaded signal.
+   */
+  bool loadTrackSegments(Track &track, std::optional<double> accuracyFilter, bool progressive);
+  void filterTrackData(Track &track, std::optional<double> accuracyFilter) const;
+  /**
+   * Load track data progressively, through the decoded track cache.
+   * Result callback may be called from thread of other request for the same track.
+   */
+  void loadTrackDataCached(Track track,
+                           std::optional<double> accuracyFilter,
+                           const std::function<void(Track&, bool)> &result);
+  bool loadTrackLodPrivate(Track &track, int level);
+  bool createSegment(qint64 trackId, qint64 &segmentId, bool open = true);
   bool exportPrivate(qint64 collectionId,
                      const QString &file,
                      const std::optional<qint64> &trackId,
                      bool includeWaypoints,
-                     std::optional<double> accuracyFilter);
+                     std::optional<double> accuracyFilter,
+                     const osmscout::BreakerRef &breaker);
 
   /**
    * obtain collection id from trackId
    */
   bool trackCollection(qint64 trackId, qint64 &collectionId);
   bool listIndexes(QStringList &indexes);
+  bool execInTransaction(const QStringList &queries);
   int querySize(QSqlQuery &query);
 
+  /** point count of every track segment, ordered by segment id */
+  bool loadSegmentPointCounts(qint64 trackId, std::vector<std::pair<qint64, qint64>> &segments);
+  /** store points of not migrated segment as chunks */
+  bool ensureSegmentChunks(qint64 segmentId);
+  /** append decoded chunk containing the position (not starting on it), if there is such */
+  bool loadSegmentChunk(qint64 segmentId, qint64 position, std::vector<SegmentChunk> &chunks);
+  /** update chunk points, empty chunk is deleted */
+  bool updateSegmentChunk(qint64 segmentId, const SegmentChunk &chunk);
+  bool shiftSegmentPoints(qint64 segmentId, qint64 from, qint64 delta);
+
+  /**
+   * Delete points in range [from, to) of the segment. Levels of detail of the segment are deleted.
+   * It is not running in own transaction.
+   */
+  bool deleteSegmentPoints(qint64 segmentId, qint64 from, qint64 to);
+
+  /**
+   * Move points in range [0, position) of the segment to target segment (that is empty).
+   * Levels of detail of the segment are deleted. It is not running in own transaction.
+   */
+  bool moveSegmentHead(qint64 segmentId, qint64 position, qint64 targetSegmentId);
+
+  /**
+   * Rebuild levels of detail and statistics of modified segments (just their points are loaded)
+   * and update track statistics. It is called in the transaction of the edit.
+   */
+  bool updateEditedTrack(qint64 trackId, const QSet<qint64> &modifiedSegments);
   void cropTrackPrivate(qint64 trackId, quint64 count, bool cropStart);
   bool updateTrackStatistics(qint64 trackId, const TrackStatistics &statistics);
 
 private :
   QSqlDatabase db;
+  std::unique_ptr<StatementCache> statementCache;
+  TrackDataCache trackDataCache;
+  TrackJournal journal;
+  StorageMetrics metrics;
+
+  // recently used track archives, most recent first
+  static constexpr size_t ArchiveCacheCapacity = 4;
+  QMutex archiveCacheMutex;
+  std::vector<std::shared_ptr<const TrackArchive>> archiveCache;
+
+  // pending reloads, processed by processReloads
+  bool reloadsScheduled{false};
+  qint64 reloadsScheduledNs{0}; // see StorageMetrics::now
+  bool collectionsReloadPending{false};
+  QSet<qint64> detailsReloadPending;
+  QSet<qint64> changedPending; // modified collections, see collectionChanged
+
+  /** background migration step, processing segments selected by SQL one by one */
+  struct MigrationStep
+  {
+    QString name;
+    QString countSql; //!< count of segments to process
+    QString nextSql; //!< next segment id after :cursor
+    std::function<bool(qint64 segmentId, qint64 &points)> migrate;
+  };
+  std::vector<MigrationStep> migrationSteps;
+  size_t migrationStep{0};
+  qint64 migrationCursor{-1};
+  qint64 migrationDone{0};
+  qint64 migrationTotal{-1};
+  std::atomic_bool legacyPoints{false}; // track_point table contains points that are not migrated yet
+
+  // idle maintenance, see maintenanceSlice
+  enum class MaintenanceStep
+  {
+    Checkpoint,
+    Optimize,
+    Vacuum,
+    ArchiveCleanup,
+    Done
+  };
+  QTimer *maintenanceTimer{nullptr};
+  MaintenanceStep maintenanceStep{MaintenanceStep::Checkpoint};
+  bool maintenancePending{true};
+  bool applicationActive{true};
+  std::atomic<qint64> lastActivityNs{0}; // last request, see StorageMetrics::now
+
   QThread *thread;
   QDir directory;
+  QString databasePath;
+
+  QMutex readersMutex;
+  std::vector<StorageReader*> readers;
   std::atomic_bool ok{false};
+  bool waypointIndex{false}; // waypoint_rtree is available
+  bool trackIndex{false}; // track_rtree is available
+  bool searchIndex{false}; // waypoint_fts and track_fts are available
 };
@@ -0,0 +1,676 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Headless benchmark of Storage. It generates synthetic collections in temporary directory,
+ * imports them and measures Storage requests, results are printed as JSON:
+ *
+ *   StorageBenchmark --collections 2 --tracks 20 --points 5000 --waypoints 1000
+ *
+ * Every request is invoked in the Storage thread and measured until its result signal
+ * is received in the main thread, so the latency includes signal delivery.
+ * Allocations are counted for the whole process during the request (all threads),
+ * with several receivers of collection details it shows that snapshots are not copied.
+ *
+ * Storage connection tuning can be compared by running it with different
+ * OSMSCOUT_STORAGE_CACHE_KIB and OSMSCOUT_STORAGE_MMAP_MIB environment variables,
+ * scripts/storage-sweep.sh runs it for a grid of values.
+ */
+
+#include "Storage.h"
+
+#include <osmscoutclientqt/OSMScoutQt.h>
+#include <osmscout/util/Breaker.h>
+
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+
+namespace {
+std::atomic<qint64> allocationCount{0};
+}
+
+void* operator new(std::size_t size)
+{
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace {
+
+constexpr int RequestTimeoutMs = 600000;
+
+struct Options
+{
+  int collections{1};
+  int tracks{10};
+  int points{2000}; // per track
+  int waypoints{500}; // per collection
+  int iterations{10};
+  int receivers{4}; // receivers of collection details
+  int appendBatch{60}; // points appended by one appendNodes call
+  unsigned seed{42};
+};
+
+/**
+ * Context of one request, it is living in the main thread.
+ * Result signal handler should call done.
+ */
+class Request: public QObject
+{
+public:
+  void done(bool success = true)
+  {
+    finished = true;
+    ok = success;
+    loop.quit();
+  }
+
+  bool wait()
+  {
+    if (!finished) {
+      QTimer::singleShot(RequestTimeoutMs, &loop, &QEventLoop::quit);
+      loop.exec();
+    }
+    return finished && ok;
+  }
+
+private:
+  QEventLoop loop;
+  bool finished{false};
+  bool ok{false};
+};
+
+struct Samples
+{
+  std::vector<qint64> durationsNs;
+  qint64 allocations{0};
+  qint64 items{0}; // points, waypoints... processed by all requests
+  int failures{0};
+};
+
+class Benchmark
+{
+public:
+  Benchmark(Storage *storage, const Options &options, const QString &directory):
+    storage(storage), options(options), directory(directory), random(options.seed)
+  {}
+
+  bool run();
+  QJsonObject result() const;
+
+private:
+  /**
+   * Measure one request. Setup connects result signal to the request and returns
+   * function invoked in the Storage thread.
+   */
+  bool measure(const QString &name, qint64 items, const std::function<std::function<void()>(Request&)> &setup);
+
+  QString generateGpx(int collection);
+  bool importCollections();
+  bool loadCollections();
+  bool loadCollectionDetails();
+  bool loadTrackData();
+  bool exportCollections();
+  bool loadNearbyWaypoints();
+  bool searchItems();
+  bool editTracks();
+  bool appendNodes();
+
+private:
+  Storage *storage;
+  Options options;
+  QString directory;
+  std::mt19937 random;
+  std::map<QString, Samples> samples;
+  std::vector<qint64> collectionIds;
+  std::vector<Track> tracks;
+  std::vector<osmscout::GeoCoord> waypointCoords;
+  double checksum{0}; // computed by additional receivers, so their work is not optimised out
+};
+
+bool Benchmark::measure(const QString &name, qint64 items, const std::function<std::function<void()>(Request&)> &setup)
+{
+  Samples &s = samples[name];
+  Request request;
+  std::function<void()> task = setup(request);
+
+  qint64 allocations = allocationCount.load();
+  QElapsedTimer timer;
+  timer.start();
+  QTimer::singleShot(0, storage, task);
+  bool success = request.wait();
+  qint64 duration = timer.nsecsElapsed();
+
+  s.allocations += allocationCount.load() - allocations;
+  if (!success) {
+    qWarning() << name << "failed";
+    s.failures++;
+    return false;
+  }
+  s.durationsNs.push_back(duration);
+  s.items += items;
+  return true;
+}
+
+QString Benchmark::generateGpx(int collection)
+{
+  std::uniform_real_distribution<double> step(-0.00005, 0.00005); // ~5 m
+  std::uniform_real_distribution<double> offset(-0.1, 0.1);
+  std::uniform_real_distribution<double> accuracy(2, 30);
+  const osmscout::GeoCoord base(50.08, 14.42);
+  QDateTime time = QDateTime(QDate(2022, 1, 1), QTime(8, 0), Qt::UTC);
+
+  QString path = QString("%1/collection-%2.gpx").arg(directory).arg(collection);
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning() << "Cannot create" << path << file.errorString();
+    return QString();
+  }
+  QTextStream out(&file);
+  out.setRealNumberPrecision(8);
+  out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      << "<gpx version=\"1.1\" creator=\"StorageBenchmark\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n"
+      << "<metadata><name>Benchmark " << collection << "</name></metadata>\n";
+
+  static const char *symbols[] = {"Flag", "Pin", "Summit", "Campground", "Restaurant"};
+  for (int i = 0; i < options.waypoints; i++) {
+    osmscout::GeoCoord coord(base.GetLat() + offset(random), base.GetLon() + offset(random));
+    waypointCoords.push_back(coord);
+    out << "<wpt lat=\"" << coord.GetLat() << "\" lon=\"" << coord.GetLon() << "\">"
+        << "<name>Waypoint " << collection << "-" << i << "</name>"
+        << "<desc>Synthetic waypoint number " << i << "</desc>"
+        << "<sym>" << symbols[i % 5] << "</sym></wpt>\n";
+  }
+
+  for (int t = 0; t < options.tracks; t++) {
+    double lat = base.GetLat() + offset(random);
+    double lon = base.GetLon() + offset(random);
+    out << "<trk><name>Track " << collection << "-" << t << "</name>"
+        << "<desc>Synthetic track number " << t << "</desc><trkseg>\n";
+    for (int p = 0; p < options.points; p++) {
+      lat += step(random);
+      lon += step(random);
+      time = time.addSecs(1);
+      out << "<trkpt lat=\"" << lat << "\" lon=\"" << lon << "\">"
+          << "<ele>" << (200 + p % 100) << "</ele>"
+          << "<time>" << time.toString(Qt::ISODate) << "</time>"
+          << "<hdop>" << accuracy(random) << "</hdop></trkpt>\n";
+    }
+    out << "</trkseg></trk>\n";
+  }
+  out << "</gpx>\n";
+  return path;
+}
+
+bool Benchmark::importCollections()
+{
+  for (int c = 0; c < options.collections; c++) {
+    QString file = generateGpx(c);
+    if (file.isEmpty()) {
+      return false;
+    }
+    bool success = measure("importCollection", qint64(options.tracks) * options.points + options.waypoints,
+      [&](Request &request) {
+        QObject::connect(storage, &Storage::collectionsLoaded, &request,
+                         [&request](CollectionListSnapshot, bool ok) { request.done(ok); });
+        QObject::connect(storage, &Storage::error, &request,
+                         [&request](QString) { request.done(false); });
+        return [this, file]() { storage->importCollection(file); };
+      });
+    if (!success) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Benchmark::loadCollections()
+{
+  for (int i = 0; i < options.iterations; i++) {
+    CollectionListSnapshot collections;
+    bool success = measure("loadCollections", 1, [&](Request &request) {
+      QObject::connect(storage, &Storage::collectionsLoaded, &request,
+                       [&](CollectionListSnapshot snapshot, bool ok) {
+                         collections = snapshot;
+                         request.done(ok);
+                       });
+      return [this]() { storage->loadCollections(); };
+    });
+    if (!success || !collections) {
+      return false;
+    }
+    collectionIds.clear();
+    for (const Collection &collection: *collections) {
+      collectionIds.push_back(collection.id);
+    }
+  }
+  return true;
+}
+
+bool Benchmark::loadCollectionDetails()
+{
+  tracks.clear();
+  for (int i = 0; i < options.iterations; i++) {
+    for (qint64 collectionId: collectionIds) {
+      CollectionSnapshot details;
+      bool success = measure("loadCollectionDetails", 1, [&](Request &request) {
+        for (int r = 1; r < options.receivers; r++) {
+          // additional receivers just read the snapshot, like collection models
+          QObject::connect(storage, &Storage::collectionDetailsLoaded, &request,
+                           [this](CollectionSnapshot snapshot, bool) {
+                             if (snapshot->tracks) {
+                               for (const Track &track: *snapshot->tracks) {
+                                 checksum += track.statistics.distance.AsMeter();
+                               }
+                             }
+                           });
+        }
+        QObject::connect(storage, &Storage::collectionDetailsLoaded, &request,
+                         [&, collectionId](CollectionSnapshot snapshot, bool ok) {
+                           if (snapshot->id == collectionId) {
+                             details = snapshot;
+                             request.done(ok);
+                           }
+                         });
+        return [this, collectionId]() { storage->loadCollectionDetails(Collection(collectionId)); };
+      });
+      if (!success || !details) {
+        return false;
+      }
+      if (i == 0 && details->tracks) {
+        tracks.insert(tracks.end(), details->tracks->begin(), details->tracks->end());
+      }
+    }
+  }
+  return true;
+}
+
+bool Benchmark::loadTrackData()
+{
+  for (int i = 0; i < options.iterations; i++) {
+    // the first load of every track is not cached
+    QString name = i == 0 ? "loadTrackDataCold" : "loadTrackData";
+    for (const Track &track: tracks) {
+      bool success = measure(name, options.points, [&](Request &request) {
+        QObject::connect(storage, &Storage::trackDataLoaded, &request,
+                         [&request, id = track.id](Track loaded, std::optional<double>, bool complete, bool ok) {
+                           if (loaded.id == id && complete) {
+                             request.done(ok);
+                           }
+                         });
+        return [this, track]() { storage->loadTrackData(track, std::nullopt); };
+      });
+      if (!success) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool Benchmark::exportCollections()
+{
+  for (qint64 collectionId: collectionIds) {
+    QString file = QString("%1/export-%2.gpx").arg(directory).arg(collectionId);
+    bool success = measure("exportCollection", qint64(options.tracks) * options.points + options.waypoints,
+      [&](Request &request) {
+        QObject::connect(storage, &Storage::collectionExported, &request,
+                         [&request, collectionId](qint64 id, QString, bool ok) {
+                           if (id == collectionId) {
+                             request.done(ok);
+                           }
+                         });
+        return [this, collectionId, file]() {
+          storage->exportCollection(collectionId, file, true, std::nullopt,
+                                    std::make_shared<osmscout::ThreadedBreaker>());
+        };
+      });
+    if (!success) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Benchmark::loadNearbyWaypoints()
+{
+  if (waypointCoords.empty()) {
+    return true;
+  }
+  std::uniform_int_distribution<size_t> index(0, waypointCoords.size() - 1);
+  for (int i = 0; i < options.iterations; i++) {
+    osmscout::GeoCoord center = waypointCoords[index(random)];
+    size_t found = 0;
+    bool success = measure("loadNearbyWaypoints", 1, [&](Request &request) {
+      QObject::connect(storage, &Storage::nearbyWaypoints, &request,
+                       [&](const osmscout::GeoCoord &, const osmscout::Distance &,
+                           const std::vector<Storage::WaypointNearby> &waypoints) {
+                         found = waypoints.size();
+                         request.done();
+                       });
+      return [this, center]() { storage->loadNearbyWaypoints(center, osmscout::Kilometers(5), 20); };
+    });
+    if (!success || found == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Benchmark::searchItems()
+{
+  std::uniform_int_distribution<int> number(0, std::max(0, options.waypoints - 1));
+  for (int i = 0; i < options.iterations; i++) {
+    QString pattern = i % 2 == 0 ? QString("Way %1").arg(number(random)) : QString("synth trac");
+    bool success = measure("searchItems", 1, [&](Request &request) {
+      QObject::connect(storage, &Storage::itemsFound, &request,
+                       [&request, pattern](QString found, SearchResultsSnapshot, bool ok) {
+                         if (found == pattern) {
+                           request.done(ok);
+                         }
+                       });
+      return [this, pattern]() { storage->searchItems(pattern, 50); };
+    });
+    if (!success) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Benchmark::editTracks()
+{
+  // every track is cropped, then the first half is split, so it modifies the data - it has to be the last read test
+  for (const Track &track: tracks) {
+    if (options.points < 4) {
+      break;
+    }
+    auto modify = [&](const QString &name, const std::function<void()> &task) {
+      return measure(name, options.points, [&](Request &request) {
+        QObject::connect(storage, &Storage::trackDataLoaded, &request,
+                         [&request, id = track.id](Track loaded, std::optional<double>, bool complete, bool ok) {
+                           if (loaded.id == id && complete) {
+                             request.done(ok);
+                           }
+                         });
+        return task;
+      });
+    };
+    if (!modify("cropTrackEnd", [this, track]() { storage->cropTrackEnd(track, options.points - options.points / 4); }) ||
+        !modify("splitTrack", [this, track]() { storage->splitTrack(track, options.points / 2); })) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Benchmark::appendNodes()
+{
+  if (collectionIds.empty()) {
+    return true;
+  }
+  qint64 collectionId = collectionIds.front();
+  qint64 trackId = -1;
+  bool created = measure("createTrack", 1, [&](Request &request) {
+    QObject::connect(storage, &Storage::trackCreated, &request,
+                     [&](qint64, qint64 id, QString) {
+                       trackId = id;
+                       request.done();
+                     });
+    return [this, collectionId]() { storage->createTrack(collectionId, "Recorded track", "", true); };
+  });
+  if (!created) {
+    return false;
+  }
+
+  std::uniform_real_distribution<double> step(-0.00005, 0.00005);
+  double lat = 50.08;
+  double lon = 14.42;
+  osmscout::Timestamp time = osmscout::Timestamp::clock::now();
+  for (int i = 0; i < options.iterations * 10; i++) {
+    auto batch = std::make_shared<std::vector<osmscout::gpx::TrackPoint>>();
+    for (int p = 0; p < options.appendBatch; p++) {
+      lat += step(random);
+      lon += step(random);
+      time += std::chrono::seconds(1);
+      osmscout::gpx::TrackPoint point(osmscout::GeoCoord(lat, lon));
+      point.time = time;
+      point.elevation = 250;
+      point.hdop = 5;
+      batch->push_back(point);
+    }
+    bool success = measure("appendNodes", options.appendBatch, [&](Request &request) {
+      QObject::connect(storage, &Storage::collectionChanged, &request,
+                       [&request, collectionId](qint64 changedId) {
+                         if (changedId == collectionId) {
+                           request.done(true);
+                         }
+                       });
+      return [this, trackId, batch]() { storage->appendNodes(trackId, batch, TrackStatistics(), false); };
+    });
+    if (!success) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Benchmark::run()
+{
+  return importCollections() &&
+         loadCollections() &&
+         loadCollectionDetails() &&
+         loadTrackData() &&
+         exportCollections() &&
+         loadNearbyWaypoints() &&
+         searchItems() &&
+         editTracks() &&
+         appendNodes();
+}
+
+QJsonObject Benchmark::result() const
+{
+  auto percentileMs = [](const std::vector<qint64> &sorted, double percentile) {
+    if (sorted.empty()) {
+      return 0.0;
+    }
+    size_t index = std::min(sorted.size() - 1, size_t(double(sorted.size()) * percentile));
+    return double(sorted[index]) / 1e6;
+  };
+
+  QJsonObject operations;
+  for (const auto &[name, s]: samples) {
+    std::vector<qint64> sorted = s.durationsNs;
+    std::sort(sorted.begin(), sorted.end());
+    qint64 totalNs = 0;
+    for (qint64 duration: sorted) {
+      totalNs += duration;
+    }
+    qint64 count = qint64(sorted.size()) + s.failures;
+    double totalSeconds = double(totalNs) / 1e9;
+
+    QJsonObject op;
+    op["count"] = double(sorted.size());
+    op["failures"] = s.failures;
+    op["totalMs"] = double(totalNs) / 1e6;
+    op["p50Ms"] = percentileMs(sorted, 0.5);
+    op["p90Ms"] = percentileMs(sorted, 0.9);
+    op["p99Ms"] = percentileMs(sorted, 0.99);
+    op["maxMs"] = sorted.empty() ? 0.0 : double(sorted.back()) / 1e6;
+    op["requestsPerSecond"] = totalSeconds > 0 ? double(sorted.size()) / totalSeconds : 0.0;
+    op["itemsPerSecond"] = totalSeconds > 0 ? double(s.items) / totalSeconds : 0.0;
+    op["allocationsPerRequest"] = count > 0 ? double(s.allocations) / double(count) : 0.0;
+    operations[name] = op;
+  }
+
+  QJsonObject scale;
+  scale["collections"] = options.collections;
+  scale["tracks"] = options.tracks;
+  scale["points"] = options.points;
+  scale["waypoints"] = options.waypoints;
+  scale["iterations"] = options.iterations;
+  scale["receivers"] = options.receivers;
+
+  QJsonObject tuning;
+  tuning["cacheKiB"] = QString::fromLocal8Bit(qgetenv("OSMSCOUT_STORAGE_CACHE_KIB")); // empty for default
+  tuning["mmapMiB"] = QString::fromLocal8Bit(qgetenv("OSMSCOUT_STORAGE_MMAP_MIB"));
+
+  QJsonObject result;
+  result["scale"] = scale;
+  result["tuning"] = tuning;
+  result["operations"] = operations;
+  result["storage"] = storage->storageMetrics().toJson();
+  return result;
+}
+
+void registerMetaTypes()
+{
+  // Storage signals are delivered by queued connection, see OSMScout.cpp
+  qRegisterMetaType<CollectionSnapshot>("CollectionSnapshot");
+  qRegisterMetaType<CollectionListSnapshot>("CollectionListSnapshot");
+  qRegisterMetaType<TrackListSnapshot>("TrackListSnapshot");
+  qRegisterMetaType<CollectionItemsSnapshot>("CollectionItemsSnapshot");
+  qRegisterMetaType<SearchResultsSnapshot>("SearchResultsSnapshot");
+  qRegisterMetaType<std::vector<SearchItem>>("std::vector<SearchItem>");
+  qRegisterMetaType<std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>>>("std::shared_ptr<std::vector<osmscout::gpx::TrackPoint> >");
+  qRegisterMetaType<std::optional<double>>("std::optional<double>");
+  qRegisterMetaType<TrackStatistics>("TrackStatistics");
+  qRegisterMetaType<Collection>("Collection");
+  qRegisterMetaType<Track>("Track");
+  qRegisterMetaType<Waypoint>("Waypoint");
+  qRegisterMetaType<std::vector<Storage::WaypointNearby>>("std::vector<Storage::WaypointNearby>");
+  qRegisterMetaType<std::optional<osmscout::Color>>("std::optional<osmscout::Color>");
+  qRegisterMetaType<osmscout::BreakerRef>("osmscout::BreakerRef");
+}
+}
+
+int main(int argc, char* argv[])
+{
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QGuiApplication app(argc, argv);
+  app.setApplicationName("StorageBenchmark");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Headless benchmark of track and waypoint storage");
+  parser.addHelpOption();
+  QCommandLineOption collectionsOption("collections", "Count of generated collections.", "count", "1");
+  QCommandLineOption tracksOption("tracks", "Tracks in every collection.", "count", "10");
+  QCommandLineOption pointsOption("points", "Points in every track.", "count", "2000");
+  QCommandLineOption waypointsOption("waypoints", "Waypoints in every collection.", "count", "500");
+  QCommandLineOption iterationsOption("iterations", "Repetitions of read requests.", "count", "10");
+  QCommandLineOption receiversOption("receivers", "Receivers of collection details signal.", "count", "4");
+  QCommandLineOption seedOption("seed", "Seed of data generator.", "seed", "42");
+  QCommandLineOption outputOption("output", "Write JSON result to the file instead of standard output.", "file");
+  parser.addOptions({collectionsOption, tracksOption, pointsOption, waypointsOption,
+                     iterationsOption, receiversOption, seedOption, outputOption});
+  parser.process(app);
+
+  Options options;
+  options.collections = std::max(1, parser.value(collectionsOption).toInt());
+  options.tracks = std::max(0, parser.value(tracksOption).toInt());
+  options.points = std::max(1, parser.value(pointsOption).toInt());
+  options.waypoints = std::max(0, parser.value(waypointsOption).toInt());
+  options.iterations = std::max(1, parser.value(iterationsOption).toInt());
+  options.receivers = std::max(1, parser.value(receiversOption).toInt());
+  options.seed = parser.value(seedOption).toUInt();
+
+  QTemporaryDir directory;
+  if (!directory.isValid()) {
+    std::cerr << "Cannot create temporary directory" << std::endl;
+    return 1;
+  }
+
+  registerMetaTypes();
+  bool initSuccess = osmscout::OSMScoutQt::NewInstance()
+    .WithSettingsStorage(new QSettings(directory.filePath("settings.ini"), QSettings::IniFormat, &app))
+    .WithCacheLocation(directory.filePath("cache"))
+    .WithTileCacheSizes(1, 1)
+    .Init();
+  if (!initSuccess) {
+    std::cerr << "Cannot initialize OSMScoutQt" << std::endl;
+    return 1;
+  }
+
+  Storage::initInstance(QDir(directory.filePath("storage")));
+  Storage *storage = Storage::getInstance();
+  {
+    Request init;
+    QObject::connect(storage, &Storage::initialised, &init, [&init]() { init.done(); });
+    QObject::connect(storage, &Storage::initialisationError, &init, [&init](QString) { init.done(false); });
+    if (!init.wait() || !*storage) {
+      std::cerr << "Storage initialisation failed" << std::endl;
+      return 1;
+    }
+  }
+
+  Benchmark benchmark(storage, options, directory.path());
+  bool success = benchmark.run();
+
+  QByteArray json = QJsonDocument(benchmark.result()).toJson(QJsonDocument::Indented);
+  if (parser.isSet(outputOption)) {
+    QFile out(parser.value(outputOption));
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate) || out.write(json) != json.size()) {
+      std::cerr << "Cannot write " << out.fileName().toStdString() << std::endl;
+      success = false;
+    }
+  } else {
+    std::cout << json.toStdString();
+  }
+
+  Storage::clearInstance();
+  osmscout::OSMScoutQt::FreeInstance();
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "StorageMetrics.h"
+
+#include <QJsonArray>
+#include <QMutexLocker>
+
+#include <chrono>
+
+namespace {
+  // innermost scope of the thread
+  thread_local StorageMetrics::Scope *currentScope = nullptr;
+}
+
+qint64 StorageMetrics::Operation::percentileUs(double percentile) const
+{
+  qint64 threshold = qint64(double(count) * percentile);
+  qint64 cumulative = 0;
+  for (int i = 0; i < BucketCount; i++) {
+    cumulative += buckets[i];
+    if (cumulative > threshold) {
+      return qint64(1) << i;
+    }
+  }
+  return qint64(1) << (BucketCount - 1);
+}
+
+StorageMetrics::Scope::Scope(StorageMetrics &metrics, const QString &name, qint64 queueWaitNs):
+  metrics(metrics), name(name), queueWaitNs(queueWaitNs), startNs(now()), parent(currentScope)
+{
+  currentScope = this;
+}
+
+StorageMetrics::Scope::~Scope()
+{
+  currentScope = parent;
+  if (!name.isEmpty()) {
+    metrics.record(*this, now() - startNs);
+  } else if (parent != nullptr) {
+    // counters of anonymous scope belong to the enclosing operation
+    parent->counters.rowsRead += counters.rowsRead;
+    parent->counters.rowsWritten += counters.rowsWritten;
+    parent->counters.bytesDecoded += counters.bytesDecoded;
+  }
+}
+
+void StorageMetrics::setName(const QString &name)
+{
+  if (currentScope != nullptr && currentScope->name.isEmpty()) {
+    currentScope->name = name;
+  }
+}
+
+void StorageMetrics::rowsRead(qint64 rows)
+{
+  if (currentScope != nullptr) {
+    currentScope->counters.rowsRead += rows;
+  }
+}
+
+void StorageMetrics::rowsWritten(qint64 rows)
+{
+  if (currentScope != nullptr) {
+    currentScope->counters.rowsWritten += rows;
+  }
+}
+
+void StorageMetrics::bytesDecoded(qint64 bytes)
+{
+  if (currentScope != nullptr) {
+    currentScope->counters.bytesDecoded += bytes;
+  }
+}
+
+qint64 StorageMetrics::now()
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void StorageMetrics::record(const Scope &scope, qint64 durationNs)
+{
+  qint64 us = durationNs / 1000;
+  int bucket = 0;
+  while (bucket < BucketCount - 1 && (qint64(1) << bucket) <= us) {
+    bucket++;
+  }
+
+  QMutexLocker locker(&mutex);
+  Operation &op = ops[scope.name];
+  op.count++;
+  op.totalNs += durationNs;
+  op.maxNs = std::max(op.maxNs, durationNs);
+  op.buckets[bucket]++;
+  op.counters.rowsRead += scope.counters.rowsRead;
+  op.counters.rowsWritten += scope.counters.rowsWritten;
+  op.counters.bytesDecoded += scope.counters.bytesDecoded;
+  if (scope.queueWaitNs >= 0) {
+    op.queued++;
+    op.queueWaitNs += scope.queueWaitNs;
+    op.queueWaitMaxNs = std::max(op.queueWaitMaxNs, scope.queueWaitNs);
+  }
+}
+
+void StorageMetrics::increment(const QString &event, qint64 value)
+{
+  QMutexLocker locker(&mutex);
+  eventCounts[event] += value;
+}
+
+QMap<QString, StorageMetrics::Operation> StorageMetrics::operations() const
+{
+  QMutexLocker locker(&mutex);
+  return ops;
+}
+
+QMap<QString, qint64> StorageMetrics::events() const
+{
+  QMutexLocker locker(&mutex);
+  return eventCounts;
+}
+
+void StorageMetrics::reset()
+{
+  QMutexLocker locker(&mutex);
+  ops.clear();
+  eventCounts.clear();
+}
+
+QJsonObject StorageMetrics::toJson() const
+{
+  QJsonObject operationsObj;
+  const auto snapshot = operations();
+  for (auto it = snapshot.begin(); it != snapshot.end(); ++it) {
+    const Operation &op = it.value();
+    QJsonArray histogram;
+    for (qint64 bucket: op.buckets) {
+      histogram.append(double(bucket));
+    }
+    QJsonObject obj;
+    obj["count"] = double(op.count);
+    obj["totalMs"] = double(op.totalNs) / 1e6;
+    obj["averageUs"] = op.count == 0 ? 0 : double(op.totalNs) / double(op.count) / 1e3;
+    obj["maxUs"] = double(op.maxNs) / 1e3;
+    obj["p50Us"] = double(op.percentileUs(0.5));
+    obj["p90Us"] = double(op.percentileUs(0.9));
+    obj["p99Us"] = double(op.percentileUs(0.99));
+    obj["histogramUs"] = histogram; // log2 buckets
+    obj["rowsRead"] = double(op.counters.rowsRead);
+    obj["rowsWritten"] = double(op.counters.rowsWritten);
+    obj["bytesDecoded"] = double(op.counters.bytesDecoded);
+    obj["queueWaitKnown"] = op.queued > 0;
+    if (op.queued > 0) {
+      obj["queueWaitAverageUs"] = double(op.queueWaitNs) / double(op.queued) / 1e3;
+      obj["queueWaitMaxUs"] = double(op.queueWaitMaxNs) / 1e3;
+    }
+    operationsObj[it.key()] = obj;
+  }
+
+  QJsonObject eventsObj;
+  const auto eventSnapshot = events();
+  for (auto it = eventSnapshot.begin(); it != eventSnapshot.end(); ++it) {
+    eventsObj[it.key()] = double(it.value());
+  }
+
+  QJsonObject result;
+  result["operations"] = operationsObj;
+  result["events"] = eventsObj;
+  return result;
+}
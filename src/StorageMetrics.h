@@ -0,0 +1,138 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <QJsonObject>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+#include <array>
+
+/**
+ * Instrumentation of Storage operations (slots and reader tasks): latency histogram,
+ * rows read and written by cached statements, bytes of decoded track points
+ * and queue wait time (from request submit to its execution).
+ *
+ * Operation is measured by Scope living on the executing thread, counters
+ * are attributed to the innermost Scope of the thread. It is thread safe.
+ *
+ * Queue wait is known for reader tasks and coalesced collection reloads. Writer slots
+ * are invoked by queued connections of emitting objects without submit time,
+ * they are reported with queueWaitKnown false.
+ *
+ * Besides operations, it holds named event counters that are not bound
+ * to single operation (like coalesced collection reloads).
+ */
+class StorageMetrics
+{
+public:
+  /** latency buckets, bucket i counts operations faster than 2^i microseconds, the last one the rest */
+  static constexpr int BucketCount = 24;
+
+  struct Counters
+  {
+    qint64 rowsRead{0};
+    qint64 rowsWritten{0};
+    qint64 bytesDecoded{0};
+  };
+
+  struct Operation
+  {
+    qint64 count{0};
+    qint64 totalNs{0};
+    qint64 maxNs{0};
+    std::array<qint64, BucketCount> buckets{};
+    Counters counters;
+    qint64 queued{0}; //!< operations with known queue wait time
+    qint64 queueWaitNs{0};
+    qint64 queueWaitMaxNs{0};
+
+    /** estimated latency percentile (upper bound of bucket), in microseconds */
+    qint64 percentileUs(double percentile) const;
+  };
+
+  /**
+   * Measurement of one operation on current thread. Operation without name
+   * (see setName) is not recorded.
+   */
+  class Scope
+  {
+  public:
+    /**
+     * @param queueWaitNs time from request submit to its execution, negative when it is not known
+     */
+    explicit Scope(StorageMetrics &metrics, const QString &name = QString(), qint64 queueWaitNs = -1);
+    Scope(const Scope&) = delete;
+    Scope(Scope&&) = delete;
+    ~Scope();
+
+    Scope& operator=(const Scope&) = delete;
+    Scope& operator=(Scope&&) = delete;
+
+  private:
+    friend class StorageMetrics;
+    StorageMetrics &metrics;
+    QString name;
+    qint64 queueWaitNs;
+    qint64 startNs;
+    Counters counters;
+    Scope *parent;
+  };
+
+  StorageMetrics() = default;
+  StorageMetrics(const StorageMetrics&) = delete;
+  StorageMetrics(StorageMetrics&&) = delete;
+  ~StorageMetrics() = default;
+
+  StorageMetrics& operator=(const StorageMetrics&) = delete;
+  StorageMetrics& operator=(StorageMetrics&&) = delete;
+
+  /** name the innermost scope of current thread, when it is not named yet */
+  static void setName(const QString &name);
+
+  static void rowsRead(qint64 rows);
+  static void rowsWritten(qint64 rows);
+  static void bytesDecoded(qint64 bytes);
+
+  /** monotonic time in nanoseconds, for queue wait measurement */
+  static qint64 now();
+
+  /** increment named event counter */
+  void increment(const QString &event, qint64 value = 1);
+
+  QMap<QString, Operation> operations() const;
+  QMap<QString, qint64> events() const;
+  void reset();
+
+  /**
+   * Object with "operations" (latency percentiles, histogram and counters of every operation)
+   * and "events" (named event counters).
+   */
+  QJsonObject toJson() const;
+
+private:
+  void record(const Scope &scope, qint64 durationNs);
+
+private:
+  mutable QMutex mutex;
+  QMap<QString, Operation> ops;
+  QMap<QString, qint64> eventCounts;
+};
@@ -0,0 +1,82 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "StorageMetricsBridge.h"
+#include "Storage.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+
+QString StorageMetricsBridge::json() const
+{
+  Storage *storage = Storage::getInstance();
+  if (storage == nullptr) {
+    return QString();
+  }
+  return QString::fromUtf8(QJsonDocument(storage->storageMetrics().toJson()).toJson(QJsonDocument::Indented));
+}
+
+QVariantList StorageMetricsBridge::operations() const
+{
+  QVariantList result;
+  Storage *storage = Storage::getInstance();
+  if (storage == nullptr) {
+    return result;
+  }
+  QJsonObject metrics = storage->storageMetrics().toJson()["operations"].toObject();
+  for (auto it = metrics.begin(); it != metrics.end(); ++it) {
+    QVariantMap operation = it.value().toObject().toVariantMap();
+    operation["name"] = it.key();
+    result << operation;
+  }
+  return result;
+}
+
+QVariantMap StorageMetricsBridge::events() const
+{
+  Storage *storage = Storage::getInstance();
+  if (storage == nullptr) {
+    return QVariantMap();
+  }
+  return storage->storageMetrics().toJson()["events"].toObject().toVariantMap();
+}
+
+void StorageMetricsBridge::reset()
+{
+  Storage *storage = Storage::getInstance();
+  if (storage != nullptr) {
+    storage->storageMetrics().reset();
+  }
+}
+
+bool StorageMetricsBridge::dump(const QString &file) const
+{
+  QFile out(file);
+  if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning() << "Failed to open" << file << out.errorString();
+    return false;
+  }
+  QByteArray data = json().toUtf8();
+  if (out.write(data) != data.size()) {
+    qWarning() << "Failed to write" << file << out.errorString();
+    return false;
+  }
+  return true;
+}
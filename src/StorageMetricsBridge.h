@@ -0,0 +1,47 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVariantList>
+#include <QVariantMap>
+
+/**
+ * QML access to Storage metrics (see StorageMetrics), for diagnostics.
+ */
+class StorageMetricsBridge: public QObject {
+  Q_OBJECT
+
+public:
+  /** metrics as JSON document, empty string when Storage is not initialised */
+  Q_INVOKABLE QString json() const;
+
+  /** list of operations, every one is map with name, count, latency percentiles and counters */
+  Q_INVOKABLE QVariantList operations() const;
+
+  /** named event counters (like collectionReloadsCoalesced), map of name to count */
+  Q_INVOKABLE QVariantMap events() const;
+
+  Q_INVOKABLE void reset();
+
+  /** write metrics JSON to the file */
+  Q_INVOKABLE bool dump(const QString &file) const;
+};
@@ -0,0 +1,409 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Unit tests of storage file formats: TrackPointCodec, TrackJournal and TrackArchive.
+ * Executed by ctest (StorageTest target).
+ */
+
+#include "TrackArchive.h"
+#include "TrackJournal.h"
+#include "TrackPointCodec.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+using namespace osmscout;
+using namespace std::chrono;
+
+namespace {
+gpx::TrackPoint makePoint(double lat, double lon)
+{
+  return gpx::TrackPoint(GeoCoord(lat, lon));
+}
+
+Timestamp makeTime(qint64 millis)
+{
+  return Timestamp(milliseconds(millis));
+}
+
+/** compare points with precision of the storage formats (1e-7 degree, millisecond, centimeter) */
+bool samePoint(const gpx::TrackPoint &a, const gpx::TrackPoint &b)
+{
+  auto sameOptional = [](const std::optional<double> &x, const std::optional<double> &y) {
+    return x.has_value() == y.has_value() && (!x || std::abs(*x - *y) < 0.006);
+  };
+  return std::abs(a.coord.GetLat() - b.coord.GetLat()) < 1e-7 &&
+         std::abs(a.coord.GetLon() - b.coord.GetLon()) < 1e-7 &&
+         a.time == b.time &&
+         sameOptional(a.elevation, b.elevation) &&
+         sameOptional(a.hdop, b.hdop) &&
+         sameOptional(a.vdop, b.vdop);
+}
+
+bool samePoints(const std::vector<gpx::TrackPoint> &a, const std::vector<gpx::TrackPoint> &b)
+{
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (!samePoint(a[i], b[i])) {
+      qWarning() << "Point" << i << "differs";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool truncateFile(const QString &path, qint64 removeBytes)
+{
+  QFile file(path);
+  return file.open(QIODevice::ReadWrite) && file.resize(file.size() - removeBytes);
+}
+
+bool flipByte(const QString &path, qint64 offsetFromEnd)
+{
+  QFile file(path);
+  if (!file.open(QIODevice::ReadWrite) || !file.seek(file.size() - offsetFromEnd)) {
+    return false;
+  }
+  QByteArray byte = file.read(1);
+  byte[0] = char(byte[0] ^ 0x5A);
+  return file.seek(file.size() - offsetFromEnd) && file.write(byte) == 1;
+}
+}
+
+class StorageTest: public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void codecEmpty();
+  void codecPresenceModes_data();
+  void codecPresenceModes();
+  void codecExtremeDeltas();
+  void codecMalformed();
+
+  void journalRoundTrip();
+  void journalTornTail();
+  void journalCorruptedChecksum();
+
+  void archiveRoundTrip();
+  void archiveValidation();
+
+private:
+  QTemporaryDir directory;
+};
+
+void StorageTest::codecEmpty()
+{
+  QByteArray data = TrackPointCodec::encode({});
+  QCOMPARE(TrackPointCodec::pointCount(data), qint64(0));
+  std::vector<gpx::TrackPoint> decoded;
+  QVERIFY(TrackPointCodec::decode(data, decoded));
+  QVERIFY(decoded.empty());
+}
+
+void StorageTest::codecPresenceModes_data()
+{
+  // optional columns: none present, all present, presence bitmap
+  QTest::addColumn<int>("presence");
+  QTest::newRow("none") << 0;
+  QTest::newRow("all") << 1;
+  QTest::newRow("bitmap") << 2;
+}
+
+void StorageTest::codecPresenceModes()
+{
+  QFETCH(int, presence);
+
+  std::vector<gpx::TrackPoint> points;
+  for (int i = 0; i < 100; i++) {
+    gpx::TrackPoint point = makePoint(50.0 + i * 1e-4, 14.0 - i * 1e-4);
+    bool present = presence == 1 || (presence == 2 && i % 3 != 0);
+    if (present) {
+      point.time = makeTime(1650000000000 + i * 1000);
+      point.elevation = 250.0 + i * 0.25;
+      point.hdop = 3.5;
+      point.vdop = 7.25;
+    }
+    points.push_back(point);
+  }
+
+  QByteArray data = TrackPointCodec::encode(points);
+  QCOMPARE(TrackPointCodec::pointCount(data), qint64(points.size()));
+  std::vector<gpx::TrackPoint> decoded;
+  QVERIFY(TrackPointCodec::decode(data, decoded));
+  QVERIFY(samePoints(points, decoded));
+
+  // range encoding
+  data = TrackPointCodec::encode(points, 10, 20);
+  decoded.clear();
+  QVERIFY(TrackPointCodec::decode(data, decoded));
+  QVERIFY(samePoints(std::vector<gpx::TrackPoint>(points.begin() + 10, points.begin() + 20), decoded));
+}
+
+void StorageTest::codecExtremeDeltas()
+{
+  std::vector<gpx::TrackPoint> points;
+  gpx::TrackPoint point = makePoint(-90.0, -180.0);
+  point.time = makeTime(0);
+  point.elevation = -11000.0;
+  points.push_back(point);
+
+  point = makePoint(90.0, 180.0);
+  point.time = makeTime(4102444800000); // year 2100
+  point.elevation = 100000.0;
+  points.push_back(point);
+
+  point = makePoint(-90.0, 180.0);
+  point.time = makeTime(-62135596800000); // year 1
+  point.elevation = -100000.0;
+  points.push_back(point);
+
+  point = makePoint(0.0000001, -0.0000001);
+  point.time = makeTime(1);
+  points.push_back(point);
+
+  QByteArray data = TrackPointCodec::encode(points);
+  std::vector<gpx::TrackPoint> decoded;
+  QVERIFY(TrackPointCodec::decode(data, decoded));
+  QVERIFY(samePoints(points, decoded));
+}
+
+void StorageTest::codecMalformed()
+{
+  std::vector<gpx::TrackPoint> points;
+  for (int i = 0; i < 10; i++) {
+    gpx::TrackPoint point = makePoint(50.0 + i * 1e-3, 14.0);
+    point.time = makeTime(1650000000000 + i * 1000);
+    points.push_back(point);
+  }
+  QByteArray data = TrackPointCodec::encode(points);
+  std::vector<gpx::TrackPoint> decoded;
+  QVERIFY(!TrackPointCodec::decode(data.left(data.size() - 1), decoded));
+  decoded.clear();
+  QVERIFY(!TrackPointCodec::decode(QByteArray(), decoded));
+}
+
+void StorageTest::journalRoundTrip()
+{
+  QString path = directory.filePath("roundtrip.journal");
+  gpx::TrackPoint point = makePoint(50.1, 14.4);
+  point.time = makeTime(1650000000000);
+  point.elevation = 300.5;
+  {
+    TrackJournal journal;
+    QVERIFY(journal.open(path));
+    journal.setSyncPolicy(TrackJournal::SyncPolicy::Never);
+    QVERIFY(journal.append(1, point, true));
+    QVERIFY(journal.append(1, point, false));
+    QVERIFY(journal.append(2, point, false));
+    QVERIFY(journal.flush());
+  }
+
+  TrackJournal journal;
+  QVERIFY(journal.open(path));
+  std::vector<TrackJournal::Record> records;
+  qint64 generation;
+  qint64 end;
+  QVERIFY(journal.read(-1, records, generation, end));
+  QCOMPARE(records.size(), size_t(3));
+  QCOMPARE(generation, journal.currentGeneration());
+  QCOMPARE(end, QFileInfo(path).size());
+  QCOMPARE(records[0].trackId, qint64(1));
+  QVERIFY(records[0].newSegment);
+  QVERIFY(!records[1].newSegment);
+  QCOMPARE(records[2].trackId, qint64(2));
+  QVERIFY(samePoint(records[2].point, point));
+
+  // reset starts new generation without records
+  QVERIFY(journal.reset(generation, end));
+  QVERIFY(journal.currentGeneration() != generation);
+  records.clear();
+  QVERIFY(journal.read(-1, records, generation, end));
+  QVERIFY(records.empty());
+}
+
+void StorageTest::journalTornTail()
+{
+  QString path = directory.filePath("torn.journal");
+  qint64 validSize;
+  {
+    TrackJournal journal;
+    QVERIFY(journal.open(path));
+    QVERIFY(journal.append(1, makePoint(50.0, 14.0), true));
+    QVERIFY(journal.append(1, makePoint(50.1, 14.1), false));
+    QVERIFY(journal.flush());
+    validSize = QFileInfo(path).size();
+    QVERIFY(journal.append(1, makePoint(50.2, 14.2), false));
+  }
+  // record written partially before crash
+  QVERIFY(truncateFile(path, 3));
+
+  TrackJournal journal;
+  QVERIFY(journal.open(path));
+  QCOMPARE(QFileInfo(path).size(), validSize);
+  std::vector<TrackJournal::Record> records;
+  qint64 generation;
+  qint64 end;
+  QVERIFY(journal.read(-1, records, generation, end));
+  QCOMPARE(records.size(), size_t(2));
+  QCOMPARE(end, validSize);
+
+  // appending continues after the truncated tail
+  QVERIFY(journal.append(1, makePoint(50.3, 14.3), false));
+  records.clear();
+  QVERIFY(journal.read(-1, records, generation, end));
+  QCOMPARE(records.size(), size_t(3));
+  QVERIFY(samePoint(records[2].point, makePoint(50.3, 14.3)));
+}
+
+void StorageTest::journalCorruptedChecksum()
+{
+  QString path = directory.filePath("crc.journal");
+  qint64 validSize;
+  {
+    TrackJournal journal;
+    QVERIFY(journal.open(path));
+    QVERIFY(journal.append(1, makePoint(50.0, 14.0), true));
+    QVERIFY(journal.flush());
+    validSize = QFileInfo(path).size();
+    QVERIFY(journal.append(1, makePoint(50.1, 14.1), false));
+  }
+  // last byte of the last record payload
+  QVERIFY(flipByte(path, 1));
+
+  TrackJournal journal;
+  QVERIFY(journal.open(path));
+  QCOMPARE(QFileInfo(path).size(), validSize);
+  std::vector<TrackJournal::Record> records;
+  qint64 generation;
+  qint64 end;
+  QVERIFY(journal.read(-1, records, generation, end));
+  QCOMPARE(records.size(), size_t(1));
+}
+
+void StorageTest::archiveRoundTrip()
+{
+  gpx::Track track;
+  track.segments.resize(2);
+  for (int i = 0; i < 50; i++) {
+    gpx::TrackPoint point = makePoint(49.0 + i * 1e-4, 16.0 + i * 1e-4);
+    point.time = makeTime(1650000000000 + i * 1000);
+    if (i % 2 == 0) {
+      point.elevation = 200.0 + i;
+    }
+    track.segments[0].points.push_back(point);
+  }
+  // segment without optional values
+  for (int i = 0; i < 20; i++) {
+    track.segments[1].points.push_back(makePoint(-33.9 - i * 1e-4, 151.2));
+  }
+
+  QString path = directory.filePath("roundtrip.archive");
+  QVERIFY(TrackArchive::write(path, {10, 12}, track));
+  QVERIFY(!QFile::exists(path + ".tmp"));
+
+  TrackArchive archive;
+  QVERIFY(archive.open(path));
+  QCOMPARE(archive.segmentCount(), size_t(2));
+  QCOMPARE(archive.pointCount(), size_t(70));
+  QVERIFY(!archive.findSegment(11).has_value());
+
+  for (size_t s = 0; s < 2; s++) {
+    std::optional<TrackArchive::SegmentView> view = archive.findSegment(s == 0 ? 10 : 12);
+    QVERIFY(view.has_value());
+    QCOMPARE(view->size(), track.segments[s].points.size());
+    std::vector<gpx::TrackPoint> points;
+    view->appendTo(points);
+    QVERIFY(samePoints(track.segments[s].points, points));
+    QVERIFY(samePoint(view->point(3), track.segments[s].points[3]));
+
+    std::vector<gpx::TrackPoint> batched;
+    view->visitBatches(std::nullopt, [&batched](const std::vector<gpx::TrackPoint> &batch) {
+      QVERIFY(batch.size() <= TrackArchive::BatchSize);
+      batched.insert(batched.end(), batch.begin(), batch.end());
+    });
+    QVERIFY(samePoints(track.segments[s].points, batched));
+  }
+}
+
+void StorageTest::archiveValidation()
+{
+  gpx::Track track;
+  track.segments.resize(2);
+  for (auto &segment: track.segments) {
+    for (int i = 0; i < 10; i++) {
+      gpx::TrackPoint point = makePoint(49.0, 16.0 + i * 1e-3);
+      point.time = makeTime(1650000000000 + i * 1000);
+      segment.points.push_back(point);
+    }
+  }
+
+  QString path = directory.filePath("validation.archive");
+  QVERIFY(TrackArchive::write(path, {1, 2}, track));
+  {
+    TrackArchive archive;
+    QVERIFY(archive.open(path));
+  }
+
+  // size does not match the header
+  QVERIFY(truncateFile(path, 4));
+  {
+    TrackArchive archive;
+    QVERIFY(!archive.open(path));
+    QVERIFY(!archive.isOpen());
+  }
+
+  // foreign magic
+  QVERIFY(TrackArchive::write(path, {1, 2}, track));
+  {
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.write("XXXX", 4) == 4);
+  }
+  {
+    TrackArchive archive;
+    QVERIFY(!archive.open(path));
+  }
+
+  // segment ids have to be ascending
+  QVERIFY(TrackArchive::write(path, {2, 1}, track));
+  {
+    TrackArchive archive;
+    QVERIFY(!archive.open(path));
+  }
+
+  // header only
+  QVERIFY(truncateFile(path, QFileInfo(path).size() - 16));
+  {
+    TrackArchive archive;
+    QVERIFY(!archive.open(path));
+  }
+}
+
+QTEST_GUILESS_MAIN(StorageTest)
+#include "StorageTest.moc"
@@ -0,0 +1,370 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "TrackArchive.h"
+
+#include <osmscoutgpx/Utils.h>
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include <unistd.h>
+
+using namespace osmscout;
+
+namespace {
+constexpr char Magic[4] = {'O', 'S', 'T', 'A'};
+constexpr uint32_t FormatVersion = 1;
+constexpr uint32_t ByteOrderMark = 0x01020304;
+
+constexpr double CoordScale = 1e7;
+constexpr double MeterScale = 100; // centimeters
+
+// flags of optional columns present in the archive
+constexpr uint32_t TimeColumn = 1;
+constexpr uint32_t ElevationColumn = 2;
+constexpr uint32_t HdopColumn = 4;
+constexpr uint32_t VdopColumn = 8;
+
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t byteOrderMark;
+  uint32_t columns;
+  uint64_t segmentCount;
+  uint64_t pointCount;
+};
+static_assert(sizeof(Header) == 32, "unexpected archive header size");
+static_assert(sizeof(TrackArchive::Segment) == 24, "unexpected archive segment size");
+
+/** size of the archive, columns starts at 8-byte aligned offset */
+qint64 archiveSize(uint32_t columns, uint64_t segmentCount, uint64_t pointCount)
+{
+  qint64 size = sizeof(Header) + segmentCount * sizeof(TrackArchive::Segment);
+  if (columns & TimeColumn) {
+    size += pointCount * sizeof(int64_t);
+  }
+  int int32Columns = 2; // latitude, longitude
+  for (uint32_t column: {ElevationColumn, HdopColumn, VdopColumn}) {
+    if (columns & column) {
+      int32Columns++;
+    }
+  }
+  return size + int32Columns * pointCount * sizeof(int32_t);
+}
+
+int32_t toFixed32(double value, double scale)
+{
+  double fixed = std::round(value * scale);
+  // minimal value is reserved for missing value
+  return int32_t(std::clamp(fixed,
+                            double(std::numeric_limits<int32_t>::min() + 1),
+                            double(std::numeric_limits<int32_t>::max())));
+}
+
+std::optional<double> fromFixed32(const int32_t *column, size_t i)
+{
+  if (column == nullptr || column[i] == TrackArchive::MissingValue) {
+    return std::nullopt;
+  }
+  return double(column[i]) / MeterScale;
+}
+}
+
+TrackArchive::SegmentView::SegmentView(const TrackArchive &archive, const Segment &segment):
+  archive(&archive), segment(segment)
+{}
+
+GeoCoord TrackArchive::SegmentView::coord(size_t i) const
+{
+  size_t p = segment.firstPoint + i;
+  return GeoCoord(double(archive->latColumn[p]) / CoordScale,
+                  double(archive->lonColumn[p]) / CoordScale);
+}
+
+std::optional<Timestamp> TrackArchive::SegmentView::time(size_t i) const
+{
+  size_t p = segment.firstPoint + i;
+  if (archive->timeColumn == nullptr || archive->timeColumn[p] == MissingTime) {
+    return std::nullopt;
+  }
+  return Timestamp(std::chrono::milliseconds(archive->timeColumn[p]));
+}
+
+std::optional<double> TrackArchive::SegmentView::elevation(size_t i) const
+{
+  return fromFixed32(archive->elevationColumn, segment.firstPoint + i);
+}
+
+std::optional<double> TrackArchive::SegmentView::hdop(size_t i) const
+{
+  return fromFixed32(archive->hdopColumn, segment.firstPoint + i);
+}
+
+std::optional<double> TrackArchive::SegmentView::vdop(size_t i) const
+{
+  return fromFixed32(archive->vdopColumn, segment.firstPoint + i);
+}
+
+gpx::TrackPoint TrackArchive::SegmentView::point(size_t i) const
+{
+  gpx::TrackPoint result(coord(i));
+  result.time = time(i);
+  result.elevation = elevation(i);
+  result.hdop = hdop(i);
+  result.vdop = vdop(i);
+  return result;
+}
+
+void TrackArchive::SegmentView::appendTo(std::vector<gpx::TrackPoint> &points) const
+{
+  points.reserve(points.size() + size());
+  for (size_t i = 0; i < size(); i++) {
+    points.push_back(point(i));
+  }
+}
+
+void TrackArchive::SegmentView::visitBatches(std::optional<double> accuracyFilter,
+                                             const std::function<void(const std::vector<gpx::TrackPoint>&)> &visitor) const
+{
+  std::vector<gpx::TrackPoint> batch;
+  batch.reserve(std::min(size(), BatchSize));
+  for (size_t from = 0; from < size(); from += BatchSize) {
+    batch.clear();
+    size_t to = std::min(size(), from + BatchSize);
+    for (size_t i = from; i < to; i++) {
+      batch.push_back(point(i));
+    }
+    if (accuracyFilter) {
+      gpx::FilterInaccuratePoints(batch, *accuracyFilter);
+    }
+    if (!batch.empty()) {
+      visitor(batch);
+    }
+  }
+}
+
+TrackArchive::~TrackArchive()
+{
+  if (data != nullptr) {
+    file.unmap(const_cast<uchar*>(data));
+  }
+}
+
+bool TrackArchive::write(const QString &path,
+                         const std::vector<qint64> &segmentIds,
+                         const gpx::Track &track)
+{
+  using namespace std::chrono;
+
+  assert(segmentIds.size() == track.segments.size());
+
+  uint32_t columns = 0;
+  uint64_t pointCount = 0;
+  for (const auto &seg: track.segments) {
+    pointCount += seg.points.size();
+    for (const auto &p: seg.points) {
+      columns |= (p.time ? TimeColumn : 0u) |
+                 (p.elevation ? ElevationColumn : 0u) |
+                 (p.hdop ? HdopColumn : 0u) |
+                 (p.vdop ? VdopColumn : 0u);
+    }
+  }
+
+  QByteArray buffer(int(archiveSize(columns, segmentIds.size(), pointCount)), 0);
+  uchar *out = reinterpret_cast<uchar*>(buffer.data());
+
+  Header header;
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = FormatVersion;
+  header.byteOrderMark = ByteOrderMark;
+  header.columns = columns;
+  header.segmentCount = segmentIds.size();
+  header.pointCount = pointCount;
+  std::memcpy(out, &header, sizeof(Header));
+  out += sizeof(Header);
+
+  uint64_t firstPoint = 0;
+  for (size_t i = 0; i < segmentIds.size(); i++) {
+    Segment segment{segmentIds[i], firstPoint, track.segments[i].points.size()};
+    std::memcpy(out, &segment, sizeof(Segment));
+    out += sizeof(Segment);
+    firstPoint += segment.pointCount;
+  }
+
+  // write column of every point, getter returns the value for the point
+  auto writeColumn = [&](auto getter) {
+    using Value = decltype(getter(std::declval<const gpx::TrackPoint&>()));
+    for (const auto &seg: track.segments) {
+      for (const auto &p: seg.points) {
+        Value value = getter(p);
+        std::memcpy(out, &value, sizeof(Value));
+        out += sizeof(Value);
+      }
+    }
+  };
+  auto meterColumn = [](std::optional<double> gpx::TrackPoint::*member) {
+    return [member](const gpx::TrackPoint &p) {
+      const std::optional<double> &opt = p.*member;
+      return opt ? toFixed32(*opt, MeterScale) : MissingValue;
+    };
+  };
+
+  if (columns & TimeColumn) {
+    writeColumn([](const gpx::TrackPoint &p) {
+      return p.time ? int64_t(duration_cast<milliseconds>(p.time->time_since_epoch()).count()) : MissingTime;
+    });
+  }
+  writeColumn([](const gpx::TrackPoint &p) { return toFixed32(p.coord.GetLat(), CoordScale); });
+  writeColumn([](const gpx::TrackPoint &p) { return toFixed32(p.coord.GetLon(), CoordScale); });
+  if (columns & ElevationColumn) {
+    writeColumn(meterColumn(&gpx::TrackPoint::elevation));
+  }
+  if (columns & HdopColumn) {
+    writeColumn(meterColumn(&gpx::TrackPoint::hdop));
+  }
+  if (columns & VdopColumn) {
+    writeColumn(meterColumn(&gpx::TrackPoint::vdop));
+  }
+  assert(out == reinterpret_cast<uchar*>(buffer.data()) + buffer.size());
+
+  QString tmpPath = path + ".tmp";
+  QFile tmp(tmpPath);
+  if (!tmp.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning() << "Opening track archive" << tmpPath << "failed:" << tmp.errorString();
+    return false;
+  }
+  // archive replaces points in the database, it have to be on the disk before the database commit
+  if (tmp.write(buffer) != buffer.size() || !tmp.flush() || ::fdatasync(tmp.handle()) != 0) {
+    qWarning() << "Writing track archive" << tmpPath << "failed:" << tmp.errorString();
+    tmp.remove();
+    return false;
+  }
+  tmp.close();
+
+  QFile::remove(path);
+  if (!QFile::rename(tmpPath, path)) {
+    qWarning() << "Renaming track archive" << tmpPath << "to" << path << "failed";
+    QFile::remove(tmpPath);
+    return false;
+  }
+  return true;
+}
+
+bool TrackArchive::open(const QString &path)
+{
+  assert(!isOpen());
+  file.setFileName(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning() << "Opening track archive" << path << "failed:" << file.errorString();
+    return false;
+  }
+  qint64 size = file.size();
+  if (size < qint64(sizeof(Header))) {
+    qWarning() << "Track archive" << path << "is truncated";
+    return false;
+  }
+  const uchar *mapped = file.map(0, size);
+  if (mapped == nullptr) {
+    qWarning() << "Mapping track archive" << path << "failed:" << file.errorString();
+    return false;
+  }
+
+  Header header;
+  std::memcpy(&header, mapped, sizeof(Header));
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+      header.version != FormatVersion ||
+      header.byteOrderMark != ByteOrderMark ||
+      size != archiveSize(header.columns, header.segmentCount, header.pointCount)) {
+    qWarning() << "Track archive" << path << "is corrupted";
+    file.unmap(const_cast<uchar*>(mapped));
+    return false;
+  }
+
+  segments.resize(header.segmentCount);
+  std::memcpy(segments.data(), mapped + sizeof(Header), header.segmentCount * sizeof(Segment));
+  uint64_t firstPoint = 0;
+  for (size_t i = 0; i < segments.size(); i++) {
+    const Segment &segment = segments[i];
+    if (segment.firstPoint != firstPoint || (i > 0 && segment.segmentId <= segments[i - 1].segmentId)) {
+      qWarning() << "Track archive" << path << "is corrupted";
+      segments.clear();
+      file.unmap(const_cast<uchar*>(mapped));
+      return false;
+    }
+    firstPoint += segment.pointCount;
+  }
+  if (firstPoint != header.pointCount) {
+    qWarning() << "Track archive" << path << "is corrupted";
+    segments.clear();
+    file.unmap(const_cast<uchar*>(mapped));
+    return false;
+  }
+
+  // columns are aligned, mapping starts on page boundary
+  const uchar *column = mapped + sizeof(Header) + header.segmentCount * sizeof(Segment);
+  auto nextColumn = [&](uint32_t flag, auto *&ptr) {
+    using Value = std::remove_const_t<std::remove_pointer_t<std::remove_reference_t<decltype(ptr)>>>;
+    if (flag != 0 && (header.columns & flag) == 0) {
+      ptr = nullptr;
+      return;
+    }
+    ptr = reinterpret_cast<const Value*>(column);
+    column += header.pointCount * sizeof(Value);
+  };
+  nextColumn(TimeColumn, timeColumn);
+  nextColumn(0, latColumn);
+  nextColumn(0, lonColumn);
+  nextColumn(ElevationColumn, elevationColumn);
+  nextColumn(HdopColumn, hdopColumn);
+  nextColumn(VdopColumn, vdopColumn);
+
+  data = mapped;
+  return true;
+}
+
+size_t TrackArchive::pointCount() const
+{
+  return segments.empty() ? 0 : size_t(segments.back().firstPoint + segments.back().pointCount);
+}
+
+TrackArchive::SegmentView TrackArchive::segment(size_t index) const
+{
+  assert(index < segments.size());
+  return SegmentView(*this, segments[index]);
+}
+
+std::optional<TrackArchive::SegmentView> TrackArchive::findSegment(qint64 segmentId) const
+{
+  // segments are ordered by id
+  auto it = std::lower_bound(segments.begin(), segments.end(), segmentId,
+                             [](const Segment &segment, qint64 id) { return segment.segmentId < id; });
+  if (it == segments.end() || it->segmentId != segmentId) {
+    return std::nullopt;
+  }
+  return SegmentView(*this, *it);
+}
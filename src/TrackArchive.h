@@ -0,0 +1,183 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <osmscoutgpx/Track.h>
+
+#include <QFile>
+#include <QString>
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+/**
+ * Read-only archive of closed track points, stored in own file and mapped to memory.
+ *
+ * Points are stored as fixed-stride columns (struct of arrays): time (int64 milliseconds),
+ * latitude and longitude (int32, 1e-7 degree), elevation, horizontal and vertical accuracy
+ * (int32 centimeters). Optional columns without any value are omitted, missing values
+ * are marked by the minimal value of the column type. Columns are preceded by header
+ * and segment table (segment id, index of its first point and point count).
+ *
+ * Values are stored in native byte order, so the mapped columns are accessed directly,
+ * without decoding. Archive is local cache of the device, archive with foreign
+ * byte order is refused.
+ */
+class TrackArchive
+{
+public:
+  static constexpr int64_t MissingTime = std::numeric_limits<int64_t>::min();
+  static constexpr int32_t MissingValue = std::numeric_limits<int32_t>::min();
+  static constexpr size_t BatchSize = 1024; //!< points in batch of SegmentView::visitBatches
+
+  struct Segment
+  {
+    int64_t segmentId;
+    uint64_t firstPoint;
+    uint64_t pointCount;
+  };
+
+  /**
+   * View of archived segment points. It is valid while the archive is open.
+   */
+  class SegmentView
+  {
+  public:
+    SegmentView(const TrackArchive &archive, const Segment &segment);
+
+    qint64 segmentId() const
+    {
+      return qint64(segment.segmentId);
+    }
+
+    size_t size() const
+    {
+      return size_t(segment.pointCount);
+    }
+
+    /** point of the segment, read from mapped columns */
+    osmscout::gpx::TrackPoint point(size_t i) const;
+
+    /** coordinate of the point, just latitude and longitude columns are read */
+    osmscout::GeoCoord coord(size_t i) const;
+
+    /** materialize all points of the segment and append them to the vector */
+    void appendTo(std::vector<osmscout::gpx::TrackPoint> &points) const;
+
+    /**
+     * Visit points in batches of at most BatchSize points, inaccurate points are removed
+     * from the batch when accuracy filter is set (see osmscout::gpx::FilterInaccuratePoints).
+     * Batch buffer is reused, so memory usage doesn't grow with the segment size.
+     */
+    void visitBatches(std::optional<double> accuracyFilter,
+                      const std::function<void(const std::vector<osmscout::gpx::TrackPoint>&)> &visitor) const;
+
+  private:
+    std::optional<osmscout::Timestamp> time(size_t i) const;
+    std::optional<double> elevation(size_t i) const;
+    std::optional<double> hdop(size_t i) const;
+    std::optional<double> vdop(size_t i) const;
+
+  private:
+    const TrackArchive *archive;
+    Segment segment;
+  };
+
+public:
+  TrackArchive() = default;
+  TrackArchive(const TrackArchive&) = delete;
+  TrackArchive(TrackArchive&&) = delete;
+  ~TrackArchive();
+
+  TrackArchive& operator=(const TrackArchive&) = delete;
+  TrackArchive& operator=(TrackArchive&&) = delete;
+
+  /**
+   * Write segments of the track to the archive file. Segment ids (ascending)
+   * are matched with track segments by index. File is written to temporary file first,
+   * synced to the disk and renamed.
+   */
+  static bool write(const QString &path,
+                    const std::vector<qint64> &segmentIds,
+                    const osmscout::gpx::Track &track);
+
+  /**
+   * Map the archive file to memory and validate its structure.
+   */
+  bool open(const QString &path);
+  bool isOpen() const
+  {
+    return data != nullptr;
+  }
+
+  QString path() const
+  {
+    return file.fileName();
+  }
+
+  size_t segmentCount() const
+  {
+    return segments.size();
+  }
+
+  size_t pointCount() const;
+
+  SegmentView segment(size_t index) const;
+
+  /** @return view of segment with given id, when archive contains it */
+  std::optional<SegmentView> findSegment(qint64 segmentId) const;
+
+private:
+  QFile file;
+  const uchar *data{nullptr};
+  std::vector<Segment> segments;
+
+  // columns of the mapped file, optional columns are nullptr when omitted
+  const int64_t *timeColumn{nullptr};
+  const int32_t *latColumn{nullptr};
+  const int32_t *lonColumn{nullptr};
+  const int32_t *elevationColumn{nullptr};
+  const int32_t *hdopColumn{nullptr};
+  const int32_t *vdopColumn{nullptr};
+};
+
+/**
+ * Segments of archived track. Storage passes it to consumers instead of decoded points,
+ * so the points are read from the mapped archive in place. Views are valid while
+ * the archive is referenced.
+ */
+struct ArchivedTrackData
+{
+  std::shared_ptr<const TrackArchive> archive;
+  std::vector<TrackArchive::SegmentView> segments;
+
+  size_t pointCount() const
+  {
+    size_t result = 0;
+    for (const auto &segment: segments) {
+      result += segment.size();
+    }
+    return result;
+  }
+};
@@ -0,0 +1,117 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "TrackDataCache.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+
+TrackDataCache::TrackDataCache(size_t capacity):
+  capacity(capacity)
+{}
+
+size_t TrackDataCache::estimateBytes(const osmscout::gpx::Track &track)
+{
+  size_t bytes = sizeof(osmscout::gpx::Track);
+  for (const auto &segment: track.segments) {
+    bytes += sizeof(osmscout::gpx::TrackSegment) + segment.points.capacity() * sizeof(osmscout::gpx::TrackPoint);
+  }
+  return bytes;
+}
+
+TrackDataCache::Lookup TrackDataCache::acquire(const Key &key, Data &data, const Waiter &waiter)
+{
+  QMutexLocker locker(&mutex);
+  if (auto it = index.find(key); it != index.end()) {
+    stats.hits++;
+    it->second->lastUsage = std::chrono::steady_clock::now();
+    entries.splice(entries.begin(), entries, it->second);
+    data = it->second->data;
+    return Lookup::Hit;
+  }
+  if (auto it = pending.find(key); it != pending.end()) {
+    stats.coalesced++;
+    it->second.push_back(waiter);
+    return Lookup::Pending;
+  }
+  stats.misses++;
+  pending[key]; // load in progress, without waiters yet
+  return Lookup::Load;
+}
+
+void TrackDataCache::finish(const Key &key, const Data &data)
+{
+  std::vector<Waiter> waiters;
+  {
+    QMutexLocker locker(&mutex);
+    if (auto it = pending.find(key); it != pending.end()) {
+      waiters = std::move(it->second);
+      pending.erase(it);
+    }
+    if (data && index.find(key) == index.end()) {
+      size_t bytes = estimateBytes(*data);
+      if (bytes <= capacity) {
+        entries.push_front(Entry{key, data, bytes, std::chrono::steady_clock::now()});
+        index[key] = entries.begin();
+        stats.entries++;
+        stats.bytes += bytes;
+        evict();
+      }
+    }
+  }
+  // waiters may emit signals, don't hold the lock
+  for (const auto &waiter: waiters) {
+    waiter(data);
+  }
+}
+
+void TrackDataCache::evict()
+{
+  while (stats.bytes > capacity && !entries.empty()) {
+    const Entry &victim = entries.back();
+    stats.bytes -= victim.bytes;
+    stats.entries--;
+    index.erase(victim.key);
+    entries.pop_back();
+  }
+}
+
+void TrackDataCache::flush(std::chrono::milliseconds idle)
+{
+  QMutexLocker locker(&mutex);
+  auto threshold = std::chrono::steady_clock::now() - idle;
+  while (!entries.empty() && entries.back().lastUsage < threshold) {
+    const Entry &victim = entries.back();
+    stats.bytes -= victim.bytes;
+    stats.entries--;
+    index.erase(victim.key);
+    entries.pop_back();
+  }
+  if (stats.hits + stats.misses + stats.coalesced > 0) {
+    qDebug() << "Track data cache hit rate:" << (stats.hitRate() * 100) << "%"
+             << "(" << stats.hits << "hits," << stats.coalesced << "coalesced," << stats.misses << "misses),"
+             << stats.entries << "entries," << (stats.bytes / 1024) << "KiB";
+  }
+}
+
+TrackDataCache::Statistics TrackDataCache::statistics() const
+{
+  QMutexLocker locker(&mutex);
+  return stats;
+}
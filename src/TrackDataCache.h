@@ -0,0 +1,125 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <osmscoutgpx/Track.h>
+
+#include <QDateTime>
+#include <QMutex>
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * Memory bounded LRU cache of decoded track points, shared by all Storage connections.
+ * Entries are keyed by track id and its last modification, so modified track is never
+ * served from the cache, its outdated entry is evicted eventually.
+ *
+ * Concurrent loads of the same entry are coalesced: first caller loads the data,
+ * others are registered as waiters and are notified when the load is finished.
+ * It is thread safe.
+ */
+class TrackDataCache
+{
+public:
+  using Key = std::pair<qint64, qint64>; //!< track id, last modification (ms since epoch)
+  using Data = std::shared_ptr<const osmscout::gpx::Track>;
+  using Waiter = std::function<void(const Data&)>; //!< data are null when load failed
+
+  enum class Lookup {
+    Hit, //!< data are cached
+    Pending, //!< load is in progress already, waiter will be notified
+    Load //!< caller should load the data and call finish
+  };
+
+  struct Statistics
+  {
+    qint64 hits{0};
+    qint64 misses{0};
+    qint64 coalesced{0}; //!< requests waiting for load in progress
+    size_t entries{0};
+    size_t bytes{0};
+
+    double hitRate() const
+    {
+      qint64 total = hits + misses + coalesced;
+      return total == 0 ? 0 : double(hits + coalesced) / double(total);
+    }
+  };
+
+  static constexpr size_t DefaultCapacity = 32 * 1024 * 1024; // bytes
+
+  explicit TrackDataCache(size_t capacity = DefaultCapacity);
+  TrackDataCache(const TrackDataCache&) = delete;
+  TrackDataCache(TrackDataCache&&) = delete;
+  ~TrackDataCache() = default;
+
+  TrackDataCache& operator=(const TrackDataCache&) = delete;
+  TrackDataCache& operator=(TrackDataCache&&) = delete;
+
+  static Key key(qint64 trackId, const QDateTime &lastModification)
+  {
+    return Key(trackId, lastModification.toMSecsSinceEpoch());
+  }
+
+  /**
+   * Lookup data. When load of the same entry is in progress, waiter is registered.
+   * When it returns Load, caller have to call finish with the same key.
+   */
+  Lookup acquire(const Key &key, Data &data, const Waiter &waiter);
+
+  /**
+   * Store loaded data (null on failure) and notify waiters, from the caller thread.
+   */
+  void finish(const Key &key, const Data &data);
+
+  /**
+   * Evict entries not used longer than idle time.
+   */
+  void flush(std::chrono::milliseconds idle);
+
+  Statistics statistics() const;
+
+private:
+  struct Entry
+  {
+    Key key;
+    Data data;
+    size_t bytes;
+    std::chrono::steady_clock::time_point lastUsage;
+  };
+
+  static size_t estimateBytes(const osmscout::gpx::Track &track);
+
+  void evict();
+
+private:
+  mutable QMutex mutex;
+  size_t capacity;
+  std::list<Entry> entries; //!< most recently used first
+  std::map<Key, std::list<Entry>::iterator> index;
+  std::map<Key, std::vector<Waiter>> pending;
+  Statistics stats;
+};
@@ -35,12 +35,16 @@ TrackElevationChartWidget::TrackElevationChartWidget(QQuickItem* parent)
 
   connect(this, &TrackElevationChartWidget::trackDataRequest,
           storage, &Storage::loadTrackData,
-          Qt::QueuedConnection);
+          Qt::DirectConnection);
 
   connect(storage, &Storage::trackDataLoaded,
           this, &TrackElevationChartWidget::onTrackDataLoaded,
           Qt::QueuedConnection);
 
+  connect(storage, &Storage::trackPointsLoaded,
+          this, &TrackElevationChartWidget::onTrackPointsLoaded,
+          Qt::QueuedConnection);
+
   connect(this, &TrackElevationChartWidget::loadingChanged,
           this, &TrackElevationChartWidget::loadingChanged2);
 }
@@ -59,42 +63,110 @@ void TrackElevationChartWidget::storageInitialisationError(QString)
   storageInitialised();
 }
 
-void TrackElevationChartWidget::onTrackDataLoaded(Track track, std::optional<double>, bool complete, bool /*ok*/)
+void TrackElevationChartWidget::resetProfile()
+{
+  points.clear();
+  lowest=std::nullopt;
+  highest=std::nullopt;
+  trackStat=TrackStatisticsAccumulator();
+  elevationFilter=ElevationFilter();
+  currentSegment=-1;
+  currentSegmentPoints=0;
+  processedPoints=0;
+  partialUpdateTimer.invalidate();
+}
+
+void TrackElevationChartWidget::appendPoints(int segment, const std::vector<osmscout::gpx::TrackPoint> &segmentPoints)
 {
   using namespace osmscout;
+  if (segment != currentSegment) {
+    if (currentSegment >= 0) {
+      trackStat.segmentEnd();
+      elevationFilter.flush();
+    }
+    currentSegment = segment;
+    currentSegmentPoints = 0;
+  }
+  points.reserve(points.size()+segmentPoints.size());
+  for (const auto &point : segmentPoints) {
+    trackStat.update(point);
+    std::optional<osmscout::Distance> eleOpt = elevationFilter.update(point);
+    if (eleOpt.has_value()) {
+      ElevationPoint pt{trackStat.getLength(), *eleOpt, point.coord, nullptr};
+      // qDebug() << "On" << pt.distance.AsMeter() << "ele" << pt.elevation.AsMeter();
+      points.push_back(pt);
+      if (!lowest.has_value() || lowest->elevation > pt.elevation){
+        lowest=pt;
+      }
+      if (!highest.has_value() || highest->elevation < pt.elevation){
+        highest=pt;
+      }
+    }
+  }
+  currentSegmentPoints+=qint64(segmentPoints.size());
+  processedPoints+=segmentPoints.size();
+}
+
+void TrackElevationChartWidget::onTrackPointsLoaded(qint64 trackId, std::optional<double> accuracyFilter, int segment, qint64 offset,
+                                                    std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> segmentPoints)
+{
+  if (!loading || trackId != track.id || accuracyFilter != this->accuracyFilter || !segmentPoints){
+    return;
+  }
+  if (segment < currentSegment ||
+      offset != (segment == currentSegment ? currentSegmentPoints : 0)) {
+    return; // chunk of concurrent load
+  }
+  appendPoints(segment, *segmentPoints);
+
+  // first chunk is rendered immediately, following ones are throttled
+  if (!partialUpdateTimer.isValid() || partialUpdateTimer.elapsed() >= PartialUpdateIntervalMs) {
+    partialUpdateTimer.start();
+    update();
+    emit pointsUpdated();
+  }
+}
+
+void TrackElevationChartWidget::onTrackDataLoaded(Track track, std::optional<double> accuracyFilter, bool complete, bool /*ok*/)
+{
   if (track.id != this->track.id || accuracyFilter != this->accuracyFilter){
     return;
   }
+  if (!complete && !loading) {
+    return; // metadata of load requested by someone else
+  }
   // TODO: error handling when !ok
   loading = !complete;
-  if (complete) {
+  if (!complete) {
+    // metadata, points will follow by onTrackPointsLoaded
+    resetProfile();
+  } else if (track.archive) {
+    // archived points are not emitted progressively, profile is computed from the mapped archive
     QElapsedTimer timer;
     timer.start();
-    points.clear();
-    TrackStatisticsAccumulator trackStat;
-    ElevationFilter elevationFilter;
+    resetProfile();
+    for (size_t i = 0; i < track.archive->segments.size(); i++) {
+      track.archive->segments[i].visitBatches(accuracyFilter, [this, i](const std::vector<osmscout::gpx::TrackPoint> &points) {
+        appendPoints(int(i), points);
+      });
+    }
+    qDebug() << "Preparing elevation profile from archive took" << timer.elapsed() << "ms";
+  } else if (track.data) {
+    size_t pointCount = 0;
     for (const auto &segment : track.data->segments) {
-      points.reserve(points.size()+segment.points.size());
-      for (const auto &point : segment.points) {
-        trackStat.update(point);
-        std::optional<osmscout::Distance> eleOpt = elevationFilter.update(point);
-        if (eleOpt.has_value()) {
-          ElevationPoint pt{trackStat.getLength(), *eleOpt, point.coord, nullptr};
-          // qDebug() << "On" << pt.distance.AsMeter() << "ele" << pt.elevation.AsMeter();
-          points.push_back(pt);
-          if (!lowest.has_value() || lowest->elevation > pt.elevation){
-            lowest=pt;
-          }
-          if (!highest.has_value() || highest->elevation < pt.elevation){
-            highest=pt;
-          }
-        }
+      pointCount += segment.points.size();
+    }
+    if (pointCount != processedPoints) {
+      // progressive loading was not received completely, compute profile from the whole track
+      QElapsedTimer timer;
+      timer.start();
+      resetProfile();
+      for (size_t i = 0; i < track.data->segments.size(); i++) {
+        appendPoints(int(i), track.data->segments[i].points);
       }
-      trackStat.segmentEnd();
-      elevationFilter.flush();
+      // be careful with elapsed time, method is processed in UI thread
+      qDebug() << "Preparing elevation profile took" << timer.elapsed() << "ms";
     }
-    // be careful with elapsed time, method is processed in UI thread
-    qDebug() << "Preparing elevation profile took" << timer.elapsed() << "ms";
   }
   ascent=track.statistics.ascent;
   descent=track.statistics.descent;
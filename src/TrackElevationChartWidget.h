@@ -22,6 +22,8 @@
 
 #include "Storage.h"
 
+#include <QElapsedTimer>
+
 class TrackElevationChartWidget : public osmscout::ElevationChartWidget
 {
   Q_OBJECT
@@ -35,6 +37,8 @@ public slots:
   void storageInitialised();
   void storageInitialisationError(QString);
   void onTrackDataLoaded(Track track, std::optional<double>, bool complete, bool ok);
+  void onTrackPointsLoaded(qint64 trackId, std::optional<double> accuracyFilter, int segment, qint64 offset,
+                           std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> points);
 
 public:
   TrackElevationChartWidget(QQuickItem* parent = nullptr);
@@ -44,6 +48,20 @@ public:
   void setTrackId(QString id);
 
 private:
+  void resetProfile();
+  void appendPoints(int segment, const std::vector<osmscout::gpx::TrackPoint> &segmentPoints);
+
+private:
+  static constexpr qint64 PartialUpdateIntervalMs = 200;
+
   Track track;
   std::optional<double> accuracyFilter=100;
+
+  // profile is computed incrementally, while track points are loaded
+  TrackStatisticsAccumulator trackStat;
+  ElevationFilter elevationFilter;
+  int currentSegment{-1};
+  qint64 currentSegmentPoints{0};
+  size_t processedPoints{0};
+  QElapsedTimer partialUpdateTimer;
 };
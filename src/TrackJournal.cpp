@@ -0,0 +1,259 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "TrackJournal.h"
+#include "TrackPointCodec.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QtEndian>
+
+#include <array>
+
+#include <unistd.h>
+
+using namespace osmscout;
+
+namespace {
+constexpr char Magic[4] = {'O', 'S', 'T', 'J'};
+constexpr qint64 HeaderSize = 4 + 8; // magic, generation
+constexpr qint64 RecordHeaderSize = 4 + 4; // length, crc
+constexpr quint32 MaxPayloadSize = 1024;
+
+constexpr uint8_t PointRecord = 1;
+constexpr uint8_t NewSegmentFlag = 1;
+
+quint32 crc32(const QByteArray &data)
+{
+  static const std::array<quint32, 256> table = [](){
+    std::array<quint32, 256> result{};
+    for (quint32 i = 0; i < 256; i++) {
+      quint32 c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      result[i] = c;
+    }
+    return result;
+  }();
+
+  quint32 crc = 0xFFFFFFFFu;
+  for (char ch: data) {
+    crc = table[(crc ^ uint8_t(ch)) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+}
+
+TrackJournal::~TrackJournal()
+{
+  QMutexLocker locker(&mutex);
+  if (file.isOpen()) {
+    sync();
+    file.close();
+  }
+}
+
+bool TrackJournal::open(const QString &path)
+{
+  QMutexLocker locker(&mutex);
+  file.setFileName(path);
+  if (!file.open(QIODevice::ReadWrite)) {
+    qWarning() << "Cannot open track journal" << path << file.errorString();
+    return false;
+  }
+
+  QByteArray header = file.read(HeaderSize);
+  if (header.size() < HeaderSize || !header.startsWith(QByteArray(Magic, sizeof(Magic)))) {
+    if (file.size() > 0) {
+      qWarning() << "Track journal" << path << "is not valid, it is replaced";
+    }
+    if (!writeHeader(QDateTime::currentMSecsSinceEpoch())) {
+      file.close();
+      return false;
+    }
+    return true;
+  }
+  generation = qFromLittleEndian<qint64>(reinterpret_cast<const uchar*>(header.constData() + 4));
+
+  qint64 end = readRecords(HeaderSize, nullptr);
+  if (end < file.size()) {
+    qWarning() << "Truncating invalid tail of track journal," << (file.size() - end) << "bytes";
+    if (!file.resize(end)) {
+      qWarning() << "Truncating track journal failed" << file.errorString();
+      file.close();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TrackJournal::isOpen() const
+{
+  QMutexLocker locker(&mutex);
+  return file.isOpen();
+}
+
+qint64 TrackJournal::currentGeneration() const
+{
+  QMutexLocker locker(&mutex);
+  return generation;
+}
+
+void TrackJournal::setSyncPolicy(SyncPolicy policy, int intervalMs)
+{
+  QMutexLocker locker(&mutex);
+  syncPolicy = policy;
+  syncIntervalMs = intervalMs;
+}
+
+bool TrackJournal::append(qint64 trackId, const gpx::TrackPoint &point, bool newSegment)
+{
+  QByteArray payload;
+  payload.append(char(PointRecord));
+  payload.append(char(newSegment ? NewSegmentFlag : 0));
+  uchar id[8];
+  qToLittleEndian<qint64>(trackId, id);
+  payload.append(reinterpret_cast<const char*>(id), sizeof(id));
+  payload.append(TrackPointCodec::encode(std::vector<gpx::TrackPoint>{point}));
+
+  uchar header[RecordHeaderSize];
+  qToLittleEndian<quint32>(quint32(payload.size()), header);
+  qToLittleEndian<quint32>(crc32(payload), header + 4);
+  payload.prepend(reinterpret_cast<const char*>(header), sizeof(header));
+
+  QMutexLocker locker(&mutex);
+  if (!file.isOpen()) {
+    return false;
+  }
+  // single write call, so the record is written to the system completely or it is torn at the end
+  if (!file.seek(file.size()) || file.write(payload) != payload.size() || !file.flush()) {
+    qWarning() << "Writing track journal failed" << file.errorString();
+    return false;
+  }
+
+  syncPending = true;
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  if (syncPolicy == SyncPolicy::EveryRecord ||
+      (syncPolicy == SyncPolicy::Interval && now - lastSyncMs >= syncIntervalMs)) {
+    return sync();
+  }
+  return true;
+}
+
+bool TrackJournal::flush()
+{
+  QMutexLocker locker(&mutex);
+  if (!file.isOpen()) {
+    return false;
+  }
+  return sync();
+}
+
+bool TrackJournal::read(qint64 offset, std::vector<Record> &records, qint64 &readGeneration, qint64 &end)
+{
+  QMutexLocker locker(&mutex);
+  if (!file.isOpen()) {
+    return false;
+  }
+  readGeneration = generation;
+  end = readRecords(std::max(offset, HeaderSize), &records);
+  return true;
+}
+
+bool TrackJournal::reset(qint64 readGeneration, qint64 end)
+{
+  QMutexLocker locker(&mutex);
+  if (!file.isOpen() || readGeneration != generation || file.size() != end) {
+    return false;
+  }
+  if (end <= HeaderSize) {
+    return true; // empty already
+  }
+  if (!file.resize(0)) {
+    qWarning() << "Truncating track journal failed" << file.errorString();
+    return false;
+  }
+  return writeHeader(generation + 1);
+}
+
+bool TrackJournal::writeHeader(qint64 newGeneration)
+{
+  QByteArray header(Magic, sizeof(Magic));
+  uchar gen[8];
+  qToLittleEndian<qint64>(newGeneration, gen);
+  header.append(reinterpret_cast<const char*>(gen), sizeof(gen));
+  if (!file.resize(0) || !file.seek(0) || file.write(header) != header.size() || !file.flush()) {
+    qWarning() << "Writing track journal header failed" << file.errorString();
+    return false;
+  }
+  generation = newGeneration;
+  syncPending = true;
+  return sync();
+}
+
+bool TrackJournal::sync()
+{
+  if (!syncPending) {
+    return true;
+  }
+  lastSyncMs = QDateTime::currentMSecsSinceEpoch();
+  syncPending = false;
+  if (::fdatasync(file.handle()) != 0) {
+    qWarning() << "Track journal sync failed";
+    return false;
+  }
+  return true;
+}
+
+qint64 TrackJournal::readRecords(qint64 offset, std::vector<Record> *records)
+{
+  if (!file.seek(offset)) {
+    return offset;
+  }
+  while (true) {
+    QByteArray header = file.read(RecordHeaderSize);
+    if (header.size() < RecordHeaderSize) {
+      break;
+    }
+    quint32 length = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(header.constData()));
+    quint32 crc = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(header.constData() + 4));
+    if (length < 10 || length > MaxPayloadSize) {
+      break;
+    }
+    QByteArray payload = file.read(length);
+    if (payload.size() < int(length) || crc32(payload) != crc || uint8_t(payload[0]) != PointRecord) {
+      break;
+    }
+    if (records != nullptr) {
+      Record record;
+      record.newSegment = (uint8_t(payload[1]) & NewSegmentFlag) != 0;
+      record.trackId = qFromLittleEndian<qint64>(reinterpret_cast<const uchar*>(payload.constData() + 2));
+      std::vector<gpx::TrackPoint> points;
+      if (!TrackPointCodec::decode(payload.mid(10), points) || points.size() != 1) {
+        break;
+      }
+      record.point = points.front();
+      records->push_back(std::move(record));
+    }
+    offset += RecordHeaderSize + length;
+  }
+  return offset;
+}
@@ -0,0 +1,118 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <osmscoutgpx/TrackPoint.h>
+
+#include <QFile>
+#include <QMutex>
+#include <QString>
+
+#include <vector>
+
+/**
+ * Append-only journal of recorded track points. Every position fix is appended
+ * by Tracker immediately, so points that are not stored in the database yet
+ * survive application kill. Storage compacts the journal into the database
+ * (see Storage::compactJournal) and resets it when everything is compacted.
+ *
+ * File starts with header (magic, generation), followed by records:
+ * payload length (uint32), CRC-32 of payload (uint32) and payload (record type,
+ * flags, track id and point packed by TrackPointCodec). Torn record at the end
+ * of the file (written partially before crash) is detected by the checksum
+ * and truncated on open.
+ *
+ * Generation is changed on every reset, so compacted position stored
+ * in the database is not applied to a new journal. It is thread safe.
+ */
+class TrackJournal
+{
+public:
+  enum class SyncPolicy
+  {
+    Never = 0, //!< data are written to the system, it survives application crash, but not power loss
+    Interval = 1, //!< fsync at most once per sync interval
+    EveryRecord = 2 //!< fsync after every record
+  };
+
+  struct Record
+  {
+    qint64 trackId{-1};
+    bool newSegment{false}; //!< point starts new segment of the track
+    osmscout::gpx::TrackPoint point{osmscout::GeoCoord()};
+  };
+
+  static constexpr int DefaultSyncIntervalMs = 5000;
+
+public:
+  TrackJournal() = default;
+  TrackJournal(const TrackJournal&) = delete;
+  TrackJournal(TrackJournal&&) = delete;
+  ~TrackJournal();
+
+  TrackJournal& operator=(const TrackJournal&) = delete;
+  TrackJournal& operator=(TrackJournal&&) = delete;
+
+  /**
+   * Open or create journal file, invalid tail is truncated.
+   */
+  bool open(const QString &path);
+  bool isOpen() const;
+
+  void setSyncPolicy(SyncPolicy policy, int intervalMs = DefaultSyncIntervalMs);
+
+  qint64 currentGeneration() const;
+
+  bool append(qint64 trackId, const osmscout::gpx::TrackPoint &point, bool newSegment);
+
+  /**
+   * Sync records appended after the last sync. With Interval policy, append syncs only
+   * when the interval elapsed, so the owner should flush the journal by timer.
+   */
+  bool flush();
+
+  /**
+   * Read valid records from the offset (position after header when it is negative).
+   *
+   * @param readGeneration generation of the journal
+   * @param end offset after the last valid record
+   */
+  bool read(qint64 offset, std::vector<Record> &records, qint64 &readGeneration, qint64 &end);
+
+  /**
+   * Remove all records and start new generation, when the journal was not appended
+   * since end of the generation was read.
+   */
+  bool reset(qint64 generation, qint64 end);
+
+private:
+  bool writeHeader(qint64 generation);
+  bool sync();
+  qint64 readRecords(qint64 offset, std::vector<Record> *records);
+
+private:
+  mutable QMutex mutex;
+  QFile file;
+  qint64 generation{0};
+  SyncPolicy syncPolicy{SyncPolicy::Interval};
+  int syncIntervalMs{DefaultSyncIntervalMs};
+  qint64 lastSyncMs{0};
+  bool syncPending{false};
+};
@@ -0,0 +1,322 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "TrackPointCodec.h"
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+
+using namespace osmscout;
+
+namespace {
+constexpr uint8_t FormatVersion = 1;
+
+constexpr double CoordScale = 1e7;
+constexpr double MeterScale = 100; // centimeters
+
+enum ColumnMode: uint8_t {
+  NonePresent = 0,
+  AllPresent = 1,
+  PresenceBitmap = 2
+};
+
+void writeVarUInt(QByteArray &buffer, uint64_t value)
+{
+  while (value >= 0x80) {
+    buffer.append(char((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  buffer.append(char(value));
+}
+
+void writeVarInt(QByteArray &buffer, int64_t value)
+{
+  // zig-zag encoding, small negative numbers are small positive numbers then
+  writeVarUInt(buffer, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+}
+
+int64_t toFixed(double value, double scale)
+{
+  return std::llround(value * scale);
+}
+
+class Reader
+{
+public:
+  explicit Reader(const QByteArray &data):
+    pos(reinterpret_cast<const uint8_t*>(data.constData())),
+    end(pos + data.size())
+  {}
+
+  bool readByte(uint8_t &value)
+  {
+    if (pos >= end) {
+      return false;
+    }
+    value = *pos++;
+    return true;
+  }
+
+  bool readVarUInt(uint64_t &value)
+  {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t byte;
+      if (!readByte(byte)) {
+        return false;
+      }
+      value |= uint64_t(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readVarInt(int64_t &value)
+  {
+    uint64_t raw;
+    if (!readVarUInt(raw)) {
+      return false;
+    }
+    value = int64_t(raw >> 1) ^ -int64_t(raw & 1);
+    return true;
+  }
+
+  const uint8_t* readBytes(size_t count)
+  {
+    if (size_t(end - pos) < count) {
+      return nullptr;
+    }
+    const uint8_t *result = pos;
+    pos += count;
+    return result;
+  }
+
+private:
+  const uint8_t *pos;
+  const uint8_t *end;
+};
+
+/**
+ * Write optional column. Getter returns true when value is present
+ * and set fixed-point value to its argument.
+ */
+void writeOptionalColumn(QByteArray &buffer,
+                         size_t count,
+                         const std::function<bool(size_t, int64_t&)> &getter)
+{
+  std::vector<int64_t> values;
+  values.reserve(count);
+  std::vector<bool> presence(count, false);
+  for (size_t i = 0; i < count; i++) {
+    int64_t value;
+    if (getter(i, value)) {
+      presence[i] = true;
+      values.push_back(value);
+    }
+  }
+
+  if (values.empty()) {
+    buffer.append(char(NonePresent));
+    return;
+  }
+  if (values.size() == count) {
+    buffer.append(char(AllPresent));
+  } else {
+    buffer.append(char(PresenceBitmap));
+    QByteArray bitmap((count + 7) / 8, 0);
+    for (size_t i = 0; i < count; i++) {
+      if (presence[i]) {
+        bitmap[int(i / 8)] = char(uint8_t(bitmap[int(i / 8)]) | (1 << (i % 8)));
+      }
+    }
+    buffer.append(bitmap);
+  }
+
+  int64_t previous = 0;
+  for (int64_t value: values) {
+    writeVarInt(buffer, value - previous);
+    previous = value;
+  }
+}
+
+/**
+ * Read optional column. Setter is called for every present value.
+ */
+bool readOptionalColumn(Reader &reader,
+                        size_t count,
+                        const std::function<void(size_t, int64_t)> &setter)
+{
+  uint8_t mode;
+  if (!reader.readByte(mode)) {
+    return false;
+  }
+  if (mode == NonePresent) {
+    return true;
+  }
+
+  const uint8_t *bitmap = nullptr;
+  if (mode == PresenceBitmap) {
+    bitmap = reader.readBytes((count + 7) / 8);
+    if (bitmap == nullptr) {
+      return false;
+    }
+  } else if (mode != AllPresent) {
+    return false;
+  }
+
+  int64_t value = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (bitmap != nullptr && (bitmap[i / 8] & (1 << (i % 8))) == 0) {
+      continue;
+    }
+    int64_t delta;
+    if (!reader.readVarInt(delta)) {
+      return false;
+    }
+    value += delta;
+    setter(i, value);
+  }
+  return true;
+}
+}
+
+QByteArray TrackPointCodec::encode(const std::vector<gpx::TrackPoint> &points,
+                                   size_t from,
+                                   size_t to)
+{
+  using namespace std::chrono;
+
+  assert(from <= to && to <= points.size());
+  size_t count = to - from;
+
+  QByteArray buffer;
+  // rough estimate: coordinates with small deltas takes 2-3 bytes each, time 1-2 bytes
+  buffer.reserve(int(16 + count * 8));
+  buffer.append(char(FormatVersion));
+  writeVarUInt(buffer, count);
+
+  int64_t previous = 0;
+  for (size_t i = from; i < to; i++) {
+    int64_t lat = toFixed(points[i].coord.GetLat(), CoordScale);
+    writeVarInt(buffer, lat - previous);
+    previous = lat;
+  }
+  previous = 0;
+  for (size_t i = from; i < to; i++) {
+    int64_t lon = toFixed(points[i].coord.GetLon(), CoordScale);
+    writeVarInt(buffer, lon - previous);
+    previous = lon;
+  }
+
+  writeOptionalColumn(buffer, count, [&](size_t i, int64_t &value) {
+    const gpx::TrackPoint &p = points[from + i];
+    if (!p.time) {
+      return false;
+    }
+    value = duration_cast<milliseconds>(p.time->time_since_epoch()).count();
+    return true;
+  });
+
+  auto meterColumn = [&](std::optional<double> gpx::TrackPoint::*member) {
+    writeOptionalColumn(buffer, count, [&](size_t i, int64_t &value) {
+      const std::optional<double> &opt = points[from + i].*member;
+      if (!opt) {
+        return false;
+      }
+      value = toFixed(*opt, MeterScale);
+      return true;
+    });
+  };
+  meterColumn(&gpx::TrackPoint::elevation);
+  meterColumn(&gpx::TrackPoint::hdop);
+  meterColumn(&gpx::TrackPoint::vdop);
+
+  return buffer;
+}
+
+bool TrackPointCodec::decode(const QByteArray &data, std::vector<gpx::TrackPoint> &points)
+{
+  using namespace std::chrono;
+
+  Reader reader(data);
+  uint8_t version;
+  uint64_t count;
+  if (!reader.readByte(version) || version != FormatVersion || !reader.readVarUInt(count)) {
+    return false;
+  }
+  // every point takes at least two bytes (latitude and longitude delta)
+  if (count > uint64_t(data.size())) {
+    return false;
+  }
+
+  std::vector<int64_t> lats;
+  lats.reserve(count);
+  int64_t value = 0;
+  for (uint64_t i = 0; i < count; i++) {
+    int64_t delta;
+    if (!reader.readVarInt(delta)) {
+      return false;
+    }
+    value += delta;
+    lats.push_back(value);
+  }
+
+  size_t first = points.size();
+  points.reserve(first + count);
+  value = 0;
+  for (uint64_t i = 0; i < count; i++) {
+    int64_t delta;
+    if (!reader.readVarInt(delta)) {
+      return false;
+    }
+    value += delta;
+    points.emplace_back(GeoCoord(double(lats[i]) / CoordScale, double(value) / CoordScale));
+  }
+
+  if (!readOptionalColumn(reader, count, [&](size_t i, int64_t millis) {
+        points[first + i].time = Timestamp(milliseconds(millis));
+      })) {
+    return false;
+  }
+
+  auto meterColumn = [&](std::optional<double> gpx::TrackPoint::*member) {
+    return readOptionalColumn(reader, count, [&](size_t i, int64_t fixed) {
+      points[first + i].*member = double(fixed) / MeterScale;
+    });
+  };
+  return meterColumn(&gpx::TrackPoint::elevation) &&
+         meterColumn(&gpx::TrackPoint::hdop) &&
+         meterColumn(&gpx::TrackPoint::vdop);
+}
+
+qint64 TrackPointCodec::pointCount(const QByteArray &data)
+{
+  Reader reader(data);
+  uint8_t version;
+  uint64_t count;
+  if (!reader.readByte(version) || version != FormatVersion || !reader.readVarUInt(count)) {
+    return -1;
+  }
+  return qint64(count);
+}
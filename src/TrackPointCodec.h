@@ -0,0 +1,71 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <osmscoutgpx/TrackPoint.h>
+
+#include <QByteArray>
+
+#include <vector>
+
+/**
+ * Compact binary representation of track points, used for storing
+ * chunks of track segment in the database (track_segment_data table).
+ *
+ * Points are stored column by column (latitude, longitude, time, elevation,
+ * horizontal and vertical accuracy). Every column is delta-encoded
+ * and packed as zig-zag varints. Optional columns (all except coordinates)
+ * are prefixed by presence mode: none present, all present, or presence bitmap.
+ *
+ * Precision of stored values:
+ *  - coordinates: 1e-7 degree (~1 cm)
+ *  - time: millisecond
+ *  - elevation and accuracy: centimeter
+ */
+class TrackPointCodec
+{
+public:
+  TrackPointCodec() = delete;
+
+  /**
+   * Encode points in range [from, to)
+   */
+  static QByteArray encode(const std::vector<osmscout::gpx::TrackPoint> &points,
+                           size_t from,
+                           size_t to);
+
+  static QByteArray encode(const std::vector<osmscout::gpx::TrackPoint> &points)
+  {
+    return encode(points, 0, points.size());
+  }
+
+  /**
+   * Decode points and append them to the vector.
+   *
+   * @return false when data are malformed, points vector may contain partial result then
+   */
+  static bool decode(const QByteArray &data, std::vector<osmscout::gpx::TrackPoint> &points);
+
+  /**
+   * Read just point count from the header, without decoding the data.
+   * @return -1 when data are malformed
+   */
+  static qint64 pointCount(const QByteArray &data);
+};
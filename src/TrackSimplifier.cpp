@@ -0,0 +1,165 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "TrackSimplifier.h"
+#include "TrackPointCodec.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace osmscout;
+
+namespace {
+constexpr double EarthRadius = 6371010.0; // meters, same as libosmscout
+constexpr double DegToRad = M_PI / 180.0;
+
+struct LocalPoint
+{
+  double x;
+  double y;
+};
+
+/**
+ * Squared distance of point p from line segment a-b, in local projection
+ */
+double segmentDistanceSquared(const LocalPoint &p, const LocalPoint &a, const LocalPoint &b)
+{
+  double dx = b.x - a.x;
+  double dy = b.y - a.y;
+  double lengthSquared = dx * dx + dy * dy;
+  double t = lengthSquared > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / lengthSquared : 0;
+  t = std::max(0.0, std::min(1.0, t));
+  double ex = a.x + t * dx - p.x;
+  double ey = a.y + t * dy - p.y;
+  return ex * ex + ey * ey;
+}
+}
+
+int TrackSimplifier::levelForZoom(int zoom)
+{
+  // ground resolution of 256 px tile on the equator
+  double metersPerPixel = 2 * M_PI * EarthRadius / 256.0 / std::pow(2.0, std::max(0, zoom));
+  for (int level = LevelCount - 1; level >= 0; level--) {
+    if (Tolerances[level] <= metersPerPixel) {
+      return level;
+    }
+  }
+  return -1;
+}
+
+std::vector<gpx::TrackPoint> TrackSimplifier::simplify(const std::vector<gpx::TrackPoint> &points,
+                                                       double tolerance)
+{
+  if (points.size() <= 2) {
+    return points;
+  }
+
+  // equirectangular projection is precise enough for track chunks
+  double lonScale = std::cos(points.front().coord.GetLat() * DegToRad) * EarthRadius * DegToRad;
+  std::vector<LocalPoint> local;
+  local.reserve(points.size());
+  for (const auto &p: points) {
+    local.push_back(LocalPoint{p.coord.GetLon() * lonScale, p.coord.GetLat() * EarthRadius * DegToRad});
+  }
+
+  std::vector<bool> keep(points.size(), false);
+  keep.front() = true;
+  keep.back() = true;
+  double toleranceSquared = tolerance * tolerance;
+
+  // iterative variant, recursion depth may be large for long segments
+  std::vector<std::pair<size_t, size_t>> stack;
+  stack.emplace_back(0, points.size() - 1);
+  while (!stack.empty()) {
+    auto [first, last] = stack.back();
+    stack.pop_back();
+
+    double maxDistance = 0;
+    size_t farthest = first;
+    for (size_t i = first + 1; i < last; i++) {
+      double distance = segmentDistanceSquared(local[i], local[first], local[last]);
+      if (distance > maxDistance) {
+        maxDistance = distance;
+        farthest = i;
+      }
+    }
+    if (maxDistance > toleranceSquared) {
+      keep[farthest] = true;
+      stack.emplace_back(first, farthest);
+      stack.emplace_back(farthest, last);
+    }
+  }
+
+  std::vector<gpx::TrackPoint> result;
+  for (size_t i = 0; i < points.size(); i++) {
+    if (keep[i]) {
+      result.push_back(points[i]);
+    }
+  }
+  return result;
+}
+
+void TrackSimplifier::append(const std::vector<gpx::TrackPoint> &points)
+{
+  if (points.empty()) {
+    return;
+  }
+
+  // points of the chunk that were added to previous level
+  std::vector<gpx::TrackPoint> input;
+  input.reserve(points.size() + 1);
+  const std::vector<gpx::TrackPoint> *chunk = &points;
+  std::vector<gpx::TrackPoint> added;
+
+  for (int level = 0; level < LevelCount; level++) {
+    if (chunk->empty()) {
+      return;
+    }
+    std::vector<gpx::TrackPoint> &output = levels[level];
+    // last point of previous chunk is kept in all levels, simplification continues from it
+    input.clear();
+    if (!output.empty()) {
+      input.push_back(output.back());
+    }
+    input.insert(input.end(), chunk->begin(), chunk->end());
+
+    std::vector<gpx::TrackPoint> simplified = simplify(input, Tolerances[level]);
+    size_t from = output.empty() ? 0 : 1;
+    added.assign(simplified.begin() + from, simplified.end());
+    output.insert(output.end(), added.begin(), added.end());
+    chunk = &added;
+  }
+}
+
+std::vector<QByteArray> TrackSimplifier::encodeLevels() const
+{
+  std::vector<QByteArray> result;
+  result.reserve(LevelCount);
+  for (const auto &level: levels) {
+    result.push_back(TrackPointCodec::encode(level));
+  }
+  return result;
+}
+
+void TrackSimplifier::clear()
+{
+  for (auto &level: levels) {
+    level.clear();
+  }
+}
@@ -0,0 +1,78 @@
+/*
+  OSMScout for SFOS
+  Copyright (C) 2022 Lukas Karas
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#pragma once
+
+#include <osmscoutgpx/TrackPoint.h>
+
+#include <QByteArray>
+
+#include <array>
+#include <vector>
+
+/**
+ * Douglas-Peucker simplification of track segment to several levels of detail (LOD),
+ * used for displaying tracks on the map with lower zoom.
+ *
+ * Segment is simplified by chunks, consecutive chunks share the boundary point,
+ * so working memory is bounded by the chunk size. Simplified output of all levels
+ * is kept until the segment is finished, the least simplified level may retain
+ * most of the segment points. Distance error
+ * of every level is still bounded by its tolerance. Level n is simplified from level n-1.
+ */
+class TrackSimplifier
+{
+public:
+  static constexpr int LevelCount = 4;
+
+  /** tolerance of levels in meters */
+  static constexpr std::array<double, LevelCount> Tolerances{5, 20, 80, 320};
+
+  /**
+   * Most simplified level that is still precise enough for map zoom level.
+   * @return -1 when raw points should be used
+   */
+  static int levelForZoom(int zoom);
+
+  /**
+   * Simplify points, first and last point is always kept.
+   */
+  static std::vector<osmscout::gpx::TrackPoint> simplify(const std::vector<osmscout::gpx::TrackPoint> &points,
+                                                         double tolerance);
+
+  /**
+   * Append chunk of segment points to all levels.
+   */
+  void append(const std::vector<osmscout::gpx::TrackPoint> &points);
+
+  const std::vector<osmscout::gpx::TrackPoint>& level(int level) const
+  {
+    return levels[level];
+  }
+
+  /**
+   * All levels packed by TrackPointCodec
+   */
+  std::vector<QByteArray> encodeLevels() const;
+
+  void clear();
+
+private:
+  std::array<std::vector<osmscout::gpx::TrackPoint>, LevelCount> levels;
+};
@@ -23,6 +23,13 @@
 #include <QDebug>
 #include <osmscout/util/Geometry.h>
 
+namespace {
+  // Journaled points are durable already, compaction to the database is one SQLite transaction,
+  // so it is done rarely. Open track displayed from the database may be delayed by this interval.
+  constexpr qint64 JournalCompactPoints = 1000;
+  constexpr qint64 JournalCompactIntervalMs = 10 * 60 * 1000;
+}
+
 Tracker::Tracker() {
   Storage *storage = Storage::getInstance();
   assert(storage);
@@ -59,10 +66,22 @@ Tracker::Tracker() {
           storage, &Storage::appendNodes,
           Qt::QueuedConnection);
 
+  connect(this, &Tracker::compactJournalRequest,
+          storage, &Storage::compactJournal,
+          Qt::QueuedConnection);
+
   connect(storage, &Storage::collectionDetailsLoaded,
           this, &Tracker::onCollectionDetailsLoaded,
           Qt::QueuedConnection);
 
+  connect(storage, &Storage::collectionChanged,
+          this, &Tracker::onCollectionChanged,
+          Qt::QueuedConnection);
+
+  connect(this, &Tracker::collectionDetailsRequest,
+          storage, &Storage::loadCollectionDetails,
+          Qt::QueuedConnection);
+
   connect(storage, &Storage::collectionDeleted,
           this, &Tracker::onCollectionDeleted,
           Qt::QueuedConnection);
@@ -75,16 +94,30 @@ Tracker::Tracker() {
           storage, &Storage::editTrack,
           Qt::QueuedConnection);
 
+  journalSyncTimer.setSingleShot(true);
+  journalSyncTimer.setInterval(TrackJournal::DefaultSyncIntervalMs);
+  connect(&journalSyncTimer, &QTimer::timeout, this, [this](){
+    if (journal != nullptr) {
+      journal->flush();
+    }
+  });
+
   init();
 }
 
 Tracker::~Tracker(){
   if (isTracking() && !batch->empty()){
-    flushBatch(false);
+    flushBatch(false, true);
   }
 }
 
 void Tracker::init(){
+  // journal is opened by Storage initialisation, points in memory batch would not be journaled during tracking
+  Storage *storage = Storage::getInstance();
+  if (journal == nullptr && !isTracking() && storage->trackJournal().isOpen()) {
+    journal = &storage->trackJournal();
+    journal->setSyncPolicy(journalSyncPolicy);
+  }
   emit openTrackRequested();
 }
 
@@ -184,15 +217,45 @@ void Tracker::startTracking(QString collectionId, QString trackName, QString tra
   emit createTrackRequest(collId, trackName, trackDescription, true);
 }
 
-void Tracker::flushBatch(bool createNewSegment){
-  emit appendNodesRequest(track.id,
-                          batch,
-                          track.statistics,
-                          createNewSegment);
+void Tracker::flushBatch(bool createNewSegment, bool force){
+  if (journal != nullptr) {
+    // points are in the journal already, including the segment flag
+    uncompactedPoints += batch->size();
+    if (!sinceCompaction.isValid()) {
+      sinceCompaction.start();
+    }
+    if (force ||
+        uncompactedPoints >= JournalCompactPoints ||
+        sinceCompaction.hasExpired(JournalCompactIntervalMs)) {
+      emit compactJournalRequest(track.id, track.statistics);
+      uncompactedPoints = 0;
+      sinceCompaction.start();
+    }
+  } else {
+    emit appendNodesRequest(track.id,
+                            batch,
+                            track.statistics,
+                            createNewSegment);
+  }
 
   batch = std::make_shared<std::vector<osmscout::gpx::TrackPoint>>();
 }
 
+void Tracker::setJournalSyncPolicy(int policy){
+  if (policy < int(TrackJournal::SyncPolicy::Never) || policy > int(TrackJournal::SyncPolicy::EveryRecord)) {
+    qWarning() << "Invalid journal sync policy" << policy;
+    return;
+  }
+  if (int(journalSyncPolicy) == policy) {
+    return;
+  }
+  journalSyncPolicy = TrackJournal::SyncPolicy(policy);
+  if (journal != nullptr) {
+    journal->setSyncPolicy(journalSyncPolicy);
+  }
+  emit journalSyncPolicyChanged();
+}
+
 void Tracker::stopTrackingWithoutSync(){
   batch = std::make_shared<std::vector<osmscout::gpx::TrackPoint>>();
   track.id = -1;
@@ -208,7 +271,7 @@ void Tracker::stopTracking(){
     return;
   }
 
-  flushBatch(false);
+  flushBatch(false, true);
   emit closeTrackRequest(track.collectionId, track.id);
 
   track.id = -1;
@@ -274,7 +337,7 @@ void Tracker::locationChanged(const QDateTime &timestamp,
 
   if (closeSegment || batch->size() > 100 || diffFromFirst > std::chrono::minutes(1)) {
     // append point batch to track (with flag for creating new segment)
-    flushBatch(closeSegment);
+    flushBatch(closeSegment, false);
   }
 
   // update track statistics
@@ -285,6 +348,21 @@ void Tracker::locationChanged(const QDateTime &timestamp,
   track.statistics = accumulator.accumulate();
   emit statisticsUpdated();
 
+  if (journal != nullptr && !journal->append(track.id, point, closeSegment)) {
+    // store journaled points and continue without journal
+    qWarning() << "Appending to track journal failed, points are buffered in memory";
+    flushBatch(false, true);
+    journal = nullptr;
+    if (closeSegment) {
+      flushBatch(true, true); // just creates new segment
+    }
+  } else if (journal != nullptr &&
+             journalSyncPolicy == TrackJournal::SyncPolicy::Interval &&
+             !journalSyncTimer.isActive()) {
+    // last points before GPS pause would stay unsynced otherwise
+    journalSyncTimer.start();
+  }
+
   assert(batch);
   batch->push_back(point);
 }
@@ -302,9 +380,16 @@ void Tracker::onTrackCreated(qint64 collectionId, qint64 trackId, QString name){
   emit trackingChanged();
 }
 
-void Tracker::onCollectionDetailsLoaded(Collection collection, bool ok) {
-  if (ok && isTracking() && collection.tracks){
-    for (const auto &t : *(collection.tracks)) {
+void Tracker::onCollectionChanged(qint64 collectionId) {
+  // tracked track may be renamed or moved to this collection
+  if (isTracking()) {
+    emit collectionDetailsRequest(Collection(collectionId));
+  }
+}
+
+void Tracker::onCollectionDetailsLoaded(CollectionSnapshot collection, bool ok) {
+  if (ok && isTracking() && collection->tracks){
+    for (const auto &t : *(collection->tracks)) {
       if (track.id == t.id) {
 
         if (track.collectionId != t.collectionId) {
@@ -20,6 +20,9 @@
 
 #include "Storage.h"
 
+#include <QElapsedTimer>
+#include <QTimer>
+
 class Tracker : public QObject {
   Q_OBJECT
   Q_DISABLE_COPY(Tracker)
@@ -39,6 +42,9 @@ class Tracker : public QObject {
   Q_PROPERTY(QString name READ getName NOTIFY trackingChanged)
   Q_PROPERTY(QString description READ getDescription NOTIFY trackingChanged)
 
+  //! fsync policy of the track journal: 0 - never, 1 - in interval, 2 - every point, see TrackJournal::SyncPolicy
+  Q_PROPERTY(int journalSyncPolicy READ getJournalSyncPolicy WRITE setJournalSyncPolicy NOTIFY journalSyncPolicyChanged)
+
   Q_PROPERTY(qint64 errors READ getErrors NOTIFY errorsChanged)
   Q_PROPERTY(QString lastError READ getLastError NOTIFY errorsChanged)
 
@@ -64,11 +70,14 @@ signals:
   void errorsChanged();
   void trackingChanged();
   void statisticsUpdated();
+  void journalSyncPolicyChanged();
 
   // for storage
   void openTrackRequested();
   void createTrackRequest(qint64 collectionId, QString name, QString description, bool open);
   void closeTrackRequest(qint64 collectionId, qint64 trackId);
+  void collectionDetailsRequest(Collection collection);
+  void compactJournalRequest(qint64 trackId, TrackStatistics statistics);
   void appendNodesRequest(qint64 trackId,
                           std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> batch,
                           TrackStatistics statistics,
@@ -80,7 +89,8 @@ public slots:
   void init();
   void onOpenTrackLoaded(Track track, bool ok);
   void onTrackCreated(qint64 collectionId, qint64 trackId, QString name);
-  void onCollectionDetailsLoaded(Collection collection, bool ok);
+  void onCollectionDetailsLoaded(CollectionSnapshot collection, bool ok);
+  void onCollectionChanged(qint64 collectionId);
   void onCollectionDeleted(qint64 collectionId);
   void onTrackDeleted(qint64 collectionId, qint64 trackId);
   void onError(QString message);
@@ -136,6 +146,12 @@ public:
     return lastError;
   }
 
+  int getJournalSyncPolicy() const {
+    return int(journalSyncPolicy);
+  }
+
+  void setJournalSyncPolicy(int policy);
+
   QString getName() const;
   QString getDescription() const;
 
@@ -154,7 +170,11 @@ public:
   double getMaxElevation() const;
 
 private:
-  void flushBatch(bool createNewSegment);
+  /**
+   * Hand the batch to Storage. Journaled points are compacted to the database
+   * just when force is true or compaction threshold is reached.
+   */
+  void flushBatch(bool createNewSegment, bool force);
 
   /**
    * Stop tracking, but don't write changes to database
@@ -167,6 +187,11 @@ private:
   Track recentOpenTrack;
   std::shared_ptr<std::vector<osmscout::gpx::TrackPoint>> batch{std::make_shared<std::vector<osmscout::gpx::TrackPoint>>()};
   TrackStatisticsAccumulator accumulator;
+  TrackJournal *journal{nullptr}; // owned by Storage, batch points are appended to database when it is not available
+  TrackJournal::SyncPolicy journalSyncPolicy{TrackJournal::SyncPolicy::Interval};
+  qint64 uncompactedPoints{0}; // journaled points that was not compacted to the database yet
+  QElapsedTimer sinceCompaction;
+  QTimer journalSyncTimer; // flush of points appended in sync interval, when no other point arrives
   QString lastError;
   qint64 errors{0};
 };